@@ -0,0 +1,418 @@
+#include "FrameHost.hpp"
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates the host side of the binary protocol, call start() before adding commands
+ *
+ *  @param[in] send Writes a frame out to the board, e.g. to the serial port
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+FrameHost::FrameHost(void (*send)(const uint8_t* data, uint8_t length))
+{
+    _send = send;
+    _first = 0;
+    _numFrames = 0;
+    _nextSequence = 0;
+    _lastTime = 0;
+    _length = 0;
+    _count = 0;
+    _credits = 0;
+    _started = 0;
+    _querying = 0;
+    _skipNaks = 0;
+    _freeBlocks = 0;
+    _queuedTime = 0;
+    _moving = 0;
+    _stalled = 0;
+    _telemetry = NULL;
+    _resent = 0;
+    _rejected = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sets what's called with every telemetry record the board sends after M990
+ *
+ *  @param[in] handler Gets the record, laid out as a TelemetryRecord, and the number of records still to come.
+ *                     NULL to drop them.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::onTelemetry(void (*handler)(const uint8_t* record, uint8_t length, uint8_t left))
+{
+    _telemetry = handler;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts a new stream, dropping whatever wasn't sent or ACKed. Commands are taken once the board replied.
+ *
+ *  @param[in] nowMs Current time [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::start(unsigned long nowMs)
+{
+    _decoder.reset();
+    _first = 0;
+    _numFrames = 0;
+    _length = 0;
+    _count = 0;
+    _credits = 0;
+    _skipNaks = 0;
+    _started = 0;
+    query(nowMs);
+}
+
+//=========================================//
+//                 SENDING                 //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Packs a command into the frame being built, sending that frame first if the command doesn't fit
+ *
+ *  @param[in] cmd   Tokenized command
+ *  @param[in] nowMs Current time [ms]
+ *
+ *  @return 0 if the command can't be taken now, there are no credits or too many frames are in flight
+ *          1 if the command was taken,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::add(const Command* cmd, unsigned long nowMs)
+{
+    // If its a NULL pointer, return 2
+    if(cmd == NULL)
+        return 2;
+
+    if(!_started)
+        return 0;
+
+    // Out of credits, what's packed goes out so the board can start on it
+    if(_count >= _credits){
+        flush(nowMs);
+        return 0;
+    }
+
+    uint8_t record[FRAME_RECORD_MAX];
+    uint8_t n = encodeCommand(cmd, record);
+    if((_length + n > FRAME_MAX_PAYLOAD) && !flush(nowMs))
+        return 0;
+
+    memcpy(_payload + _length, record, n);
+    _length += n;
+    _count++;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends the frame being built, if any
+ *
+ *  @param[in] nowMs Current time [ms]
+ *
+ *  @return 0 if it has to wait, too many frames are in flight
+ *          1 if it was sent or there was nothing to send
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::flush(unsigned long nowMs)
+{
+    if(_count == 0)
+        return 1;
+    if((_numFrames == HOST_WINDOW) || _querying)
+        return 0;
+
+    HostFrame* frame = &_window[(_first + _numFrames) % HOST_WINDOW];
+    frame->sequence = _nextSequence++;
+    frame->count = _count;
+    frame->length = writeFrame(frame->sequence, _payload, _length, frame->frame);
+    _send(frame->frame, frame->length);
+
+    if(_numFrames++ == 0)
+        _lastTime = nowMs;
+    _credits -= _count;
+    _length = 0;
+    _count = 0;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends every frame in flight again, oldest first
+ *
+ *  @param[in] nowMs Current time [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::resend(unsigned long nowMs)
+{
+    for(uint8_t i = 0; i < _numFrames; i++){
+        HostFrame* frame = &_window[(_first + i) % HOST_WINDOW];
+        _send(frame->frame, frame->length);
+        _resent++;
+    }
+    _lastTime = nowMs;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends an empty frame, asking for the credits. Only while no frame is in flight, it restarts the sequence.
+ *
+ *  @param[in] nowMs Current time [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::query(unsigned long nowMs)
+{
+    uint8_t frame[FRAME_OVERHEAD];
+    _send(frame, writeFrame(_nextSequence++, NULL, 0, frame));
+    _querying = 1;
+    _lastTime = nowMs;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends frames again that got no reply, and asks for credits while there are none. Call it regularly.
+ *
+ *  @param[in] nowMs Current time [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::poll(unsigned long nowMs)
+{
+    unsigned long elapsed = nowMs - _lastTime;
+
+    if(_querying){
+        if(elapsed >= HOST_TIMEOUT_MS)
+            query(nowMs);
+    }
+    else if(_numFrames > 0){
+        if(elapsed >= HOST_TIMEOUT_MS){
+            _skipNaks = 0;
+            resend(nowMs);
+        }
+    }
+    else if(_started && (_count >= _credits) && (elapsed >= HOST_QUERY_MS)){
+        query(nowMs);
+    }
+}
+
+//=========================================//
+//                RECEIVING                //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Consumes one byte received from the board, handling its reply frames
+ *
+ *  @param[in] c     Byte received
+ *  @param[in] nowMs Current time [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::receive(uint8_t c, unsigned long nowMs)
+{
+    // A corrupted reply is as good as a lost one, the timeout takes care of it
+    if(_decoder.receive(c) == FRAME_DONE)
+        handleReply(nowMs);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Handles the reply just received
+ *
+ *  @param[in] nowMs Current time [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::handleReply(unsigned long nowMs)
+{
+    const uint8_t* payload = _decoder.payload();
+    uint8_t length = _decoder.length();
+    uint8_t sequence = _decoder.sequence();
+
+    if((length == 2) && (payload[0] == FRAME_ACK)){
+        if(_querying && (sequence == (uint8_t)(_nextSequence - 1))){
+            _querying = 0;
+            _started = 1;
+        }
+        ackUpTo(sequence);
+        _skipNaks = 0;
+        setCredits(payload[1]);
+    }
+    else if((length == 6) && (payload[0] == FRAME_STATUS)){
+        // Sent with the number of the frame expected next, everything before it made it
+        ackUpTo(sequence - 1);
+        setCredits(payload[1]);
+        _freeBlocks = payload[2];
+        _queuedTime = payload[3] | ((unsigned long)payload[4] << 8);
+        _moving = (payload[5] & FRAME_STATUS_MOVING) != 0;
+        _stalled = (payload[5] & FRAME_STATUS_STALL) != 0;
+    }
+    else if((length > 2) && (payload[0] == FRAME_TELEMETRY)){
+        // Only sent when asked for, it doesn't ACK anything
+        if(_telemetry != NULL)
+            _telemetry(payload + 2, length - 2, payload[1]);
+        return;
+    }
+    else if((length == 3) && (payload[0] == FRAME_NAK)){
+        // The frames before the one expected next made it
+        ackUpTo(sequence - 1);
+        setCredits(payload[2]);
+
+        if(payload[1] == FRAME_ERR_COMMAND){
+            _rejected++;
+        }
+        else if(_skipNaks > 0){
+            _skipNaks--;
+        }
+        else{
+            // Every frame in flight after the first will be NAKed too, before the ones sent again get a reply
+            _skipNaks = (_numFrames > 0) ? (_numFrames - 1) : 0;
+
+            // Without room the frame is only sent again after the timeout, the board needs time to free some
+            if(payload[1] != FRAME_ERR_ROOM)
+                resend(nowMs);
+            return;
+        }
+    }
+    else{
+        return;
+    }
+
+    _lastTime = nowMs;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Drops the frames in flight up to a sequence number, they're queued on the board
+ *
+ *  @param[in] sequence Sequence number of the last frame ACKed
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::ackUpTo(uint8_t sequence)
+{
+    while((_numFrames > 0) && ((uint8_t)(sequence - _window[_first].sequence) < 128)){
+        _first = (_first + 1) % HOST_WINDOW;
+        _numFrames--;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Takes the credits of a reply. The frames still in flight were sent after the board worked them out.
+ *
+ *  @param[in] credits Credits of the reply
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameHost::setCredits(uint8_t credits)
+{
+    uint8_t count = committed();
+    _credits = (credits > count) ? (credits - count) : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of commands in flight
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::committed(void)
+{
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < _numFrames; i++)
+        count += _window[(_first + i) % HOST_WINDOW].count;
+
+    return count;
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if the board replied to start(), so commands are taken
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::ready(void)
+{
+    return _started;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the number of commands that can still be added, as far as the host knows
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::credits(void)
+{
+    return (_credits > _count) ? (_credits - _count) : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the number of frames sent and not yet ACKed
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::inFlight(void)
+{
+    return _numFrames;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the free blocks of the board's MotionQueue, as of the last status
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::freeBlocks(void)
+{
+    return _freeBlocks;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets how long the board's queued moves take, as of the last status [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long FrameHost::queuedTime(void)
+{
+    return _queuedTime;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if the board's step engine was running, as of the last status
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::moving(void)
+{
+    return _moving;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if an axis of the board stalled and has to be homed again, as of the last status
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameHost::stalled(void)
+{
+    return _stalled;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get how many frames were sent again
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long FrameHost::getResent(void)
+{
+    return _resent;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get how many frames the board skipped because they held an invalid command
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long FrameHost::getRejected(void)
+{
+    return _rejected;
+}
@@ -0,0 +1,97 @@
+#ifndef FRAMEHOST_HPP
+#define FRAMEHOST_HPP
+
+#include "../inc/Frame.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define HOST_WINDOW             4       // Frames sent and not yet ACKed, at most
+#define HOST_TIMEOUT_MS         200     // Time without a reply before the frames in flight are sent again [ms]
+#define HOST_QUERY_MS           300     // How often the credits are asked for while there are none, in case a status was lost [ms]
+
+/**
+ * @brief A frame sent and not yet ACKed, kept to be sent again
+ */
+typedef struct {
+    uint8_t sequence;
+    uint8_t count;                      // Commands in it
+    uint8_t length;                     // [Bytes]
+    uint8_t frame[FRAME_MAX_LENGTH];
+} HostFrame;
+
+/**
+ * @brief Host side of the binary protocol, the counterpart of FrameLink on the board.
+ * Plain C++, it builds anywhere the firmware's Frame.cpp does.
+ *
+ * Commands added are packed into a frame until it's full or flushed. Up to HOST_WINDOW
+ * frames are in flight at once, so the link never sits idle waiting for a reply. The
+ * commands in flight are kept under the credits of the last reply, so no frame is ever
+ * turned away for lack of room: add() returns 0 instead and the command has to be added
+ * again later.
+ *
+ * A NAK sends every frame in flight again, from the one the board expects next. The
+ * frames already behind it when that happens are NAKed as well, those NAKs are skipped.
+ * Frames getting no reply at all are sent again after HOST_TIMEOUT_MS.
+ *
+ * The status frames the board sends on its own keep the credits up to date and tell how
+ * much motion is queued, so a streamer can keep the board's queues full without polling.
+ */
+class FrameHost
+{
+public:
+    FrameHost(void (*send)(const uint8_t* data, uint8_t length));
+
+    void start(unsigned long nowMs);
+    uint8_t add(const Command* cmd, unsigned long nowMs);
+    uint8_t flush(unsigned long nowMs);
+    void receive(uint8_t c, unsigned long nowMs);
+    void poll(unsigned long nowMs);
+    void onTelemetry(void (*handler)(const uint8_t* record, uint8_t length, uint8_t left));
+
+    uint8_t ready(void);
+    uint8_t credits(void);
+    uint8_t inFlight(void);
+    uint8_t freeBlocks(void);
+    unsigned long queuedTime(void);
+    uint8_t moving(void);
+    uint8_t stalled(void);
+    unsigned long getResent(void);
+    unsigned long getRejected(void);
+
+private:
+    void handleReply(unsigned long nowMs);
+    void ackUpTo(uint8_t sequence);
+    void resend(unsigned long nowMs);
+    void query(unsigned long nowMs);
+    void setCredits(uint8_t credits);
+    uint8_t committed(void);
+
+    void (*_send)(const uint8_t* data, uint8_t length);
+    FrameDecoder _decoder;
+
+    HostFrame _window[HOST_WINDOW];
+    uint8_t _first;                     // Index of the oldest frame in flight
+    uint8_t _numFrames;                 // Frames in flight
+    uint8_t _nextSequence;
+    unsigned long _lastTime;            // When a reply was last received, or frames sent to an idle link [ms]
+
+    uint8_t _payload[FRAME_MAX_PAYLOAD];
+    uint8_t _length;                    // Bytes of the frame being packed
+    uint8_t _count;                     // Commands of the frame being packed
+
+    uint8_t _credits;                   // Credits of the last reply, less the commands sent after it
+    uint8_t _started;                   // The board replied to the empty frame of start()
+    uint8_t _querying;                  // An empty frame is waiting for its reply
+    uint8_t _skipNaks;                  // NAKs still on their way for frames already sent again
+    uint8_t _freeBlocks;                // Free blocks of the board's MotionQueue, from the last status
+    unsigned long _queuedTime;          // Time the board's queued moves take, from the last status [ms]
+    uint8_t _moving;                    // The board's step engine was running, from the last status
+    uint8_t _stalled;                   // An axis of the board stalled, from the last status
+    void (*_telemetry)(const uint8_t* record, uint8_t length, uint8_t left);
+    unsigned long _resent;              // Frames sent again
+    unsigned long _rejected;            // Frames with invalid commands, skipped by the board
+};
+
+#endif
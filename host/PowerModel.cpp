@@ -0,0 +1,72 @@
+#include "PowerModel.hpp"
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Fills an axis with the POWER_DEFAULT_x values
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void powerAxisDefaults(PowerAxis* axis)
+{
+    axis->phaseAmps = POWER_DEFAULT_PHASE_AMPS;
+    axis->phaseOhms = POWER_DEFAULT_PHASE_OHMS;
+    axis->driverOhms = POWER_DEFAULT_DRIVER_OHMS;
+    axis->logicWatts = POWER_DEFAULT_LOGIC_WATTS;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Power drawn by an axis
+ *
+ *  @param[in] axis Axis to model
+ *  @param[in] on   Set if its driver is on
+ *
+ *  @return [W]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double powerWatts(const PowerAxis* axis, uint8_t on)
+{
+    if(!on)
+        return axis->logicWatts;
+
+    return axis->phaseAmps * axis->phaseAmps * (axis->phaseOhms + axis->driverOhms) + axis->logicWatts;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Energy drawn by an axis over a run
+ *
+ *  @param[in] axis         Axis to model
+ *  @param[in] onSeconds    Time its driver was on [s]
+ *  @param[in] totalSeconds Length of the run [s]
+ *
+ *  @return [J]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double powerEnergy(const PowerAxis* axis, double onSeconds, double totalSeconds)
+{
+    double offSeconds = (totalSeconds > onSeconds) ? (totalSeconds - onSeconds) : 0;
+
+    return powerWatts(axis, 1) * onSeconds + powerWatts(axis, 0) * offSeconds;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief How long a battery lasts, with the drivers on for a share of the time
+ *
+ *  @param[in] axes      Axes to model
+ *  @param[in] dutyCycle Share of the time each driver is on, from 0 to 1
+ *  @param[in] numAxes   Number of axes
+ *  @param[in] batteryWh Energy of the battery that can be used [Wh]
+ *
+ *  @return [h]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double powerRuntime(const PowerAxis axes[], const double dutyCycle[], uint8_t numAxes, double batteryWh)
+{
+    double watts = 0;
+
+    for(uint8_t i = 0; i < numAxes; i++)
+        watts += powerWatts(&axes[i], 1) * dutyCycle[i] + powerWatts(&axes[i], 0) * (1.0 - dutyCycle[i]);
+
+    return (watts > 0) ? (batteryWh / watts) : 0;
+}
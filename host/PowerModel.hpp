@@ -0,0 +1,41 @@
+#ifndef POWERMODEL_HPP
+#define POWERMODEL_HPP
+
+#include <stdint.h>
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// A NEMA 17 with 2.4 Ohm phases on an A4988 set to 0.8 A, the driver's logic on 5 V
+#define POWER_DEFAULT_PHASE_AMPS    0.8     // [A]
+#define POWER_DEFAULT_PHASE_OHMS    2.4     // [Ohms]
+#define POWER_DEFAULT_DRIVER_OHMS   0.75    // A4988 source and sink MOSFETs together [Ohms]
+#define POWER_DEFAULT_LOGIC_WATTS   0.04    // [W]
+
+/**
+ * @brief What one axis draws, on and off
+ */
+typedef struct {
+    double phaseAmps;                   // Current limit set on the driver, the peak phase current [A]
+    double phaseOhms;                   // Resistance of a motor phase [Ohms]
+    double driverOhms;                  // On resistance of the driver's bridge, source and sink [Ohms]
+    double logicWatts;                  // Drawn by the driver whether it's on or off [W]
+} PowerAxis;
+
+/**
+ * @brief Energy model of the drivers, to size the battery of a timelapse from how long each
+ * driver is on. Plain C++, it builds anywhere.
+ *
+ * A chopper driver holds its phase current whether the motor turns or not, and microstepping
+ * splits it so the squares of both phase currents add up to the peak squared. So a driver on
+ * burns the peak current squared in the motor's and its own resistance, moving or holding,
+ * and a driver off only its logic. At speed the back EMF lowers the current a bit, which is
+ * left out, so the model errs on the side of a bigger battery.
+ */
+void powerAxisDefaults(PowerAxis* axis);
+double powerWatts(const PowerAxis* axis, uint8_t on);
+double powerEnergy(const PowerAxis* axis, double onSeconds, double totalSeconds);
+double powerRuntime(const PowerAxis axes[], const double dutyCycle[], uint8_t numAxes, double batteryWh);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef COMMAND_HPP
+#define COMMAND_HPP
+
+#include "Hal.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define FIXED_SCALE         1000L       // Fixed-point arguments are in thousandths, e.g. millidegrees
+
+#define ARG_P               0           // Pan argument index
+#define ARG_T               1           // Tilt argument index
+#define ARG_I               2           // Time, interval, overlap or arc center pan offset argument index
+#define ARG_J               3           // Exposure, order or arc center tilt offset argument index
+#define NUM_OF_ARGS         4
+
+#define ARG_P_BIT           (1 << ARG_P)
+#define ARG_T_BIT           (1 << ARG_T)
+#define ARG_I_BIT           (1 << ARG_I)
+#define ARG_J_BIT           (1 << ARG_J)
+
+typedef enum {
+    CMD_NONE = 0,                       // Empty or unparsable command
+    CMD_MOVE,                           // G0/G1 P<deg> T<deg>
+    CMD_HOME,                           // G28
+    CMD_ABS,                            // G90
+    CMD_REL,                            // G91
+    CMD_ENABLE,                         // M17
+    CMD_DISABLE,                        // M18
+    CMD_SPEED,                          // M203 P<deg/s> T<deg/s>
+    CMD_KEYFRAME,                       // M420 P<deg> T<deg> I<s>, adds a keyframe of a sequence at I, without arguments clears them
+    CMD_SEQUENCE,                       // M421 I<interval s> J<exposure s> P<settle s>, runs the sequence, without arguments stops it
+    CMD_SHOOT,                          // M240
+    CMD_IDLE,                           // M84 P<s> T<s>, without arguments same as M18
+    CMD_HOME_OFFSET,                    // M206 P<deg> T<deg>, position of the magnets' centers once homed
+    CMD_TELEMETRY,                      // M990, sends the telemetry records as binary frames
+    CMD_ARC_CW,                         // G2 P<deg> T<deg> I<deg> J<deg>, clockwise around the center at I J from the start
+    CMD_ARC_CCW,                        // G3 P<deg> T<deg> I<deg> J<deg>, counterclockwise
+    CMD_PANO_FRAME,                     // M422 P<deg> T<deg> I<overlap> J<order>, field of view of a frame of the panoramas
+    CMD_PANORAMA,                       // M423 P<deg> T<deg> I<settle s> J<exposure s>, shoots a panorama from here, without arguments stops it
+    NUM_OF_OPS                          // Not a command, new ops go above it
+} CommandOp;
+
+/**
+ * @brief A command in its tokenized form, ready to be executed without any more parsing
+ */
+typedef struct {
+    uint8_t op;                         // CommandOp
+    uint8_t argMask;                    // ARG_x_BIT set for every argument given
+    int32_t args[NUM_OF_ARGS];          // Arguments [1/FIXED_SCALE of their unit]
+} Command;
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef COMMANDEXECUTOR_HPP
+#define COMMANDEXECUTOR_HPP
+
+#include "Hal.hpp"
+#include "Command.hpp"
+#include "MotionProcessor.hpp"
+#include "MotorPower.hpp"
+#include "Panorama.hpp"
+#include "Sequencer.hpp"
+#include "Telemetry.hpp"
+
+/**
+ * @brief Turns tokenized commands into calls on the MotionProcessor
+ */
+class CommandExecutor
+{
+public:
+    CommandExecutor(MotionProcessor* motion, Sequencer* sequencer = NULL, Panorama* panorama = NULL);
+
+    uint8_t execute(const Command* cmd);
+
+private:
+    LongVector endPoint(const Command* cmd);
+
+    MotionProcessor* _motion;
+    Sequencer* _sequencer;              // Runs M420/M421, NULL to leave them unknown
+    Panorama* _panorama;                // Runs M422/M423, NULL to leave them unknown
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef COMMANDPARSER_HPP
+#define COMMANDPARSER_HPP
+
+#include "Hal.hpp"
+#include "Command.hpp"
+#include "CommandQueue.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define PARSE_NONE          0           // Byte consumed, no command finished
+#define PARSE_DONE          1           // A command was finished
+#define PARSE_ERROR         2           // The line is invalid, the rest of it is skipped
+
+typedef enum {
+    PARSE_LETTER,                       // Waiting for the letter of the next word
+    PARSE_NUMBER,                       // Inside the number of a word
+    PARSE_COMMENT,                      // Skipping a comment until the end of the line
+    PARSE_SKIP                          // Skipping an invalid line until its end
+} ParseState;
+
+/**
+ * @brief Single pass, byte at a time parser of G-code style commands, e.g. "G1 P12.5 T-3".
+ *
+ * Bytes are consumed as they arrive and each word is folded into the command as soon as it
+ * ends, so nothing is buffered as text. Numbers are accumulated straight into fixed-point.
+ * Given a CommandQueue, commands are written in place into a reserved slot and committed
+ * when their line ends.
+ */
+class CommandParser
+{
+public:
+    CommandParser(void);
+    CommandParser(CommandQueue* queue);
+
+    uint8_t parse(char c);
+    const Command* command(void);
+    void reset(void);
+
+private:
+    void startWord(char letter);
+    uint8_t endWord(void);
+    uint8_t endLine(void);
+
+    CommandQueue* _queue;               // Queue to write commands into, NULL to keep them in _own
+    Command* _cmd;                      // Command being parsed
+    Command _own;
+
+    ParseState _state;
+    uint8_t _words;                     // Words finished on this line, the first one is the command code
+    char _letter;                       // Letter of the word being parsed
+    uint8_t _negative;
+    uint8_t _dot;                       // Set once past the decimal point
+    uint8_t _digits;
+    uint8_t _decimals;                  // Digits kept after the decimal point
+    int32_t _whole;
+    int32_t _fraction;
+};
+
+uint8_t tokenizeCommand(const char* text, Command* cmd);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef COMMANDQUEUE_HPP
+#define COMMANDQUEUE_HPP
+
+#include "Hal.hpp"
+#include "Command.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define COMMAND_QUEUE_SIZE      8       // Number of slots, must be a power of two no bigger than 128
+#define COMMAND_QUEUE_MASK      (COMMAND_QUEUE_SIZE - 1)
+#define COMMAND_TEXT_LENGTH     32      // Longest text command a slot holds, including the '\0'
+
+#define SLOT_TEXT               0       // Slot holds text that is tokenized on commit
+#define SLOT_TOKEN              1       // Slot holds a tokenized command
+
+#if (COMMAND_QUEUE_SIZE & COMMAND_QUEUE_MASK) || (COMMAND_QUEUE_SIZE > 128)
+#error "COMMAND_QUEUE_SIZE must be a power of two no bigger than 128"
+#endif
+
+/**
+ * @brief A slot of the CommandQueue. The text is only needed until the command is tokenized,
+ * so both share the same memory.
+ */
+typedef struct {
+    uint8_t state;                      // SLOT_TEXT or SLOT_TOKEN
+    union {
+        char text[COMMAND_TEXT_LENGTH];
+        Command cmd;
+    };
+} CommandSlot;
+
+/**
+ * @brief FIFO of commands that works in place, without copying them in or out.
+ *
+ * The producer reserves the tail slot, writes into it and commits it. The consumer borrows
+ * the head slot, executes it and releases it. Text written in a slot is tokenized once on
+ * commit, so the consumer only ever sees the binary form.
+ *
+ * Safe with one producer and one consumer running concurrently, e.g. a serial receive
+ * interrupt and the main loop, without disabling interrupts. The producer only writes
+ * _tail and the consumer only writes _head. Both are free running byte counters, read and
+ * written whole in a single access, and masked into slot indexes. Their difference is the
+ * number of commands stored, so all slots are usable and no shared full flag or counter is
+ * needed. A slot is published with a release store of the index and picked up with an
+ * acquire load, so its contents are complete before the other side can see it.
+ */
+class CommandQueue
+{
+public:
+    CommandQueue(void);
+
+    // Producer side
+    CommandSlot* reserveCommand(void);
+    uint8_t commitCommand(void);
+
+    // Consumer side
+    const Command* borrowCommand(void);
+    uint8_t releaseCommand(void);
+
+    uint8_t isEmpty(void);
+    uint8_t isFull(void);
+    uint8_t numCommands(void);
+
+private:
+    CommandSlot _slots[COMMAND_QUEUE_SIZE];
+    uint8_t _head;                      // Commands released so far, only written by the consumer
+    uint8_t _tail;                      // Commands committed so far, only written by the producer
+};
+
+#endif
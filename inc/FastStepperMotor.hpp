@@ -0,0 +1,312 @@
+#ifndef FASTSTEPPERMOTOR_HPP
+#define FASTSTEPPERMOTOR_HPP
+
+#include "Hal.hpp"
+#include "StepperMotor.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define STEP_PULSE_US       2           // Minimum high time of a step pulse [us], covers the A4988 (1us) and the DRV8825 (1.9us)
+
+// Port registers are only resolved at build time for the Uno's ATmega328P, anything else goes through the hal
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define FAST_PIN_DIRECT
+#endif
+
+#define FAST_PORT_D         0
+#define FAST_PORT_B         1
+#define FAST_PORT_C         2
+
+/**
+ * @brief A digital pin fixed at build time.
+ *
+ * On the ATmega328P the port and the bitmask are worked out by the compiler from the pin
+ * number, so writing the pin is a single sbi/cbi and reading it a single sbic/sbis instead
+ * of going through the pin to port tables of digitalWrite() and digitalRead(). Those
+ * instructions are also atomic, so the step interrupt and the main loop can share a port.
+ * The pin still has to be set up with halPinMode() once.
+ */
+template<uint8_t PIN>
+struct FastPin
+{
+#ifdef FAST_PIN_DIRECT
+    static_assert(PIN < 20, "FastPin only knows the pins of the ATmega328P");
+
+    // Pins 0-7 are on PORTD, 8-13 on PORTB and 14-19 (A0-A5) on PORTC
+    static const uint8_t PORT = (PIN < 8) ? FAST_PORT_D : (PIN < 14) ? FAST_PORT_B : FAST_PORT_C;
+    static const uint8_t MASK = 1 << ((PIN < 8) ? PIN : (PIN < 14) ? (PIN - 8) : (PIN - 14));
+
+    static inline void high(void) __attribute__((always_inline))
+    {
+        if(PIN < 8)         PORTD |= MASK;
+        else if(PIN < 14)   PORTB |= MASK;
+        else                PORTC |= MASK;
+    }
+
+    static inline void low(void) __attribute__((always_inline))
+    {
+        if(PIN < 8)         PORTD &= ~MASK;
+        else if(PIN < 14)   PORTB &= ~MASK;
+        else                PORTC &= ~MASK;
+    }
+
+    static inline uint8_t read(void) __attribute__((always_inline))
+    {
+        if(PIN < 8)         return (PIND & MASK) != 0;
+        else if(PIN < 14)   return (PINB & MASK) != 0;
+        else                return (PINC & MASK) != 0;
+    }
+#else
+    static inline void high(void)       { halDigitalWrite(PIN, HIGH); }
+    static inline void low(void)        { halDigitalWrite(PIN, LOW); }
+    static inline uint8_t read(void)    { return halDigitalRead(PIN); }
+#endif
+
+    static inline void write(uint8_t value) __attribute__((always_inline))
+    {
+        if(value)
+            high();
+        else
+            low();
+    }
+};
+
+/**
+ * @brief Holds the step pin high for STEP_PULSE_US, counted in cycles so it costs no call
+ */
+static inline void stepPulseDelay(void) __attribute__((always_inline));
+static inline void stepPulseDelay(void)
+{
+#ifdef FAST_PIN_DIRECT
+    __builtin_avr_delay_cycles((F_CPU / 1000000UL) * STEP_PULSE_US);
+#else
+    halDelayMicroseconds(STEP_PULSE_US);
+#endif
+}
+
+/**
+ * @brief StepperMotor with its pins fixed at build time.
+ *
+ * Same API as StepperMotor, but every pin access is a FastPin so stepping, setting the
+ * direction and reading the endstop are single register instructions on the Uno.
+ */
+template<uint8_t DIR_PIN, uint8_t STEP_PIN, uint8_t EN_PIN, uint8_t ENDSTOP_PIN>
+class FastStepperMotor
+{
+public:
+    typedef FastPin<DIR_PIN> DirPin;
+    typedef FastPin<STEP_PIN> StepPin;
+    typedef FastPin<ENDSTOP_PIN> EndstopPin;
+
+    /**
+     * @brief Sets up the pins. Only needed if no StepperMotor was initialized on the same pins.
+     *
+     * @param[in] en_value Value of the enable pin to start with
+     * @param[in] endstop_pin_setup PULLUP_ENDSTOP to turn the endstop's pullup on
+     */
+    void init(uint8_t en_value, pinSetup_t endstop_pin_setup = NONE)
+    {
+        halPinMode(DIR_PIN, OUTPUT);
+        halPinMode(STEP_PIN, OUTPUT);
+        halPinMode(EN_PIN, OUTPUT);
+
+        if((en_value != 0) && (en_value != 1))
+            en_value = 0;
+
+        FastPin<EN_PIN>::write(en_value);
+
+        if (endstop_pin_setup == PULLUP_ENDSTOP)
+            halPinMode(ENDSTOP_PIN, INPUT_PULLUP);
+        else
+            halPinMode(ENDSTOP_PIN, INPUT);
+    }
+
+    void enable(void)                   { FastPin<EN_PIN>::write(EN_MOTOR_ON); }
+    void disable(void)                  { FastPin<EN_PIN>::write(EN_MOTOR_OFF); }
+    void setDir(uint8_t pinVal)         { FastPin<DIR_PIN>::write(pinVal); }
+
+    /**
+     * @brief Steps unless the endstop is pressed. Direction should be set before calling this.
+     *
+     * @return 0 if step not taken due to reaching endstop, 1 if step was taken
+     */
+    uint8_t step(void)
+    {
+        if (endstop())
+            return 0;
+
+        hardStep();
+        return 1;
+    }
+
+    uint8_t step(uint8_t dir)
+    {
+        if (endstop())
+            return 0;
+
+        hardStep(dir);
+        return 1;
+    }
+
+    /**
+     * @brief Steps without considering the endstop
+     */
+    void hardStep(void)
+    {
+        FastPin<STEP_PIN>::high();
+        stepPulseDelay();
+        FastPin<STEP_PIN>::low();
+    }
+
+    void hardStep(uint8_t dir)
+    {
+        setDir(dir);
+        hardStep();
+    }
+
+    /**
+     * @return 1 if pressed/activated, 0 otherwise
+     */
+    uint8_t endstop(void)
+    {
+        return !FastPin<ENDSTOP_PIN>::read(); // Inverted because 0 is active since endstops are setup as input pullup
+    }
+};
+
+/**
+ * @brief Mode select pins of a driver fixed at build time, so the step interrupt can switch
+ * the microstep resolution between two pulses with three single pin writes. Their pins are
+ * set up by StepperMotor::initMicrostep().
+ */
+template<uint8_t MS1_PIN, uint8_t MS2_PIN, uint8_t MS3_PIN>
+struct FastModePins
+{
+    /**
+     * @brief Sets the mode
+     *
+     * @param[in] modeBits Level of MS1 in bit 0, MS2 in bit 1 and MS3 in bit 2
+     */
+    static inline void set(uint8_t modeBits) __attribute__((always_inline))
+    {
+        FastPin<MS1_PIN>::write(modeBits & 0x01);
+        FastPin<MS2_PIN>::write(modeBits & 0x02);
+        FastPin<MS3_PIN>::write(modeBits & 0x04);
+    }
+};
+
+/**
+ * @brief Two FastStepperMotors stepped together.
+ *
+ * Every axis to step is given as a bit of a mask, bit 0 for M0 and bit 1 for M1. All the DIR
+ * lines are written first, then all the STEP lines go up together and come back down together
+ * after one pulse, so the axes step without skew between them. Pins sharing a port are written
+ * with a single read-modify-write of that port. Call it from the step interrupt, or while it's
+ * stopped, since those writes aren't atomic like the single pin ones.
+ */
+template<class M0, class M1>
+class FastMotorGroup
+{
+public:
+    /**
+     * @brief Sets the direction of every axis
+     *
+     * @param[in] dirMask Direction pin value of axis i in bit i
+     */
+    void setDirs(uint8_t dirMask)
+    {
+#ifdef FAST_PIN_DIRECT
+        writePort(FAST_PORT_D, dirBits(FAST_PORT_D, 0x03), dirBits(FAST_PORT_D, dirMask));
+        writePort(FAST_PORT_B, dirBits(FAST_PORT_B, 0x03), dirBits(FAST_PORT_B, dirMask));
+        writePort(FAST_PORT_C, dirBits(FAST_PORT_C, 0x03), dirBits(FAST_PORT_C, dirMask));
+#else
+        M0::DirPin::write(dirMask & 0x01);
+        M1::DirPin::write(dirMask & 0x02);
+#endif
+    }
+
+    /**
+     * @brief Steps every axis of the mask at once, without considering the endstops.
+     *        Direction should be set before calling this.
+     *
+     * @param[in] axisMask Axis i steps if bit i is set
+     */
+    void step(uint8_t axisMask)
+    {
+        if(axisMask == 0)
+            return;
+
+#ifdef FAST_PIN_DIRECT
+        uint8_t d = stepBits(FAST_PORT_D, axisMask);
+        uint8_t b = stepBits(FAST_PORT_B, axisMask);
+        uint8_t c = stepBits(FAST_PORT_C, axisMask);
+
+        if(d) PORTD |= d;
+        if(b) PORTB |= b;
+        if(c) PORTC |= c;
+        stepPulseDelay();
+        if(d) PORTD &= ~d;
+        if(b) PORTB &= ~b;
+        if(c) PORTC &= ~c;
+#else
+        if(axisMask & 0x01) M0::StepPin::high();
+        if(axisMask & 0x02) M1::StepPin::high();
+        stepPulseDelay();
+        if(axisMask & 0x01) M0::StepPin::low();
+        if(axisMask & 0x02) M1::StepPin::low();
+#endif
+    }
+
+    /**
+     * @brief Sets the directions, then steps every axis of the mask at once
+     *
+     * @param[in] axisMask Axis i steps if bit i is set
+     * @param[in] dirMask Direction pin value of axis i in bit i
+     */
+    void step(uint8_t axisMask, uint8_t dirMask)
+    {
+        setDirs(dirMask);
+        stepPulseDelay();               // Direction setup time before the step edge
+        step(axisMask);
+    }
+
+    /**
+     * @brief Reads every endstop
+     *
+     * @return Endstop of axis i in bit i, set if pressed/activated
+     */
+    uint8_t endstops(void)
+    {
+        return (M0::EndstopPin::read() ? 0 : 0x01) | (M1::EndstopPin::read() ? 0 : 0x02);   // Inverted like StepperMotor::endstop()
+    }
+
+private:
+#ifdef FAST_PIN_DIRECT
+    // Bits of a port driven by the pins of the masked axes. Everything but the mask is known at build time.
+    static inline uint8_t stepBits(uint8_t port, uint8_t axisMask) __attribute__((always_inline))
+    {
+        return (((axisMask & 0x01) && (M0::StepPin::PORT == port)) ? M0::StepPin::MASK : 0) |
+               (((axisMask & 0x02) && (M1::StepPin::PORT == port)) ? M1::StepPin::MASK : 0);
+    }
+
+    static inline uint8_t dirBits(uint8_t port, uint8_t axisMask) __attribute__((always_inline))
+    {
+        return (((axisMask & 0x01) && (M0::DirPin::PORT == port)) ? M0::DirPin::MASK : 0) |
+               (((axisMask & 0x02) && (M1::DirPin::PORT == port)) ? M1::DirPin::MASK : 0);
+    }
+
+    // Replaces the used bits of a port, skipped entirely for ports the group has no pin on
+    static inline void writePort(uint8_t port, uint8_t used, uint8_t set) __attribute__((always_inline))
+    {
+        if(used == 0)
+            return;
+
+        if(port == FAST_PORT_D)         PORTD = (PORTD & ~used) | set;
+        else if(port == FAST_PORT_B)    PORTB = (PORTB & ~used) | set;
+        else                            PORTC = (PORTC & ~used) | set;
+    }
+#endif
+};
+
+#endif
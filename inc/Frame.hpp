@@ -0,0 +1,99 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include "Hal.hpp"
+#include "Command.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define FRAME_SYNC              0xA5    // Starts every frame, never part of a text command
+#define FRAME_MAX_PAYLOAD       48      // Largest payload, so a whole frame fits the Uno's 64 byte serial buffer
+#define FRAME_OVERHEAD          5       // Sync, length, sequence and the CRC-16
+#define FRAME_MAX_LENGTH        (FRAME_MAX_PAYLOAD + FRAME_OVERHEAD)
+#define FRAME_CRC_INIT          0xFFFF
+
+#define FRAME_RECORD_MAX        (2 + 4 * NUM_OF_ARGS)  // Largest command record
+#define FRAME_OP_MASK           0x0F    // Bits of a record's first byte holding the op, the argMask is above them
+#define FRAME_OP_EXTENDED       CMD_NONE  // Op bits of a record whose op doesn't fit them, the op is in the next byte
+#define FRAME_ARG_SHIFT         4
+
+// Payload of the replies, its first byte
+#define FRAME_ACK               0x06    // [ACK, credits], the frame was queued or already had been
+#define FRAME_NAK               0x15    // [NAK, reason, credits], the frame was dropped
+#define FRAME_STATUS            0x13    // [STATUS, credits, free blocks, queued time low, high, flags], sent unasked
+#define FRAME_TELEMETRY         0x14    // [TELEMETRY, records left, TelemetryRecord], sent after M990
+
+// Flags of a status
+#define FRAME_STATUS_MOVING     0x01    // The step engine is running
+#define FRAME_STATUS_STALL      0x02    // An axis stalled, it has to be homed again
+
+// Reasons of a NAK
+#define FRAME_ERR_CRC           1       // The frame was corrupted
+#define FRAME_ERR_SEQUENCE      2       // The frame isn't the next one, a frame before it was lost
+#define FRAME_ERR_ROOM          3       // The frame has more commands than there are credits
+#define FRAME_ERR_COMMAND       4       // The payload holds an invalid command
+
+#define FRAME_NONE              0       // Byte consumed, no frame finished
+#define FRAME_DONE              1       // A valid frame was finished
+#define FRAME_ERROR             2       // A frame was finished but its CRC doesn't match
+
+#if (FRAME_MAX_PAYLOAD + FRAME_OVERHEAD) > 64
+#error "A frame has to fit the serial receive buffer"
+#endif
+static_assert((NUM_OF_ARGS <= 8 - FRAME_ARG_SHIFT) && (NUM_OF_OPS <= 256),
+              "The argMask has to fit the first byte of a record, and the op the byte after it");
+
+typedef enum {
+    FRAME_WAIT_SYNC,                    // Waiting for the sync byte
+    FRAME_WAIT_LENGTH,
+    FRAME_WAIT_SEQUENCE,
+    FRAME_WAIT_PAYLOAD,
+    FRAME_WAIT_CRC_LOW,
+    FRAME_WAIT_CRC_HIGH
+} FrameState;
+
+/**
+ * @brief Byte at a time receiver of binary frames.
+ *
+ * A frame is FRAME_SYNC, the payload length, a sequence number, the payload, then the
+ * CRC-16/CCITT-FALSE of the length, sequence and payload, low byte first. Commands are
+ * packed in the payload back to back as records: one byte with the op in its low bits
+ * and the argMask above it, then each argument given as a little endian int32 in
+ * 1/FIXED_SCALE of its unit, e.g. a move of both axes is 9 bytes. An op past FRAME_OP_MASK
+ * has FRAME_OP_EXTENDED in the low bits instead and takes a byte of its own after the first. Arguments go through
+ * exactly as the text parser would have tokenized them, with no parsing at all.
+ *
+ * A length over FRAME_MAX_PAYLOAD can't be a frame, so the receiver drops back to looking
+ * for the next sync byte.
+ */
+class FrameDecoder
+{
+public:
+    FrameDecoder(void);
+
+    uint8_t receive(uint8_t c);
+    void reset(void);
+    uint8_t receiving(void);
+
+    const uint8_t* payload(void);
+    uint8_t length(void);
+    uint8_t sequence(void);
+
+private:
+    FrameState _state;
+    uint8_t _length;
+    uint8_t _sequence;
+    uint8_t _count;                     // Payload bytes received so far
+    uint16_t _crc;                      // CRC of what was received so far
+    uint16_t _received;                 // CRC sent with the frame
+    uint8_t _payload[FRAME_MAX_PAYLOAD];
+};
+
+uint16_t frameCrc(uint16_t crc, uint8_t c);
+uint8_t writeFrame(uint8_t sequence, const uint8_t* payload, uint8_t length, uint8_t* frame);
+uint8_t encodeCommand(const Command* cmd, uint8_t* record);
+uint8_t decodeCommand(const uint8_t* record, uint8_t length, Command* cmd);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef FRAMELINK_HPP
+#define FRAMELINK_HPP
+
+#include "Hal.hpp"
+#include "Frame.hpp"
+#include "CommandQueue.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define FRAME_STATUS_US         20000UL                 // Shortest time between two status frames [us]
+#define FRAME_STATUS_IDLE_US    250000UL                // Longest time without one, while nothing changes [us]
+#define FRAME_STATUS_XON        (COMMAND_QUEUE_SIZE / 2) // Credits going up to this are reported right away
+
+/**
+ * @brief Board side of the binary protocol, queuing the commands of every frame received
+ * and answering each frame with a reply frame.
+ *
+ * Frames are numbered by the host, one after the other, wrapping around after 255. A frame
+ * is only taken in order, as a whole: all of its commands are queued, or none are. The
+ * reply carries the number of credits, the free slots of the CommandQueue once the frame
+ * was queued. The host keeps the commands it has in flight under its credits, so a frame
+ * never has to wait for room.
+ *
+ * The reply to a frame queued, or one received again because its ACK was lost, is
+ * [FRAME_ACK, credits] with the sequence number of that frame. Any other frame is dropped
+ * and answered with [FRAME_NAK, reason, credits] with the sequence number of the frame
+ * expected next, so the host sends again from there. An empty frame doesn't queue anything
+ * and makes its sequence number the current one, which is how the host starts a stream
+ * or asks for the credits.
+ *
+ * Once the host spoke binary, the board also reports on its own, so the host never has to
+ * poll. A status frame carries the credits, the free blocks of the MotionQueue and how long
+ * the queued moves take, and is sent whenever the credits changed since the last reply,
+ * at most every FRAME_STATUS_US, and at least every FRAME_STATUS_IDLE_US. Credits coming
+ * back up to FRAME_STATUS_XON after running low are sent right away, like an XON, so a
+ * host waiting on them can send a full frame without delay. Its sequence number is the
+ * one of the frame expected next, so it also ACKs every frame before it.
+ *
+ * After M990, text or binary, the telemetry records go out one frame each, whenever the
+ * serial buffer has room for a whole one, so the dump never makes the main loop wait.
+ */
+class FrameLink
+{
+public:
+    FrameLink(CommandQueue* queue, void (*send)(const uint8_t* data, uint8_t length), uint8_t (*room)(void));
+
+    uint8_t receive(uint8_t c);
+    uint8_t receiving(void);
+    uint8_t credits(void);
+    void service(void);
+
+private:
+    void accept(void);
+    void reply(uint8_t sequence, uint8_t type, uint8_t reason);
+    void send(const uint8_t* payload, uint8_t length, uint8_t sequence);
+    void sendTelemetry(void);
+
+    FrameDecoder _decoder;
+    CommandQueue* _queue;
+    void (*_send)(const uint8_t* data, uint8_t length);
+    uint8_t (*_room)(void);
+    uint8_t _expected;                  // Sequence number of the next frame
+    uint8_t _active;                    // A frame was received, so the host reads binary
+    uint8_t _reported;                  // Credits sent last
+    unsigned long _reportTime;          // When credits were sent last [us]
+};
+
+#endif
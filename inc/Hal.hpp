@@ -0,0 +1,164 @@
+#ifndef HAL_HPP
+#define HAL_HPP
+
+/**
+ * @brief Hardware abstraction of everything the motion code touches: pins, delays, time,
+ * the step timer, interrupts and the EEPROM.
+ *
+ * On the board every hal function is an inline wrapper of its Arduino/TimerOne counterpart,
+ * so it costs nothing. Built anywhere else they are implemented by the simulator in
+ * HalSim.cpp, which runs on virtual time so the same motion code can be tested and profiled
+ * on a host.
+ */
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <TimerOne.h>
+#include <avr/eeprom.h>
+
+#define HAL_EEPROM_SIZE     (E2END + 1)
+
+static inline void halPinMode(uint8_t pin, uint8_t mode)        { pinMode(pin, mode); }
+static inline void halDigitalWrite(uint8_t pin, uint8_t value)  { digitalWrite(pin, value); }
+static inline uint8_t halDigitalRead(uint8_t pin)               { return digitalRead(pin); }
+
+static inline void halDelay(unsigned long ms)                   { delay(ms); }
+static inline void halDelayMicroseconds(unsigned int us)        { delayMicroseconds(us); }
+static inline unsigned long halMicros(void)                     { return micros(); }
+
+static inline void halNoInterrupts(void)                        { noInterrupts(); }
+static inline void halInterrupts(void)                          { interrupts(); }
+
+/**
+ * @brief Sets the step timer up, stopped, to call isr every periodUs once started
+ */
+static inline void halTimerInit(unsigned long periodUs, void (*isr)(void))
+{
+    Timer1.initialize(periodUs);
+    Timer1.attachInterrupt(isr);
+    Timer1.stop();
+}
+
+static inline void halTimerStart(void)                          { Timer1.start(); }
+static inline void halTimerStop(void)                           { Timer1.stop(); }
+
+/**
+ * @brief Times the step interrupt off Timer1 itself, for a couple of cycles instead of two micros().
+ * The step period is short enough for TimerOne to run Timer1 unprescaled, counting up from the
+ * tick to TOP and back down, one count per cycle. halTimerMark() clears the flag set at TOP, so
+ * halTimerElapsed() tells which way it's counting. Good for up to one period.
+ */
+#define HAL_TIMER_COUNTS_PER_US (F_CPU / 1000000UL)
+
+static inline void halTimerMark(void)                           { TIFR1 = _BV(ICF1); }
+
+static inline uint16_t halTimerElapsed(void)
+{
+    uint16_t count = TCNT1;
+    return (TIFR1 & _BV(ICF1)) ? (2 * ICR1 - count) : count;
+}
+
+/**
+ * @brief The EEPROM writes a byte in the background in about 3.4 ms. halEepromWrite() waits for
+ * the write before it to finish, then only starts its own, so checking halEepromReady() first
+ * never blocks.
+ */
+static inline uint8_t halEepromRead(uint16_t address)           { return eeprom_read_byte((const uint8_t*)address); }
+static inline void halEepromWrite(uint16_t address, uint8_t value) { eeprom_write_byte((uint8_t*)address, value); }
+static inline uint8_t halEepromReady(void)                      { return eeprom_is_ready(); }
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define PI              3.1415926535897932384626433832795
+
+void halPinMode(uint8_t pin, uint8_t mode);
+void halDigitalWrite(uint8_t pin, uint8_t value);
+uint8_t halDigitalRead(uint8_t pin);
+
+void halDelay(unsigned long ms);
+void halDelayMicroseconds(unsigned int us);
+unsigned long halMicros(void);
+
+void halNoInterrupts(void);
+void halInterrupts(void);
+
+void halTimerInit(unsigned long periodUs, void (*isr)(void));
+void halTimerStart(void);
+void halTimerStop(void);
+
+#define HAL_TIMER_COUNTS_PER_US 16          // Counts like the Uno's Timer1, one per cycle at 16 MHz
+
+void halTimerMark(void);
+uint16_t halTimerElapsed(void);
+
+#define HAL_EEPROM_SIZE     1024            // EEPROM of the Uno [Bytes]
+
+uint8_t halEepromRead(uint16_t address);
+void halEepromWrite(uint16_t address, uint8_t value);
+uint8_t halEepromReady(void);
+
+//=========================================//
+//                SIMULATOR                //
+//=========================================//
+
+#define HAL_SIM_PINS        20              // Pins of the Uno
+#define HAL_SIM_AXES        2
+#define HAL_SIM_EDGES       65536           // Edges kept before the oldest ones are overwritten
+#define HAL_SIM_EEPROM_US   3400            // Time the EEPROM takes to write a byte [us]
+
+/**
+ * @brief A pin changing level
+ */
+typedef struct {
+    unsigned long time;                     // Virtual time [us]
+    uint8_t pin;
+    uint8_t value;
+} HalSimEdge;
+
+/**
+ * @brief Host time taken by the calls of the timer interrupt
+ */
+typedef struct {
+    unsigned long calls;
+    unsigned long worstNs;                  // Longest call [ns]
+    double totalNs;                         // [ns]
+} HalSimIsrTime;
+
+void halSimReset(void);
+void halSimPowerCycle(void);
+void halSimAxis(uint8_t axis, uint8_t stepPin, uint8_t dirPin, uint8_t hallPin, uint8_t forwardDir, double stepsPerDegree);
+void halSimMagnet(uint8_t axis, double angle, double width, uint8_t detectedLevel);
+void halSimMicrostep(uint8_t axis, uint8_t ms1Pin, uint8_t ms2Pin, uint8_t ms3Pin, uint8_t microsteps);
+void halSimDriver(uint8_t axis, uint8_t enPin, uint8_t onLevel, unsigned long wakeUs);
+void halSimSlip(uint8_t axis, long steps);
+void halSimGlitch(uint8_t axis, unsigned long us);
+void halSimRun(unsigned long us);
+unsigned long halSimTime(void);
+long halSimSteps(uint8_t axis);
+double halSimAngle(uint8_t axis);
+unsigned long halSimPulses(uint8_t axis);
+unsigned long halSimMisaligned(uint8_t axis);
+unsigned long halSimOnTime(uint8_t axis);
+unsigned long halSimMissed(uint8_t axis);
+unsigned long halSimNumEdges(void);
+const HalSimEdge* halSimEdge(unsigned long index);
+void halSimClearEdges(void);
+void halSimIsrTime(HalSimIsrTime* time);
+void halSimClearIsrTime(void);
+void halSimEepromErase(void);
+unsigned long halSimEepromWrites(uint16_t address);
+
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef KINEMATICS_HPP
+#define KINEMATICS_HPP
+
+#include "Hal.hpp"
+#include "Command.hpp"
+#include "PinDef.h"
+
+/**
+ * Fixed-point angles. The motion path keeps angles in millidegrees (FIXED_SCALE), the
+ * same unit commands are parsed into, and only converts from or to degrees at the API edge.
+ *
+ * Millidegrees go to steps with one multiply by the steps per millidegree in Q0.32 and a
+ * rounding shift, never a division. Positions are always converted whole, from the absolute
+ * target, so the step position is a pure function of the angle and no rounding can build
+ * up over any number of moves. Within KIN_EXACT_MDEG of home it's the exact nearest step.
+ */
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define KIN_SHIFT               32
+
+// Steps per millidegree [Q0.32], rounded. Worked out by the compiler.
+#define PAN_STEPS_PER_MDEG      ((uint32_t)(4294967296.0 / (PAN_STEPRATE * FIXED_SCALE) + 0.5))
+#define TILT_STEPS_PER_MDEG     ((uint32_t)(4294967296.0 / (TILT_STEPRATE * FIXED_SCALE) + 0.5))
+
+// The conversions give the exact nearest step within this of home, about 350 turns, see test_step_exact [Millidegrees]
+#define KIN_EXACT_MDEG          126000000L
+
+// Arcs are traced from their center in 1/ARC_Q of a millidegree, see StepEngine
+#define ARC_Q                   4096L
+#define ARC_MAX_RADIUS          360000L     // Biggest radius, so the traced vector fits a long [Millidegrees]
+
+// Size of a step of each axis along an arc [1/ARC_Q of a millidegree]
+#define ARC_PAN_STEP            ((long)(PAN_STEPRATE * FIXED_SCALE * ARC_Q + 0.5))
+#define ARC_TILT_STEP           ((long)(TILT_STEPRATE * FIXED_SCALE * ARC_Q + 0.5))
+
+static_assert((ARC_MAX_RADIUS + PAN_STEPRATE * FIXED_SCALE) * ARC_Q < 2147483647.0 &&
+              (ARC_MAX_RADIUS + TILT_STEPRATE * FIXED_SCALE) * ARC_Q < 2147483647.0,
+              "An arc's vector and the spans of its steps have to fit a long");
+
+static_assert((PAN_STEPRATE * FIXED_SCALE > 1.0) && (TILT_STEPRATE * FIXED_SCALE > 1.0),
+              "A step must be more than a millidegree for the steps per millidegree to fit in Q0.32");
+
+//=========================================//
+//               CONVERSIONS               //
+//=========================================//
+
+/**
+ * @brief Converts an angle to the nearest step, halves rounded up
+ *
+ * @param[in] mdeg         Angle [Millidegrees]
+ * @param[in] stepsPerMdeg Steps per millidegree of the axis [Q0.32]
+ */
+static inline long stepsFromMdeg(long mdeg, uint32_t stepsPerMdeg)
+{
+    return (long)(((int64_t)mdeg * stepsPerMdeg + (1LL << (KIN_SHIFT - 1))) >> KIN_SHIFT);
+}
+
+static inline long panStepsFromMdeg(long mdeg)      { return stepsFromMdeg(mdeg, PAN_STEPS_PER_MDEG); }
+static inline long tiltStepsFromMdeg(long mdeg)     { return stepsFromMdeg(mdeg, TILT_STEPS_PER_MDEG); }
+
+/**
+ * @brief API edge, converts degrees to the nearest millidegree
+ */
+static inline long mdegFromDegrees(double degrees)
+{
+    return lround(degrees * FIXED_SCALE);
+}
+
+/**
+ * @brief API edge, converts millidegrees to degrees
+ */
+static inline double degreesFromMdeg(long mdeg)
+{
+    return (double)mdeg / FIXED_SCALE;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef MICROSTEP_HPP
+#define MICROSTEP_HPP
+
+#include "Hal.hpp"
+
+/**
+ * Microstep resolution of each axis. Steps everywhere in the motion path are microsteps of
+ * the finest mode, the one PAN_STEPRATE and TILT_STEPRATE are worked out for. Slow moves
+ * are stepped in it, fast ones switch the driver to a coarser mode so each pulse moves
+ * 1 << COARSE_SHIFT microsteps, and the step interrupt emits that many times fewer pulses.
+ *
+ * The driver only takes a coarser mode cleanly on a position of its coarser grid, so the
+ * planner only switches on a full step: on a multiple of MICROSTEPS of the driver's index.
+ * The index counts from where the driver was powered up or reset, which is index 0 of
+ * every mode.
+ */
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// Microsteps per full step of the finest mode, a power of two
+#ifndef PAN_MICROSTEPS
+#define PAN_MICROSTEPS          16
+#endif
+#ifndef TILT_MICROSTEPS
+#define TILT_MICROSTEPS         16
+#endif
+
+// Fast moves step 1 << this many microsteps per pulse, 0 never leaves the finest mode. 2 goes from 1/16 to 1/4 steps.
+#ifndef PAN_COARSE_SHIFT
+#define PAN_COARSE_SHIFT        2
+#endif
+#ifndef TILT_COARSE_SHIFT
+#define TILT_COARSE_SHIFT       2
+#endif
+
+// Moves cruising faster than this on an axis step it in the coarse mode [Degrees/Sec]
+#ifndef PAN_COARSE_SPEED
+#define PAN_COARSE_SPEED        45.0
+#endif
+#ifndef TILT_COARSE_SPEED
+#define TILT_COARSE_SPEED       30.0
+#endif
+
+// Mode select pins of the drivers, MS1 to MS3 of the A4988
+#ifndef PAN_MS1_PIN
+#define PAN_MS1_PIN             10
+#define PAN_MS2_PIN             11
+#define PAN_MS3_PIN             12
+#endif
+#ifndef TILT_MS1_PIN
+#define TILT_MS1_PIN            16      // A2
+#define TILT_MS2_PIN            17      // A3
+#define TILT_MS3_PIN            18      // A4
+#endif
+
+// Levels of the mode select pins, MS1 in bit 0, for 1 << log2 microsteps per full step. The A4988's
+// full, half, quarter, eighth and sixteenth steps. Use (log2) for the DRV8825's M0 to M2, up to 1/32.
+#ifndef MICROSTEP_MODE_BITS
+#define MICROSTEP_MODE_BITS(log2)   (((log2) >= 4) ? 0x07 : (log2))
+#endif
+
+#define MICROSTEP_MIN_FULL_STEPS    2   // A move only switches if it has this many full steps to go coarse over
+
+constexpr uint8_t microstepLog2(unsigned long microsteps)
+{
+    return (microsteps <= 1) ? 0 : 1 + microstepLog2(microsteps >> 1);
+}
+
+#define PAN_MICROSTEP_LOG2      microstepLog2(PAN_MICROSTEPS)
+#define TILT_MICROSTEP_LOG2     microstepLog2(TILT_MICROSTEPS)
+
+static_assert(((PAN_MICROSTEPS & (PAN_MICROSTEPS - 1)) == 0) && ((TILT_MICROSTEPS & (TILT_MICROSTEPS - 1)) == 0) &&
+              (PAN_MICROSTEPS <= 64) && (TILT_MICROSTEPS <= 64),
+              "Microsteps per full step have to be a power of two up to 64, so a full step fits the step interrupt's int8_t");
+static_assert((PAN_COARSE_SHIFT <= PAN_MICROSTEP_LOG2) && (TILT_COARSE_SHIFT <= TILT_MICROSTEP_LOG2),
+              "The coarse mode can't step more than a full step per pulse");
+
+#endif
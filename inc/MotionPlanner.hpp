@@ -0,0 +1,94 @@
+#ifndef MOTIONPLANNER_HPP
+#define MOTIONPLANNER_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+#include "MotionQueue.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define PAN_DEFAULT_ACCEL       60.0    // [Degrees/Sec^2]
+#define TILT_DEFAULT_ACCEL      40.0    // [Degrees/Sec^2]
+#define PAN_DEFAULT_JERK        600.0   // [Degrees/Sec^3]
+#define TILT_DEFAULT_JERK       400.0   // [Degrees/Sec^3]
+#define DEFAULT_JUNCTION_DEV    0.05    // [Degrees], how far from the corner the path may round it off
+
+#define SCURVE_ACCEL_MIN_DIV    16      // An S-curve eases its acceleration down to accel/SCURVE_ACCEL_MIN_DIV, never to 0
+
+#define PLANNER_MAX_PARTS       3       // Most blocks a move is queued as, see split()
+
+typedef enum {
+    TRAPEZOID,                          // Constant acceleration ramps
+    SCURVE                              // Jerk limited ramps
+} ProfileMode;
+
+/**
+ * @brief Queues moves for the step engine and plans their speed profiles with look-ahead.
+ *
+ * Every appended move gets a junction speed limit from the angle it makes with the previous
+ * one. A backward pass then raises the entry speeds of the queued moves as far as they can
+ * still brake for what follows, and stops as soon as an entry speed doesn't change. A forward
+ * pass caps them to what can be reached by accelerating and hands the new profiles to the
+ * step interrupt as fixed-point rates, so it never touches a double.
+ *
+ * A move cruising fast enough on an axis to go past its COARSE_SPEED is queued as up to
+ * three blocks: a fine head up to the first full step of the drivers, a coarse body taking
+ * 1 << COARSE_SHIFT microsteps per pulse, and a fine tail from the last full step on. The
+ * full steps are found from the drivers' microstep index, followed from the step engine's
+ * through every move queued, and moves stay fine while it isn't known, e.g. after homing
+ * until the queue runs empty.
+ *
+ * An arc is queued as one block, always fine, that the step interrupt traces whole. It's
+ * blended into the moves around it like a line, through the tangents at its ends.
+ */
+class MotionPlanner
+{
+public:
+    static MotionPlanner* getInstance();
+
+    uint8_t append(const long delta[], const uint8_t dir[], double panFeedrate, double tiltFeedrate);
+    uint8_t appendArc(const long from[], const long center[], const long delta[], double sweep,
+                      double panFeedrate, double tiltFeedrate);
+    unsigned long queuedTime(void);
+    uint8_t hasRoom(void);
+
+    void setProfileMode(ProfileMode mode);
+    ProfileMode getProfileMode(void);
+    void setPanAccel(double accel);
+    void setTiltAccel(double accel);
+    double getPanAccel(void);
+    double getTiltAccel(void);
+    void setPanJerk(double jerk);
+    void setTiltJerk(double jerk);
+    void setJunctionDeviation(double deviation);
+
+private:
+    MotionPlanner(void);
+    static MotionPlanner* instance;
+
+    void trackIndex(void);
+    uint8_t split(const long delta[], const double feedrate[], long part[][STEP_ENGINE_AXES], uint8_t shift[][STEP_ENGINE_AXES]);
+    uint8_t appendBlock(const long delta[], const uint8_t dir[], const uint8_t shift[], const double feedrate[]);
+    void enqueue(MotionBlock* block, const double entryUnit[], const double exitUnit[]);
+    void profile(StepBlock* block, double entry, double cruise, double exit, double accel, double jerk);
+    double rampSteps(double from, double to, double accel, double jerk);
+    double reachable(double from, double distance, double accel, double jerk);
+    double restSpeed(const MotionBlock* block);
+    double junctionSpeed(const double unit[], double accel);
+    void recalculate(void);
+
+    ProfileMode _mode;
+    double _pan_accel;                  // [Steps/Sec^2]
+    double _tilt_accel;                 // [Steps/Sec^2]
+    double _pan_jerk;                   // [Steps/Sec^3]
+    double _tilt_jerk;                  // [Steps/Sec^3]
+    double _junctionDeviation;          // [Degrees]
+    double _prevUnit[STEP_ENGINE_AXES]; // Direction of the newest queued move
+    uint8_t _index[STEP_ENGINE_AXES];   // Microstep index of the drivers once the queued moves are done, as StepEngine::microIndex()
+    uint8_t _indexKnown;                // The index was taken from the idle engine and followed since
+    uint8_t _indexHome;                 // StepEngine::homeCount() when it was taken
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef MOTIONPROCESSOR_HPP
+#define MOTIONPROCESSOR_HPP
+
+#include "Hal.hpp"
+#include "StepperMotor.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define NUM_OF_MOTORS   2               // Pan and tilt
+
+/**
+ * @brief A pan and tilt pair of angles or speeds
+ */
+typedef struct {
+    double p;                           // Pan
+    double t;                           // Tilt
+} DoubleVector;
+
+/**
+ * @brief A pan and tilt pair of steps or millidegrees
+ */
+typedef struct {
+    long p;                             // Pan
+    long t;                             // Tilt
+} LongVector;
+
+static const DoubleVector doubleZeroVect = {0, 0};
+
+typedef enum {
+    ABS,                                // Coordinates are absolute, from home
+    REL                                 // Coordinates are added to where the queued moves end
+} MoveMode;
+
+/**
+ * @brief Moves the pan and tilt head. Moves are queued for the step interrupt to run,
+ * so they return right away unless the motion queue is full.
+ */
+class MotionProcessor
+{
+public:
+    static MotionProcessor* getInstance();
+
+    void home();
+    uint8_t restore(void);
+    void line(DoubleVector coords);
+    void line(LongVector coords);
+    void line(LongVector coords, unsigned long ms);
+    void arc(DoubleVector coords, DoubleVector center, ArcDir dir);
+    void arc(LongVector coords, LongVector center, ArcDir dir);
+
+    static void bresenham(void);
+
+    void setPosition(double p, double t);
+    void setPosition(DoubleVector pos);
+    DoubleVector getPosition(void);
+    LongVector getPositionSteps(void);
+    LongVector getTargetMdeg(void);
+    void shiftPositionSteps(const long shift[]);
+    uint8_t settle(void);
+    uint8_t positionKnown(void);
+    void setHomeOffset(LongVector offset);
+    LongVector getHomeOffset(void);
+
+    void setPanSpeed(double speed);
+    void setTiltSpeed(double speed);
+    double getPanSpeed();
+    double getTiltSpeed();
+    double getPanFeedrate();
+    double getTiltFeedrate();
+    void setMode(MoveMode mode);
+    MoveMode getMode();
+
+    void enableMotors(void);
+    void disableMotors(void);
+    void pause(long us);
+    void shoot(void);
+    uint8_t ready(void);
+    uint8_t canQueue(LongVector target);
+    void registerTryAndExecCallback(void (*tryAndExecCallback)(void));
+
+    StepperMotor motors[NUM_OF_MOTORS];
+
+private:
+    MotionProcessor(void);
+    static MotionProcessor* instance;
+
+    long _delta[NUM_OF_MOTORS];         // Steps of the last move on each axis, signed
+    MoveMode _mode;
+    LongVector _targetMdeg;             // Where the queued moves end [Millidegrees]
+    LongVector _currentPositionSteps;   // Same, converted from _targetMdeg [Steps]
+
+    double _pan_speed;                  // [Degrees/Sec]
+    double _tilt_speed;                 // [Degrees/Sec]
+    double _pan_feedrate;               // [Steps/Sec]
+    double _tilt_feedrate;              // [Steps/Sec]
+    LongVector _homeOffset;             // Position homing gives to the center of the magnets [Millidegrees]
+    uint8_t _restored;                  // The position was taken back from a snapshot, homing only checks it
+
+    long _pan_linearStepDelay;          // [us]
+    long _tilt_linearStepDelay;         // [us]
+
+    unsigned long _pauseDeadline;       // End of the last pause(), the next one is timed from it [us]
+
+    void (*_tryAndExecCallback)(void);  // Called over and over while a command waits
+};
+
+#endif
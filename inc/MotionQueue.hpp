@@ -0,0 +1,76 @@
+#ifndef MOTIONQUEUE_HPP
+#define MOTIONQUEUE_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define MOTION_QUEUE_SIZE   8                       // Must be a power of two, holds MOTION_QUEUE_SIZE-1 blocks
+#define MOTION_QUEUE_MASK   (MOTION_QUEUE_SIZE - 1)
+
+#define BLOCK_BUSY          0x01                    // Set by the step interrupt once it loaded the block
+
+/**
+ * @brief A queued move. The step interrupt only reads step and dir, the rest belongs to the planner.
+ */
+typedef struct {
+    StepBlock step;                                 // What the step interrupt executes
+    uint8_t dir[STEP_ENGINE_AXES];                  // Direction pin value of each axis
+    volatile uint8_t flags;                         // BLOCK_ flags
+
+    // Planner only, speeds are along the path in pan/tilt space
+    double length;                                  // [Degrees]
+    double stepsPerDegree;                          // Leading axis steps per degree of path
+    double nominalSpeed;                            // [Degrees/Sec]
+    double accel;                                   // [Degrees/Sec^2]
+    double jerk;                                    // [Degrees/Sec^3]
+    double maxEntrySpeed;                           // Junction speed limit [Degrees/Sec]
+    double entrySpeed;                              // Highest entry speed the following blocks allow [Degrees/Sec]
+    double exitSpeed;                               // Exit speed of the profile handed to the interrupt [Degrees/Sec]
+} MotionBlock;
+
+/**
+ * @brief FIFO of moves between the planner and the step interrupt.
+ *
+ * The main loop only ever moves the tail and the step interrupt only ever moves the
+ * head, so neither side needs to block the other.
+ * One slot is kept empty to tell a full queue from an empty one without a shared flag.
+ */
+class MotionQueue
+{
+public:
+    static MotionQueue* getInstance();
+
+    // Producer side, main loop
+    MotionBlock* tailBlock(void);
+    void pushBlock(void);
+
+    // Consumer side, step interrupt
+    MotionBlock* headBlock(void);
+    void popBlock(void);
+
+    // Planner access to queued blocks
+    MotionBlock* block(uint8_t index);
+    uint8_t headIndex(void);
+    uint8_t tailIndex(void);
+    uint8_t nextIndex(uint8_t index);
+    uint8_t prevIndex(uint8_t index);
+
+    uint8_t isEmpty(void);
+    uint8_t isFull(void);
+    uint8_t numBlocks(void);
+    void clear(void);
+
+private:
+    MotionQueue(void);
+    static MotionQueue* instance;
+
+    MotionBlock _blocks[MOTION_QUEUE_SIZE];
+    volatile uint8_t _head;                         // Next block to execute, only moved by the interrupt
+    volatile uint8_t _tail;                         // Next free slot, only moved by the main loop
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MOTORPOWER_HPP
+#define MOTORPOWER_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#ifndef MOTOR_WAKE_US
+#define MOTOR_WAKE_US           2000UL  // From enabling a driver to its first step, for the phase current to build up [us]
+#endif
+
+// Idle time after which an axis' driver is turned off, 0 to keep it on [ms]
+#ifndef PAN_IDLE_TIMEOUT_MS
+#define PAN_IDLE_TIMEOUT_MS     5000UL
+#endif
+#ifndef TILT_IDLE_TIMEOUT_MS
+#define TILT_IDLE_TIMEOUT_MS    0UL     // Tilt holds the camera up against gravity, so it stays on unless told otherwise
+#endif
+
+#define MOTOR_IDLE_TIMEOUT_MAX  3600000UL   // Longest idle timeout, well within a wrap of halMicros() [ms]
+
+/**
+ * @brief Turns the drivers off on their own once their axis has been idle for a while, and
+ * back on before the next move that needs them, to save the battery on long timelapses.
+ *
+ * An axis is busy while a queued block steps it or while homing. Once it's been idle for its
+ * timeout, its driver is disabled, which drops its hold current to nothing. The A4988 has no
+ * input to only lower the hold current, so off is the one idle level. The driver's translator
+ * keeps its microstep index while disabled, and the rotor only settles onto the nearest full
+ * step, which it's pulled back from as soon as the driver is on again.
+ *
+ * M18 and M84 go through sleepWhenIdle(), which leaves a driver on until the moves queued
+ * before them are done.
+ *
+ * A move wakes the drivers it needs before it's queued, and waits MOTOR_WAKE_US from there
+ * so the current is up before its first step. That wait only happens on a move that needed
+ * a driver turned on.
+ */
+class MotorPower
+{
+public:
+    static MotorPower* getInstance();
+
+    void attach(StepperMotor* motors);
+    void wake(uint8_t axisMask);
+    uint8_t awake(uint8_t axisMask);
+    void sleep(uint8_t axisMask);
+    void sleepWhenIdle(uint8_t axisMask);
+    void service(void);
+
+    void setIdleTimeout(uint8_t axis, unsigned long ms);
+    unsigned long getIdleTimeout(uint8_t axis);
+    uint8_t enabled(void);
+
+private:
+    MotorPower(void);
+    static MotorPower* instance;
+
+    uint8_t busyAxes(void);
+
+    StepperMotor* _motors;                          // Indexed like StepBlock::steps
+    uint8_t _enabled;                               // Driver i is on when bit i is set
+    uint8_t _sleepPending;                          // Driver i is turned off once axis i is idle when bit i is set
+    unsigned long _idleTimeout[STEP_ENGINE_AXES];   // [ms], 0 never turns the driver off
+    unsigned long _wakeTime[STEP_ENGINE_AXES];      // When each driver was turned on [us]
+    unsigned long _lastBusy[STEP_ENGINE_AXES];      // When each axis was last seen busy [us]
+};
+
+#endif
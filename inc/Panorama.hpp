@@ -0,0 +1,96 @@
+#ifndef PANORAMA_HPP
+#define PANORAMA_HPP
+
+#include "Hal.hpp"
+#include "MotionProcessor.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define PANO_DEFAULT_FOV        10000L      // Field of view of a frame on both axes until set [Millidegrees]
+#define PANO_DEFAULT_OVERLAP    300         // Of a frame with its neighbours until set [1/1000 of the field of view]
+#define PANO_MAX_OVERLAP        900         // Most overlap taken, more would make frames nearly on top of each other [1/1000]
+#define PANO_MAX_FRAMES         100000UL    // Most frames of a panorama, more are taken for a field of view set wrong
+
+typedef enum {
+    PANO_SERPENTINE,                    // Row by row, every other row the other way
+    PANO_MIN_TRAVEL,                    // Row by row or column by column, whichever serpentine takes the head the least time
+    PANO_ROWS,                          // Row by row, every row the same way, as a host sending the moves one by one does
+    NUM_OF_PANO_ORDERS
+} PanoramaOrder;
+
+typedef enum {
+    PANO_IDLE,                          // Not running
+    PANO_MOVE,                          // Moving to the next frame
+    PANO_SETTLE,                        // Waiting to be at rest and settled before the shot
+    PANO_EXPOSE,                        // Holding still for the shot
+    PANO_DONE                           // Every frame was shot
+} PanoramaState;
+
+/**
+ * @brief Shoots a panorama as a grid of frames, each overlapping its neighbours, for stitching.
+ *
+ * The grid is given by the field of view of a frame, the overlap and the pan and tilt extents,
+ * from where the head is when it starts. Columns and rows are spread evenly, as few as can be
+ * with neighbours overlapping at least as set, so the frames on the edges are centered right
+ * on them. A frame's position is worked out from its number when it's due, the grid is
+ * never held in RAM, so a panorama of any size takes the same few bytes.
+ *
+ * Frames are shot serpentine, row by row every other row the other way, so every move is to a
+ * neighbour. The minimum travel order goes by rows or by columns, whichever takes the head less
+ * time at the set speeds and accelerations. No order through the grid takes less: any has to
+ * change column at least columns - 1 times, each change taking at least a pan move, and its
+ * other moves at least the quicker axis' move, which is just what the column serpentine does
+ * with tilt quicker, and the same for rows. The rows order goes back to the start of every row.
+ *
+ * service() is called from the main loop and never blocks. It queues the move to a frame once
+ * the planner has room and the drivers are awake, waits for the head to be at rest and settled,
+ * fires the shutter through the Trigger and holds still for the exposure, then goes on.
+ */
+class Panorama
+{
+public:
+    Panorama(MotionProcessor* motion);
+
+    uint8_t setFrame(const long fov[], long overlap, uint8_t order);
+    uint8_t start(const long extent[], unsigned long settle, unsigned long exposure);
+    void stop(void);
+    PanoramaState service(void);
+    PanoramaState getState(void);
+
+    long getFov(uint8_t axis);
+    long getOverlap(void);
+    uint8_t getOrder(void);
+
+    uint8_t frameAt(unsigned long index, LongVector* pos);
+    unsigned long numFrames(void);
+    unsigned long getColumns(void);
+    unsigned long getRows(void);
+    uint8_t byColumns(void);
+    unsigned long getShot(void);
+
+private:
+    double moveTime(double distance, double speed, double accel);
+    void queueMove(LongVector target);
+
+    MotionProcessor* _motion;
+    uint8_t _state;                     // PanoramaState
+
+    long _fov[NUM_OF_MOTORS];           // [Millidegrees]
+    long _overlap;                      // [1/1000 of the field of view]
+    uint8_t _order;                     // PanoramaOrder
+    uint8_t _byColumns;                 // Serpentine goes column by column instead of row by row
+    unsigned long _settle;              // Wait once at rest before a shot [ms]
+    unsigned long _exposure;            // Time held still for a shot [ms]
+
+    LongVector _origin;                 // Center of the first frame [Millidegrees]
+    long _extent[NUM_OF_MOTORS];        // From the center of the first frame to the far corner's, signed [Millidegrees]
+    unsigned long _columns;
+    unsigned long _rows;
+
+    unsigned long _shot;                // Frames shot so far
+    unsigned long _since;               // When the head was last seen moving, or the shot was taken [us]
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PINDEF_H
+#define PINDEF_H
+
+#include "Microstep.hpp"
+
+//=========================================//
+//                  PINS                   //
+//=========================================//
+
+// Pan driver and its Hall sensor
+#define PAN_DIR_PIN         2
+#define PAN_STEP_PIN        3
+#define PAN_EN_PIN          4
+#define PAN_HALL_PIN        5
+
+// Tilt driver and its Hall sensor
+#define TILT_DIR_PIN        6
+#define TILT_STEP_PIN       7
+#define TILT_EN_PIN         8
+#define TILT_HALL_PIN       9
+
+//=========================================//
+//                 LEVELS                  //
+//=========================================//
+
+// Direction pin values, counterclockwise counts the position up
+#define PAN_DIR_CW          HIGH
+#define PAN_DIR_CCW         LOW
+#define TILT_DIR_CW         HIGH
+#define TILT_DIR_CCW        LOW
+
+// What StepperMotor::endstop() reads over a magnet, the sensors pull their pin low
+#define HALL_MAG_DETECTED   1
+
+//=========================================//
+//                MECHANICS                //
+//=========================================//
+
+#define MOTOR_STEP_ANGLE    1.8         // Full step of the motors [Degrees]
+#define PAN_GEAR_RATIO      5.0         // Motor turns per pan turn
+#define TILT_GEAR_RATIO     3.0         // Motor turns per tilt turn
+
+// Degrees per microstep of the finest mode
+#define PAN_STEPRATE        (MOTOR_STEP_ANGLE / PAN_MICROSTEPS / PAN_GEAR_RATIO)
+#define TILT_STEPRATE       (MOTOR_STEP_ANGLE / TILT_MICROSTEPS / TILT_GEAR_RATIO)
+
+// Speeds a move is kept within [Degrees/Sec]
+#define PAN_MIN_SPEED       0.5
+#define PAN_MAX_SPEED       90.0
+#define TILT_MIN_SPEED      0.5
+#define TILT_MAX_SPEED      60.0
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef SEQUENCER_HPP
+#define SEQUENCER_HPP
+
+#include "Hal.hpp"
+#include "MotionProcessor.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define SEQ_SEGMENT_MS      250         // Longest move a span is cut into while moving continuously [ms]
+#define SEQ_LEAD_MS         1000        // How far ahead of the clock moves are queued [ms]
+#define SEQ_SPANS           4           // Spans worked out ahead, must be a power of two
+#define SEQ_SPANS_MASK      (SEQ_SPANS - 1)
+#define SEQ_KEYS            4           // Keyframes a span is worked out from, must be a power of two
+#define SEQ_KEYS_MASK       (SEQ_KEYS - 1)
+
+#ifndef SEQ_TABLE_KEYS
+#define SEQ_TABLE_KEYS      16          // Keyframes the sequencer's own table holds, filled by M420
+#endif
+
+typedef enum {
+    SEQ_IDLE,                           // Not running
+    SEQ_START,                          // Moving to the first keyframe, the clock starts once there
+    SEQ_MOVE,                           // Queuing the moves along the path
+    SEQ_SETTLE,                         // Shoot-move-shoot, waiting to be at rest and settled before the shot
+    SEQ_EXPOSE,                         // Shoot-move-shoot, holding still for the shot
+    SEQ_DONE                            // The whole path was queued, or shot
+} SequenceState;
+
+/**
+ * @brief A point the head goes through at a given time
+ */
+typedef struct {
+    unsigned long time;                 // From the start of the sequence [ms]
+    long p;                             // Pan [Millidegrees]
+    long t;                             // Tilt [Millidegrees]
+} Keyframe;
+
+/**
+ * @brief Gets keyframe number index of a sequence, e.g. from a table in flash, the EEPROM or the host.
+ * Keyframes are read once, in order, and only a few are kept at a time.
+ *
+ * @return 1 if the keyframe was written to key, 0 if the sequence has no more keyframes
+ */
+typedef uint8_t (*KeyframeSource)(unsigned long index, Keyframe* key);
+
+/**
+ * @brief How a sequence is shot. An interval of 0 moves continuously through the path,
+ * otherwise the head stops at every shot: shoot-move-shoot.
+ */
+typedef struct {
+    unsigned long interval;             // Time between shots, 0 to move continuously [ms]
+    unsigned long settle;               // Wait once at rest before a shot, for vibrations to die down [ms]
+    unsigned long exposure;             // Time held still for a shot [ms]
+} SequenceConfig;
+
+/**
+ * @brief The cubic in between two keyframes, p(s) = ((a*s + b)*s + c)*s + start with s going from 0 to 1
+ */
+typedef struct {
+    unsigned long time;                 // Time of its first keyframe [ms]
+    unsigned long length;               // [ms]
+    long start[NUM_OF_MOTORS];          // Position at its first keyframe [Millidegrees]
+    long end[NUM_OF_MOTORS];            // Position at its last keyframe [Millidegrees]
+    double a[NUM_OF_MOTORS];
+    double b[NUM_OF_MOTORS];
+    double c[NUM_OF_MOTORS];
+} SequenceSpan;
+
+/**
+ * @brief Makes the head follow a path of keyframes over time, for timelapses and hyperlapses.
+ *
+ * The keyframes are joined by a Catmull-Rom spline, timed so the speed carries on smoothly
+ * through every keyframe however far apart in time they are. The path starts and ends at rest,
+ * and an axis turning around at a keyframe stops on it instead of overshooting it.
+ *
+ * Keyframes are pulled from a source a few at a time, and the cubic of each span between two
+ * of them is worked out into a small table ahead of when it's needed, so a path of any length
+ * takes the same RAM. service() is called from the main loop and never blocks: it cuts the
+ * spans into timed moves of up to SEQ_SEGMENT_MS and queues each one SEQ_LEAD_MS before it's
+ * due, while the motion queue has room. The step engine always has the next moves queued, and
+ * the path never runs more than SEQ_LEAD_MS ahead of its clock.
+ *
+ * service() only queues a move once the planner has room for all the blocks it may be split
+ * into and its drivers are awake, and otherwise wakes them and comes back on the next call.
+ *
+ * With a shot interval the head goes to where the path is at every shot time instead, at the
+ * set speeds, settles, then calls the shot callback and holds still for the exposure.
+ *
+ * Without a source, the keyframes are read from a small table of the sequencer's own, which
+ * the commands fill one keyframe at a time.
+ */
+class Sequencer
+{
+public:
+    Sequencer(MotionProcessor* motion);
+
+    uint8_t start(KeyframeSource source, const SequenceConfig* config);
+    uint8_t start(const SequenceConfig* config);
+    void stop(void);
+    SequenceState service(void);
+    SequenceState getState(void);
+    unsigned long getClock(void);
+    void registerShotCallback(void (*shotCallback)(unsigned long shot));
+
+    uint8_t addKeyframe(const Keyframe* key);
+    void clearKeyframes(void);
+    uint8_t numKeyframes(void);
+
+private:
+    uint8_t readKey(unsigned long index, Keyframe* key);
+    void tickClock(void);
+    void fill(void);
+    uint8_t spanReady(void);
+    double tangent(unsigned long index, uint8_t axis);
+    uint8_t positionAt(unsigned long time, LongVector* pos);
+    void queueMove(LongVector target, unsigned long ms);
+    void serviceMoves(void);
+    void serviceShots(void);
+
+    MotionProcessor* _motion;
+    KeyframeSource _source;             // NULL to read the table
+    SequenceConfig _config;
+    void (*_shotCallback)(unsigned long shot);
+    uint8_t _state;                     // SequenceState
+    uint8_t _servicing;                 // Set while in service(), so it isn't run again from a callback
+
+    unsigned long _startTime;           // Time of the first keyframe [ms]
+    unsigned long _clock;               // Time along the path [ms]
+    unsigned long _clockUs;             // Microseconds not yet added to _clock
+    unsigned long _lastMicros;
+
+    Keyframe _keys[SEQ_KEYS];           // Keyframe i is at i & SEQ_KEYS_MASK
+    unsigned long _numKeys;             // Keyframes read so far
+    uint8_t _ended;                     // The source has no more keyframes
+    unsigned long _numSpans;            // Spans worked out so far
+
+    SequenceSpan _spans[SEQ_SPANS];
+    uint8_t _spanHead;                  // Span being followed
+    uint8_t _spanCount;                 // Spans worked out and not followed yet
+
+    unsigned long _segmentTime;         // Where the path was cut into moves up to [ms]
+    unsigned long _queuedTime;          // When the moves queued so far end [ms]
+    unsigned long _shot;                // Shots taken so far
+    unsigned long _shotTime;            // When the current shot is or was taken [ms]
+
+    Keyframe _table[SEQ_TABLE_KEYS];
+    uint8_t _tableKeys;                 // Keyframes in the table
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// Part of the EEPROM the snapshots are kept in
+#ifndef SNAPSHOT_EEPROM_START
+#define SNAPSHOT_EEPROM_START   0
+#endif
+#ifndef SNAPSHOT_EEPROM_SIZE
+#define SNAPSHOT_EEPROM_SIZE    HAL_EEPROM_SIZE
+#endif
+
+#define SNAPSHOT_SETTLE_MS      250UL       // Time at rest before the state is compared with the last snapshot, and between compares [ms]
+
+#define SNAPSHOT_POSITION       0x01        // Flag set if the position was known, from homing or a snapshot, when it was taken
+
+// Byte before each record, outside its CRC, so a move only takes one byte to mark
+#define SNAPSHOT_MARK_REST      0x5A        // The head hasn't moved since the record was taken
+#define SNAPSHOT_MARK_MOVED     0x00        // It has, or the record is being written. Anything but SNAPSHOT_MARK_REST reads as this.
+
+#define SNAPSHOT_NO_SLOT        0xFF
+
+/**
+ * @brief What's kept of the state across a power cycle. Laid out without padding, so it's the same bytes on the
+ * board and on a host.
+ */
+typedef struct {
+    int32_t targetMdeg[STEP_ENGINE_AXES];   // Where the queued moves ended [Millidegrees]
+    int32_t position[STEP_ENGINE_AXES];     // Live position, where the same is in steps [Steps]
+    int32_t homeOffset[STEP_ENGINE_AXES];   // Position homing gives to the center of each magnet [Millidegrees]
+    float stepRate[STEP_ENGINE_AXES];       // Degrees per step it was taken with, it's only taken back with the same [Degrees]
+    float speed[STEP_ENGINE_AXES];          // Set speeds [Degrees/Sec]
+    uint8_t flags;                          // SNAPSHOT_ flags
+    uint8_t microIndex[STEP_ENGINE_AXES];   // Microstep index of each driver
+    uint8_t reserved;
+    uint16_t sequence;                      // Counts up with every record written, wrapping around
+    uint16_t crc;                           // CRC-16/CCITT-FALSE of everything before it
+} SnapshotRecord;
+
+#define SNAPSHOT_SLOT_SIZE      (1 + sizeof(SnapshotRecord))                    // Mark, then the record
+#define SNAPSHOT_SLOTS          (SNAPSHOT_EEPROM_SIZE / SNAPSHOT_SLOT_SIZE)
+
+static_assert(sizeof(SnapshotRecord) == 48, "A snapshot record has no padding, it's the same on the board and on a host");
+static_assert((SNAPSHOT_SLOTS >= 2) && (SNAPSHOT_SLOTS < SNAPSHOT_NO_SLOT),
+              "The snapshots need two slots or more, so the latest one is never overwritten");
+
+/**
+ * @brief Keeps the calibration and the last position at rest in the EEPROM, so a power cycle, e.g. a battery swap in
+ * the middle of a timelapse, doesn't need homing to carry on.
+ *
+ * Once the head has been at rest for SNAPSHOT_SETTLE_MS with every driver holding it, its state is compared with the
+ * latest record and written to a new one if it changed. Records go round a ring of slots, each write into the slot
+ * after the latest one, so the wear is spread over all of them and the latest record is never the one overwritten.
+ * The newest record with a valid CRC is the latest, a record cut by a power loss fails its CRC and the one before it
+ * stands. Writing takes about 3.4 ms a byte, so service() starts one byte at a time and never waits on the EEPROM.
+ *
+ * Every slot starts with a mark. A record's mark is only set to SNAPSHOT_MARK_REST once the whole record is written,
+ * and moving() sets it back to SNAPSHOT_MARK_MOVED before the head moves away from it, so a position is only taken
+ * back if the head was still there when the power went.
+ */
+class Snapshot
+{
+public:
+    static Snapshot* getInstance();
+
+    uint8_t load(SnapshotRecord* record);
+    uint8_t save(const SnapshotRecord* record);
+    void moving(void);
+    void service(void);
+    uint8_t writing(void);
+
+private:
+    Snapshot(void);
+    static Snapshot* instance;
+
+    void scan(void);
+    uint8_t atRest(void);
+    void capture(SnapshotRecord* record);
+    uint16_t slotAddress(uint8_t slot);
+
+    uint8_t _scanned;                       // Set once the EEPROM was scanned for the latest record
+    uint8_t _slot;                          // Slot of the latest record, SNAPSHOT_NO_SLOT if there's none
+    uint8_t _moved;                         // The latest record is marked as moved
+    SnapshotRecord _latest;                 // Copy of the latest record
+    SnapshotRecord _record;                 // Record being written
+    uint8_t _writeSlot;                     // Slot it's written into
+    uint8_t _step;                          // Bytes of the slot written so far plus one, then the final mark. 0 when not writing.
+    uint8_t _resting;                       // Set while the head is at rest
+    unsigned long _restSince;               // When it was last compared, or came to rest [us]
+};
+
+#endif
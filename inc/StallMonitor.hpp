@@ -0,0 +1,64 @@
+#ifndef STALLMONITOR_HPP
+#define STALLMONITOR_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// Largest error at a checkpoint that's put down to slipped steps and taken out, a bigger one is a stall [Degrees]
+#ifndef STALL_TOLERANCE
+#define STALL_TOLERANCE         3.0
+#endif
+
+// Checkpoints of an axis, one per edge of its magnet and direction it's crossed in
+#define STALL_CHECKPOINTS       4
+
+/**
+ * @brief Checks the position of each axis every time it crosses the edge of its magnet, so steps lost on an ordinary
+ * move, e.g. to an unbalanced lens, don't go unnoticed.
+ *
+ * An edge is always detected at the same position, as long as the axis crosses it the same way: each side of the
+ * magnet, going up or down, is a checkpoint of its own. Homing measures two of them, and the others are learned the first
+ * time they're crossed once the position is known, from homing or a snapshot. Every later crossing is compared with them.
+ *
+ * A rotor that slips falls back onto the same phase a whole number of electrical cycles, 4 full steps, away from where
+ * its translator is. An error within STALL_TOLERANCE is rounded to that and taken out of the position, along with
+ * where the queued moves end, so the rest of the queue and any move after it land where they were meant to. Anything
+ * further is flagged as a stall: the position stops being known, which the host sees, and G28 homes from scratch.
+ *
+ * It only looks at the latest edge of each axis, so it's fine to call service() from the main loop alone.
+ */
+class StallMonitor
+{
+public:
+    static StallMonitor* getInstance();
+
+    void service(void);
+    void forget(void);
+
+    uint8_t stalled(void);
+    long getError(uint8_t axis);
+    uint8_t getResyncs(uint8_t axis);
+
+private:
+    StallMonitor(void);
+    static StallMonitor* instance;
+
+    void seed(void);
+    long check(uint8_t axis, const EndstopEdge* edge);
+
+    uint8_t _homeCount;                                         // Homings the checkpoints were learned after
+    uint8_t _edgeCount[STEP_ENGINE_AXES];                       // Edges of each axis already looked at
+    uint8_t _learned[STEP_ENGINE_AXES];                         // Checkpoint j of axis i is learned when bit j is set
+    long _checkpoints[STEP_ENGINE_AXES][STALL_CHECKPOINTS];     // Indexed by entered * 2 + down [Steps]
+    long _errors[STEP_ENGINE_AXES];                             // Error at the last checkpoint of each axis [Steps]
+    uint8_t _resyncs[STEP_ENGINE_AXES];                         // Slips taken out of each axis, saturating
+    uint8_t _stalled;                                           // Axis i stalled when bit i is set
+    uint8_t _settle;                                            // The head has yet to be moved onto its target after a resync
+    uint8_t _seed;                                              // The checkpoints are to be learned from the homing under way
+};
+
+#endif
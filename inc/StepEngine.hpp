@@ -0,0 +1,232 @@
+#ifndef STEPENGINE_HPP
+#define STEPENGINE_HPP
+
+#include "Hal.hpp"
+#include "StepperMotor.hpp"
+#include "Microstep.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define STEP_ENGINE_AXES    2                           // Pan and tilt
+#define STEP_TICK_US        40                          // Period of the step interrupt [us]
+#define STEP_TICK_HZ        (1000000UL / STEP_TICK_US)  // Frequency of the step interrupt [Hz], also the max step rate
+
+// Ticks in a row a Hall sensor has to read a new level for before it's taken, 1 takes every change right away
+#ifndef ENDSTOP_DEBOUNCE_TICKS
+#define ENDSTOP_DEBOUNCE_TICKS  3
+#endif
+
+static_assert((ENDSTOP_DEBOUNCE_TICKS >= 1) && (ENDSTOP_DEBOUNCE_TICKS <= 255), "The endstop debounce counts 1 to 255 ticks");
+
+#define ARC_MIN_SHIFT       4           // An arc turns by at most 1/16 radian per step event, however small its radius
+
+typedef enum {
+    ARC_NONE,                               // A straight move
+    ARC_CW,                                 // Clockwise in pan/tilt space, pan across and tilt up as their positions count up
+    ARC_CCW                                 // Counterclockwise, from pan towards tilt
+} ArcDir;
+
+/**
+ * @brief A straight move or an arc as seen by the step interrupt. Everything in here is
+ * precomputed in the main loop so the interrupt only has to add and compare.
+ *
+ * Rates are step events of the leading axis per tick in Q0.32. Accelerations and jerk
+ * are rate changes per tick in Q0.40, the interrupt adds (accel >> 8) to the rate.
+ * Steps, events and rates count pulses, each moving an axis 1 << shift microsteps.
+ */
+typedef struct {
+    unsigned long steps[STEP_ENGINE_AXES];  // Absolute number of pulses to take on each axis
+    unsigned long events;                   // Number of step events, equal to the biggest of steps[]
+    uint8_t negMask;                        // Axis i counts its position down when bit i is set
+    uint8_t shift[STEP_ENGINE_AXES];        // Microsteps per pulse of each axis as a power of two, 0 in the finest mode
+    uint32_t entryRate;                     // Rate at the first step event [Q0.32]
+    uint32_t cruiseRate;                    // Rate to hold between the ramps [Q0.32]
+    uint32_t exitRate;                      // Rate at the last step event [Q0.32]
+    uint32_t accel;                         // Max rate change per tick [Q0.40]
+    uint32_t accelMin;                      // Rate change per tick an S-curve eases down to [Q0.40]
+    uint32_t jerk;                          // Accel change per tick [Q0.40], 0 for a trapezoid
+    uint32_t accelEaseRate;                 // While accelerating, the accel eases down above this rate [Q0.32]
+    uint32_t decelEaseRate;                 // While decelerating, the accel eases down below this rate [Q0.32]
+    unsigned long decelEvents;              // Decelerating starts when this many step events are left
+
+    // Arcs only. Every step event turns the vector from the center by the same angle, so events count angle instead
+    // of leading axis steps. steps[] and negMask then give where the arc ends, relative to where it starts.
+    uint8_t arc;                            // ArcDir
+    uint8_t arcShift;                       // Each step event turns the vector by about 2^-arcShift radians
+    long arcX;                              // Vector from the center to the start [1/ARC_Q of a millidegree]
+    long arcY;
+    long arcLow[STEP_ENGINE_AXES];          // Lower edge of the step each axis starts on, along the vector [1/ARC_Q of a millidegree]
+} StepBlock;
+
+typedef enum {
+    HOMING_IDLE,                            // Not homing
+    HOMING_SEEK,                            // Fast towards the magnet until it's detected
+    HOMING_BACKOFF,                         // Back out of the magnet and clear of it
+    HOMING_APPROACH,                        // Slowly back towards the magnet until its edge
+    HOMING_MEASURE,                         // Slowly across the magnet, counting its width
+    HOMING_CENTER,                          // Slowly back half of the width, onto its center
+    HOMING_DONE,                            // Sitting on the center of the magnet
+    HOMING_FAILED                           // The magnet wasn't found
+} HomingState;
+
+/**
+ * @brief How an axis homes. Rates and acceleration are in the same units as StepBlock.
+ */
+typedef struct {
+    uint8_t seekDir;                        // Direction pin value towards the magnet
+    uint32_t seekRate;                      // Rate of the seek, the back-off goes at a quarter of it [Q0.32]
+    uint32_t slowRate;                      // Rate of the approach, measure and center, started and stopped without a ramp [Q0.32]
+    uint32_t accel;                         // Ramp of the seek and the back-off [Q0.40]
+    unsigned long backoffSteps;             // Steps to keep going once clear of the magnet before approaching again
+    unsigned long maxSteps;                 // Fails if a part takes more steps than this, e.g. about one turn
+    long homePosition;                      // Position the axis takes on the center of the magnet [Steps]
+} HomingConfig;
+
+/**
+ * @brief Homing progress of one axis
+ */
+typedef struct {
+    uint8_t state;                          // HomingState
+    uint8_t dir;                            // Direction pin value the axis is stepping towards
+    uint8_t stopping;                       // Set while ramping down to rest before the next part
+    uint8_t seen;                           // Back-off went through the magnet
+    uint32_t rate;                          // [Q0.32]
+    uint32_t targetRate;                    // [Q0.32]
+    uint32_t phase;
+    unsigned long count;                    // Steps taken in the current part
+    unsigned long width;                    // Magnet width [Steps]
+    long target;                            // Position of the magnet's center [Steps]
+} HomingAxis;
+
+/**
+ * @brief An edge of a magnet, as the interrupt saw it
+ */
+typedef struct {
+    long position;                          // Position at the first reading of the new level [Steps]
+    uint8_t entered;                        // 1 if the magnet was detected from there on, 0 if it was cleared
+    uint8_t down;                           // 1 if the axis was counting its position down
+} EndstopEdge;
+
+typedef enum {
+    RAMP_ACCEL,                             // Going up to the cruise rate
+    RAMP_CRUISE,                            // Holding the cruise rate
+    RAMP_DECEL,                             // Going down to the exit rate
+    RAMP_HOLD                               // Holding the exit rate until the last step event
+} RampState;
+
+/**
+ * @brief Timer driven Bresenham step generator, executing the blocks of the MotionQueue.
+ *
+ * The interrupt runs every STEP_TICK_US. Every tick the rate is added to a 32 bit
+ * phase accumulator and each carry out of it is one step event of the leading axis.
+ * On a step event, every axis adds its step count to its error accumulator and steps
+ * when the accumulator passes the number of events. The work done is the same on
+ * every tick, no matter the direction or the slope of the move. When a block is done
+ * the next one is loaded within the same tick, so consecutive blocks run back to back.
+ *
+ * An arc block instead turns a vector from the arc's center by a fixed angle on every step event,
+ * with a shift and an add per axis, and steps an axis once the vector leaves the span of the step
+ * it's on. It's traced whole in the interrupt, at one angular speed, instead of as short lines.
+ *
+ * It can also home every axis at once, stepping each on its own rate and watching its
+ * Hall sensor, then picks up the blocks queued in the meantime.
+ *
+ * The Hall sensors are sampled once per tick into a debounced state word, so the interrupt
+ * and the main loop test a bit instead of reading pins. A new level has to hold for
+ * ENDSTOP_DEBOUNCE_TICKS before it's taken, and the position at its first reading is latched
+ * as the position of that edge. Homing measures the magnet between those latched edges.
+ *
+ * The position of every axis is counted pulse by pulse, so it can be read live mid-move.
+ * It's counted while homing too, for the edges, and set to the home position once homing succeeds. It's in microsteps of
+ * the finest mode whatever mode a block steps in, the mode pins being switched as each
+ * block is loaded. The driver's own microstep index is counted alongside, homing included,
+ * for the planner to know where the full steps are.
+ */
+class StepEngine
+{
+public:
+    static StepEngine* getInstance();
+
+    void attach(StepperMotor* motors);
+    void wake(void);
+    uint8_t busy(void);
+    void home(const HomingConfig config[]);
+    long getPosition(uint8_t axis);
+    void shiftPosition(const long shift[]);
+    HomingState homingState(void);
+    uint8_t microIndex(uint8_t axis);
+    void setMicroIndex(const uint8_t index[]);
+    uint8_t homeCount(void);
+    uint8_t endstops(void);
+    long getEdge(uint8_t axis, uint8_t entered);
+    uint8_t lastEdge(uint8_t axis, EndstopEdge* edge);
+
+    void tick(void);
+    long isrPosition(uint8_t axis);
+    uint8_t isrSteady(void);
+
+    static uint32_t rateFromStepsPerSec(double stepsPerSec);
+    static uint32_t accelFromStepsPerSec2(double stepsPerSec2);
+    static uint32_t jerkFromStepsPerSec3(double stepsPerSec3);
+
+private:
+    StepEngine(void);
+    static StepEngine* instance;
+
+    void startTimer(void);
+    void sampleEndstops(void);
+    void setDirs(uint8_t dirMask);
+    uint8_t load(void);
+    uint8_t arcEvent(void);
+    void homingTick(void);
+    void homingNext(uint8_t axis);
+    uint8_t homingDirs(void);
+
+    StepperMotor* _motors;                          // Motors stepped by the interrupt, indexed like steps[]
+
+    volatile uint8_t _busy;                         // Set while a block is being executed or while homing
+    volatile uint8_t _homing;                       // Set while homing instead of executing blocks
+    HomingConfig _homingConfig[STEP_ENGINE_AXES];
+    HomingAxis _homingAxes[STEP_ENGINE_AXES];
+    volatile long _position[STEP_ENGINE_AXES];      // Live position [Steps]
+    volatile uint8_t _microIndex[STEP_ENGINE_AXES]; // Microstep index of each driver, wrapping around [Steps]
+    volatile uint8_t _homeCount;                    // Homings started, the index went somewhere the planner can't know
+    volatile uint8_t _endstops;                     // Debounced Hall sensors, axis i's magnet is detected when bit i is set
+    uint8_t _bounce[STEP_ENGINE_AXES];              // Ticks in a row each sensor has read the other level for
+    long _edgeCandidate[STEP_ENGINE_AXES];          // Position at the first of those readings [Steps]
+    volatile long _enterAt[STEP_ENGINE_AXES];       // Position where each magnet was last detected from clear [Steps]
+    volatile long _leaveAt[STEP_ENGINE_AXES];       // Position where each magnet was last cleared [Steps]
+    volatile uint8_t _edgeCount[STEP_ENGINE_AXES];  // Edges seen on each axis, wrapping around
+    volatile uint8_t _edgeDown;                     // Axis i was counting down on its last edge when bit i is set
+    uint8_t _dirMask;                               // Direction pin values last set, axis i in bit i
+    uint8_t _shift[STEP_ENGINE_AXES];               // Microstep mode the drivers are in, as StepBlock::shift
+    int8_t _stepSign[STEP_ENGINE_AXES];             // What a pulse adds to the position of each axis in this block
+    unsigned long _steps[STEP_ENGINE_AXES];         // Copy of the block's step counts
+    unsigned long _error[STEP_ENGINE_AXES];         // Bresenham error accumulators
+    unsigned long _events;                          // Copy of the block's step events
+    unsigned long _eventsLeft;                      // Step events left before the block is done
+    uint32_t _rate;                                 // Step events per tick [Q0.32]
+    uint32_t _phase;                                // Phase accumulator, a carry out of it is a step event
+
+    RampState _ramp;                                // Which part of the speed profile we're in
+    uint32_t _accel;                                // Current rate change per tick [Q0.40]
+    uint32_t _accelMax;                             // Copies of the block's profile
+    uint32_t _accelMin;
+    uint32_t _jerk;
+    uint32_t _cruiseRate;
+    uint32_t _exitRate;
+    uint32_t _accelEaseRate;
+    uint32_t _decelEaseRate;
+    unsigned long _decelEvents;
+
+    uint8_t _arc;                                   // Copies of the block's arc, ARC_NONE for a straight move
+    uint8_t _arcShift;
+    long _arcX;                                     // Vector from the center, turned on every step event
+    long _arcY;
+    long _arcLow[STEP_ENGINE_AXES];
+    long _arcLeft[STEP_ENGINE_AXES];                // Steps each axis has left to the end of the arc, signed
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef STEPTIMING_HPP
+#define STEPTIMING_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// Set to 1 to have the step interrupt record its timing. Left at 0 it compiles to nothing.
+#ifndef STEP_TIMING
+#define STEP_TIMING             0
+#endif
+
+#define STEP_TIMING_BUCKETS     16      // Bucket i of the histograms holds intervals from 2^i to 2^(i+1)-1 us
+
+/**
+ * @brief Step timing of one axis
+ */
+typedef struct {
+    unsigned long steps;
+    unsigned long firstUs;                          // Time of the first step
+    unsigned long lastUs;                           // Time of the last step
+    unsigned long minInterval;                      // Shortest time between two steps [us]
+    unsigned long maxInterval;                      // Longest time between two steps [us]
+    unsigned long histogram[STEP_TIMING_BUCKETS];   // Count of times between two steps, log2 buckets
+} StepTimingAxis;
+
+/**
+ * @brief Records how the step interrupt keeps time: how long it runs, when every axis
+ * steps and the fastest rate it was asked for. Everything is in plain counters that the
+ * interrupt updates, report() turns them into one line of JSON for a host to parse.
+ */
+class StepTiming
+{
+public:
+    static StepTiming* getInstance();
+
+    void reset(void);
+    void isrEnter(void);
+    void isrExit(void);
+    void stepped(uint8_t axisMask);
+    void commanded(uint32_t rate);
+
+    unsigned int report(char* buffer, unsigned int size);
+
+private:
+    StepTiming(void);
+    static StepTiming* instance;
+
+    unsigned long _isrStart;
+    unsigned long _isrCount;
+    unsigned long _isrMaxUs;                        // Worst case duration of the interrupt
+    unsigned long _isrTotalUs;
+    uint32_t _commandedRate;                        // Fastest cruise rate loaded [Q0.32]
+    StepTimingAxis _axes[STEP_ENGINE_AXES];
+};
+
+// Hooks placed in the step interrupt
+#if STEP_TIMING
+#define STEP_TIMING_ENTER()             StepTiming::getInstance()->isrEnter()
+#define STEP_TIMING_EXIT()              StepTiming::getInstance()->isrExit()
+#define STEP_TIMING_STEPPED(axisMask)   StepTiming::getInstance()->stepped(axisMask)
+#define STEP_TIMING_COMMANDED(rate)     StepTiming::getInstance()->commanded(rate)
+#else
+#define STEP_TIMING_ENTER()
+#define STEP_TIMING_EXIT()
+#define STEP_TIMING_STEPPED(axisMask)
+#define STEP_TIMING_COMMANDED(rate)
+#endif
+
+#endif
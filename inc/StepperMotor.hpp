@@ -0,0 +1,49 @@
+#ifndef STEPPERMOTOR_HPP
+#define STEPPERMOTOR_HPP
+
+#include "Hal.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// Levels of the enable pin, the A4988's is active low
+#define EN_MOTOR_ON     LOW
+#define EN_MOTOR_OFF    HIGH
+
+typedef enum {
+    NONE,                               // Endstop pin left floating, the sensor drives it
+    PULLUP_ENDSTOP                      // Endstop pin pulled up, for open collector sensors
+} pinSetup_t;
+
+/**
+ * @brief A stepper motor driven through a STEP/DIR driver, with an endstop
+ */
+class StepperMotor
+{
+public:
+    StepperMotor();
+    StepperMotor(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, uint8_t en_value, uint8_t endstop_pin, pinSetup_t endstop_pin_setup = NONE);
+
+    void init(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, uint8_t en_value, uint8_t endstop_pin, pinSetup_t endstop_pin_setup = NONE);
+    void initMicrostep(uint8_t ms1_pin, uint8_t ms2_pin, uint8_t ms3_pin, uint8_t mode_bits);
+    void setMicrostep(uint8_t mode_bits);
+
+    void enable(void);
+    void disable(void);
+    void setDir(uint8_t pinVal);
+    uint8_t step(void);
+    uint8_t step(uint8_t dir);
+    void hardStep(void);
+    void hardStep(uint8_t dir);
+    uint8_t endstop(void);
+
+private:
+    uint8_t _dir_pin;
+    uint8_t _step_pin;
+    uint8_t _en_pin;
+    uint8_t _endstop_pin;
+    uint8_t _ms_pins[3];                // MS1, MS2 and MS3 of the driver
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// Time each record covers [ms]
+#ifndef TELEMETRY_PERIOD_MS
+#define TELEMETRY_PERIOD_MS     1000UL
+#endif
+
+// Records kept, the oldest is overwritten by the next one
+#ifndef TELEMETRY_RECORDS
+#define TELEMETRY_RECORDS       8
+#endif
+
+static_assert((TELEMETRY_RECORDS & (TELEMETRY_RECORDS - 1)) == 0, "The telemetry ring holds a power of two records");
+static_assert((TELEMETRY_PERIOD_MS >= 10) && (TELEMETRY_PERIOD_MS <= 60000UL),
+              "A telemetry period is long enough to mean something, and short enough for its counters not to wrap");
+
+/**
+ * @brief What happened over one period. Laid out without padding, so a host reads the same bytes.
+ */
+typedef struct {
+    uint16_t sequence;                      // Counts up with every record, wrapping around
+    uint16_t periodMs;                      // Time it covers, longer if the main loop was held up [ms]
+    uint32_t ticks;                         // Step interrupts run
+    uint32_t isrCounts;                     // Time they took all together [HAL_TIMER_COUNTS_PER_US of a us]
+    uint16_t isrMax;                        // Longest one [HAL_TIMER_COUNTS_PER_US of a us]
+    uint8_t blocksHigh;                     // Most blocks the MotionQueue held
+    uint8_t commandsHigh;                   // Most commands the CommandQueue held
+    uint32_t steps[STEP_ENGINE_AXES];       // Pulses sent to each axis, in whatever microstep mode
+    uint32_t parseUs;                       // Time the text commands took to parse all together [us]
+    uint16_t parseMax;                      // Longest one took [us]
+    uint16_t parseCount;                    // Text commands parsed, valid or not
+} TelemetryRecord;
+
+static_assert(sizeof(TelemetryRecord) == 32, "A telemetry record has no padding, it's the same on the board and on a host");
+
+/**
+ * @brief Always on counters of the hot paths, kept as one record per TELEMETRY_PERIOD_MS in a ring
+ * of TELEMETRY_RECORDS, so there's a recent history to look at without any Serial.print in the way.
+ *
+ * The step interrupt only adds to a few counters. It's timed off the step timer itself, which
+ * reads in a couple of cycles where halMicros() would take longer than most of the interrupt.
+ * Everything else is counted from the main loop. service() closes a record once its period is
+ * up and starts the next one.
+ *
+ * dump() only marks the records there are to be sent. The FrameLink sends them one frame at a time
+ * as the serial buffer has room, so a dump never waits and never holds up a move.
+ */
+class Telemetry
+{
+public:
+    static Telemetry* getInstance();
+
+    // Step interrupt side, inline as they run on every tick
+    void isrEnter(void)
+    {
+        halTimerMark();
+    }
+
+    void isrExit(void)
+    {
+        uint16_t counts = halTimerElapsed();
+
+        _ticks++;
+        _isrCounts += counts;
+        if(counts > _isrMax)
+            _isrMax = counts;
+    }
+
+    void stepped(uint8_t axisMask)
+    {
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+            if(axisMask & (1 << i))
+                _steps[i]++;
+        }
+    }
+
+    // Main loop side
+    void queued(uint8_t blocks);
+    void commands(uint8_t count);
+    void parsed(unsigned long us);
+    void service(void);
+
+    void dump(void);
+    uint8_t dumping(void);
+    uint8_t next(TelemetryRecord* record);
+
+private:
+    Telemetry(void);
+    static Telemetry* instance;
+
+    // Counted by the interrupt over the current period
+    volatile uint32_t _ticks;
+    volatile uint32_t _isrCounts;
+    volatile uint16_t _isrMax;
+    volatile uint32_t _steps[STEP_ENGINE_AXES];
+
+    TelemetryRecord _current;                       // Everything else of the current period
+    unsigned long _periodStart;                     // [us]
+    TelemetryRecord _records[TELEMETRY_RECORDS];
+    uint16_t _count;                                // Records closed so far, wrapping around
+    uint16_t _dumpNext;                             // Number of the next record to send
+    uint16_t _dumpEnd;                              // Number of the first record after the dump
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef TRIGGER_HPP
+#define TRIGGER_HPP
+
+#include "Hal.hpp"
+#include "StepEngine.hpp"
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+// Outputs to the camera's remote port, e.g. through optocouplers, active high
+#ifndef TRIGGER_SHUTTER_PIN
+#define TRIGGER_SHUTTER_PIN     14      // A0
+#endif
+#ifndef TRIGGER_FOCUS_PIN
+#define TRIGGER_FOCUS_PIN       15      // A1
+#endif
+
+#define TRIGGER_DEFAULT_PULSE_US    100000UL    // Long enough for any DSLR to take the shutter press [us]
+
+typedef enum {
+    TRIGGER_NONE,                       // Nothing scheduled
+    TRIGGER_STEPS,                      // On step counts of an axis
+    TRIGGER_INTERVAL                    // On a fixed interval
+} TriggerMode;
+
+/**
+ * @brief Fires the camera's shutter from the step interrupt, on the same ticks the motors step on.
+ *
+ * A shot can be scheduled on the step count at which an axis gets somewhere, so it fires in the
+ * very tick that axis steps there, or on a fixed interval of ticks. A shot raises the shutter and
+ * focus lines together for the pulse time. The focus line can also be held up in between shots
+ * to keep the camera awake, so it has no wake-up lag on the shutter edge.
+ *
+ * Shots only fire while the motors are at rest or going at a constant rate. One falling while
+ * they accelerate or decelerate, or while the last pulse isn't over, is dropped and counted as
+ * blocked, so every frame taken is at the position and on the time it was scheduled for. The
+ * position of every axis is latched on each shot.
+ *
+ * The timer keeps running while a shot is scheduled or a pulse is on, even with the motors idle.
+ */
+class Trigger
+{
+public:
+    static Trigger* getInstance();
+
+    uint8_t atSteps(uint8_t axis, long first, long spacing, unsigned long count);
+    uint8_t every(unsigned long intervalUs, unsigned long count);
+    uint8_t shoot(void);
+    void cancel(void);
+
+    void setPulse(unsigned long pulseUs);
+    void setFocusHold(uint8_t hold);
+    uint8_t busy(void);
+    unsigned long getFired(void);
+    unsigned long getBlocked(void);
+    long getShotPosition(uint8_t axis);
+
+    void tick(void);
+
+private:
+    Trigger(void);
+    static Trigger* instance;
+
+    void schedule(uint8_t running);
+    void fire(StepEngine* engine);
+
+    volatile uint8_t _mode;                         // TriggerMode
+    uint8_t _focusHold;                             // Focus line held up while shots are scheduled
+    uint8_t _axis;                                  // Axis watched by TRIGGER_STEPS
+    long _next;                                     // Step count of the next shot
+    long _last;                                     // Step count of the axis on the last tick
+    long _spacing;                                  // Steps between shots, signed
+    unsigned long _interval;                        // Ticks between shots
+    unsigned long _countdown;                       // Ticks until the next shot
+    unsigned long _remaining;                       // Shots left to schedule
+    unsigned long _pulse;                           // Length of a pulse [Ticks]
+    unsigned long _pulseLeft;                       // Ticks left of the pulse on, 0 when off, only touched by the interrupt
+    volatile uint8_t _pulseOn;                      // Set while a pulse is on, a single byte the main loop reads in one go
+    volatile unsigned long _fired;
+    volatile unsigned long _blocked;
+    volatile long _shotPosition[STEP_ENGINE_AXES];  // Position of every axis on the last shot [Steps]
+};
+
+#endif
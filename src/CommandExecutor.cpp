@@ -0,0 +1,227 @@
+#include "../inc/CommandExecutor.hpp"
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates an executor driving a motion processor
+ *
+ *  @param[in] motion    Motion processor the commands act on
+ *  @param[in] sequencer Sequencer the keyframes and sequences go to, serviced from the main loop
+ *  @param[in] panorama  Panorama the frames and panoramas go to, serviced from the main loop
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+CommandExecutor::CommandExecutor(MotionProcessor* motion, Sequencer* sequencer, Panorama* panorama)
+{
+    _motion = motion;
+    _sequencer = sequencer;
+    _panorama = panorama;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Executes a command. Moves only wait when the motion queue is full. Homing runs in the background
+ *         from the step interrupt, the moves after it wait for it to be done. Only checking a restored
+ *         position against the magnets blocks.
+ *
+ *  @param[in] cmd Tokenized command
+ *
+ *  @return 0 if the command isn't known
+ *          1 if the command was executed,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandExecutor::execute(const Command* cmd)
+{
+    // If its a NULL pointer, return 2
+    if(cmd == NULL)
+        return 2;
+
+    switch(cmd->op){
+        case CMD_MOVE:
+            _motion->line(endPoint(cmd));
+            break;
+
+        case CMD_ARC_CW:
+        case CMD_ARC_CCW:{
+            // The center is relative to the start, like G-code's I and J, an offset left out is 0
+            LongVector center = {0, 0};
+            if(cmd->argMask & ARG_I_BIT)
+                center.p = cmd->args[ARG_I];
+            if(cmd->argMask & ARG_J_BIT)
+                center.t = cmd->args[ARG_J];
+            _motion->arc(endPoint(cmd), center, (cmd->op == CMD_ARC_CW) ? ARC_CW : ARC_CCW);
+            break;
+        }
+
+        case CMD_HOME:
+            _motion->home();
+            break;
+
+        case CMD_ABS:
+            _motion->setMode(ABS);
+            break;
+
+        case CMD_REL:
+            _motion->setMode(REL);
+            break;
+
+        case CMD_ENABLE:
+            _motion->enableMotors();
+            break;
+
+        case CMD_DISABLE:
+            _motion->disableMotors();
+            break;
+
+        case CMD_IDLE:
+            // Seconds in thousandths are milliseconds
+            if(cmd->argMask & ARG_P_BIT)
+                MotorPower::getInstance()->setIdleTimeout(0, (cmd->args[ARG_P] > 0) ? cmd->args[ARG_P] : 0);
+            if(cmd->argMask & ARG_T_BIT)
+                MotorPower::getInstance()->setIdleTimeout(1, (cmd->args[ARG_T] > 0) ? cmd->args[ARG_T] : 0);
+            if(cmd->argMask == 0)
+                _motion->disableMotors();
+            break;
+
+        case CMD_HOME_OFFSET:{
+            // Taken on the next homing, and kept in the snapshots
+            LongVector offset = _motion->getHomeOffset();
+            if(cmd->argMask & ARG_P_BIT)
+                offset.p = cmd->args[ARG_P];
+            if(cmd->argMask & ARG_T_BIT)
+                offset.t = cmd->args[ARG_T];
+            _motion->setHomeOffset(offset);
+            break;
+        }
+
+        case CMD_SPEED:
+            if(cmd->argMask & ARG_P_BIT)
+                _motion->setPanSpeed((double)cmd->args[ARG_P] / FIXED_SCALE);
+            if(cmd->argMask & ARG_T_BIT)
+                _motion->setTiltSpeed((double)cmd->args[ARG_T] / FIXED_SCALE);
+            break;
+
+        case CMD_KEYFRAME:{
+            // Seconds in thousandths are milliseconds. Placed like a move, kept absolute.
+            if(_sequencer == NULL)
+                return 0;
+            if(cmd->argMask == 0){
+                _sequencer->clearKeyframes();
+                break;
+            }
+
+            LongVector at = endPoint(cmd);
+            if(_motion->getMode() == REL){
+                LongVector from = _motion->getTargetMdeg();
+                at.p += from.p;
+                at.t += from.t;
+            }
+            Keyframe key;
+            key.time = ((cmd->argMask & ARG_I_BIT) && (cmd->args[ARG_I] > 0)) ? cmd->args[ARG_I] : 0;
+            key.p = at.p;
+            key.t = at.t;
+            _sequencer->addKeyframe(&key);
+            break;
+        }
+
+        case CMD_SEQUENCE:{
+            // Run by Sequencer::service() from the main loop, shoot-move-shoot with an interval
+            if(_sequencer == NULL)
+                return 0;
+            if(cmd->argMask == 0){
+                _sequencer->stop();
+                break;
+            }
+
+            SequenceConfig config = {0, 0, 0};
+            if((cmd->argMask & ARG_I_BIT) && (cmd->args[ARG_I] > 0))
+                config.interval = cmd->args[ARG_I];
+            if((cmd->argMask & ARG_J_BIT) && (cmd->args[ARG_J] > 0))
+                config.exposure = cmd->args[ARG_J];
+            if((cmd->argMask & ARG_P_BIT) && (cmd->args[ARG_P] > 0))
+                config.settle = cmd->args[ARG_P];
+            _sequencer->start(&config);
+            break;
+        }
+
+        case CMD_PANO_FRAME:{
+            // Degrees in thousandths are millidegrees, the overlap a fraction in thousandths. Left out stays as it was.
+            if(_panorama == NULL)
+                return 0;
+
+            long fov[NUM_OF_MOTORS] = {_panorama->getFov(0), _panorama->getFov(1)};
+            long overlap = _panorama->getOverlap();
+            uint8_t order = _panorama->getOrder();
+            if(cmd->argMask & ARG_P_BIT)
+                fov[0] = cmd->args[ARG_P];
+            if(cmd->argMask & ARG_T_BIT)
+                fov[1] = cmd->args[ARG_T];
+            if(cmd->argMask & ARG_I_BIT)
+                overlap = cmd->args[ARG_I];
+            if((cmd->argMask & ARG_J_BIT) && (cmd->args[ARG_J] >= 0))
+                order = cmd->args[ARG_J] / FIXED_SCALE;
+            _panorama->setFrame(fov, overlap, order);
+            break;
+        }
+
+        case CMD_PANORAMA:{
+            // Run by Panorama::service() from the main loop. The extents are from here whichever the mode.
+            if(_panorama == NULL)
+                return 0;
+            if(cmd->argMask == 0){
+                _panorama->stop();
+                break;
+            }
+
+            long extent[NUM_OF_MOTORS] = {0, 0};
+            unsigned long settle = 0, exposure = 0;
+            if(cmd->argMask & ARG_P_BIT)
+                extent[0] = cmd->args[ARG_P];
+            if(cmd->argMask & ARG_T_BIT)
+                extent[1] = cmd->args[ARG_T];
+            if((cmd->argMask & ARG_I_BIT) && (cmd->args[ARG_I] > 0))
+                settle = cmd->args[ARG_I];
+            if((cmd->argMask & ARG_J_BIT) && (cmd->args[ARG_J] > 0))
+                exposure = cmd->args[ARG_J];
+            _panorama->start(extent, settle, exposure);
+            break;
+        }
+
+        case CMD_TELEMETRY:
+            // Sent by the FrameLink as the serial buffer has room
+            Telemetry::getInstance()->dump();
+            break;
+
+        case CMD_SHOOT:
+            // Taken where the moves before it end, like any G-code after them
+            _motion->shoot();
+            break;
+
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets where a move or a keyframe goes. An axis left out stays where it is.
+ *         Arguments are already in millidegrees, so they go through as they are.
+ *
+ *  @param[in] cmd Tokenized command
+ *
+ *  @return Coordinates to pass on, absolute or relative as the motion processor's mode [Millidegrees]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+LongVector CommandExecutor::endPoint(const Command* cmd)
+{
+    LongVector coords = {0, 0};
+    if(_motion->getMode() == ABS)
+        coords = _motion->getTargetMdeg();
+
+    if(cmd->argMask & ARG_P_BIT)
+        coords.p = cmd->args[ARG_P];
+    if(cmd->argMask & ARG_T_BIT)
+        coords.t = cmd->args[ARG_T];
+    return coords;
+}
@@ -0,0 +1,301 @@
+#include "../inc/CommandParser.hpp"
+
+// Scale of a fraction by the number of decimals kept, so no division is needed
+static const int32_t decimalScale[] = {FIXED_SCALE, FIXED_SCALE / 10, FIXED_SCALE / 100, FIXED_SCALE / 1000};
+#define MAX_DECIMALS    3
+
+// Largest whole part an argument holds with any fraction, without overflowing 32 bits
+#define MAX_WHOLE       ((2147483647L - (FIXED_SCALE - 1)) / FIXED_SCALE)
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates a parser that keeps the command it parses, read it with command() once parse() returns PARSE_DONE
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+CommandParser::CommandParser(void)
+{
+    _queue = NULL;
+    _cmd = &_own;
+    reset();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates a parser that writes the commands it parses straight into a queue
+ *
+ *  @param[in] queue Queue to reserve and commit slots in. Feed bytes only while it isn't full.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+CommandParser::CommandParser(CommandQueue* queue)
+{
+    _queue = queue;
+    _cmd = &_own;
+    reset();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Drops the line being parsed. A queue slot it was written into stays uncommitted, the next reserve gets it.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void CommandParser::reset(void)
+{
+    _state = PARSE_LETTER;
+    _words = 0;
+}
+
+//=========================================//
+//                 PARSING                 //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Consumes one byte. A line ends with '\n' or '\r', anything after a ';' or '(' is a comment.
+ *
+ *  @param[in] c Byte received
+ *
+ *  @return PARSE_NONE if no command was finished,
+ *          PARSE_DONE if a command was finished and committed, or is ready in command(),
+ *          PARSE_ERROR if the line is invalid, it is dropped
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandParser::parse(char c)
+{
+    if((c == '\n') || (c == '\r'))
+        return endLine();
+
+    switch(_state){
+        case PARSE_COMMENT:
+        case PARSE_SKIP:
+            return PARSE_NONE;
+
+        case PARSE_NUMBER:
+            if((c >= '0') && (c <= '9')){
+                // The whole part stops growing once out of range, endWord() rejects it
+                if(!_dot){
+                    if(_whole <= MAX_WHOLE)
+                        _whole = _whole * 10 + (c - '0');
+                }
+                else if(_decimals < MAX_DECIMALS){
+                    _fraction = _fraction * 10 + (c - '0');
+                    _decimals++;
+                }
+                if(_digits < 0xFF)
+                    _digits++;
+                return PARSE_NONE;
+            }
+            if((c == '.') && !_dot){
+                _dot = 1;
+                return PARSE_NONE;
+            }
+            if(((c == '-') || (c == '+')) && (_digits == 0) && !_dot && !_negative){
+                _negative = (c == '-');
+                return PARSE_NONE;
+            }
+
+            // Anything else ends the number, then gets handled as the start of what follows it
+            if(!endWord()){
+                _state = PARSE_SKIP;
+                return PARSE_ERROR;
+            }
+            _state = PARSE_LETTER;
+            // fall through
+
+        case PARSE_LETTER:
+            if((c == ' ') || (c == '\t'))
+                return PARSE_NONE;
+            if((c == ';') || (c == '(')){
+                _state = PARSE_COMMENT;
+                return PARSE_NONE;
+            }
+            if(((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z'))){
+                startWord(c);
+                return (_state == PARSE_SKIP) ? PARSE_ERROR : PARSE_NONE;
+            }
+            _state = PARSE_SKIP;
+            return PARSE_ERROR;
+    }
+
+    return PARSE_NONE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts a new word. The first word of a line also gets the command a slot to be written into.
+ *
+ *  @param[in] letter Letter of the word
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void CommandParser::startWord(char letter)
+{
+    if(_words == 0){
+        if(_queue != NULL){
+            CommandSlot* slot = _queue->reserveCommand();
+            if(slot == NULL){
+                _state = PARSE_SKIP;        // No room, the line is lost
+                return;
+            }
+            slot->state = SLOT_TOKEN;
+            _cmd = &slot->cmd;
+        }
+        _cmd->op = CMD_NONE;
+        _cmd->argMask = 0;
+    }
+
+    _letter = (letter >= 'a') ? (letter - 'a' + 'A') : letter;
+    _negative = 0;
+    _dot = 0;
+    _digits = 0;
+    _decimals = 0;
+    _whole = 0;
+    _fraction = 0;
+    _state = PARSE_NUMBER;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Folds the word just parsed into the command
+ *
+ *  @return 0 if the word is invalid or its number out of range,
+ *          1 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandParser::endWord(void)
+{
+    if((_digits == 0) || (_whole > MAX_WHOLE))
+        return 0;
+
+    int32_t value = _whole * FIXED_SCALE + _fraction * decimalScale[_decimals];
+    if(_negative)
+        value = -value;
+
+    // The first word is the command code, always a whole number. The count saturates, so a
+    // line of many words never wraps back to its first.
+    uint8_t first = (_words == 0);
+    if(_words < 0xFF)
+        _words++;
+
+    if(first){
+        if(_dot || _negative)
+            return 0;
+
+        if(_letter == 'G'){
+            switch(_whole){
+                case 0:
+                case 1:     _cmd->op = CMD_MOVE;    break;
+                case 2:     _cmd->op = CMD_ARC_CW;  break;
+                case 3:     _cmd->op = CMD_ARC_CCW; break;
+                case 28:    _cmd->op = CMD_HOME;    break;
+                case 90:    _cmd->op = CMD_ABS;     break;
+                case 91:    _cmd->op = CMD_REL;     break;
+                default:    return 0;
+            }
+        }
+        else if(_letter == 'M'){
+            switch(_whole){
+                case 17:    _cmd->op = CMD_ENABLE;  break;
+                case 18:    _cmd->op = CMD_DISABLE; break;
+                case 84:    _cmd->op = CMD_IDLE;    break;
+                case 203:   _cmd->op = CMD_SPEED;   break;
+                case 206:   _cmd->op = CMD_HOME_OFFSET; break;
+                case 240:   _cmd->op = CMD_SHOOT;   break;
+                case 420:   _cmd->op = CMD_KEYFRAME; break;
+                case 421:   _cmd->op = CMD_SEQUENCE; break;
+                case 422:   _cmd->op = CMD_PANO_FRAME; break;
+                case 423:   _cmd->op = CMD_PANORAMA; break;
+                case 990:   _cmd->op = CMD_TELEMETRY; break;
+                default:    return 0;
+            }
+        }
+        else{
+            return 0;
+        }
+        return 1;
+    }
+
+    // Then the arguments
+    uint8_t arg;
+    switch(_letter){
+        case 'P':   arg = ARG_P;    break;
+        case 'T':   arg = ARG_T;    break;
+        case 'I':   arg = ARG_I;    break;
+        case 'J':   arg = ARG_J;    break;
+        default:    return 0;
+    }
+    _cmd->args[arg] = value;
+    _cmd->argMask |= (1 << arg);
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Finishes the line, committing its command if it's valid
+ *
+ *  @return PARSE_NONE if the line was empty or already reported as invalid,
+ *          PARSE_DONE if a command was finished,
+ *          PARSE_ERROR if the line turned out invalid
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandParser::endLine(void)
+{
+    uint8_t result = PARSE_NONE;
+
+    if((_state == PARSE_NUMBER) && !endWord())
+        result = PARSE_ERROR;               // The line ended on an invalid word
+    else if((_state != PARSE_SKIP) && (_words > 0)){
+        result = PARSE_DONE;
+        if(_queue != NULL)
+            _queue->commitCommand();
+    }
+
+    reset();
+    return result;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the last command finished, when not writing into a queue
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+const Command* CommandParser::command(void)
+{
+    return _cmd;
+}
+
+//=========================================//
+//                TOKENIZER                //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Tokenizes a whole text command, e.g. "G1 P12.5 T-3", into its binary form.
+ *
+ *  @param[in]  text NULL terminated command text
+ *  @param[out] cmd  Tokenized command
+ *
+ *  @return 0 if the text isn't a valid command
+ *          1 if tokenizing was successful,
+ *          2 if a passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t tokenizeCommand(const char* text, Command* cmd)
+{
+    // If its a NULL pointer, return 2
+    if((text == NULL) || (cmd == NULL))
+        return 2;
+
+    CommandParser parser;
+    while(*text != '\0'){
+        if(parser.parse(*text++) == PARSE_ERROR)
+            return 0;
+    }
+    if(parser.parse('\n') != PARSE_DONE)
+        return 0;
+
+    *cmd = *parser.command();
+    return 1;
+}
@@ -0,0 +1,149 @@
+#include "../inc/CommandQueue.hpp"
+#include "../inc/CommandParser.hpp"
+
+// Index accesses shared between the producer and the consumer. A release store publishes everything written
+// before it, an acquire load sees everything published by the matching store. Single byte, so never torn.
+#define LOAD_INDEX(index)           __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define STORE_INDEX(index, value)   __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates an empty command queue
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+CommandQueue::CommandQueue(void)
+{
+    _head = 0;
+    _tail = 0;
+}
+
+//=========================================//
+//              PRODUCER SIDE              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Reserves the slot at the tail of the queue to be written in place. The slot is set up to receive text,
+ *         a producer writing the tokenized form directly sets state to SLOT_TOKEN. Nothing is queued until
+ *         commitCommand() is called, so reserving again returns the same slot.
+ *
+ *  @return Pointer to the slot, NULL if the buffer is full
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+CommandSlot* CommandQueue::reserveCommand(void)
+{
+    // If buffer is full, there is no slot to give
+    if((uint8_t)(_tail - LOAD_INDEX(_head)) == COMMAND_QUEUE_SIZE)
+        return NULL;
+
+    CommandSlot* slot = &_slots[_tail & COMMAND_QUEUE_MASK];
+    slot->state = SLOT_TEXT;
+    slot->text[0] = '\0';
+    return slot;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues the reserved slot. Text is tokenized here, once, and replaced by its binary form.
+ *
+ *  @return 0 if buffer is full
+ *          1 if command queued successfully,
+ *          2 if the text isn't a valid command, the slot stays free
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandQueue::commitCommand(void)
+{
+    // If buffer is full, nothing can have been reserved
+    if((uint8_t)(_tail - LOAD_INDEX(_head)) == COMMAND_QUEUE_SIZE)
+        return 0;
+
+    CommandSlot* slot = &_slots[_tail & COMMAND_QUEUE_MASK];
+    if(slot->state == SLOT_TEXT){
+        Command cmd;
+
+        slot->text[COMMAND_TEXT_LENGTH-1] = '\0';   // Make sure the text is NULL terminated before going through it
+        if(tokenizeCommand(slot->text, &cmd) != 1)
+            return 2;
+
+        slot->cmd = cmd;                            // The text overlaps the command, so it's tokenized on the side first
+        slot->state = SLOT_TOKEN;
+    }
+
+    STORE_INDEX(_tail, (uint8_t)(_tail + 1));       // Publish the slot, the counter wraps around on its own
+    return 1;
+}
+
+//=========================================//
+//              CONSUMER SIDE              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Borrows the next command in the queue without removing it. FIFO setup.
+ *         The command stays valid until releaseCommand() is called.
+ *
+ *  @return Pointer to the command, NULL if the buffer is empty
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+const Command* CommandQueue::borrowCommand(void)
+{
+    if(LOAD_INDEX(_tail) == _head)
+        return NULL;
+
+    return &_slots[_head & COMMAND_QUEUE_MASK].cmd;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Removes the borrowed command from the queue, freeing its slot. FIFO setup.
+ *
+ *  @return 0 if buffer is empty
+ *          1 if releasing was successful
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandQueue::releaseCommand(void)
+{
+    if(LOAD_INDEX(_tail) == _head)
+        return 0;
+
+    STORE_INDEX(_head, (uint8_t)(_head + 1));       // Hand the slot back, we're done reading it
+    return 1;
+}
+
+//=========================================//
+//                 STATUS                  //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Checks if the queue is empty. Exact from the consumer, may be stale from the producer.
+ *
+ *  @return 1 if empty, 0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandQueue::isEmpty(void)
+{
+    return LOAD_INDEX(_tail) == LOAD_INDEX(_head);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Checks if the queue is full. Exact from the producer, may be stale from the consumer.
+ *
+ *  @return 1 if full, 0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandQueue::isFull(void)
+{
+    return (uint8_t)(LOAD_INDEX(_tail) - LOAD_INDEX(_head)) == COMMAND_QUEUE_SIZE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of commands waiting in the queue
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t CommandQueue::numCommands(void)
+{
+    return (uint8_t)(LOAD_INDEX(_tail) - LOAD_INDEX(_head));
+}
@@ -0,0 +1,267 @@
+#include "../inc/Frame.hpp"
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates a receiver waiting for the sync byte of a frame
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+FrameDecoder::FrameDecoder(void)
+{
+    _length = 0;
+    _sequence = 0;
+    reset();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Drops the frame being received
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameDecoder::reset(void)
+{
+    _state = FRAME_WAIT_SYNC;
+}
+
+//=========================================//
+//                RECEIVING                //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Consumes one byte. Bytes outside of a frame are skipped until FRAME_SYNC.
+ *
+ *  @param[in] c Byte received
+ *
+ *  @return FRAME_NONE if no frame was finished,
+ *          FRAME_DONE if a valid frame was finished, it can be read until the next byte is received,
+ *          FRAME_ERROR if a frame was finished with a CRC that doesn't match, it is dropped
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameDecoder::receive(uint8_t c)
+{
+    switch(_state){
+        case FRAME_WAIT_SYNC:
+            if(c == FRAME_SYNC)
+                _state = FRAME_WAIT_LENGTH;
+            return FRAME_NONE;
+
+        case FRAME_WAIT_LENGTH:
+            if(c > FRAME_MAX_PAYLOAD){
+                _state = (c == FRAME_SYNC) ? FRAME_WAIT_LENGTH : FRAME_WAIT_SYNC;   // Could have been the real sync byte
+                return FRAME_NONE;
+            }
+            _length = c;
+            _count = 0;
+            _crc = frameCrc(FRAME_CRC_INIT, c);
+            _state = FRAME_WAIT_SEQUENCE;
+            return FRAME_NONE;
+
+        case FRAME_WAIT_SEQUENCE:
+            _sequence = c;
+            _crc = frameCrc(_crc, c);
+            _state = (_length == 0) ? FRAME_WAIT_CRC_LOW : FRAME_WAIT_PAYLOAD;
+            return FRAME_NONE;
+
+        case FRAME_WAIT_PAYLOAD:
+            _payload[_count++] = c;
+            _crc = frameCrc(_crc, c);
+            if(_count == _length)
+                _state = FRAME_WAIT_CRC_LOW;
+            return FRAME_NONE;
+
+        case FRAME_WAIT_CRC_LOW:
+            _received = c;
+            _state = FRAME_WAIT_CRC_HIGH;
+            return FRAME_NONE;
+
+        case FRAME_WAIT_CRC_HIGH:
+            _received |= (uint16_t)c << 8;
+            _state = FRAME_WAIT_SYNC;
+            return (_received == _crc) ? FRAME_DONE : FRAME_ERROR;
+    }
+
+    return FRAME_NONE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if a frame is being received, its bytes have to go to receive() until it's finished
+ *
+ *  @return 1 if a frame is being received,
+ *          0 if waiting for the sync byte
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameDecoder::receiving(void)
+{
+    return _state != FRAME_WAIT_SYNC;
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the payload of the last frame finished
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+const uint8_t* FrameDecoder::payload(void)
+{
+    return _payload;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the payload length of the last frame finished [Bytes]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameDecoder::length(void)
+{
+    return _length;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the sequence number of the last frame finished
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameDecoder::sequence(void)
+{
+    return _sequence;
+}
+
+//=========================================//
+//                ENCODING                 //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Adds a byte to a CRC-16/CCITT-FALSE (polynomial 0x1021), worked out without a table to spare the flash
+ *
+ *  @param[in] crc CRC so far, FRAME_CRC_INIT to start with
+ *  @param[in] c   Byte to add
+ *
+ *  @return CRC with the byte added
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint16_t frameCrc(uint16_t crc, uint8_t c)
+{
+    uint8_t x = (crc >> 8) ^ c;
+    x ^= x >> 4;
+    return (crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Wraps a payload into a frame
+ *
+ *  @param[in]  sequence Sequence number of the frame
+ *  @param[in]  payload  Payload, can be NULL if length is 0
+ *  @param[in]  length   Length of the payload, up to FRAME_MAX_PAYLOAD [Bytes]
+ *  @param[out] frame    Frame, room for length + FRAME_OVERHEAD bytes
+ *
+ *  @return Length of the frame [Bytes], 0 if the payload is too long or frame is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t writeFrame(uint8_t sequence, const uint8_t* payload, uint8_t length, uint8_t* frame)
+{
+    if((frame == NULL) || (length > FRAME_MAX_PAYLOAD) || ((payload == NULL) && (length > 0)))
+        return 0;
+
+    uint16_t crc = frameCrc(FRAME_CRC_INIT, length);
+    crc = frameCrc(crc, sequence);
+
+    frame[0] = FRAME_SYNC;
+    frame[1] = length;
+    frame[2] = sequence;
+    for(uint8_t i = 0; i < length; i++){
+        frame[3 + i] = payload[i];
+        crc = frameCrc(crc, payload[i]);
+    }
+    frame[3 + length] = crc & 0xFF;
+    frame[4 + length] = crc >> 8;
+
+    return length + FRAME_OVERHEAD;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Packs a command into a payload record
+ *
+ *  @param[in]  cmd    Tokenized command
+ *  @param[out] record Record, room for FRAME_RECORD_MAX bytes
+ *
+ *  @return Length of the record [Bytes], 0 if a passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t encodeCommand(const Command* cmd, uint8_t* record)
+{
+    if((cmd == NULL) || (record == NULL))
+        return 0;
+
+    uint8_t n = 0;
+    if(cmd->op > FRAME_OP_MASK){
+        record[n++] = FRAME_OP_EXTENDED | (cmd->argMask << FRAME_ARG_SHIFT);
+        record[n++] = cmd->op;
+    }
+    else{
+        record[n++] = cmd->op | (cmd->argMask << FRAME_ARG_SHIFT);
+    }
+    for(uint8_t i = 0; i < NUM_OF_ARGS; i++){
+        if(!(cmd->argMask & (1 << i)))
+            continue;
+
+        uint32_t value = (uint32_t)cmd->args[i];
+        record[n++] = value;
+        record[n++] = value >> 8;
+        record[n++] = value >> 16;
+        record[n++] = value >> 24;
+    }
+
+    return n;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Unpacks the payload record at the start of record into a command
+ *
+ *  @param[in]  record Bytes left of the payload
+ *  @param[in]  length Number of bytes left [Bytes]
+ *  @param[out] cmd    Tokenized command
+ *
+ *  @return Length of the record [Bytes], 0 if it's cut short or isn't a valid command
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t decodeCommand(const uint8_t* record, uint8_t length, Command* cmd)
+{
+    if((record == NULL) || (cmd == NULL) || (length == 0))
+        return 0;
+
+    uint8_t n = 1;
+    cmd->op = record[0] & FRAME_OP_MASK;
+    cmd->argMask = record[0] >> FRAME_ARG_SHIFT;
+    if(cmd->op == FRAME_OP_EXTENDED){
+        if(length < 2)
+            return 0;
+        cmd->op = record[n++];
+    }
+    if((cmd->op == CMD_NONE) || (cmd->op >= NUM_OF_OPS))
+        return 0;
+
+    for(uint8_t i = 0; i < NUM_OF_ARGS; i++){
+        if(!(cmd->argMask & (1 << i)))
+            continue;
+        if(length - n < 4)
+            return 0;
+
+        cmd->args[i] = (int32_t)((uint32_t)record[n] | ((uint32_t)record[n+1] << 8) |
+                                 ((uint32_t)record[n+2] << 16) | ((uint32_t)record[n+3] << 24));
+        n += 4;
+    }
+
+    return n;
+}
@@ -0,0 +1,235 @@
+#include "../inc/FrameLink.hpp"
+#include "../inc/MotionPlanner.hpp"
+#include "../inc/StallMonitor.hpp"
+#include "../inc/Telemetry.hpp"
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates the board side of the binary protocol
+ *
+ *  @param[in] queue Queue the commands of every frame go into
+ *  @param[in] send  Writes a reply frame out, e.g. with Serial.write()
+ *  @param[in] room  Gets the bytes send can take without waiting, e.g. with Serial.availableForWrite()
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+FrameLink::FrameLink(CommandQueue* queue, void (*send)(const uint8_t* data, uint8_t length), uint8_t (*room)(void))
+{
+    _queue = queue;
+    _send = send;
+    _room = room;
+    _expected = 0;
+    _active = 0;
+    _reported = 0;
+    _reportTime = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Consumes one byte, queuing the commands of a frame and replying to it once it's finished
+ *
+ *  @param[in] c Byte received
+ *
+ *  @return FRAME_NONE if no frame was finished,
+ *          FRAME_DONE if a frame was finished and replied to,
+ *          FRAME_ERROR if a corrupted frame was finished and NAKed
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameLink::receive(uint8_t c)
+{
+    uint8_t result = _decoder.receive(c);
+
+    if(result == FRAME_DONE){
+        _active = 1;
+        accept();
+    }
+    else if(result == FRAME_ERROR)
+        reply(_expected, FRAME_NAK, FRAME_ERR_CRC);
+
+    return result;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if a frame is being received. While not, the bytes that aren't FRAME_SYNC can go to the text parser.
+ *
+ *  @return 1 if a frame is being received,
+ *          0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameLink::receiving(void)
+{
+    return _decoder.receiving();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the number of commands that can be queued right now
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t FrameLink::credits(void)
+{
+    return COMMAND_QUEUE_SIZE - _queue->numCommands();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends a status frame when it's due, and the next telemetry record of a dump if there's room for it.
+ *         Called from the main loop, and while a command waits for room.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameLink::service(void)
+{
+    // Asked for, so it goes to a host only sending text as well
+    sendTelemetry();
+
+    // A host only sending text wouldn't know what to do with it
+    if(!_active)
+        return;
+
+    uint8_t free = credits();
+    unsigned long elapsed = halMicros() - _reportTime;
+
+    if(elapsed < FRAME_STATUS_IDLE_US){
+        if(free == _reported)
+            return;
+        if((elapsed < FRAME_STATUS_US) && !((_reported < FRAME_STATUS_XON) && (free >= FRAME_STATUS_XON)))
+            return;
+    }
+
+    unsigned long queued = MotionPlanner::getInstance()->queuedTime();
+    if(queued > 0xFFFF)
+        queued = 0xFFFF;
+
+    uint8_t payload[6];
+    payload[0] = FRAME_STATUS;
+    payload[1] = free;
+    payload[2] = (MOTION_QUEUE_SIZE - 1) - MotionQueue::getInstance()->numBlocks();
+    payload[3] = queued & 0xFF;
+    payload[4] = queued >> 8;
+    payload[5] = StepEngine::getInstance()->busy() ? FRAME_STATUS_MOVING : 0;
+    if(StallMonitor::getInstance()->stalled())
+        payload[5] |= FRAME_STATUS_STALL;
+    send(payload, sizeof(payload), _expected);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends the next record of a telemetry dump as [TELEMETRY, records left, record], only if the serial buffer
+ *         takes the whole frame without waiting. Its sequence number is the one of the frame expected next.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameLink::sendTelemetry(void)
+{
+    Telemetry* telemetry = Telemetry::getInstance();
+    if(!telemetry->dumping() || (_room() < FRAME_OVERHEAD + 2 + sizeof(TelemetryRecord)))
+        return;
+
+    uint8_t payload[2 + sizeof(TelemetryRecord)];
+    TelemetryRecord record;
+    telemetry->next(&record);
+    payload[0] = FRAME_TELEMETRY;
+    payload[1] = telemetry->dumping();
+    memcpy(payload + 2, &record, sizeof(record));
+
+    // Not a reply, so the credits reported stay as they were
+    uint8_t frame[sizeof(payload) + FRAME_OVERHEAD];
+    _send(frame, writeFrame(_expected, payload, sizeof(payload), frame));
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Handles the frame just received: queues all of its commands if it's the one expected, then replies
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameLink::accept(void)
+{
+    uint8_t sequence = _decoder.sequence();
+    const uint8_t* payload = _decoder.payload();
+    uint8_t length = _decoder.length();
+
+    // An empty frame (re)starts the stream from its number
+    if(length == 0){
+        _expected = sequence + 1;
+        reply(sequence, FRAME_ACK, 0);
+        return;
+    }
+
+    if(sequence != _expected){
+        // One of the last 128 frames was already queued, only its ACK was lost
+        if((uint8_t)(_expected - 1 - sequence) < 128)
+            reply(sequence, FRAME_ACK, 0);
+        else
+            reply(_expected, FRAME_NAK, FRAME_ERR_SEQUENCE);
+        return;
+    }
+
+    // Check the whole payload first, so the frame is queued all or nothing
+    Command cmd;
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < length; count++){
+        uint8_t n = decodeCommand(payload + i, length - i, &cmd);
+        if(n == 0){
+            // Sending it again wouldn't fix it, so it's skipped
+            _expected++;
+            reply(_expected, FRAME_NAK, FRAME_ERR_COMMAND);
+            return;
+        }
+        i += n;
+    }
+
+    if(count > credits()){
+        reply(_expected, FRAME_NAK, FRAME_ERR_ROOM);
+        return;
+    }
+
+    // Decode every command straight into its slot
+    for(uint8_t i = 0; i < length;){
+        CommandSlot* slot = _queue->reserveCommand();
+        slot->state = SLOT_TOKEN;
+        i += decodeCommand(payload + i, length - i, &slot->cmd);
+        _queue->commitCommand();
+    }
+
+    _expected++;
+    reply(sequence, FRAME_ACK, 0);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends a reply frame carrying the credits left
+ *
+ *  @param[in] sequence Sequence number of the frame replied to for an ACK, of the one expected next for a NAK
+ *  @param[in] type     FRAME_ACK or FRAME_NAK
+ *  @param[in] reason   FRAME_ERR_x of a NAK
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameLink::reply(uint8_t sequence, uint8_t type, uint8_t reason)
+{
+    uint8_t payload[3];
+    uint8_t length = 0;
+
+    payload[length++] = type;
+    if(type == FRAME_NAK)
+        payload[length++] = reason;
+    payload[length++] = credits();
+
+    send(payload, length, sequence);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sends a frame to the host, noting the credits it carries in its last byte of a reply or its second of a status
+ *
+ *  @param[in] payload  Payload of the frame
+ *  @param[in] length   Length of the payload [Bytes]
+ *  @param[in] sequence Sequence number of the frame
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void FrameLink::send(const uint8_t* payload, uint8_t length, uint8_t sequence)
+{
+    _reported = (payload[0] == FRAME_STATUS) ? payload[1] : payload[length - 1];
+    _reportTime = halMicros();
+
+    uint8_t frame[6 + FRAME_OVERHEAD];
+    _send(frame, writeFrame(sequence, payload, length, frame));
+}
@@ -0,0 +1,754 @@
+#ifndef ARDUINO
+
+#include "../inc/Hal.hpp"
+#include "../inc/Microstep.hpp"
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Host simulator behind the hal functions. Time only moves when the code under test delays
+ * or when halSimRun() is called, and the step timer fires at exact multiples of its period
+ * on that virtual time, so every run is deterministic. Each pin change is logged with its
+ * time, and each simulated axis counts the rising edges of its STEP pin to know its angle
+ * and answer the reads of its Hall sensor. An axis given mode select pins moves as many
+ * microsteps per edge as the mode they're in, and counts the edges taken in a coarse mode
+ * off that mode's grid, where a real driver would lose track of its full steps. An axis given
+ * the enable pin of its driver adds up the time the driver is on, and counts the edges taken
+ * while it's off or still waking up, which a real motor would miss. Edges taken while it's
+ * off only move the driver's translator. Once back on, the rotor is pulled to the nearest
+ * position in phase with it, up to two full steps either way.
+ *
+ * A Hall sensor can be made to glitch, reading the other level for a while, the way noise on
+ * its line would.
+ *
+ * Each call of the timer interrupt is timed on the host clock, which tells its worst case
+ * on the host, not on the board.
+ *
+ * The EEPROM keeps its content through halSimReset(), like through a power cycle. A byte
+ * being written when it's reset is left with a mix of its old and new bits, the way a
+ * write cut by a power loss would leave it.
+ */
+
+typedef struct {
+    uint8_t used;
+    uint8_t stepPin;
+    uint8_t dirPin;
+    uint8_t hallPin;
+    uint8_t forwardDir;                     // DIR level that counts steps up
+    double stepsPerDegree;
+    long steps;                             // Position from where the simulation started [Steps]
+    long index;                             // Microstep the driver's translator is on, in phase with steps while on [Steps]
+    unsigned long pulses;                   // Rising edges of the STEP pin
+    uint8_t msPins[3];
+    uint8_t microsteps;                     // Microsteps per full step of the finest mode, 0 without mode select pins
+    unsigned long misaligned;               // Edges taken off the grid of a coarse mode
+    uint8_t driver;                         // Set once an enable pin is given
+    uint8_t enPin;
+    uint8_t onLevel;                        // Level of the enable pin that turns the driver on
+    unsigned long wakeUs;                   // Time from turning the driver on until it can step [us]
+    unsigned long onSince;                  // When the driver was last turned on [us]
+    unsigned long onTime;                   // Time on before onSince [us]
+    unsigned long missed;                   // Edges taken while off or waking up
+
+    uint8_t magnet;                         // Set once a magnet is placed
+    double magnetAngle;                     // Center of the magnet [Degrees]
+    double magnetWidth;                     // [Degrees]
+    uint8_t detectedLevel;                  // Level the Hall pin reads over the magnet
+    unsigned long glitchStart;              // When the Hall pin last started reading the other level [us]
+    unsigned long glitchUs;                 // How long it reads it for [us]
+} SimAxis;
+
+static uint8_t _levels[HAL_SIM_PINS];
+static uint8_t _modes[HAL_SIM_PINS];
+static SimAxis _axes[HAL_SIM_AXES];
+
+static HalSimEdge _edges[HAL_SIM_EDGES];
+static unsigned long _edgeCount;            // Edges logged since the last clear, kept or not
+
+static unsigned long _now;                  // Virtual time [us]
+static unsigned long _period;
+static unsigned long _nextTick;
+static void (*_isr)(void);
+static uint8_t _running;
+static uint8_t _interruptsOn = 1;
+static uint8_t _pending;                    // A tick came while interrupts were off
+static uint8_t _inIsr;
+static HalSimIsrTime _isrTime;
+static unsigned long _timerMark;            // Time of the last halTimerMark() [us]
+
+static uint8_t _eeprom[HAL_EEPROM_SIZE];
+static unsigned long _eepromWrites[HAL_EEPROM_SIZE];
+static uint8_t _eepromUsed;                 // Cleared until the EEPROM is first touched, it starts erased
+static uint8_t _eepromBusy;                 // A write is under way
+static uint16_t _eepromAddress;             // Byte it's writing
+static uint8_t _eepromValue;                // Value it's writing
+static unsigned long _eepromStart;          // When it started [us]
+
+//=========================================//
+//             HELPER FUNCTIONS            //
+//=========================================//
+
+static void fire(void)
+{
+    if(!_interruptsOn){
+        _pending = 1;
+        return;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    _inIsr = 1;
+    _isr();
+    _inIsr = 0;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    unsigned long ns = (end.tv_sec - start.tv_sec) * 1000000000UL + end.tv_nsec - start.tv_nsec;
+    _isrTime.calls++;
+    _isrTime.totalNs += ns;
+    if(ns > _isrTime.worstNs)
+        _isrTime.worstNs = ns;
+}
+
+/**
+ * @brief Moves virtual time forward, firing every tick on the way. Time spent inside the
+ * interrupt, e.g. a step pulse, moves it forward without firing, like the board would.
+ */
+static void advance(unsigned long us)
+{
+    unsigned long target = _now + us;
+
+    while(!_inIsr && _running && (_isr != NULL) && ((long)(target - _nextTick) >= 0)){
+        _now = _nextTick;
+        _nextTick += _period;
+        fire();
+    }
+
+    if((long)(target - _now) > 0)
+        _now = target;
+}
+
+/**
+ * @brief Microsteps a step edge moves an axis in the mode its select pins are in
+ */
+static long microstepsPerPulse(const SimAxis* axis)
+{
+    if(axis->microsteps == 0)
+        return 1;
+
+    uint8_t bits = (_levels[axis->msPins[0]] ? 0x01 : 0) | (_levels[axis->msPins[1]] ? 0x02 : 0) |
+                   (_levels[axis->msPins[2]] ? 0x04 : 0);
+    for(uint8_t log2 = 0; (1 << log2) <= axis->microsteps; log2++){
+        if(MICROSTEP_MODE_BITS(log2) == bits)
+            return axis->microsteps >> log2;
+    }
+    return 1;
+}
+
+/**
+ * @brief Probes if the driver of an axis is on, always so without an enable pin
+ */
+static uint8_t driverOn(const SimAxis* axis)
+{
+    return !axis->driver || (_levels[axis->enPin] == axis->onLevel);
+}
+
+/**
+ * @brief Pulls the rotor of an axis to the nearest position in phase with its translator, as turning its driver on does.
+ * The phases repeat every four full steps.
+ */
+static void pullIntoPhase(SimAxis* axis)
+{
+    long cycle = 4L * ((axis->microsteps != 0) ? axis->microsteps : 1);
+    long offset = (axis->index - axis->steps) % cycle;
+
+    if(offset < -cycle / 2)
+        offset += cycle;
+    else if(offset >= cycle / 2)
+        offset -= cycle;
+    axis->steps += offset;
+}
+
+/**
+ * @brief Follows the enable pins, adding up the time each driver was on
+ */
+static void enableEdge(uint8_t pin, uint8_t value)
+{
+    for(uint8_t i = 0; i < HAL_SIM_AXES; i++){
+        SimAxis* axis = &_axes[i];
+        if(!axis->used || !axis->driver || (axis->enPin != pin))
+            continue;
+
+        if(value == axis->onLevel){
+            axis->onSince = _now;
+            pullIntoPhase(axis);
+        }
+        else{
+            axis->onTime += _now - axis->onSince;
+        }
+    }
+}
+
+/**
+ * @brief Finishes the EEPROM write under way once it's had the time to. Called before anything looks at the EEPROM.
+ */
+static void eepromUpdate(void)
+{
+    if(!_eepromUsed){
+        memset(_eeprom, 0xFF, sizeof(_eeprom));
+        _eepromUsed = 1;
+    }
+
+    if(_eepromBusy && (_now - _eepromStart >= HAL_SIM_EEPROM_US)){
+        _eeprom[_eepromAddress] = _eepromValue;
+        _eepromBusy = 0;
+    }
+}
+
+static SimAxis* axisOnPin(uint8_t pin, uint8_t hall)
+{
+    for(uint8_t i = 0; i < HAL_SIM_AXES; i++){
+        if(_axes[i].used && ((hall ? _axes[i].hallPin : _axes[i].stepPin) == pin))
+            return &_axes[i];
+    }
+    return NULL;
+}
+
+//=========================================//
+//                   HAL                   //
+//=========================================//
+
+void halPinMode(uint8_t pin, uint8_t mode)
+{
+    if(pin >= HAL_SIM_PINS)
+        return;
+
+    _modes[pin] = mode;
+    if(mode == INPUT_PULLUP)
+        _levels[pin] = HIGH;
+}
+
+void halDigitalWrite(uint8_t pin, uint8_t value)
+{
+    if(pin >= HAL_SIM_PINS)
+        return;
+
+    value = value ? HIGH : LOW;
+    if(_levels[pin] == value)
+        return;
+    _levels[pin] = value;
+
+    HalSimEdge* edge = &_edges[_edgeCount % HAL_SIM_EDGES];
+    edge->time = _now;
+    edge->pin = pin;
+    edge->value = value;
+    _edgeCount++;
+    enableEdge(pin, value);
+
+    SimAxis* axis = axisOnPin(pin, 0);
+    if((axis == NULL) || (value == LOW))
+        return;
+
+    if(!driverOn(axis) || (_now - axis->onSince < axis->wakeUs))
+        axis->missed++;
+
+    // The rotor only follows the translator while the driver is on
+    long size = microstepsPerPulse(axis);
+    if(axis->index % size != 0)
+        axis->misaligned++;
+    if(_levels[axis->dirPin] != axis->forwardDir)
+        size = -size;
+    axis->index += size;
+    if(driverOn(axis))
+        axis->steps += size;
+    axis->pulses++;
+}
+
+uint8_t halDigitalRead(uint8_t pin)
+{
+    if(pin >= HAL_SIM_PINS)
+        return LOW;
+
+    SimAxis* axis = axisOnPin(pin, 1);
+    if(axis == NULL)
+        return _levels[pin];
+
+    uint8_t level = _levels[pin];
+    if(axis->magnet){
+        // Angle from the center of the magnet, wrapped to [-180, 180)
+        double angle = fmod(axis->steps / axis->stepsPerDegree - axis->magnetAngle + 180.0, 360.0);
+        if(angle < 0)
+            angle += 360.0;
+        angle -= 180.0;
+
+        if((angle >= -axis->magnetWidth / 2) && (angle < axis->magnetWidth / 2))
+            level = axis->detectedLevel;
+        else
+            level = !axis->detectedLevel;
+    }
+
+    if(_now - axis->glitchStart < axis->glitchUs)
+        return !level;
+    return level;
+}
+
+void halDelay(unsigned long ms)
+{
+    advance(ms * 1000UL);
+}
+
+void halDelayMicroseconds(unsigned int us)
+{
+    advance(us);
+}
+
+unsigned long halMicros(void)
+{
+    return _now;
+}
+
+void halNoInterrupts(void)
+{
+    _interruptsOn = 0;
+}
+
+void halInterrupts(void)
+{
+    _interruptsOn = 1;
+    if(_pending){
+        _pending = 0;
+        fire();
+    }
+}
+
+void halTimerInit(unsigned long periodUs, void (*isr)(void))
+{
+    _period = periodUs;
+    _isr = isr;
+    _running = 0;
+}
+
+void halTimerStart(void)
+{
+    // Like TimerOne, the first tick is a whole period after starting
+    if(!_running)
+        _nextTick = _now + _period;
+    _running = 1;
+}
+
+void halTimerStop(void)
+{
+    _running = 0;
+}
+
+void halTimerMark(void)
+{
+    _timerMark = _now;
+}
+
+// Only the time the simulation gives the interrupt, e.g. its step pulses, shows up
+uint16_t halTimerElapsed(void)
+{
+    unsigned long counts = (_now - _timerMark) * HAL_TIMER_COUNTS_PER_US;
+    return (counts > 0xFFFF) ? 0xFFFF : counts;
+}
+
+uint8_t halEepromRead(uint16_t address)
+{
+    eepromUpdate();
+
+    // The AVR can't read while writing, it waits
+    if(_eepromBusy){
+        advance(HAL_SIM_EEPROM_US - (_now - _eepromStart));
+        eepromUpdate();
+    }
+    return (address < HAL_EEPROM_SIZE) ? _eeprom[address] : 0xFF;
+}
+
+void halEepromWrite(uint16_t address, uint8_t value)
+{
+    if(!halEepromReady())
+        advance(HAL_SIM_EEPROM_US - (_now - _eepromStart));
+    eepromUpdate();
+
+    if(address >= HAL_EEPROM_SIZE)
+        return;
+
+    _eepromBusy = 1;
+    _eepromAddress = address;
+    _eepromValue = value;
+    _eepromStart = _now;
+    _eepromWrites[address]++;
+}
+
+uint8_t halEepromReady(void)
+{
+    eepromUpdate();
+    return !_eepromBusy;
+}
+
+//=========================================//
+//                SIMULATOR                //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Puts the simulator back to time 0, every pin low, no axis and no edge logged. The timer keeps its setup but is stopped.
+ *         The EEPROM keeps its content, but the byte it was writing, if any, is left half written.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimReset(void)
+{
+    // Erasing sets bits, programming clears them, so a cut write has some of each
+    eepromUpdate();
+    if(_eepromBusy){
+        uint8_t mix = (uint8_t)rand();
+        uint8_t erasing = ((_now - _eepromStart) < HAL_SIM_EEPROM_US / 2);
+        _eeprom[_eepromAddress] = erasing ? (_eeprom[_eepromAddress] | mix) : (_eepromValue | mix);
+        _eepromBusy = 0;
+    }
+
+    memset(_levels, 0, sizeof(_levels));
+    memset(_modes, 0, sizeof(_modes));
+    memset(_axes, 0, sizeof(_axes));
+    _edgeCount = 0;
+    _now = 0;
+    _running = 0;
+    _interruptsOn = 1;
+    _pending = 0;
+    _inIsr = 0;
+    halSimClearIsrTime();
+    _timerMark = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Cuts the power and brings it back. Like halSimReset(), but every axis keeps its setup and its rotor stays where
+ *         it is. Each driver's translator starts over on its first microstep, and a driver that comes up on pulls its
+ *         rotor into phase with it.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimPowerCycle(void)
+{
+    SimAxis axes[HAL_SIM_AXES];
+    memcpy(axes, _axes, sizeof(axes));
+    halSimReset();
+    memcpy(_axes, axes, sizeof(axes));
+
+    for(uint8_t i = 0; i < HAL_SIM_AXES; i++){
+        SimAxis* axis = &_axes[i];
+        if(!axis->used)
+            continue;
+
+        // The phases started in step with the rotor, its first microstep is every four full steps from there
+        long cycle = 4L * ((axis->microsteps != 0) ? axis->microsteps : 1);
+        axis->index = axis->steps - (((axis->steps % cycle) + cycle) % cycle);
+        axis->onSince = 0;
+        if(driverOn(axis))
+            pullIntoPhase(axis);
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Simulates an axis driven by a step and a direction pin
+ *
+ *  @param[in] axis           Index of the axis, below HAL_SIM_AXES
+ *  @param[in] stepPin        Pin whose rising edges are steps
+ *  @param[in] dirPin         Direction pin
+ *  @param[in] hallPin        Pin of its Hall sensor
+ *  @param[in] forwardDir     Level of the direction pin that moves the angle up
+ *  @param[in] stepsPerDegree Steps per degree of the axis
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimAxis(uint8_t axis, uint8_t stepPin, uint8_t dirPin, uint8_t hallPin, uint8_t forwardDir, double stepsPerDegree)
+{
+    if(axis >= HAL_SIM_AXES)
+        return;
+
+    _axes[axis].used = 1;
+    _axes[axis].stepPin = stepPin;
+    _axes[axis].dirPin = dirPin;
+    _axes[axis].hallPin = hallPin;
+    _axes[axis].forwardDir = forwardDir;
+    _axes[axis].stepsPerDegree = stepsPerDegree;
+    _axes[axis].steps = 0;
+    _axes[axis].index = 0;
+    _axes[axis].pulses = 0;
+    _axes[axis].misaligned = 0;
+    _axes[axis].driver = 0;
+    _axes[axis].onTime = 0;
+    _axes[axis].missed = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Places the magnet seen by the Hall sensor of an axis. Angles wrap around every turn.
+ *
+ *  @param[in] axis          Index of the axis
+ *  @param[in] angle         Center of the magnet from where the axis starts [Degrees]
+ *  @param[in] width         Width over which the sensor detects it [Degrees]
+ *  @param[in] detectedLevel Level the Hall pin reads while over it
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimMagnet(uint8_t axis, double angle, double width, uint8_t detectedLevel)
+{
+    if(axis >= HAL_SIM_AXES)
+        return;
+
+    _axes[axis].magnet = 1;
+    _axes[axis].magnetAngle = angle;
+    _axes[axis].magnetWidth = width;
+    _axes[axis].detectedLevel = detectedLevel;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gives an axis the mode select pins of its driver. Its steps then count microsteps of the finest mode,
+ *         and the driver starts on index 0, a full step, like after power up.
+ *
+ *  @param[in] axis       Index of the axis
+ *  @param[in] ms1Pin     MS1 pin
+ *  @param[in] ms2Pin     MS2 pin
+ *  @param[in] ms3Pin     MS3 pin
+ *  @param[in] microsteps Microsteps per full step of the finest mode, its stepsPerDegree is given in those
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimMicrostep(uint8_t axis, uint8_t ms1Pin, uint8_t ms2Pin, uint8_t ms3Pin, uint8_t microsteps)
+{
+    if(axis >= HAL_SIM_AXES)
+        return;
+
+    _axes[axis].msPins[0] = ms1Pin;
+    _axes[axis].msPins[1] = ms2Pin;
+    _axes[axis].msPins[2] = ms3Pin;
+    _axes[axis].microsteps = microsteps;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gives an axis the enable pin of its driver, so the time it's on is added up and the steps it misses counted
+ *
+ *  @param[in] axis    Index of the axis
+ *  @param[in] enPin   Enable pin of the driver
+ *  @param[in] onLevel Level of the enable pin that turns the driver on
+ *  @param[in] wakeUs  Time the driver needs once on before it can step, e.g. for its current to build up [us]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimDriver(uint8_t axis, uint8_t enPin, uint8_t onLevel, unsigned long wakeUs)
+{
+    if(axis >= HAL_SIM_AXES)
+        return;
+
+    _axes[axis].driver = 1;
+    _axes[axis].enPin = enPin;
+    _axes[axis].onLevel = onLevel;
+    _axes[axis].wakeUs = wakeUs;
+    _axes[axis].onSince = _now;
+    _axes[axis].onTime = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves the rotor of an axis without its translator, as a stall does. A rotor falls back in phase, so steps
+ *         is a multiple of 4 full steps for the driver to hold it there.
+ *
+ *  @param[in] axis  Index of the axis
+ *  @param[in] steps What it moves by, negative to fall behind a move counting up [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimSlip(uint8_t axis, long steps)
+{
+    if(axis >= HAL_SIM_AXES)
+        return;
+
+    _axes[axis].steps += steps;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Makes the Hall sensor of an axis read the other level from now on for a while, as noise on its line does
+ *
+ *  @param[in] axis Index of the axis
+ *  @param[in] us   How long it lasts, 0 to end one under way [us]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimGlitch(uint8_t axis, unsigned long us)
+{
+    if(axis >= HAL_SIM_AXES)
+        return;
+
+    _axes[axis].glitchStart = _now;
+    _axes[axis].glitchUs = us;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Lets virtual time run, firing the timer as it goes, as if the main loop was busy for that long
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimRun(unsigned long us)
+{
+    advance(us);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Virtual time since the last reset [us]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long halSimTime(void)
+{
+    return _now;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Position of an axis [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long halSimSteps(uint8_t axis)
+{
+    return (axis < HAL_SIM_AXES) ? _axes[axis].steps : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Angle of an axis, not wrapped [Degrees]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double halSimAngle(uint8_t axis)
+{
+    if((axis >= HAL_SIM_AXES) || !_axes[axis].used)
+        return 0;
+    return _axes[axis].steps / _axes[axis].stepsPerDegree;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of step pulses an axis took
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long halSimPulses(uint8_t axis)
+{
+    return (axis < HAL_SIM_AXES) ? _axes[axis].pulses : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of step pulses an axis took in a coarse mode while off that mode's grid, each of which would shift
+ *         a real driver's full steps
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long halSimMisaligned(uint8_t axis)
+{
+    return (axis < HAL_SIM_AXES) ? _axes[axis].misaligned : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Time the driver of an axis was on since its enable pin was given [us]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long halSimOnTime(uint8_t axis)
+{
+    if((axis >= HAL_SIM_AXES) || !_axes[axis].driver)
+        return 0;
+
+    const SimAxis* sim = &_axes[axis];
+    return sim->onTime + (driverOn(sim) ? (_now - sim->onSince) : 0);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of step pulses an axis took while its driver was off or still waking up
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long halSimMissed(uint8_t axis)
+{
+    return (axis < HAL_SIM_AXES) ? _axes[axis].missed : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of edges that can be read with halSimEdge(). Only the last HAL_SIM_EDGES are kept.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long halSimNumEdges(void)
+{
+    return (_edgeCount > HAL_SIM_EDGES) ? HAL_SIM_EDGES : _edgeCount;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets a logged edge, oldest first
+ *
+ *  @param[in] index From 0 to halSimNumEdges()-1
+ *
+ *  @return Pointer to the edge, NULL if there's none at that index
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+const HalSimEdge* halSimEdge(unsigned long index)
+{
+    if(index >= halSimNumEdges())
+        return NULL;
+
+    unsigned long first = (_edgeCount > HAL_SIM_EDGES) ? (_edgeCount - HAL_SIM_EDGES) : 0;
+    return &_edges[(first + index) % HAL_SIM_EDGES];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Forgets every logged edge
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimClearEdges(void)
+{
+    _edgeCount = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the host time the timer interrupt took since the last clear
+ *
+ *  @param[out] time Calls, longest call and total
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimIsrTime(HalSimIsrTime* time)
+{
+    *time = _isrTime;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Forgets the time the timer interrupt took so far
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimClearIsrTime(void)
+{
+    memset(&_isrTime, 0, sizeof(_isrTime));
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Erases the whole EEPROM to 0xFF, as it comes from the factory, and forgets how many times each byte was written
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void halSimEepromErase(void)
+{
+    memset(_eeprom, 0xFF, sizeof(_eeprom));
+    memset(_eepromWrites, 0, sizeof(_eepromWrites));
+    _eepromUsed = 1;
+    _eepromBusy = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of times a byte of the EEPROM was written, the wear it took
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long halSimEepromWrites(uint16_t address)
+{
+    return (address < HAL_EEPROM_SIZE) ? _eepromWrites[address] : 0;
+}
+
+#endif
@@ -0,0 +1,881 @@
+#include "../inc/MotionPlanner.hpp"
+#include "math.h"
+#include "../inc/PinDef.h"
+#include "../inc/Kinematics.hpp"
+#include "../inc/Telemetry.hpp"
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+MotionPlanner* MotionPlanner::instance;
+
+MotionPlanner* MotionPlanner::getInstance()
+{
+    if(instance == NULL){
+        instance = new MotionPlanner();
+    }
+    return instance;
+}
+
+MotionPlanner::MotionPlanner(void)
+{
+    _mode = TRAPEZOID;
+    setPanAccel(PAN_DEFAULT_ACCEL);
+    setTiltAccel(TILT_DEFAULT_ACCEL);
+    setPanJerk(PAN_DEFAULT_JERK);
+    setTiltJerk(TILT_DEFAULT_JERK);
+    setJunctionDeviation(DEFAULT_JUNCTION_DEV);
+
+    _indexKnown = 0;
+    _indexHome = 0;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _index[i] = 0;
+}
+
+//=========================================//
+//                 PLANNING                //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues a move and replans the queue. The move is planned to end at rest until another one is appended.
+ *         Every axis is kept within its own feedrate, acceleration and jerk. A fast move takes up to three blocks,
+ *         see split(), and is only queued once they all fit.
+ *
+ *  @param[in] delta        Steps to take on each axis, signed
+ *  @param[in] dir          Direction pin value of each axis
+ *  @param[in] panFeedrate  Max pan step rate [Steps/Sec]
+ *  @param[in] tiltFeedrate Max tilt step rate [Steps/Sec]
+ *
+ *  @return 0 if the queue doesn't have room for it,
+ *          1 if the move was queued,
+ *          2 if there is nothing to move or a passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionPlanner::append(const long delta[], const uint8_t dir[], double panFeedrate, double tiltFeedrate)
+{
+    if((delta == NULL) || (dir == NULL))
+        return 2;
+
+    MotionQueue* queue = MotionQueue::getInstance();
+    double feedrate[STEP_ENGINE_AXES] = {panFeedrate, tiltFeedrate};
+    long part[PLANNER_MAX_PARTS][STEP_ENGINE_AXES];
+    uint8_t shift[PLANNER_MAX_PARTS][STEP_ENGINE_AXES];
+    uint8_t i;
+
+    trackIndex();
+    uint8_t parts = split(delta, feedrate, part, shift);
+    if(queue->numBlocks() + parts > MOTION_QUEUE_SIZE - 1)
+        return 0;
+
+    uint8_t result = 2;
+    for(uint8_t p = 0; p < parts; p++){
+        if(appendBlock(part[p], dir, shift[p], feedrate) == 1)
+            result = 1;
+    }
+    if(result != 1)
+        return result;
+
+    for(i = 0; i < STEP_ENGINE_AXES; i++)
+        _index[i] += delta[i];
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues an arc as a single block and replans the queue. The step interrupt traces it whole, see StepEngine, at
+ *         one speed along the path, always in the finest microstep mode. Its speed is kept within the slowest axis'
+ *         feedrate, since every axis goes as fast as the path somewhere on a long enough arc, and within what the
+ *         slowest axis' acceleration can hold on the circle.
+ *
+ *  @param[in] from         Where the arc starts, where the queued moves end [Millidegrees]
+ *  @param[in] center       Center of the arc [Millidegrees]
+ *  @param[in] delta        Steps from the start to where the arc ends on each axis, signed
+ *  @param[in] sweep        Angle to go around the center, counterclockwise if positive [Radians]
+ *  @param[in] panFeedrate  Max pan step rate [Steps/Sec]
+ *  @param[in] tiltFeedrate Max tilt step rate [Steps/Sec]
+ *
+ *  @return 0 if the queue doesn't have room for it,
+ *          1 if the arc was queued,
+ *          2 if it's too small to trace, over ARC_MAX_RADIUS, or a passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionPlanner::appendArc(const long from[], const long center[], const long delta[], double sweep,
+                                 double panFeedrate, double tiltFeedrate)
+{
+    if((from == NULL) || (center == NULL) || (delta == NULL))
+        return 2;
+
+    const double stepRate[STEP_ENGINE_AXES] = {PAN_STEPRATE, TILT_STEPRATE};
+    const double feedrate[STEP_ENGINE_AXES] = {panFeedrate, tiltFeedrate};
+    const double accelLimit[STEP_ENGINE_AXES] = {_pan_accel, _tilt_accel};
+    const double jerkLimit[STEP_ENGINE_AXES] = {_pan_jerk, _tilt_jerk};
+    const long span[STEP_ENGINE_AXES] = {ARC_PAN_STEP, ARC_TILT_STEP};
+    const long start[STEP_ENGINE_AXES] = {panStepsFromMdeg(from[0]), tiltStepsFromMdeg(from[1])};
+    long vector[STEP_ENGINE_AXES];
+    uint8_t i;
+
+    for(i = 0; i < STEP_ENGINE_AXES; i++)
+        vector[i] = from[i] - center[i];
+    double radius = sqrt((double)vector[0] * vector[0] + (double)vector[1] * vector[1]);
+    if((radius == 0) || (radius > ARC_MAX_RADIUS) || (sweep == 0))
+        return 2;
+
+    // Turn by 2^-shift radians per step event, the biggest angle that moves no axis by more than a step.
+    // Minsky's circle turns by 2*asin(2^-shift/2) each time.
+    uint8_t shift = ARC_MIN_SHIFT;
+    long smallest = (span[0] < span[1]) ? span[0] : span[1];
+    while((shift < 30) && (radius * ARC_Q > (double)smallest * (1L << shift)))
+        shift++;
+    double turn = 2.0 * asin(ldexp(1.0, -shift) / 2.0);
+    unsigned long events = lround(fabs(sweep) / turn);
+    if(events == 0)
+        return 2;
+
+    trackIndex();
+    MotionQueue* queue = MotionQueue::getInstance();
+    MotionBlock* block = queue->tailBlock();
+    if(block == NULL)
+        return 0;
+
+    // Each axis starts on the step the start converts to, its span along the vector laid out the same way
+    block->step.arc = (sweep > 0) ? ARC_CCW : ARC_CW;
+    block->step.arcShift = shift;
+    block->step.arcX = vector[0] * ARC_Q;
+    block->step.arcY = vector[1] * ARC_Q;
+    block->step.events = events;
+    block->step.negMask = 0;
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        long low = lround(((start[i] - 0.5) * stepRate[i] * FIXED_SCALE - center[i]) * ARC_Q);
+        if(low > vector[i] * ARC_Q)
+            low = vector[i] * ARC_Q;
+        if(low + span[i] <= vector[i] * ARC_Q)
+            low = vector[i] * ARC_Q - span[i] + 1;
+        block->step.arcLow[i] = low;
+
+        block->step.steps[i] = labs(delta[i]);
+        block->step.shift[i] = 0;
+        if(delta[i] < 0)
+            block->step.negMask |= (1 << i);
+    }
+
+    // Tangents at both ends, the start one also sets the direction pins the arc starts with
+    double direction = (sweep > 0) ? 1.0 : -1.0;
+    double startAngle = atan2((double)vector[1], (double)vector[0]);
+    double endAngle = startAngle + sweep;
+    double entryUnit[STEP_ENGINE_AXES] = {-direction * sin(startAngle), direction * cos(startAngle)};
+    double exitUnit[STEP_ENGINE_AXES] = {-direction * sin(endAngle), direction * cos(endAngle)};
+    const uint8_t forward[STEP_ENGINE_AXES] = {PAN_DIR_CCW, TILT_DIR_CCW};
+    for(i = 0; i < STEP_ENGINE_AXES; i++)
+        block->dir[i] = (entryUnit[i] >= 0) ? forward[i] : !forward[i];
+
+    // Path limits from the slowest axis, in degrees
+    double nominal = 0, accel = 0, jerk = 0;
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        if((nominal == 0) || (feedrate[i] * stepRate[i] < nominal))
+            nominal = feedrate[i] * stepRate[i];
+        if((accel == 0) || (accelLimit[i] * stepRate[i] < accel))
+            accel = accelLimit[i] * stepRate[i];
+        if((jerk == 0) || (jerkLimit[i] * stepRate[i] < jerk))
+            jerk = jerkLimit[i] * stepRate[i];
+    }
+
+    radius /= FIXED_SCALE;
+    block->length = radius * fabs(sweep);
+    block->stepsPerDegree = events / block->length;
+
+    // Going around takes a centripetal acceleration of speed^2/radius, and the interrupt does at most one event a tick
+    if(nominal * nominal > accel * radius)
+        nominal = sqrt(accel * radius);
+    if(nominal * block->stepsPerDegree > STEP_TICK_HZ)
+        nominal = STEP_TICK_HZ / block->stepsPerDegree;
+    block->nominalSpeed = nominal;
+    block->accel = accel;
+    block->jerk = jerk;
+
+    enqueue(block, entryUnit, exitUnit);
+    for(i = 0; i < STEP_ENGINE_AXES; i++)
+        _index[i] += delta[i];
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Takes the drivers' microstep index from the step engine when it's idle. It can only be read while nothing
+ *         moves them, and homing moves them by an unknown amount. The queue is checked first, the interrupt only ever
+ *         empties it before it goes idle.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::trackIndex(void)
+{
+    StepEngine* engine = StepEngine::getInstance();
+
+    if(MotionQueue::getInstance()->isEmpty() && !engine->busy()){
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+            _index[i] = engine->microIndex(i);
+        _indexHome = engine->homeCount();
+        _indexKnown = 1;
+    }
+    else if(engine->homeCount() != _indexHome){
+        _indexKnown = 0;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Splits a move into the blocks it's queued as. A move stays whole and fine unless an axis with a coarse mode
+ *         cruises past its COARSE_SPEED and goes over at least MICROSTEP_MIN_FULL_STEPS full steps.
+ *
+ *         The split is made on the full steps of the coarse axis with the most of them: a fine head up to its first
+ *         full step, a coarse body, and a fine tail from its last full step. The other axis goes coarse as well if
+ *         it's fast enough, its split points then snapped to its own nearest full steps, which bends the path by
+ *         less than half a full step. Otherwise its split points are just rounded.
+ *
+ *  @param[in]  delta    Steps to take on each axis, signed
+ *  @param[in]  feedrate Max step rate of each axis [Steps/Sec]
+ *  @param[out] part     Steps of each block to queue, signed. Empty blocks are left out.
+ *  @param[out] shift    Microstep mode of each axis in each block, as StepBlock::shift
+ *
+ *  @return Number of blocks to queue, from 1 to PLANNER_MAX_PARTS
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionPlanner::split(const long delta[], const double feedrate[], long part[][STEP_ENGINE_AXES], uint8_t shift[][STEP_ENGINE_AXES])
+{
+    const double stepRate[STEP_ENGINE_AXES] = {PAN_STEPRATE, TILT_STEPRATE};
+    const double coarseSpeed[STEP_ENGINE_AXES] = {PAN_COARSE_SPEED, TILT_COARSE_SPEED};
+    const uint8_t coarseShift[STEP_ENGINE_AXES] = {PAN_COARSE_SHIFT, TILT_COARSE_SHIFT};
+    const long microsteps[STEP_ENGINE_AXES] = {PAN_MICROSTEPS, TILT_MICROSTEPS};
+    long from[STEP_ENGINE_AXES];        // Where the head ends
+    long to[STEP_ENGINE_AXES];          // Where the body ends
+    uint8_t i;
+
+    // Unless split, the whole move goes in one fine block
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        part[0][i] = delta[i];
+        shift[0][i] = 0;
+    }
+    if(!_indexKnown)
+        return 1;
+
+    // Cruising, the axis taking the longest at its feedrate sets the time and the others go in proportion
+    double time = 0;
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        if((delta[i] != 0) && (feedrate[i] > 0) && (labs(delta[i]) / feedrate[i] > time))
+            time = labs(delta[i]) / feedrate[i];
+    }
+    if(time == 0)
+        return 1;
+
+    uint8_t coarse = 0;
+    int8_t lead = -1;
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        if((coarseShift[i] == 0) || (labs(delta[i]) * stepRate[i] / time <= coarseSpeed[i]))
+            continue;
+
+        coarse |= (1 << i);
+        if((lead < 0) || (labs(delta[i]) / microsteps[i] > labs(delta[lead]) / microsteps[lead]))
+            lead = i;
+    }
+    if(lead < 0)
+        return 1;
+
+    // Microsteps of the lead axis before its first full step, and after its last one
+    long n = labs(delta[lead]);
+    long m = microsteps[lead];
+    long sign = (delta[lead] < 0) ? -1 : 1;
+    long first = (uint8_t)_index[lead] % m;
+    long last = (uint8_t)(_index[lead] + delta[lead]) % m;
+    long head = (sign > 0) ? (m - first) % m : first;
+    long tail = (sign > 0) ? last : (m - last) % m;
+    if(n - head - tail < MICROSTEP_MIN_FULL_STEPS * m)
+        return 1;
+
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        if((int8_t)i == lead){
+            from[i] = sign * head;
+            to[i] = delta[i] - sign * tail;
+            continue;
+        }
+
+        from[i] = lround(delta[i] * (double)head / n);
+        to[i] = lround(delta[i] * (double)(n - tail) / n);
+        if(!(coarse & (1 << i)))
+            continue;
+
+        // Snap both onto the nearest full steps, as long as they stay within the move and apart
+        long mi = microsteps[i];
+        long a = (uint8_t)(_index[i] + from[i]) % mi;
+        long b = (uint8_t)(_index[i] + to[i]) % mi;
+        a = from[i] - a + ((2 * a >= mi) ? mi : 0);
+        b = to[i] - b + ((2 * b >= mi) ? mi : 0);
+
+        long s = (delta[i] < 0) ? -1 : 1;
+        if((s * a >= 0) && (s * (b - a) >= MICROSTEP_MIN_FULL_STEPS * mi) && (s * (delta[i] - b) >= 0)){
+            from[i] = a;
+            to[i] = b;
+        }
+        else{
+            coarse &= ~(1 << i);
+        }
+    }
+
+    // Head, body and tail, leaving out the empty ones
+    uint8_t parts = 0;
+    for(uint8_t p = 0; p < 3; p++){
+        uint8_t moves = 0;
+        for(i = 0; i < STEP_ENGINE_AXES; i++){
+            long start = (p == 0) ? 0 : (p == 1) ? from[i] : to[i];
+            long end = (p == 0) ? from[i] : (p == 1) ? to[i] : delta[i];
+
+            part[parts][i] = end - start;
+            shift[parts][i] = ((p == 1) && (coarse & (1 << i))) ? coarseShift[i] : 0;
+            if(end != start)
+                moves = 1;
+        }
+        if(moves)
+            parts++;
+    }
+    return parts;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues one block and replans the queue
+ *
+ *  @param[in] delta    Steps to take on each axis, signed
+ *  @param[in] dir      Direction pin value of each axis
+ *  @param[in] shift    Microstep mode of each axis, as StepBlock::shift. Steps are still given in the finest mode.
+ *  @param[in] feedrate Max step rate of each axis [Steps/Sec]
+ *
+ *  @return 0 if the queue is full,
+ *          1 if the block was queued,
+ *          2 if there is nothing to move
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionPlanner::appendBlock(const long delta[], const uint8_t dir[], const uint8_t shift[], const double feedrate[])
+{
+    MotionQueue* queue = MotionQueue::getInstance();
+    MotionBlock* block = queue->tailBlock();
+    if(block == NULL)
+        return 0;
+
+    double stepRate[STEP_ENGINE_AXES] = {PAN_STEPRATE, TILT_STEPRATE};
+    double accelLimit[STEP_ENGINE_AXES] = {_pan_accel, _tilt_accel};
+    double jerkLimit[STEP_ENGINE_AXES] = {_pan_jerk, _tilt_jerk};
+    double travel[STEP_ENGINE_AXES];
+    double unit[STEP_ENGINE_AXES];
+    double length = 0;
+    uint8_t i;
+
+    block->step.arc = ARC_NONE;
+    block->step.events = 0;
+    block->step.negMask = 0;
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        block->step.steps[i] = labs(delta[i]) >> shift[i];
+        block->step.shift[i] = shift[i];
+        if(block->step.steps[i] > block->step.events)
+            block->step.events = block->step.steps[i];
+        if(delta[i] < 0)
+            block->step.negMask |= (1 << i);
+        block->dir[i] = dir[i];
+
+        travel[i] = labs(delta[i]) * stepRate[i];
+        length += travel[i] * travel[i];
+    }
+    if(block->step.events == 0)
+        return 2;
+    length = sqrt(length);
+
+    // Scale every axis limit to the path. An axis covering half of the path's degrees
+    // moves at half the path speed, so the path may go twice as fast as that axis' own limit.
+    // Limits are in microsteps of the finest mode, whatever mode the block steps in.
+    double nominal = 0, accel = 0, jerk = 0;
+    for(i = 0; i < STEP_ENGINE_AXES; i++){
+        unit[i] = ((delta[i] < 0) ? -travel[i] : travel[i]) / length;
+        if(travel[i] == 0)
+            continue;
+
+        double scale = length / labs(delta[i]);
+        if((nominal == 0) || (feedrate[i] * scale < nominal))
+            nominal = feedrate[i] * scale;
+        if((accel == 0) || (accelLimit[i] * scale < accel))
+            accel = accelLimit[i] * scale;
+        if((jerk == 0) || (jerkLimit[i] * scale < jerk))
+            jerk = jerkLimit[i] * scale;
+    }
+
+    block->length = length;
+    block->stepsPerDegree = block->step.events / length;
+    block->nominalSpeed = nominal;
+    block->accel = accel;
+    block->jerk = jerk;
+
+    enqueue(block, unit, unit);
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Limits the entry speed of the block at the tail from the corner it makes with the previous one, queues it and
+ *         replans the queue. Its geometry and limits are filled in already.
+ *
+ *  @param[in,out] block    Block at the tail of the queue
+ *  @param[in]     entryUnit Direction it starts in, unit vector in pan/tilt space
+ *  @param[in]     exitUnit  Direction it ends in, the next block's corner is taken from it
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::enqueue(MotionBlock* block, const double entryUnit[], const double exitUnit[])
+{
+    MotionQueue* queue = MotionQueue::getInstance();
+    double nominal = block->nominalSpeed;
+
+    // The corner with the previous move limits how fast we may go through it.
+    // With nothing queued the move starts from rest.
+    double rest = restSpeed(block);
+    double entry = rest;
+    block->maxEntrySpeed = rest;
+    if(!queue->isEmpty()){
+        MotionBlock* prev = queue->block(queue->prevIndex(queue->tailIndex()));
+        double junction = junctionSpeed(entryUnit, block->accel);
+
+        if(junction > nominal)
+            junction = nominal;
+        if(junction > prev->nominalSpeed)
+            junction = prev->nominalSpeed;
+        if(junction > rest)
+            block->maxEntrySpeed = junction;
+
+        // A running move ending at rest may exit faster than this one goes. Dropping from
+        // its rest speed is within what a single step can do, so start at the nominal speed.
+        entry = prev->exitSpeed;
+        if(entry > nominal)
+            entry = nominal;
+    }
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _prevUnit[i] = exitUnit[i];
+
+    // Queue it with a profile that is safe on its own, carrying on from the previous move and
+    // ending at rest, in case the interrupt picks it up before the replan below is done
+    block->entrySpeed = entry;
+    block->exitSpeed = rest;
+    profile(&block->step, entry * block->stepsPerDegree, nominal * block->stepsPerDegree, rest * block->stepsPerDegree,
+            block->accel * block->stepsPerDegree, block->jerk * block->stepsPerDegree);
+    queue->pushBlock();
+    Telemetry::getInstance()->queued(queue->numBlocks());
+
+    recalculate();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Replans the queue after a block was appended.
+ *
+ *         The backward pass goes from the newest block towards the oldest, raising each entry speed up to its
+ *         junction limit as long as the block can still brake down to the entry speed of the one after it.
+ *         It stops at the first block whose entry speed doesn't change or that the interrupt already loaded,
+ *         so appending costs at most one pass over the queue and usually much less.
+ *
+ *         The forward pass then goes back up from there, caps each exit speed to what can be reached by
+ *         accelerating from the entry speed and commits the new profiles. A block that the interrupt loaded
+ *         in the meantime keeps its old profile and the next block carries on from its exit speed.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::recalculate(void)
+{
+    MotionQueue* queue = MotionQueue::getInstance();
+    uint8_t head = queue->headIndex();
+    uint8_t tail = queue->tailIndex();
+    if(head == tail)
+        return;
+
+    uint8_t newest = queue->prevIndex(tail);
+    uint8_t index = newest;
+    uint8_t first = newest;
+    double speed = restSpeed(queue->block(newest));
+
+    // Backward pass
+    while(1){
+        MotionBlock* block = queue->block(index);
+        if(block->flags & BLOCK_BUSY)
+            break;
+
+        double entry = reachable(speed, block->length, block->accel, block->jerk);
+        if(entry > block->maxEntrySpeed)
+            entry = block->maxEntrySpeed;
+        if((index != newest) && (entry == block->entrySpeed))
+            break;
+
+        block->entrySpeed = entry;
+        first = index;
+        speed = entry;
+
+        if(index == head)
+            break;
+        index = queue->prevIndex(index);
+    }
+
+    // The block before the first changed one exits into a new speed, so it needs a new profile as well
+    // unless it's already running. A block at the head that isn't running yet starts from rest.
+    uint8_t start = first;
+    if((first != head) && !(queue->block(queue->prevIndex(first))->flags & BLOCK_BUSY))
+        start = queue->prevIndex(first);
+
+    if(start == head)
+        speed = restSpeed(queue->block(head));
+    else
+        speed = queue->block(queue->prevIndex(start))->exitSpeed;
+
+    // Forward pass
+    for(index = start; index != tail; index = queue->nextIndex(index)){
+        MotionBlock* block = queue->block(index);
+        uint8_t next = queue->nextIndex(index);
+        double exit = (next == tail) ? restSpeed(block) : queue->block(next)->entrySpeed;
+        double reach = reachable(speed, block->length, block->accel, block->jerk);
+        double k = block->stepsPerDegree;
+        StepBlock step = block->step;
+
+        // A move never goes faster than its nominal speed, not even to carry on from a running move's
+        // rest speed (see append()) or into the rest speed of the next one, so timed moves last their time
+        if(speed > block->nominalSpeed)
+            speed = block->nominalSpeed;
+        if(exit > block->nominalSpeed)
+            exit = block->nominalSpeed;
+        if(exit > reach)
+            exit = reach;
+        profile(&step, speed * k, block->nominalSpeed * k, exit * k, block->accel * k, block->jerk * k);
+
+        halNoInterrupts();
+        if(block->flags & BLOCK_BUSY){
+            halInterrupts();
+            speed = block->exitSpeed;
+            continue;
+        }
+        block->step = step;
+        block->exitSpeed = exit;
+        halInterrupts();
+
+        speed = exit;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Fills the speed profile of a block. Lowers the cruise speed when the move is too short to reach it.
+ *
+ *  @param[in,out] block  Block to fill the speed profile of
+ *  @param[in]     entry  Leading axis speed at the first step [Steps/Sec]
+ *  @param[in]     cruise Leading axis speed to reach [Steps/Sec]
+ *  @param[in]     exit   Leading axis speed at the last step [Steps/Sec]
+ *  @param[in]     accel  Leading axis acceleration [Steps/Sec^2]
+ *  @param[in]     jerk   Leading axis jerk [Steps/Sec^3], only used in SCURVE mode
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::profile(StepBlock* block, double entry, double cruise, double exit, double accel, double jerk)
+{
+    double n = (double)block->events;
+    double jump = sqrt(2.0 * accel);
+    double lowest;
+    double down;
+
+    // A speed change no bigger than the speed reached by a single step from standstill is taken
+    // at once, like a move starting from rest. Slow moves then hold their speed over every step.
+    if((entry < cruise) && (cruise - entry <= jump))
+        entry = cruise;
+    if((exit < cruise) && (cruise - exit <= jump))
+        exit = cruise;
+
+    lowest = (entry > exit) ? entry : exit;
+    if(cruise < lowest)
+        cruise = lowest;
+
+    // If accelerating and decelerating take more steps than we have, find the highest speed
+    // that fits. Trapezoids have a closed form, S-curves are bisected.
+    if(rampSteps(entry, cruise, accel, jerk) + rampSteps(cruise, exit, accel, jerk) > n){
+        if(_mode == TRAPEZOID){
+            cruise = sqrt(accel * n + (entry * entry + exit * exit) / 2.0);
+        }
+        else{
+            double low = lowest, high = cruise;
+            for(uint8_t i = 0; i < 16; i++){
+                double mid = (low + high) / 2.0;
+                if(rampSteps(entry, mid, accel, jerk) + rampSteps(mid, exit, accel, jerk) > n)
+                    high = mid;
+                else
+                    low = mid;
+            }
+            cruise = low;
+        }
+
+        if(cruise < lowest)
+            cruise = lowest;
+    }
+
+    down = ceil(rampSteps(cruise, exit, accel, jerk));
+    block->decelEvents = (down > n) ? block->events : (unsigned long)down;
+
+    block->entryRate = StepEngine::rateFromStepsPerSec(entry);
+    block->cruiseRate = StepEngine::rateFromStepsPerSec(cruise);
+    block->exitRate = StepEngine::rateFromStepsPerSec(exit);
+    block->accel = StepEngine::accelFromStepsPerSec2(accel);
+
+    if(_mode == SCURVE){
+        // The acceleration eases down over the last accel^2/(2*jerk) of speed change, or over
+        // the second half of the ramp when it's too short to reach full acceleration
+        double ease = accel * accel / (2.0 * jerk);
+        double easeUp = ((cruise - entry) / 2.0 < ease) ? (cruise - entry) / 2.0 : ease;
+        double easeDown = ((cruise - exit) / 2.0 < ease) ? (cruise - exit) / 2.0 : ease;
+
+        block->jerk = StepEngine::jerkFromStepsPerSec3(jerk);
+        block->accelMin = block->accel / SCURVE_ACCEL_MIN_DIV;
+        block->accelEaseRate = StepEngine::rateFromStepsPerSec(cruise - easeUp);
+        block->decelEaseRate = StepEngine::rateFromStepsPerSec(exit + easeDown);
+    }
+    else{
+        block->jerk = 0;
+        block->accelMin = block->accel;
+        block->accelEaseRate = block->cruiseRate;
+        block->decelEaseRate = block->exitRate;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Highest speed that can be reached from another one within a distance. The same speed can be
+ *         braked down from within that distance, since ramps are symmetric.
+ *
+ *  @param[in] from     Starting speed
+ *  @param[in] distance Distance available
+ *  @param[in] accel    Acceleration
+ *  @param[in] jerk     Jerk, only used in SCURVE mode
+ *
+ *  @return Speed, in the same units as the parameters
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double MotionPlanner::reachable(double from, double distance, double accel, double jerk)
+{
+    // An S-curve never does better than the trapezoid with the same acceleration, so bisect below it
+    double high = sqrt(from * from + 2.0 * accel * distance);
+    if(_mode == TRAPEZOID)
+        return high;
+
+    double low = from;
+    for(uint8_t i = 0; i < 16; i++){
+        double mid = (low + high) / 2.0;
+        if(rampSteps(from, mid, accel, jerk) > distance)
+            high = mid;
+        else
+            low = mid;
+    }
+    return low;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Speed a block starts from and stops at when it's at rest, the speed reached after a single step
+ *
+ *  @return [Degrees/Sec]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double MotionPlanner::restSpeed(const MotionBlock* block)
+{
+    double rest = sqrt(2.0 * block->accel / block->stepsPerDegree);
+    return (rest > block->nominalSpeed) ? block->nominalSpeed : rest;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Max speed through the corner between the newest queued move and a new one. The path is treated as
+ *         rounding the corner with an arc that stays within the junction deviation of it, taken at the
+ *         speed where the centripetal acceleration equals the acceleration limit.
+ *
+ *  @param[in] unit  Direction of the new move, unit vector in pan/tilt space
+ *  @param[in] accel Acceleration of the new move [Degrees/Sec^2]
+ *
+ *  @return [Degrees/Sec], 0 for a reversal
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double MotionPlanner::junctionSpeed(const double unit[], double accel)
+{
+    double cosTheta = 0;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        cosTheta -= _prevUnit[i] * unit[i];
+
+    if(cosTheta > 0.999)
+        return 0;                       // Going back the way we came
+    if(cosTheta < -0.999)
+        return 1e9;                     // Straight on, only the nominal speeds limit it
+
+    double sinHalfTheta = sqrt(0.5 * (1.0 - cosTheta));
+    return sqrt(accel * _junctionDeviation * sinHalfTheta / (1.0 - sinHalfTheta));
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Steps taken while going from one speed to another. Both S-curve and trapezoid ramps
+ *         are symmetric in speed, so the distance is the average speed times the ramp time.
+ *
+ *  @param[in] from  Starting speed [Steps/Sec]
+ *  @param[in] to    Ending speed [Steps/Sec]
+ *  @param[in] accel Acceleration [Steps/Sec^2]
+ *  @param[in] jerk  Jerk [Steps/Sec^3], only used in SCURVE mode
+ *
+ *  @return Number of steps
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double MotionPlanner::rampSteps(double from, double to, double accel, double jerk)
+{
+    double change = (to > from) ? (to - from) : (from - to);
+    double time;
+
+    if(_mode == TRAPEZOID)
+        time = change / accel;
+    else if(change * jerk >= accel * accel)
+        time = change / accel + accel / jerk;   // Reaches full acceleration
+    else
+        time = 2.0 * sqrt(change / jerk);       // Jerks up then straight back down
+
+    return (from + to) / 2.0 * time;
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets how long the queued moves take at their nominal speed, ignoring the ramps. The block being stepped
+ *         counts whole, so it's a little over. Tells how long the step engine has left before it starves.
+ *
+ *  @return [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long MotionPlanner::queuedTime(void)
+{
+    MotionQueue* queue = MotionQueue::getInstance();
+    uint8_t tail = queue->tailIndex();
+    double time = 0;
+
+    for(uint8_t i = queue->headIndex(); i != tail; i = queue->nextIndex(i)){
+        const MotionBlock* block = queue->block(i);
+        if(block->nominalSpeed > 0)
+            time += block->length / block->nominalSpeed;
+    }
+
+    return (unsigned long)(time * 1000.0);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if the queue has room for any move, however many blocks it's split into, so appending one won't wait
+ *
+ *  @return 1 if it has room, 0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionPlanner::hasRoom(void)
+{
+    return MotionQueue::getInstance()->numBlocks() + PLANNER_MAX_PARTS <= MOTION_QUEUE_SIZE - 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set the shape of the acceleration ramps
+ *
+ *  @param[in] mode TRAPEZOID or SCURVE
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::setProfileMode(ProfileMode mode)
+{
+    _mode = mode;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the shape of the acceleration ramps
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+ProfileMode MotionPlanner::getProfileMode(void)
+{
+    return _mode;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set the panning acceleration
+ *
+ *  @param[in] accel [Degrees/Sec^2]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::setPanAccel(double accel)
+{
+    _pan_accel = accel / PAN_STEPRATE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set the tilting acceleration
+ *
+ *  @param[in] accel [Degrees/Sec^2]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::setTiltAccel(double accel)
+{
+    _tilt_accel = accel / TILT_STEPRATE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the panning acceleration [Degrees/Sec^2]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double MotionPlanner::getPanAccel(void)
+{
+    return _pan_accel * PAN_STEPRATE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the tilting acceleration [Degrees/Sec^2]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double MotionPlanner::getTiltAccel(void)
+{
+    return _tilt_accel * TILT_STEPRATE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set the panning jerk, used by SCURVE ramps
+ *
+ *  @param[in] jerk [Degrees/Sec^3]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::setPanJerk(double jerk)
+{
+    _pan_jerk = jerk / PAN_STEPRATE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set the tilting jerk, used by SCURVE ramps
+ *
+ *  @param[in] jerk [Degrees/Sec^3]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::setTiltJerk(double jerk)
+{
+    _tilt_jerk = jerk / TILT_STEPRATE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set how far from a corner the path may round it off. Bigger values carry more speed through corners.
+ *
+ *  @param[in] deviation [Degrees]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionPlanner::setJunctionDeviation(double deviation)
+{
+    _junctionDeviation = deviation;
+}
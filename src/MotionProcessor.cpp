@@ -1,10 +1,27 @@
 #include "../inc/MotionProcessor.hpp"
 #include "math.h"
+#include "../inc/Hal.hpp"
 #include "../inc/PinDef.h"
+#include "../inc/StepEngine.hpp"
+#include "../inc/MotionPlanner.hpp"
+#include "../inc/MotionQueue.hpp"
+#include "../inc/StepTiming.hpp"
+#include "../inc/Trigger.hpp"
+#include "../inc/Kinematics.hpp"
+#include "../inc/MotorPower.hpp"
+#include "../inc/Snapshot.hpp"
+#include "../inc/StallMonitor.hpp"
+#include "../inc/Telemetry.hpp"
 
 #define DEBUG   0
 #define VERBOSE 0
 
+#define HOMING_PAN_SEEK_SPEED   30.0    // Speed looking for the magnet [Degrees/Sec]
+#define HOMING_TILT_SEEK_SPEED  20.0    // Speed looking for the magnet [Degrees/Sec]
+#define HOMING_SLOW_SPEED       2.0     // Speed measuring the magnet, sets how precise homing is [Degrees/Sec]
+#define HOMING_BACKOFF          1.0     // How far to clear the magnet before measuring it [Degrees]
+#define HOMING_MAX_TRAVEL       400.0   // Homing fails if a part of it goes further, a bit more than a turn [Degrees]
+
 //=========================================//
 //             HELPER FUNCTIONS            //
 //=========================================//
@@ -38,190 +55,386 @@ MotionProcessor* MotionProcessor::getInstance()
 
 MotionProcessor::MotionProcessor(void){
     // Initialize Timer in order to use its functionalities
-    Timer1.intialize();
+    // It ticks the step engine and the trigger, and is only running while a move or a shot is under way
+    halTimerInit(STEP_TICK_US, MotionProcessor::bresenham);
+    Trigger::getInstance();
 
     // Initialize Stepper Motor Drivers and their respective endstops
     // Initialize Stepper Motors disabled off
     motors[0].init(PAN_DIR_PIN, PAN_STEP_PIN, PAN_EN_PIN, EN_MOTOR_OFF, PAN_HALL_PIN);
     motors[1].init(TILT_DIR_PIN, TILT_STEP_PIN, TILT_EN_PIN, EN_MOTOR_OFF, TILT_HALL_PIN, PULLUP_ENDSTOP);
+
+    // Start in the finest microstep mode, the step engine switches it per move from there
+    motors[0].initMicrostep(PAN_MS1_PIN, PAN_MS2_PIN, PAN_MS3_PIN, MICROSTEP_MODE_BITS(PAN_MICROSTEP_LOG2));
+    motors[1].initMicrostep(TILT_MS1_PIN, TILT_MS2_PIN, TILT_MS3_PIN, MICROSTEP_MODE_BITS(TILT_MICROSTEP_LOG2));
+
+    // Nothing queued yet, start at the origin, unknown until homed or restored
+    _currentPositionSteps.p = 0;
+    _currentPositionSteps.t = 0;
+    _targetMdeg.p = 0;
+    _targetMdeg.t = 0;
+    _mode = ABS;
+    _tryAndExecCallback = NULL;
+    _pauseDeadline = halMicros();
+    _homeOffset.p = 0;
+    _homeOffset.t = 0;
+    _restored = 0;
+
+    // Speeds homing used to leave behind, so moves have one before any is set
+    setPanSpeed(5);
+    setTiltSpeed(5);
+
+    StepEngine::getInstance()->attach(motors);
+    MotorPower::getInstance()->attach(motors);
 }
 
 //=========================================//
 //            MOTION PROCESSORS            //
 //=========================================//
 /**
- * @brief [BLOCKING] Homes the pan and tilt axis.
+ * @brief [NON-BLOCKING] Homes the pan and tilt axis at the same time.
+ * Each axis seeks its magnet fast, backs out of it, then comes back slowly
+ * across it and settles on its center. Only waits for the moves already queued.
+ * ready() is 0 until homing is done, StepEngine::homingState() tells how far it got.
+ * Moves queued while homing run once it's done, relative to home.
+ * The center of the magnets is at the home offset.
+ * 
+ * [BLOCKING] With the position restored from a snapshot, it only goes to where
+ * the magnets should be and checks that both sensors see them, which keeps the
+ * position. Homes as above if they don't.
  * 
  */
 void MotionProcessor::home(){
-    enableMotors();
-
-    setPanSpeed(5);
-    setTiltSpeed(5);
+    StepEngine* engine = StepEngine::getInstance();
+    HomingConfig config[NUM_OF_MOTORS];
+
+    MotorPower* power = MotorPower::getInstance();
+    uint8_t axisMask = (1 << NUM_OF_MOTORS) - 1;
+
+    // Going there as fast as the seek would, so checking never takes longer than homing.
+    // A stall since the restore means the position can't be trusted to get there.
+    if(_restored && !StallMonitor::getInstance()->stalled()){
+        MoveMode mode = _mode;
+        double panSpeed = _pan_speed;
+        double tiltSpeed = _tilt_speed;
+        _mode = ABS;
+        setPanSpeed(HOMING_PAN_SEEK_SPEED);
+        setTiltSpeed(HOMING_TILT_SEEK_SPEED);
+        line(_homeOffset);
+        setPanSpeed(panSpeed);
+        setTiltSpeed(tiltSpeed);
+        _mode = mode;
+
+        while(engine->busy()){
+            if(_tryAndExecCallback != NULL)
+                _tryAndExecCallback();
+        }
+        if(engine->endstops() == axisMask)
+            return;
 
-    #if VERBOSE
-    Serial.println("homing...");
-    Serial.println("enabled motors");
-    #endif
+        #if VERBOSE
+        Serial.println("restored position is off, homing...");
+        #endif
+        _restored = 0;
+    }
 
-    #if DEBUG
-    Serial.print("Pan Step Delay: ");
-    Serial.print(_pan_linearStepDelay);
-    Serial.println(" us");
+    // Homing takes over the step interrupt, so let the queued moves finish first,
+    // then give the drivers that were off time to get their current up.
+    // Keep servicing whoever registered to be called while we wait.
+    while(engine->busy()){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
+    }
 
-    Serial.print("Tilt Step Delay: ");
-    Serial.print(_tilt_linearStepDelay);
-    Serial.println(" us");
-    #endif
+    power->wake(axisMask);
+    while(!power->awake(axisMask)){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
+    }
 
     #if VERBOSE
-    Serial.println("Homing Pan");
+    Serial.println("homing...");
     #endif
 
-    //--------------------------------------------//
-    //                HOME PAN
-    //--------------------------------------------//
-    // Rotate pan clockwise until magnet is first detected
-    while (motors[0].endstop()!=HALL_MAG_DETECTED)
-    {
-        motors[0].hardStep(PAN_DIR_CW);
-        pause(_pan_linearStepDelay);
-    }
+    config[0].seekDir = PAN_DIR_CW;
+    config[0].seekRate = StepEngine::rateFromStepsPerSec(HOMING_PAN_SEEK_SPEED / PAN_STEPRATE);
+    config[0].slowRate = StepEngine::rateFromStepsPerSec(HOMING_SLOW_SPEED / PAN_STEPRATE);
+    config[0].accel = StepEngine::accelFromStepsPerSec2(MotionPlanner::getInstance()->getPanAccel() / PAN_STEPRATE);
+    config[0].backoffSteps = HOMING_BACKOFF / PAN_STEPRATE;
+    config[0].maxSteps = HOMING_MAX_TRAVEL / PAN_STEPRATE;
+
+    config[1].seekDir = TILT_DIR_CW;
+    config[1].seekRate = StepEngine::rateFromStepsPerSec(HOMING_TILT_SEEK_SPEED / TILT_STEPRATE);
+    config[1].slowRate = StepEngine::rateFromStepsPerSec(HOMING_SLOW_SPEED / TILT_STEPRATE);
+    config[1].accel = StepEngine::accelFromStepsPerSec2(MotionPlanner::getInstance()->getTiltAccel() / TILT_STEPRATE);
+    config[1].backoffSteps = HOMING_BACKOFF / TILT_STEPRATE;
+    config[1].maxSteps = HOMING_MAX_TRAVEL / TILT_STEPRATE;
+
+    // Home is where every move queued from now on is measured from
+    Snapshot::getInstance()->moving();
+    setPosition(degreesFromMdeg(_homeOffset.p), degreesFromMdeg(_homeOffset.t));
+    config[0].homePosition = _currentPositionSteps.p;
+    config[1].homePosition = _currentPositionSteps.t;
+    engine->home(config);
+}
 
-    // Once, magnet is detected, keep rotating untill magnet is no longer detected
-    // while counting the steps taken. 
-    uint8_t steps_taken_pan = 0;
-    while (motors[0].endstop()==HALL_MAG_DETECTED)
-    {
-        motors[0].hardStep(PAN_DIR_CW);
-        steps_taken_pan++;
-        pause(_pan_linearStepDelay);
-    }
+/**
+ * @brief [BLOCKING] Takes back the calibration and the speeds from the latest
+ * snapshot, and the position too if the head hasn't moved since it was taken.
+ * Call it once at startup, with the drivers still off. Each driver is put back
+ * on the microstep it was left on, so it doesn't pull its motor anywhere once on.
+ * 
+ * @return 1 if the position was restored, homing only needs to check it.
+ *         0 if it wasn't, the head has to be homed.
+ */
+uint8_t MotionProcessor::restore(void){
+    SnapshotRecord record;
 
-    // Once magnet is no longer detected, we need to move back half of the steps we've taken
-    // to land on the center of the magnet
-    for(int i = 0; i<(steps_taken_pan/2); i++){
-        motors[0].hardStep(PAN_DIR_CCW);
-        pause(_pan_linearStepDelay);
-    }
-    
-    if VERBOSE
-    Serial.println("Finished homing pan")
-    Serial.println("Homing Tilt...");
-    #endif
-    //--------------------------------------------//
-    //                HOME TILT
-    //--------------------------------------------//
-    // Rotate pan clockwise until magnet is first detected
-    while (motors[1].endstop()!=HALL_MAG_DETECTED)
-    {
-        motors[1].hardStep(TILT_DIR_CW);
-        pause(_tilt_linearStepDelay);
-    }
+    if(Snapshot::getInstance()->load(&record) != 1)
+        return 0;
 
-    // Keep rotating untill magnet is no longer detected while counting the steps taken 
-    uint8_t steps_taken_tilt = 0;
-    while (motors[1].endstop()==HALL_MAG_DETECTED)
-    {
-        motors[1].hardStep(TILT_DIR_CW);
-        steps_taken_tilt++;
-        pause(_tilt_linearStepDelay);
-    }
+    // A record taken with other steps can't be trusted for any of them
+    if((record.stepRate[0] != (float)PAN_STEPRATE) || (record.stepRate[1] != (float)TILT_STEPRATE))
+        return 0;
 
-    // Once magnet is not longer detected, we need to move back half of the steps we've taken
-    // to land on the center of the magnet
-    for(int i = 0; i<(steps_taken_tilt/2); i++){
-        motors[1].hardStep(TILT_DIR_CCW);
-        pause(_tilt_linearStepDelay);
-    }
+    setPanSpeed(record.speed[0]);
+    setTiltSpeed(record.speed[1]);
+    _homeOffset.p = record.homeOffset[0];
+    _homeOffset.t = record.homeOffset[1];
+
+    if(!(record.flags & SNAPSHOT_POSITION))
+        return 0;
+    if((panStepsFromMdeg(record.targetMdeg[0]) != record.position[0]) ||
+       (tiltStepsFromMdeg(record.targetMdeg[1]) != record.position[1]))
+        return 0;
 
-    setPosition(doubleZeroVect);
+    StepEngine::getInstance()->setMicroIndex(record.microIndex);
+    setPosition(degreesFromMdeg(record.targetMdeg[0]), degreesFromMdeg(record.targetMdeg[1]));
+    _restored = 1;
 
-    if VERBOSE
-    Serial.println("Finished homing tilt")
-    Serial.println("Homing Finished!!");
+    #if VERBOSE
+    Serial.println("position restored");
     #endif
+    return 1;
 }
 
 /**
- * @brief [BLOCKING] Do a linear movement from starting to end points. 
- * All stepper motors finish movement at the same time. However,
- * this function returns only when it reaches the destination.
+ * @brief [NON-BLOCKING] Do a linear movement from starting to end points. 
+ * All stepper motors finish movement at the same time.
+ * Service stepper motors through interupt service routine.
+ * The move is queued behind the ones not done yet and blended into them,
+ * this only waits when the motion queue has no room for it.
  * 
- * @param coords holds the goal values for each axis
+ * @param coords holds the goal values for each axis [Degrees]
  */
-void MotionProcessor::dumbLine(DoubleVector coords){
+void MotionProcessor::line(DoubleVector coords){
+    LongVector mdeg = {mdegFromDegrees(coords.p), mdegFromDegrees(coords.t)};
+    line(mdeg);
+}
 
+/**
+ * @brief [NON-BLOCKING] Same as line(DoubleVector), in fixed-point.
+ * 
+ * @param coords holds the goal values for each axis [Millidegrees]
+ */
+void MotionProcessor::line(LongVector coords){
+    line(coords, 0);
 }
 
 /**
- * @brief [NON-BLOCKING] Do a linear movement from starting to end points. 
- * All stepper motors finish movement at the same time.
- * Service stepper motors through interupt service routine.
+ * @brief [NON-BLOCKING] Same as line(LongVector), but timed to take ms
+ * instead of going at the set speeds. Each axis gets the feedrate that
+ * covers its steps in that time, capped at its max speed.
  * 
- * @param coords holds the goal values for each axis
- * @param d holds the direction we want to 
+ * @param coords holds the goal values for each axis [Millidegrees]
+ * @param ms how long the move should take, 0 to go at the set speeds
  */
-void MotionProcessor::line(DoubleVector coords){
-    long stepDelay;
-    int i;
-
-    // Calculate the number of steps that need to be taken to achieve 80 degrees of rotation
-    // [# degrees]/[# degrees/step] = [# step]
-    _delta[0] = coords.p / PAN_STEPRATE;     
-    _delta[1] = coords.t / TILT_STEPRATE;
-
-    // If we're in relative mode, the amount of steps we need to take to achieve 80 degrees of rotation is what's calculated above.
-    // However, if we're in absolute mode, substract the amount of steps we have already taken from home 
-    if(_mode == ABS){
-        _delta[0] -= _currentPositionSteps.p;
-        _delta[1] -= _currentPositionSteps.t;
+void MotionProcessor::line(LongVector coords, unsigned long ms){
+    double panFeedrate = _pan_feedrate;
+    double tiltFeedrate = _tilt_feedrate;
+    uint8_t dir[NUM_OF_MOTORS];
+    LongVector target;
+    LongVector targetSteps;
+
+    // In relative mode the coordinates are added to where the queued moves end.
+    // Either way the whole target angle is converted to steps, so no rounding carries over between moves.
+    target = coords;
+    if(_mode == REL){
+        target.p += _targetMdeg.p;
+        target.t += _targetMdeg.t;
     }
+    targetSteps.p = panStepsFromMdeg(target.p);
+    targetSteps.t = tiltStepsFromMdeg(target.t);
+
+    _delta[0] = targetSteps.p - _currentPositionSteps.p;
+    _delta[1] = targetSteps.t - _currentPositionSteps.t;
 
     #if VERBOSE || DEBUG
     Serial.println("line command:");
     Serial.print("delta p: ");
-    Serial.print(delta[0]);
+    Serial.print(_delta[0]);
     Serial.print("\t");
     Serial.print("delta t: ");
-    Serial.println(delta[1]);
-    #endif
-
-    // To run the bresenham algorithm, we need to find the axis with the biggest delta which is also the fastest one.
-    // The axis with the biggest delta will be the one continuouly stepped while we determine if the 
-    // other one gets stepped or not.
-    // Find axis with the biggest delta
-    // We'll first inialize the fastest motor index to be 0. We then step through each delta and if the index getting checked
-    // has a higher delta, update the fastest motor's index to that one.
-    _fastest = 0;
-    for (i = 0; i < NUM_OF_MOTORS; i++){
-        if( abs(_delta[_fastest]) <= abs(_delta[i]) ){
-            _fastest = i;
-        }
-    }
-
-    #if DEBUG
-    Serial.print("Fastest axis: ");
-    Serial.print(_fastest);
+    Serial.println(_delta[1]);
     #endif
 
     // Let's set the direction for the pan motor
+    // The step engine sets the pins when it gets to this move
     if(_delta[0] < 0){
-        motors[0].setDir(PAN_DIR_CW); 
+        dir[0] = PAN_DIR_CW; 
     }
     else{
-        motors[0].setDir(PAN_DIR_CCW);
+        dir[0] = PAN_DIR_CCW;
     }
 
     // Let's set the direction for the tilt motor
     if(_delta[1] < 0){
-        motors[1].setDir(TILT_DIR_CW); 
+        dir[1] = TILT_DIR_CW; 
     }
     else{
-        motors[1].setDir(TILT_DIR_CCW);
+        dir[1] = TILT_DIR_CCW;
+    }
+
+    // A timed move goes at the speed that makes it last ms on every axis. An axis that
+    // doesn't move keeps its set feedrate, the planner ignores it anyway.
+    if(ms > 0){
+        if(_delta[0] != 0)
+            panFeedrate = labs(_delta[0]) * 1000.0 / ms;
+        if(panFeedrate > PAN_MAX_SPEED / PAN_STEPRATE)
+            panFeedrate = PAN_MAX_SPEED / PAN_STEPRATE;
+
+        if(_delta[1] != 0)
+            tiltFeedrate = labs(_delta[1]) * 1000.0 / ms;
+        if(tiltFeedrate > TILT_MAX_SPEED / TILT_STEPRATE)
+            tiltFeedrate = TILT_MAX_SPEED / TILT_STEPRATE;
+    }
+
+    // Turn on the drivers the move needs if they went idle, and give their current time to build up
+    // before it's queued, so its first step isn't missed
+    MotorPower* power = MotorPower::getInstance();
+    uint8_t axisMask = 0;
+    for (uint8_t i = 0; i < NUM_OF_MOTORS; i++){
+        if(_delta[i] != 0)
+            axisMask |= (1 << i);
+    }
+    power->wake(axisMask);
+    while(!power->awake(axisMask)){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
+    }
+
+    // A snapshot taken at rest stops being where the head is
+    Snapshot::getInstance()->moving();
+
+    // Queue the move and let the planner blend it with the ones before it
+    // within each axis' feedrate and acceleration. A fast move takes up to three blocks,
+    // so wait until the motion queue has room for all of them.
+    // Keep servicing whoever registered to be called while we wait.
+    uint8_t queued;
+    while((queued = MotionPlanner::getInstance()->append(_delta, dir, panFeedrate, tiltFeedrate)) == 0){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
+    }
+
+    // Where we'll be once the engine is done with the queue.
+    // A move shorter than a step still moves the target, so relative moves add up.
+    _targetMdeg = target;
+    _currentPositionSteps = targetSteps;
+
+    if(queued == 1)
+        StepEngine::getInstance()->wake();
+}
+
+/**
+ * @brief [NON-BLOCKING] Same as arc(LongVector, LongVector, ArcDir), in degrees.
+ * 
+ * @param coords holds the goal values for each axis [Degrees]
+ * @param center offset of the center from where the arc starts [Degrees]
+ * @param dir ARC_CW or ARC_CCW
+ */
+void MotionProcessor::arc(DoubleVector coords, DoubleVector center, ArcDir dir){
+    LongVector mdeg = {mdegFromDegrees(coords.p), mdegFromDegrees(coords.t)};
+    LongVector offset = {mdegFromDegrees(center.p), mdegFromDegrees(center.t)};
+    arc(mdeg, offset, dir);
+}
+
+/**
+ * @brief [NON-BLOCKING] Do a circular movement around a center, from where the
+ * queued moves end to the end point, pan across and tilt up. Both axes keep one
+ * speed along the path, the slower of the set speeds. The step interrupt traces
+ * the whole arc, it's queued as a single move and blended into the others.
+ * Going all the way around if the end point is the start.
+ * 
+ * The radius is the one of the start, an end point off the circle ends the arc
+ * where it crosses the line from the center to the end point, and goes on from
+ * there to the end point straight. Too small or too big an arc is a line.
+ * 
+ * @param coords holds the goal values for each axis [Millidegrees]
+ * @param center offset of the center from where the arc starts, whatever the mode [Millidegrees]
+ * @param dir ARC_CW or ARC_CCW
+ */
+void MotionProcessor::arc(LongVector coords, LongVector center, ArcDir dir){
+    LongVector target = coords;
+    if(_mode == REL){
+        target.p += _targetMdeg.p;
+        target.t += _targetMdeg.t;
+    }
+
+    long from[NUM_OF_MOTORS] = {_targetMdeg.p, _targetMdeg.t};
+    long middle[NUM_OF_MOTORS] = {_targetMdeg.p + center.p, _targetMdeg.t + center.t};
+    double radius = sqrt((double)center.p * center.p + (double)center.t * center.t);
+
+    // Angles of the start and the end around the center, the sweep going the given way between them
+    double start = atan3(-(double)center.t, -(double)center.p);
+    double end = atan3((double)(target.t - middle[1]), (double)(target.p - middle[0]));
+    double sweep = end - start;
+    if((dir == ARC_CCW) && (sweep <= 0))
+        sweep += 2.0 * PI;
+    if((dir == ARC_CW) && (sweep >= 0))
+        sweep -= 2.0 * PI;
+
+    // Where the arc ends, on the circle
+    LongVector arcEnd;
+    arcEnd.p = middle[0] + lround(radius * cos(end));
+    arcEnd.t = middle[1] + lround(radius * sin(end));
+    LongVector endSteps = {panStepsFromMdeg(arcEnd.p), tiltStepsFromMdeg(arcEnd.t)};
+    _delta[0] = endSteps.p - _currentPositionSteps.p;
+    _delta[1] = endSteps.t - _currentPositionSteps.t;
+
+    // Both axes go somewhere on an arc, whatever their end is
+    MotorPower* power = MotorPower::getInstance();
+    uint8_t axisMask = (1 << NUM_OF_MOTORS) - 1;
+    power->wake(axisMask);
+    while(!power->awake(axisMask)){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
     }
-    
 
+    Snapshot::getInstance()->moving();
+
+    uint8_t queued;
+    while((queued = MotionPlanner::getInstance()->appendArc(from, middle, _delta, sweep, _pan_feedrate, _tilt_feedrate)) == 0){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
+    }
+
+    MoveMode mode = _mode;
+    _mode = ABS;
+    if(queued == 1){
+        _targetMdeg = arcEnd;
+        _currentPositionSteps = endSteps;
+        StepEngine::getInstance()->wake();
+
+        // Only takes a move if the end point is off the circle by a step or more
+        if((panStepsFromMdeg(target.p) == endSteps.p) && (tiltStepsFromMdeg(target.t) == endSteps.t))
+            _targetMdeg = target;
+        else
+            line(target);
+    }
+    else{
+        line(target);
+    }
+    _mode = mode;
 }
 
 /**
@@ -229,8 +442,22 @@ void MotionProcessor::line(DoubleVector coords){
  * @note Is a public static to be able to be attached to an interrupt
  * 
  */
-static void MotionProcessor::bresenham(void){
-
+void MotionProcessor::bresenham(void){
+    STEP_TIMING_ENTER();
+    Telemetry* telemetry = Telemetry::getInstance();
+    telemetry->isrEnter();
+    StepEngine* engine = StepEngine::getInstance();
+    Trigger* trigger = Trigger::getInstance();
+
+    // The trigger goes second so it sees the positions just stepped to
+    engine->tick();
+    trigger->tick();
+
+    // Nothing left to time, the next move or shot starts the timer again
+    if(!engine->busy() && !trigger->busy())
+        halTimerStop();
+    telemetry->isrExit();
+    STEP_TIMING_EXIT();
 }
 
 
@@ -250,32 +477,120 @@ void MotionProcessor::setPosition(double p, double t){
 }
 
 /**
- * @brief Sets the absolute position of the pan and tilt axis
+ * @brief Sets the absolute position of the pan and tilt axis.
+ * Taken as where the queued moves end, the live position shifts along with it.
  * 
  * @param pos position vector of the pan and tilt
  */
 void MotionProcessor::setPosition(DoubleVector pos){
+    long shift[NUM_OF_MOTORS];
 
-    _currentPosition = pos;
-    _currentPositionSteps.p = (long)(pos.p / PAN_STEPRATE);
-    _currentPositionSteps.t = (long)(pos.t / TILT_STEPRATE);
+    _targetMdeg.p = mdegFromDegrees(pos.p);
+    _targetMdeg.t = mdegFromDegrees(pos.t);
+
+    shift[0] = panStepsFromMdeg(_targetMdeg.p) - _currentPositionSteps.p;
+    shift[1] = tiltStepsFromMdeg(_targetMdeg.t) - _currentPositionSteps.t;
+    _currentPositionSteps.p += shift[0];
+    _currentPositionSteps.t += shift[1];
+
+    StepEngine::getInstance()->shiftPosition(shift);
+    StallMonitor::getInstance()->forget();
+}
+
+/**
+ * @brief Shifts the live position and where the queued moves end by
+ * some steps, leaving the target where it is. Takes slipped steps out,
+ * so the next move makes up for them.
+ * 
+ * @param shift Steps to add to each axis
+ */
+void MotionProcessor::shiftPositionSteps(const long shift[]){
+    _currentPositionSteps.p += shift[0];
+    _currentPositionSteps.t += shift[1];
+
+    StepEngine::getInstance()->shiftPosition(shift);
+}
+
+/**
+ * @brief [NON-BLOCKING] Queues a move onto the target if the queued
+ * moves end off it, after a shift of the position
+ * 
+ * @return 1 if a move was queued, 0 if they already end on it
+ */
+uint8_t MotionProcessor::settle(void){
+    if((panStepsFromMdeg(_targetMdeg.p) == _currentPositionSteps.p) &&
+       (tiltStepsFromMdeg(_targetMdeg.t) == _currentPositionSteps.t))
+        return 0;
+
+    MoveMode mode = _mode;
+    _mode = ABS;
+    line(_targetMdeg);
+    _mode = mode;
+    return 1;
 }
 
 /**
- * @brief Gets the absolute position of the pan and tilt axis
+ * @brief Gets the live absolute position of the pan and tilt axis,
+ * worked out from the steps taken so far. Can be called mid-move.
  * 
  * @return Position vectors as a DoubleVector
  */
 DoubleVector MotionProcessor::getPosition( void ){
-    return _currentPosition;
+    LongVector steps = getPositionSteps();
+    DoubleVector pos = {steps.p * PAN_STEPRATE, steps.t * TILT_STEPRATE};
+    return pos;
 }
+
 /**
- * @brief Get how many steps the stepper motor have taken thus far from home
+ * @brief Gets where the queued moves end, the position the next
+ * absolute move starts from
+ * 
+ * @return Position in millidegrees as a LongVector
+ */
+LongVector MotionProcessor::getTargetMdeg(void){
+    return _targetMdeg;
+}
+
+/**
+ * @brief Get how many steps the stepper motor have taken thus far from home.
+ * Counted by the step interrupt on every pulse, so it's live mid-move.
  * 
  * @return Number of steps as a LongVector 
  */
 LongVector MotionProcessor::getPositionSteps(void){
-    return _currentPositionSteps;
+    StepEngine* engine = StepEngine::getInstance();
+    LongVector steps = {engine->getPosition(0), engine->getPosition(1)};
+    return steps;
+}
+
+/**
+ * @brief Probes if the position is known, from homing or from a snapshot
+ * 
+ * @return 1 if known, 0 before homing, after it failed or after a stall
+ */
+uint8_t MotionProcessor::positionKnown(void){
+    if(StallMonitor::getInstance()->stalled())
+        return 0;
+    return _restored || (StepEngine::getInstance()->homingState() == HOMING_DONE);
+}
+
+/**
+ * @brief Sets the position homing gives to the center of the magnets,
+ * from the next homing on
+ * 
+ * @param offset [Millidegrees]
+ */
+void MotionProcessor::setHomeOffset(LongVector offset){
+    _homeOffset = offset;
+}
+
+/**
+ * @brief Gets the position homing gives to the center of the magnets
+ * 
+ * @return Offset in millidegrees as a LongVector
+ */
+LongVector MotionProcessor::getHomeOffset(void){
+    return _homeOffset;
 }
 
 /**
@@ -366,7 +681,7 @@ void MotionProcessor::setTiltSpeed(double speed){
  * @brief Get the panning speed
  * 
  */
-void MotionProcessor::getPanSpeed(){
+double MotionProcessor::getPanSpeed(){
     return _pan_speed;
 }
 
@@ -374,7 +689,7 @@ void MotionProcessor::getPanSpeed(){
  * @brief Get the tilting speed
  * 
  */
-void MotionProcessor::getTiltSpeed(){
+double MotionProcessor::getTiltSpeed(){
     return _tilt_speed;
 }
 
@@ -382,7 +697,7 @@ void MotionProcessor::getTiltSpeed(){
  * @brief Get the pan stepper motor feedrate
  * 
  */
-void MotionProcessor::getPanFeedrate(){
+double MotionProcessor::getPanFeedrate(){
     return _pan_feedrate;
 }
 
@@ -390,7 +705,7 @@ void MotionProcessor::getPanFeedrate(){
  * @brief Get the tilt stepper motor feedrate
  * 
  */
-void MotionProcessor::getTiltFeedrate(){
+double MotionProcessor::getTiltFeedrate(){
     return _tilt_feedrate;
 }
 
@@ -413,45 +728,105 @@ MoveMode MotionProcessor::getMode(){
 }
 
 /**
- * @brief Enable Motors
+ * @brief Enable Motors. Each one is turned off again once
+ * idle for its MotorPower idle timeout, if it has one.
  * 
  */
 void MotionProcessor::enableMotors(void){
-    for(int i = 0; i<NUM_OF_MOTORS; i++){
-        motors[i].enable();
-    }
+    MotorPower::getInstance()->wake((1 << NUM_OF_MOTORS) - 1);
 }
 
 /**
- * @brief Disable Motors
+ * @brief [NON-BLOCKING] Disable Motors once the queued moves are done.
+ * The next move turns back on the ones it needs.
  * 
  */
 void MotionProcessor::disableMotors(void){
-    for(int i = 0; i<NUM_OF_MOTORS; i++){
-        motors[i].disable();
-    }
+    MotorPower::getInstance()->sleepWhenIdle((1 << NUM_OF_MOTORS) - 1);
 }
 
 /**
- * @brief [BLOCKING] pauses code for a specific amount of time
+ * @brief [BLOCKING] pauses code for a specific amount of time.
+ * Each pause ends us after the end of the previous one, so the time the
+ * caller spent in between is taken out of it and a loop of pauses keeps
+ * its period. A caller that fell behind by a whole pause starts over from now.
  * 
  * @param us microseconds to be paused
  */
 void MotionProcessor::pause(long us){
+    unsigned long now = halMicros();
+
+    if((long)(now - _pauseDeadline) > us)
+        _pauseDeadline = now;
+    _pauseDeadline += us;
+
+    long left = (long)(_pauseDeadline - now);
+    if(left <= 0)
+        return;
+
     // Break it into delay and delay microseconds because delayMicroseconds doesn't
     // work accurately for values over 16383. Check it out at link below.
     // https://www.arduino.cc/reference/en/language/functions/time/delaymicroseconds/
-    delay(us/1000);
-    delayMicroseconds(us%1000);
+    halDelay(left/1000);
+    halDelayMicroseconds(left%1000);
+}
+
+/**
+ * @brief [BLOCKING] Takes a shot where the queued moves end. Waits for them
+ * to be done, then holds still until the shutter is released, so the next
+ * move doesn't start during the shot. Replaces the shots scheduled on the trigger.
+ * Keeps servicing whoever registered to be called while it waits.
+ * 
+ */
+void MotionProcessor::shoot(void){
+    StepEngine* engine = StepEngine::getInstance();
+    Trigger* trigger = Trigger::getInstance();
+
+    while(engine->busy()){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
+    }
+
+    trigger->shoot();
+    while(trigger->busy()){
+        if(_tryAndExecCallback != NULL)
+            _tryAndExecCallback();
+    }
 }
 
 /**
- * @brief Probes if system is ready to receive new commands
+ * @brief Probes if system is ready to receive new commands, 0 while moving or homing
  * 
  * @return uint8_t 
  */
 uint8_t MotionProcessor::ready(void){
-    return _ready;
+    return !StepEngine::getInstance()->busy();
+}
+
+/**
+ * @brief Probes if a move to an absolute position can be queued without waiting:
+ * the planner has room for every block it may take and the drivers it needs are
+ * awake. Drivers that aren't are woken, to be awake on a later call.
+ * 
+ * @param target Position [Millidegrees]
+ * @return uint8_t 1 if it can be queued, 0 otherwise
+ */
+uint8_t MotionProcessor::canQueue(LongVector target){
+    if(!MotionPlanner::getInstance()->hasRoom())
+        return 0;
+
+    uint8_t axisMask = 0;
+    if(panStepsFromMdeg(target.p) != panStepsFromMdeg(_targetMdeg.p))
+        axisMask |= 0x01;
+    if(tiltStepsFromMdeg(target.t) != tiltStepsFromMdeg(_targetMdeg.t))
+        axisMask |= 0x02;
+
+    MotorPower* power = MotorPower::getInstance();
+    if(power->awake(axisMask))
+        return 1;
+
+    power->wake(axisMask);
+    return 0;
 }
 
 /**
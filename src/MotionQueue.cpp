@@ -0,0 +1,189 @@
+#include "../inc/MotionQueue.hpp"
+
+// Index accesses shared between the main loop and the interrupt. A release store publishes everything written
+// before it, an acquire load sees everything published by the matching store. Single byte, so never torn.
+#define LOAD_INDEX(index)           __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define STORE_INDEX(index, value)   __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+MotionQueue* MotionQueue::instance;
+
+MotionQueue* MotionQueue::getInstance()
+{
+    if(instance == NULL){
+        instance = new MotionQueue();
+    }
+    return instance;
+}
+
+MotionQueue::MotionQueue(void)
+{
+    _head = 0;
+    _tail = 0;
+}
+
+//=========================================//
+//              PRODUCER SIDE              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the free slot at the tail of the queue to be filled in. It isn't queued until pushBlock() is called.
+ *
+ *  @return Pointer to the free slot, NULL if the queue is full
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+MotionBlock* MotionQueue::tailBlock(void)
+{
+    if(isFull())
+        return NULL;
+
+    return &_blocks[_tail];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues the block filled in through tailBlock()
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionQueue::pushBlock(void)
+{
+    if(isFull())
+        return;
+
+    _blocks[_tail].flags = 0;
+    STORE_INDEX(_tail, (_tail + 1) & MOTION_QUEUE_MASK);   // Only published once the block is complete so the interrupt never sees half of it
+}
+
+//=========================================//
+//              CONSUMER SIDE              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the oldest block in the queue without removing it
+ *
+ *  @return Pointer to the block, NULL if the queue is empty
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+MotionBlock* MotionQueue::headBlock(void)
+{
+    if(isEmpty())
+        return NULL;
+
+    return &_blocks[_head];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Removes the oldest block from the queue once it's done
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionQueue::popBlock(void)
+{
+    if(isEmpty())
+        return;
+
+    STORE_INDEX(_head, (_head + 1) & MOTION_QUEUE_MASK);
+}
+
+//=========================================//
+//             PLANNER ACCESS              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the block stored at an index of the ring buffer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+MotionBlock* MotionQueue::block(uint8_t index)
+{
+    return &_blocks[index & MOTION_QUEUE_MASK];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Index of the oldest block
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionQueue::headIndex(void)
+{
+    return _head;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Index of the free slot after the newest block
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionQueue::tailIndex(void)
+{
+    return _tail;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Index following the passed one, wrapping around
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionQueue::nextIndex(uint8_t index)
+{
+    return (index + 1) & MOTION_QUEUE_MASK;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Index preceding the passed one, wrapping around
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionQueue::prevIndex(uint8_t index)
+{
+    return (index - 1) & MOTION_QUEUE_MASK;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Checks if the queue is empty
+ *
+ *  @return 1 if empty, 0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionQueue::isEmpty(void)
+{
+    return LOAD_INDEX(_head) == LOAD_INDEX(_tail);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Checks if the queue is full
+ *
+ *  @return 1 if full, 0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionQueue::isFull(void)
+{
+    return ((LOAD_INDEX(_tail) + 1) & MOTION_QUEUE_MASK) == LOAD_INDEX(_head);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Number of blocks waiting or being executed
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotionQueue::numBlocks(void)
+{
+    return (_tail - _head) & MOTION_QUEUE_MASK;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Drops every queued block. Only call it from the step interrupt or while it's stopped.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotionQueue::clear(void)
+{
+    _head = _tail;
+}
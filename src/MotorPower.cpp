@@ -0,0 +1,240 @@
+#include "../inc/MotorPower.hpp"
+#include "../inc/MotionQueue.hpp"
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+MotorPower* MotorPower::instance;
+
+MotorPower* MotorPower::getInstance()
+{
+    if(instance == NULL){
+        instance = new MotorPower();
+    }
+    return instance;
+}
+
+MotorPower::MotorPower(void)
+{
+    _motors = NULL;
+    _enabled = 0;
+    _sleepPending = 0;
+    _idleTimeout[0] = PAN_IDLE_TIMEOUT_MS;
+    _idleTimeout[1] = TILT_IDLE_TIMEOUT_MS;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        _wakeTime[i] = 0;
+        _lastBusy[i] = 0;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Attaches the motors whose drivers are turned on and off. They start off, as their init leaves them.
+ *
+ *  @param[in] motors Array of STEP_ENGINE_AXES motors, indexed the same way as StepBlock::steps
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotorPower::attach(StepperMotor* motors)
+{
+    _motors = motors;
+}
+
+//=========================================//
+//                  POWER                  //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Turns on the drivers of the axes that are off. Returns right away, awake() tells once they can step.
+ *         The axes count as busy from now, so they aren't turned off before their move is queued, and any
+ *         sleepWhenIdle() still pending on them is dropped.
+ *
+ *  @param[in] axisMask Axis i is woken if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotorPower::wake(uint8_t axisMask)
+{
+    if(_motors == NULL)
+        return;
+
+    unsigned long now = halMicros();
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(!(axisMask & (1 << i)))
+            continue;
+
+        _lastBusy[i] = now;
+        _sleepPending &= ~(1 << i);
+        if(_enabled & (1 << i))
+            continue;
+
+        _motors[i].enable();
+        _enabled |= (1 << i);
+        _wakeTime[i] = now;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if the drivers of some axes are on and have had MOTOR_WAKE_US to get their current up
+ *
+ *  @param[in] axisMask Axis i is checked if bit i is set
+ *
+ *  @return 1 if every one of them can step,
+ *          0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotorPower::awake(uint8_t axisMask)
+{
+    unsigned long now = halMicros();
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(!(axisMask & (1 << i)))
+            continue;
+        if(!(_enabled & (1 << i)) || (now - _wakeTime[i] < MOTOR_WAKE_US))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Turns off the drivers of some axes right away, moving or not
+ *
+ *  @param[in] axisMask Axis i is turned off if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotorPower::sleep(uint8_t axisMask)
+{
+    if(_motors == NULL)
+        return;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(!(axisMask & (1 << i)))
+            continue;
+
+        _motors[i].disable();
+        _enabled &= ~(1 << i);
+        _sleepPending &= ~(1 << i);
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Turns off the drivers of some axes once they have no more steps to take. Idle ones are turned off right
+ *         away, the others by service() as soon as their queued moves are done, so no move is cut short.
+ *
+ *  @param[in] axisMask Axis i is turned off if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotorPower::sleepWhenIdle(uint8_t axisMask)
+{
+    uint8_t busy = busyAxes();
+
+    sleep(axisMask & ~busy);
+    _sleepPending |= axisMask & busy & _enabled;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Turns off the drivers of the axes idle for longer than their timeout, or idle at last after a
+ *         sleepWhenIdle(). Call it regularly from the main loop.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotorPower::service(void)
+{
+    if(_enabled == 0)
+        return;
+
+    unsigned long now = halMicros();
+    uint8_t busy = busyAxes();
+    uint8_t idle = 0;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(!(_enabled & (1 << i)))
+            continue;
+
+        if(busy & (1 << i))
+            _lastBusy[i] = now;
+        else if(_sleepPending & (1 << i))
+            idle |= (1 << i);
+        else if((_idleTimeout[i] != 0) && ((now - _lastBusy[i]) / 1000UL >= _idleTimeout[i]))
+            idle |= (1 << i);
+    }
+
+    if(idle)
+        sleep(idle);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gathers the axes that have steps to take, in the block being stepped or any queued one, or that are homing.
+ *         An arc may come back to where it started on an axis, so both of its axes count.
+ *
+ *  @return Axis i is busy if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotorPower::busyAxes(void)
+{
+    StepEngine* engine = StepEngine::getInstance();
+    HomingState homing = engine->homingState();
+    if(engine->busy() && (homing >= HOMING_SEEK) && (homing < HOMING_DONE))
+        return (1 << STEP_ENGINE_AXES) - 1;
+
+    // The block being stepped stays at the head of the queue until it's done
+    MotionQueue* queue = MotionQueue::getInstance();
+    uint8_t tail = queue->tailIndex();
+    uint8_t busy = 0;
+
+    for(uint8_t index = queue->headIndex(); index != tail; index = queue->nextIndex(index)){
+        const MotionBlock* block = queue->block(index);
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+            if((block->step.steps[i] != 0) || (block->step.arc != ARC_NONE))
+                busy |= (1 << i);
+        }
+    }
+    return busy;
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set how long an axis has to be idle before its driver is turned off
+ *
+ *  @param[in] axis Index of the axis
+ *  @param[in] ms   [ms], 0 to keep it on. Capped at MOTOR_IDLE_TIMEOUT_MAX.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void MotorPower::setIdleTimeout(uint8_t axis, unsigned long ms)
+{
+    if(axis >= STEP_ENGINE_AXES)
+        return;
+
+    _idleTimeout[axis] = (ms > MOTOR_IDLE_TIMEOUT_MAX) ? MOTOR_IDLE_TIMEOUT_MAX : ms;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get how long an axis has to be idle before its driver is turned off [ms], 0 if it's kept on
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long MotorPower::getIdleTimeout(uint8_t axis)
+{
+    return (axis < STEP_ENGINE_AXES) ? _idleTimeout[axis] : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets which drivers are on
+ *
+ *  @return Driver i is on if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t MotorPower::enabled(void)
+{
+    return _enabled;
+}
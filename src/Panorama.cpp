@@ -0,0 +1,354 @@
+#include "../inc/Panorama.hpp"
+#include "../inc/Kinematics.hpp"
+#include "../inc/MotionPlanner.hpp"
+#include "../inc/Trigger.hpp"
+
+/**
+ * @brief Offset of column or row i of n spread evenly over an extent, the last one right on it [Millidegrees]
+ */
+static inline long gridOffset(unsigned long i, unsigned long n, long extent)
+{
+    return (n > 1) ? lround((double)extent * i / (n - 1)) : 0;
+}
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates an idle panorama driving a motion processor, with the default field of view and overlap
+ *
+ *  @param[in] motion Motion processor the moves are queued on
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+Panorama::Panorama(MotionProcessor* motion)
+{
+    _motion = motion;
+    _state = PANO_IDLE;
+    for(uint8_t i = 0; i < NUM_OF_MOTORS; i++){
+        _fov[i] = PANO_DEFAULT_FOV;
+        _extent[i] = 0;
+    }
+    _overlap = PANO_DEFAULT_OVERLAP;
+    _order = PANO_SERPENTINE;
+    _byColumns = 0;
+    _columns = 0;
+    _rows = 0;
+    _shot = 0;
+}
+
+//=========================================//
+//                 RUNNING                 //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sets the frames the next panoramas are shot as
+ *
+ *  @param[in] fov     Field of view of a frame on each axis [Millidegrees]
+ *  @param[in] overlap Least overlap of a frame with its neighbours, up to PANO_MAX_OVERLAP [1/1000 of the field of view]
+ *  @param[in] order   PanoramaOrder the frames are shot in
+ *
+ *  @return 0 if a field of view isn't positive, or the overlap or order is out of range, nothing is changed
+ *          1 if it was set,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Panorama::setFrame(const long fov[], long overlap, uint8_t order)
+{
+    if(fov == NULL)
+        return 2;
+    if((fov[0] <= 0) || (fov[1] <= 0) || (overlap < 0) || (overlap > PANO_MAX_OVERLAP) || (order >= NUM_OF_PANO_ORDERS))
+        return 0;
+
+    for(uint8_t i = 0; i < NUM_OF_MOTORS; i++)
+        _fov[i] = fov[i];
+    _overlap = overlap;
+    _order = order;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts a panorama from where the queued moves end, which is the center of its first frame.
+ *         Picks the order the frames are shot in, the rest is left to service().
+ *
+ *  @param[in] extent   From the center of the first frame to the center of the one on the far corner, signed [Millidegrees]
+ *  @param[in] settle   Wait once at rest before a shot, for vibrations to die down [ms]
+ *  @param[in] exposure Time held still for a shot [ms]
+ *
+ *  @return 0 if it would take more than PANO_MAX_FRAMES frames, it isn't started
+ *          1 if the panorama was started,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Panorama::start(const long extent[], unsigned long settle, unsigned long exposure)
+{
+    if(extent == NULL)
+        return 2;
+
+    // As few columns and rows as keep neighbours overlapping at least as set
+    double count[NUM_OF_MOTORS];
+    for(uint8_t i = 0; i < NUM_OF_MOTORS; i++){
+        double pitch = _fov[i] * (1000 - _overlap) / 1000.0;
+        count[i] = ceil(labs(extent[i]) / pitch) + 1;
+    }
+    if(count[0] * count[1] > PANO_MAX_FRAMES)
+        return 0;
+
+    _state = PANO_IDLE;
+    _origin = _motion->getTargetMdeg();
+    _extent[0] = extent[0];
+    _extent[1] = extent[1];
+    _columns = count[0];
+    _rows = count[1];
+    _settle = settle;
+    _exposure = exposure;
+    _shot = 0;
+
+    // Both serpentines make as many moves, they differ in how many are pan moves and how many tilt moves
+    _byColumns = 0;
+    if(_order == PANO_MIN_TRAVEL){
+        MotionPlanner* planner = MotionPlanner::getInstance();
+        double pan = (_columns > 1) ? labs(extent[0]) / (double)FIXED_SCALE / (_columns - 1) : 0;
+        double tilt = (_rows > 1) ? labs(extent[1]) / (double)FIXED_SCALE / (_rows - 1) : 0;
+        double panTime = moveTime(pan, _motion->getPanSpeed(), planner->getPanAccel());
+        double tiltTime = moveTime(tilt, _motion->getTiltSpeed(), planner->getTiltAccel());
+
+        double rowsTime = _rows * (_columns - 1) * panTime + (_rows - 1) * tiltTime;
+        double columnsTime = _columns * (_rows - 1) * tiltTime + (_columns - 1) * panTime;
+        _byColumns = (columnsTime < rowsTime);
+    }
+
+    _state = PANO_MOVE;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Stops the panorama. A move already queued still runs.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Panorama::stop(void)
+{
+    _state = PANO_IDLE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves the panorama along. Never blocks, call it from the main loop.
+ *         Settling is timed from the last time the head was seen moving, the exposure from the shot,
+ *         and the head holds still until the shutter line is released too.
+ *
+ *  @return State of the panorama
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+PanoramaState Panorama::service(void)
+{
+    LongVector target;
+
+    switch(_state){
+        case PANO_MOVE:
+            if(!frameAt(_shot, &target)){
+                _state = PANO_DONE;
+                break;
+            }
+            if(!_motion->canQueue(target))
+                break;
+
+            queueMove(target);
+            _since = halMicros();
+            _state = PANO_SETTLE;
+            // fall through
+
+        case PANO_SETTLE:
+            if(!_motion->ready()){
+                _since = halMicros();
+                break;
+            }
+            if(halMicros() - _since < _settle * 1000UL)
+                break;
+
+            Trigger::getInstance()->shoot();
+            _since = halMicros();
+            _state = PANO_EXPOSE;
+            break;
+
+        case PANO_EXPOSE:
+            if(Trigger::getInstance()->busy() || (halMicros() - _since < _exposure * 1000UL))
+                break;
+
+            _shot++;
+            _state = PANO_MOVE;
+            break;
+
+        default:
+            break;
+    }
+
+    return (PanoramaState)_state;
+}
+
+//=========================================//
+//                   GRID                  //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets where a frame of the panorama started last is, in the order they're shot
+ *
+ *  @param[in]  index Number of the frame, from 0
+ *  @param[out] pos   Center of the frame [Millidegrees]
+ *
+ *  @return 0 if the panorama has no such frame,
+ *          1 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Panorama::frameAt(unsigned long index, LongVector* pos)
+{
+    if((pos == NULL) || (index >= numFrames()))
+        return 0;
+
+    // Along a row, or a column, then on to the next, every other one the other way round unless by rows
+    unsigned long along = _byColumns ? _rows : _columns;
+    unsigned long line = index / along;
+    unsigned long at = index % along;
+    if((_order != PANO_ROWS) && (line & 1))
+        at = along - 1 - at;
+
+    unsigned long column = _byColumns ? line : at;
+    unsigned long row = _byColumns ? at : line;
+    pos->p = _origin.p + gridOffset(column, _columns, _extent[0]);
+    pos->t = _origin.t + gridOffset(row, _rows, _extent[1]);
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Time a move of an axis takes from rest to rest, on a trapezoid [Sec]
+ *
+ *  @param[in] distance [Degrees]
+ *  @param[in] speed    [Degrees/Sec]
+ *  @param[in] accel    [Degrees/Sec^2]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double Panorama::moveTime(double distance, double speed, double accel)
+{
+    if(distance <= 0)
+        return 0;
+    if(distance >= speed * speed / accel)
+        return distance / speed + speed / accel;
+    return 2.0 * sqrt(distance / accel);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues a move to an absolute position, whichever the mode of the motion processor
+ *
+ *  @param[in] target Position [Millidegrees]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Panorama::queueMove(LongVector target)
+{
+    if(_motion->getMode() == REL){
+        LongVector from = _motion->getTargetMdeg();
+        target.p -= from.p;
+        target.t -= from.t;
+    }
+    _motion->line(target);
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the state of the panorama
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+PanoramaState Panorama::getState(void)
+{
+    return (PanoramaState)_state;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the field of view of a frame on an axis [Millidegrees]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long Panorama::getFov(uint8_t axis)
+{
+    return _fov[axis];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the least overlap of a frame with its neighbours [1/1000 of the field of view]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long Panorama::getOverlap(void)
+{
+    return _overlap;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the PanoramaOrder the frames are shot in
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Panorama::getOrder(void)
+{
+    return _order;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the number of frames of the panorama started last
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long Panorama::numFrames(void)
+{
+    return _columns * _rows;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the number of columns of the panorama started last, along pan
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long Panorama::getColumns(void)
+{
+    return _columns;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the number of rows of the panorama started last, along tilt
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long Panorama::getRows(void)
+{
+    return _rows;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Tells if the panorama started last goes column by column, 0 if row by row
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Panorama::byColumns(void)
+{
+    return _byColumns;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the number of frames shot so far
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long Panorama::getShot(void)
+{
+    return _shot;
+}
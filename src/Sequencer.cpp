@@ -0,0 +1,529 @@
+#include "../inc/Sequencer.hpp"
+#include "../inc/Kinematics.hpp"
+
+#define SEQ_TANGENT_LIMIT   3.0         // Largest tangent, in times the span's own slope, that can't overshoot
+
+/**
+ * @brief Position of a keyframe along an axis [Millidegrees]
+ */
+static inline long keyPosition(const Keyframe* key, uint8_t axis)
+{
+    return (axis == 0) ? key->p : key->t;
+}
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Creates an idle sequencer driving a motion processor
+ *
+ *  @param[in] motion Motion processor the moves are queued on
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+Sequencer::Sequencer(MotionProcessor* motion)
+{
+    _motion = motion;
+    _source = NULL;
+    _shotCallback = NULL;
+    _state = SEQ_IDLE;
+    _servicing = 0;
+    _tableKeys = 0;
+}
+
+//=========================================//
+//                 RUNNING                 //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts a sequence. The head first goes to the first keyframe at the set speeds, the path's clock starts
+ *         from the time of that keyframe once it's there. Waits for room in the motion queue like line() does.
+ *
+ *  @param[in] source Where the keyframes are read from, their times must go up, NULL for the table
+ *  @param[in] config How the sequence is shot
+ *
+ *  @return 0 if the source has no keyframe,
+ *          1 if the sequence was started,
+ *          2 if the config is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Sequencer::start(KeyframeSource source, const SequenceConfig* config)
+{
+    if(config == NULL)
+        return 2;
+
+    // Idle while the first move waits for room, so a service() from the wait leaves it alone
+    _state = SEQ_IDLE;
+    _source = source;
+    _config = *config;
+
+    _numKeys = 0;
+    _ended = 0;
+    _numSpans = 0;
+    _spanHead = 0;
+    _spanCount = 0;
+    _shot = 0;
+
+    if(!readKey(0, &_keys[0]))
+        return 0;
+    _numKeys = 1;
+
+    _startTime = _keys[0].time;
+    _clock = _startTime;
+    _segmentTime = _startTime;
+    _queuedTime = _startTime;
+
+    LongVector first = {_keys[0].p, _keys[0].t};
+    queueMove(first, 0);
+
+    _state = SEQ_START;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts a sequence through the keyframes of the table, see start(KeyframeSource, const SequenceConfig*)
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Sequencer::start(const SequenceConfig* config)
+{
+    return start(NULL, config);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Stops queuing the path. The moves already queued still run.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::stop(void)
+{
+    _state = SEQ_IDLE;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves the sequence along. Never blocks, call it from the main loop at least every SEQ_LEAD_MS/2
+ *         so the motion queue never runs dry.
+ *
+ *  @return State of the sequence
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+SequenceState Sequencer::service(void)
+{
+    if(_servicing)
+        return (SequenceState)_state;
+    _servicing = 1;
+
+    switch(_state){
+        case SEQ_START:
+            // The clock runs from when the head is on the first keyframe
+            if(_motion->ready()){
+                _lastMicros = halMicros();
+                _clockUs = 0;
+                _state = SEQ_MOVE;
+            }
+            break;
+
+        case SEQ_MOVE:
+        case SEQ_SETTLE:
+        case SEQ_EXPOSE:
+            tickClock();
+            if(_config.interval == 0)
+                serviceMoves();
+            else
+                serviceShots();
+            break;
+
+        default:
+            break;
+    }
+
+    _servicing = 0;
+    return (SequenceState)_state;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues the timed moves of the path that are due within SEQ_LEAD_MS, while they can be queued without waiting.
+ *         Each span is cut into moves of SEQ_SEGMENT_MS, its last one taking what's left, up to 1.5 times that.
+ *         Every move is timed to end when the path gets to its end, counted from where the queued moves end.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::serviceMoves(void)
+{
+    LongVector target;
+
+    while((long)(_segmentTime - _clock) <= SEQ_LEAD_MS){
+        fill();
+        if(_spanCount == 0){
+            _state = SEQ_DONE;
+            return;
+        }
+
+        SequenceSpan* span = &_spans[_spanHead];
+        unsigned long spanEnd = span->time + span->length;
+        if(_segmentTime >= spanEnd){
+            _spanHead = (_spanHead + 1) & SEQ_SPANS_MASK;
+            _spanCount--;
+            continue;
+        }
+
+        unsigned long end = _segmentTime + SEQ_SEGMENT_MS;
+        if(spanEnd - _segmentTime < SEQ_SEGMENT_MS * 3 / 2)
+            end = spanEnd;
+
+        // A move of no step is left out, its time goes to the next move so that one still ends on time
+        positionAt(end, &target);
+        LongVector from = _motion->getTargetMdeg();
+        if((panStepsFromMdeg(target.p) == panStepsFromMdeg(from.p)) && (tiltStepsFromMdeg(target.t) == tiltStepsFromMdeg(from.t))){
+            _segmentTime = end;
+            continue;
+        }
+
+        // Left for the next call, the same time gives the same target
+        if(!_motion->canQueue(target))
+            return;
+        _segmentTime = end;
+
+        // Moves queued while the engine is idle start now, not where the last one ended
+        if(_motion->ready() && ((long)(_clock - _queuedTime) > 0))
+            _queuedTime = _clock;
+
+        // Fell behind, catch up as fast as allowed
+        unsigned long ms = ((long)(end - _queuedTime) > 0) ? (end - _queuedTime) : 1;
+        queueMove(target, ms);
+        _queuedTime = end;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Shoot-move-shoot. Goes to where the path is at the next shot time, waits to be at rest and settled,
+ *         and no earlier than the shot time, shoots, then holds still for the exposure. Shots that fall behind
+ *         their interval stay where the path is at their own time, so frames are evenly spaced along it.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::serviceShots(void)
+{
+    LongVector target;
+
+    switch(_state){
+        case SEQ_MOVE:
+            _shotTime = _startTime + _shot * _config.interval;
+            if(!positionAt(_shotTime, &target)){
+                _state = SEQ_DONE;
+                return;
+            }
+            if(!_motion->canQueue(target))
+                return;
+
+            queueMove(target, 0);
+            _state = SEQ_SETTLE;
+            // fall through
+
+        case SEQ_SETTLE:
+            // Settling is timed from the last time the head was seen moving
+            if(!_motion->ready()){
+                if((long)(_clock + _config.settle - _shotTime) > 0)
+                    _shotTime = _clock + _config.settle;
+                return;
+            }
+            if((long)(_clock - _shotTime) < 0)
+                return;
+
+            if(_shotCallback != NULL)
+                _shotCallback(_shot);
+            _state = SEQ_EXPOSE;
+            return;
+
+        case SEQ_EXPOSE:
+            if((long)(_clock - (_shotTime + _config.exposure)) < 0)
+                return;
+
+            _shot++;
+            _state = SEQ_MOVE;
+            return;
+    }
+}
+
+//=========================================//
+//                   PATH                  //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Works out spans until the table is full, reading the keyframes they need from the source.
+ *         A span needs the keyframe before and the one after its own two, so at most SEQ_KEYS are kept.
+ *         A keyframe that isn't later than the one before it ends the path.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::fill(void)
+{
+    Keyframe key;
+
+    while(_spanCount < SEQ_SPANS){
+        if(!spanReady()){
+            if(_ended)
+                return;
+
+            // Only keyframes the next span needs can be overwritten once it's worked out
+            if(!readKey(_numKeys, &key) || (key.time <= _keys[(_numKeys - 1) & SEQ_KEYS_MASK].time)){
+                _ended = 1;
+                continue;
+            }
+            _keys[_numKeys & SEQ_KEYS_MASK] = key;
+            _numKeys++;
+            continue;
+        }
+
+        // Hermite cubic from the positions and tangents at both ends, put in power form for evaluating
+        const Keyframe* from = &_keys[_numSpans & SEQ_KEYS_MASK];
+        const Keyframe* to = &_keys[(_numSpans + 1) & SEQ_KEYS_MASK];
+        SequenceSpan* span = &_spans[(_spanHead + _spanCount) & SEQ_SPANS_MASK];
+
+        span->time = from->time;
+        span->length = to->time - from->time;
+        for(uint8_t i = 0; i < NUM_OF_MOTORS; i++){
+            double d = keyPosition(to, i) - keyPosition(from, i);
+            double limit = SEQ_TANGENT_LIMIT * fabs(d);
+            double m0 = tangent(_numSpans, i) * span->length;
+            double m1 = tangent(_numSpans + 1, i) * span->length;
+
+            // Tangents kept within 3 times the slope of the span can't overshoot its keyframes
+            if(m0 > limit)  m0 = limit;
+            if(m0 < -limit) m0 = -limit;
+            if(m1 > limit)  m1 = limit;
+            if(m1 < -limit) m1 = -limit;
+
+            span->start[i] = keyPosition(from, i);
+            span->end[i] = keyPosition(to, i);
+            span->a[i] = m0 + m1 - 2.0 * d;
+            span->b[i] = 3.0 * d - 2.0 * m0 - m1;
+            span->c[i] = m0;
+        }
+
+        _spanCount++;
+        _numSpans++;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Tells if the next span can be worked out, i.e. if both keyframes around it are read or known not to exist
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Sequencer::spanReady(void)
+{
+    return (_numSpans + 2 < _numKeys) || (_ended && (_numSpans + 1 < _numKeys));
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Speed of the path through a keyframe, the slope from the keyframe before to the one after it.
+ *         0 at the first and last keyframes, and where the axis turns around or holds still.
+ *
+ *  @param[in] index Keyframe, its neighbours must be read already
+ *  @param[in] axis  Axis
+ *
+ *  @return [Millidegrees/ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+double Sequencer::tangent(unsigned long index, uint8_t axis)
+{
+    if((index == 0) || (_ended && (index + 1 == _numKeys)))
+        return 0;
+
+    const Keyframe* prev = &_keys[(index - 1) & SEQ_KEYS_MASK];
+    const Keyframe* key = &_keys[index & SEQ_KEYS_MASK];
+    const Keyframe* next = &_keys[(index + 1) & SEQ_KEYS_MASK];
+    long in = keyPosition(key, axis) - keyPosition(prev, axis);
+    long out = keyPosition(next, axis) - keyPosition(key, axis);
+
+    if((in == 0) || (out == 0) || ((in < 0) != (out < 0)))
+        return 0;
+
+    return (double)(keyPosition(next, axis) - keyPosition(prev, axis)) / (next->time - prev->time);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets where the path is at a time. Spans that end before it are dropped, so times must not go back.
+ *
+ *  @param[in]  time Time along the path [ms]
+ *  @param[out] pos  Position [Millidegrees]
+ *
+ *  @return 0 if the path ended before that time,
+ *          1 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Sequencer::positionAt(unsigned long time, LongVector* pos)
+{
+    fill();
+    while(_spanCount > 0){
+        const SequenceSpan* span = &_spans[_spanHead];
+
+        if(time - span->time <= span->length){
+            long at[NUM_OF_MOTORS];
+            double s = (double)(time - span->time) / span->length;
+
+            for(uint8_t i = 0; i < NUM_OF_MOTORS; i++){
+                if(time - span->time == span->length)
+                    at[i] = span->end[i];       // Exactly on the keyframe
+                else
+                    at[i] = span->start[i] + lround(((span->a[i] * s + span->b[i]) * s + span->c[i]) * s);
+            }
+            pos->p = at[0];
+            pos->t = at[1];
+            return 1;
+        }
+
+        _spanHead = (_spanHead + 1) & SEQ_SPANS_MASK;
+        _spanCount--;
+        fill();
+    }
+
+    // A path of a single keyframe has no span, only that one time
+    if((_numKeys == 1) && (time == _keys[0].time)){
+        pos->p = _keys[0].p;
+        pos->t = _keys[0].t;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Reads a keyframe from the source, or from the table without one
+ *
+ *  @param[in]  index Number of the keyframe, from 0
+ *  @param[out] key   Keyframe
+ *
+ *  @return 1 if the keyframe was read, 0 if the sequence has no more keyframes
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Sequencer::readKey(unsigned long index, Keyframe* key)
+{
+    if(_source != NULL)
+        return _source(index, key);
+
+    if(index >= _tableKeys)
+        return 0;
+    *key = _table[index];
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Queues a move to an absolute position, whichever the mode of the motion processor
+ *
+ *  @param[in] target Position [Millidegrees]
+ *  @param[in] ms     How long it should take, 0 to go at the set speeds
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::queueMove(LongVector target, unsigned long ms)
+{
+    if(_motion->getMode() == REL){
+        LongVector from = _motion->getTargetMdeg();
+        target.p -= from.p;
+        target.t -= from.t;
+    }
+    _motion->line(target, ms);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Adds the time since the last call to the path's clock, without losing the microseconds
+ *         below a millisecond or breaking when micros() wraps around
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::tickClock(void)
+{
+    unsigned long now = halMicros();
+
+    _clockUs += now - _lastMicros;
+    _lastMicros = now;
+    _clock += _clockUs / 1000;
+    _clockUs %= 1000;
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the state of the sequence
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+SequenceState Sequencer::getState(void)
+{
+    return (SequenceState)_state;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the time along the path, on the same clock as the keyframe times [ms]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long Sequencer::getClock(void)
+{
+    return _clock;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Register the function taking a shot in shoot-move-shoot, it's given the number of the shot
+ *
+ *  @param[in] shotCallback
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::registerShotCallback(void (*shotCallback)(unsigned long shot))
+{
+    _shotCallback = shotCallback;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Adds a keyframe at the end of the table. Its time has to be later than the one before it, or the path ends there.
+ *
+ *  @param[in] key Keyframe
+ *
+ *  @return 0 if the table is full,
+ *          1 if the keyframe was added,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Sequencer::addKeyframe(const Keyframe* key)
+{
+    if(key == NULL)
+        return 2;
+    if(_tableKeys >= SEQ_TABLE_KEYS)
+        return 0;
+
+    _table[_tableKeys++] = *key;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Empties the table, stopping the sequence if it runs through it
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Sequencer::clearKeyframes(void)
+{
+    if(_source == NULL)
+        stop();
+    _tableKeys = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get how many keyframes the table holds
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Sequencer::numKeyframes(void)
+{
+    return _tableKeys;
+}
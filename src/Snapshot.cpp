@@ -0,0 +1,302 @@
+#include "../inc/Snapshot.hpp"
+#include "../inc/Frame.hpp"
+#include "../inc/MotionQueue.hpp"
+#include "../inc/MotionProcessor.hpp"
+#include "../inc/MotorPower.hpp"
+#include "../inc/PinDef.h"
+
+// Bytes of a record compared to tell if the state changed, everything but its sequence and CRC
+#define SNAPSHOT_STATE_SIZE     offsetof(SnapshotRecord, sequence)
+
+/**
+ * @brief Starts writing a byte of the EEPROM, unless it already holds that value
+ *
+ * @return 1 if a write was started, 0 if there was nothing to write
+ */
+static uint8_t updateByte(uint16_t address, uint8_t value)
+{
+    if(halEepromRead(address) == value)
+        return 0;
+
+    halEepromWrite(address, value);
+    return 1;
+}
+
+/**
+ * @brief CRC of a record, everything before its crc field
+ */
+static uint16_t recordCrc(const SnapshotRecord* record)
+{
+    const uint8_t* bytes = (const uint8_t*)record;
+    uint16_t crc = FRAME_CRC_INIT;
+
+    for(uint8_t i = 0; i < offsetof(SnapshotRecord, crc); i++)
+        crc = frameCrc(crc, bytes[i]);
+    return crc;
+}
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+Snapshot* Snapshot::instance;
+
+Snapshot* Snapshot::getInstance()
+{
+    if(instance == NULL){
+        instance = new Snapshot();
+    }
+    return instance;
+}
+
+Snapshot::Snapshot(void)
+{
+    _scanned = 0;
+    _slot = SNAPSHOT_NO_SLOT;
+    _moved = 1;
+    _writeSlot = 0;
+    _step = 0;
+    _resting = 0;
+    _restSince = 0;
+    memset(&_latest, 0, sizeof(_latest));
+    memset(&_record, 0, sizeof(_record));
+}
+
+//=========================================//
+//                 RECORDS                 //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the latest record. Its SNAPSHOT_POSITION flag is cleared if the head moved after it was taken.
+ *
+ *  @param[out] record Where to copy it
+ *
+ *  @return 0 if there's no valid record,
+ *          1 if the record was copied,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Snapshot::load(SnapshotRecord* record)
+{
+    if(record == NULL)
+        return 2;
+
+    scan();
+    if(_slot == SNAPSHOT_NO_SLOT)
+        return 0;
+
+    *record = _latest;
+    if(_moved)
+        record->flags &= ~SNAPSHOT_POSITION;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts writing a record into the slot after the latest one, in place of any record still being written.
+ *         Returns right away, service() writes it out. Its sequence and CRC are filled in.
+ *
+ *  @param[in] record Record to write
+ *
+ *  @return 1 if it was started,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Snapshot::save(const SnapshotRecord* record)
+{
+    if(record == NULL)
+        return 2;
+
+    scan();
+    _record = *record;
+    _record.reserved = 0;
+    _record.sequence = (_slot == SNAPSHOT_NO_SLOT) ? 0 : _latest.sequence + 1;
+    _record.crc = recordCrc(&_record);
+
+    _writeSlot = (_slot == SNAPSHOT_NO_SLOT) ? 0 : (_slot + 1) % SNAPSHOT_SLOTS;
+    _step = 1;
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Tells that the head is about to move. Drops the record being written, which is of where the head was, and
+ *         marks the latest record as moved. Only that first call after a record waits, for up to one EEPROM write.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Snapshot::moving(void)
+{
+    // The dropped record's slot was marked as moved before anything else was written to it
+    _step = 0;
+    _resting = 0;
+
+    scan();
+    if(_moved || (_slot == SNAPSHOT_NO_SLOT))
+        return;
+
+    updateByte(slotAddress(_slot), SNAPSHOT_MARK_MOVED);
+    _moved = 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Writes the record under way a byte at a time, or takes a snapshot once at rest. Call it regularly from the
+ *         main loop, it never waits on the EEPROM.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Snapshot::service(void)
+{
+    scan();
+
+    // Bytes already holding their value take no write, so skip over them
+    while(_step != 0){
+        if(!halEepromReady())
+            return;
+
+        uint16_t address = slotAddress(_writeSlot);
+        uint8_t started;
+        if(_step == 1)
+            started = updateByte(address, SNAPSHOT_MARK_MOVED);
+        else if(_step < SNAPSHOT_SLOT_SIZE + 1)
+            started = updateByte(address + _step - 1, ((const uint8_t*)&_record)[_step - 2]);
+        else
+            started = updateByte(address, SNAPSHOT_MARK_REST);
+
+        if(++_step > SNAPSHOT_SLOT_SIZE + 1){
+            _step = 0;
+            _slot = _writeSlot;
+            _latest = _record;
+            _moved = 0;
+        }
+        if(started)
+            return;
+    }
+
+    if(!atRest()){
+        _resting = 0;
+        return;
+    }
+
+    unsigned long now = halMicros();
+    if(!_resting){
+        _resting = 1;
+        _restSince = now;
+        return;
+    }
+    if(now - _restSince < SNAPSHOT_SETTLE_MS * 1000UL)
+        return;
+    _restSince = now;
+
+    // Back where the latest record was taken, only its mark needs setting back
+    SnapshotRecord record;
+    capture(&record);
+    if((_slot != SNAPSHOT_NO_SLOT) && (memcmp(&record, &_latest, SNAPSHOT_STATE_SIZE) == 0)){
+        if(_moved && halEepromReady()){
+            updateByte(slotAddress(_slot), SNAPSHOT_MARK_REST);
+            _moved = 0;
+        }
+        return;
+    }
+
+    save(&record);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if a record is being written
+ *
+ *  @return 1 if writing,
+ *          0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Snapshot::writing(void)
+{
+    return _step != 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Finds the latest record, the valid one with the highest sequence, the first time the EEPROM is needed
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Snapshot::scan(void)
+{
+    if(_scanned)
+        return;
+    _scanned = 1;
+
+    SnapshotRecord record;
+    for(uint8_t slot = 0; slot < SNAPSHOT_SLOTS; slot++){
+        uint16_t address = slotAddress(slot) + 1;
+        for(uint8_t i = 0; i < sizeof(record); i++)
+            ((uint8_t*)&record)[i] = halEepromRead(address + i);
+
+        if(record.crc != recordCrc(&record))
+            continue;
+
+        // Sequences wrap around, the newer one is ahead by less than half of them
+        if((_slot == SNAPSHOT_NO_SLOT) || ((int16_t)(record.sequence - _latest.sequence) > 0)){
+            _slot = slot;
+            _latest = record;
+        }
+    }
+
+    _moved = (_slot == SNAPSHOT_NO_SLOT) || (halEepromRead(slotAddress(_slot)) != SNAPSHOT_MARK_REST);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if the head is at rest with every driver holding it, nothing queued or homing
+ *
+ *  @return 1 if at rest,
+ *          0 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Snapshot::atRest(void)
+{
+    if(StepEngine::getInstance()->busy() || !MotionQueue::getInstance()->isEmpty())
+        return 0;
+    return MotorPower::getInstance()->enabled() == (1 << STEP_ENGINE_AXES) - 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Fills a record with the current state
+ *
+ *  @param[out] record Record to fill, its sequence and CRC are left at 0
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Snapshot::capture(SnapshotRecord* record)
+{
+    MotionProcessor* motion = MotionProcessor::getInstance();
+    StepEngine* engine = StepEngine::getInstance();
+    LongVector target = motion->getTargetMdeg();
+    LongVector position = motion->getPositionSteps();
+    LongVector offset = motion->getHomeOffset();
+
+    memset(record, 0, sizeof(*record));
+    record->targetMdeg[0] = target.p;
+    record->targetMdeg[1] = target.t;
+    record->position[0] = position.p;
+    record->position[1] = position.t;
+    record->homeOffset[0] = offset.p;
+    record->homeOffset[1] = offset.t;
+    record->stepRate[0] = PAN_STEPRATE;
+    record->stepRate[1] = TILT_STEPRATE;
+    record->speed[0] = motion->getPanSpeed();
+    record->speed[1] = motion->getTiltSpeed();
+    record->flags = motion->positionKnown() ? SNAPSHOT_POSITION : 0;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        record->microIndex[i] = engine->microIndex(i);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the EEPROM address of a slot, that of its mark, followed by its record
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint16_t Snapshot::slotAddress(uint8_t slot)
+{
+    return SNAPSHOT_EEPROM_START + (uint16_t)slot * SNAPSHOT_SLOT_SIZE;
+}
@@ -0,0 +1,219 @@
+#include "../inc/StallMonitor.hpp"
+#include "math.h"
+#include "../inc/PinDef.h"
+#include "../inc/MotionProcessor.hpp"
+#include "../inc/MotionQueue.hpp"
+
+// Degrees per step of each axis, indexed like StepBlock::steps
+static const double stepRates[STEP_ENGINE_AXES] = {PAN_STEPRATE, TILT_STEPRATE};
+
+// Steps in an electrical cycle of each axis, what a slipping rotor loses at a time
+static const long cycleSteps[STEP_ENGINE_AXES] = {4L * PAN_MICROSTEPS, 4L * TILT_MICROSTEPS};
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+StallMonitor* StallMonitor::instance;
+
+StallMonitor* StallMonitor::getInstance()
+{
+    if(instance == NULL){
+        instance = new StallMonitor();
+    }
+    return instance;
+}
+
+StallMonitor::StallMonitor(void)
+{
+    _homeCount = StepEngine::getInstance()->homeCount();
+    _stalled = 0;
+    _settle = 0;
+    _seed = 0;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        EndstopEdge edge;
+        _edgeCount[i] = StepEngine::getInstance()->lastEdge(i, &edge);
+        _resyncs[i] = 0;
+    }
+    forget();
+}
+
+//=========================================//
+//               CHECKPOINTS               //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Checks the edges crossed since the last call against their checkpoints, taking slips out of the position and
+ *         flagging stalls. Call it regularly from the main loop, never from a callback run while a move is queued.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StallMonitor::service(void)
+{
+    StepEngine* engine = StepEngine::getInstance();
+    MotionProcessor* motion = MotionProcessor::getInstance();
+
+    // A homing measures the magnets again, and whatever stalled before is settled by it
+    uint8_t homeCount = engine->homeCount();
+    if(homeCount != _homeCount){
+        _homeCount = homeCount;
+        _stalled = 0;
+        _settle = 0;
+        _seed = 1;
+        forget();
+    }
+
+    // The edges crossed while homing, or before the position is known, only get counted
+    HomingState homing = engine->homingState();
+    uint8_t homingBusy = engine->busy() && (homing >= HOMING_SEEK) && (homing < HOMING_DONE);
+    uint8_t checking = !homingBusy && motion->positionKnown();
+
+    if(_seed && !homingBusy){
+        _seed = 0;
+        if(homing == HOMING_DONE)
+            seed();
+    }
+
+    long shift[STEP_ENGINE_AXES];
+    uint8_t shifted = 0;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        EndstopEdge edge;
+        uint8_t count = engine->lastEdge(i, &edge);
+
+        shift[i] = 0;
+        if(count == _edgeCount[i])
+            continue;
+        _edgeCount[i] = count;
+
+        if(checking)
+            shift[i] = check(i, &edge);
+        if(shift[i] != 0)
+            shifted = 1;
+    }
+
+    if(shifted){
+        motion->shiftPositionSteps(shift);
+        _settle = 1;
+    }
+
+    // The last queued move ended off its target by the slip, so it's made up for once the queue runs dry
+    if(_settle && !engine->busy() && MotionQueue::getInstance()->isEmpty()){
+        _settle = 0;
+        if(!_stalled)
+            motion->settle();
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Forgets every checkpoint, to be learned again. Needed whenever the position is set to something else.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StallMonitor::forget(void)
+{
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        _learned[i] = 0;
+        _errors[i] = 0;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Learns the checkpoints of the edges homing measured, so a slip before they're next crossed is caught.
+ *         Both were crossed slowly in the direction of the last edge, the far one.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StallMonitor::seed(void)
+{
+    StepEngine* engine = StepEngine::getInstance();
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        EndstopEdge edge;
+        _edgeCount[i] = engine->lastEdge(i, &edge);
+        if(edge.entered)
+            continue;
+
+        _learned[i] = (1 << edge.down) | (1 << (2 + edge.down));
+        _checkpoints[i][edge.down] = edge.position;
+        _checkpoints[i][2 + edge.down] = engine->getEdge(i, 1);
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Compares an edge with its checkpoint, or learns it if it's the first one
+ *
+ *  @param[in] axis Index of the axis
+ *  @param[in] edge Edge just crossed
+ *
+ *  @return What to add to the position to take a slip out [Steps], 0 if there's none or if it's a stall
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long StallMonitor::check(uint8_t axis, const EndstopEdge* edge)
+{
+    uint8_t checkpoint = edge->entered * 2 + edge->down;
+
+    if(!(_learned[axis] & (1 << checkpoint))){
+        _learned[axis] |= (1 << checkpoint);
+        _checkpoints[axis][checkpoint] = edge->position;
+        return 0;
+    }
+
+    // A turn later, the edge is the same one
+    long turn = lround(360.0 / stepRates[axis]);
+    long error = (edge->position - _checkpoints[axis][checkpoint]) % turn;
+    if(error > turn / 2)
+        error -= turn;
+    else if(error < -turn / 2)
+        error += turn;
+    _errors[axis] = error;
+
+    if(labs(error) > STALL_TOLERANCE / stepRates[axis]){
+        _stalled |= (1 << axis);
+        return 0;
+    }
+
+    // Whatever's left over is the sensor's own spread, not a slip
+    long cycle = cycleSteps[axis];
+    long slip = ((error >= 0) ? (error + cycle / 2) : (error - cycle / 2)) / cycle * cycle;
+    if((slip != 0) && (_resyncs[axis] < 0xFF))
+        _resyncs[axis]++;
+    return -slip;
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets which axes stalled since they were last homed
+ *
+ *  @return Axis i stalled if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StallMonitor::stalled(void)
+{
+    return _stalled;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get the error at the last checkpoint an axis crossed [Steps], positive if it was reached late counting up
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long StallMonitor::getError(uint8_t axis)
+{
+    return (axis < STEP_ENGINE_AXES) ? _errors[axis] : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get how many slips were taken out of an axis' position, up to 255
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StallMonitor::getResyncs(uint8_t axis)
+{
+    return (axis < STEP_ENGINE_AXES) ? _resyncs[axis] : 0;
+}
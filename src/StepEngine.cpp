@@ -0,0 +1,938 @@
+#include "../inc/StepEngine.hpp"
+#include "../inc/MotionQueue.hpp"
+#include "../inc/FastStepperMotor.hpp"
+#include "../inc/Kinematics.hpp"
+#include "../inc/StepTiming.hpp"
+#include "../inc/Telemetry.hpp"
+#include "../inc/Trigger.hpp"
+#include "../inc/PinDef.h"
+
+// The interrupt drives the pins through these, resolved at build time. Their pins are set up by the attached motors.
+typedef FastStepperMotor<PAN_DIR_PIN, PAN_STEP_PIN, PAN_EN_PIN, PAN_HALL_PIN> PanMotor;
+typedef FastStepperMotor<TILT_DIR_PIN, TILT_STEP_PIN, TILT_EN_PIN, TILT_HALL_PIN> TiltMotor;
+static FastMotorGroup<PanMotor, TiltMotor> motorGroup;
+typedef FastModePins<PAN_MS1_PIN, PAN_MS2_PIN, PAN_MS3_PIN> PanModePins;
+typedef FastModePins<TILT_MS1_PIN, TILT_MS2_PIN, TILT_MS3_PIN> TiltModePins;
+
+// Direction pin value that counts each axis' position up
+static const uint8_t forwardDirs[STEP_ENGINE_AXES] = {PAN_DIR_CCW, TILT_DIR_CCW};
+
+// Flips motorGroup.endstops() so a set bit means the magnet is detected, whichever level the sensors give for it
+static const uint8_t endstopsFlip = (HALL_MAG_DETECTED) ? 0x00 : ((1 << STEP_ENGINE_AXES) - 1);
+
+/**
+ * @brief Switches the microstep mode of an axis. Only call it between pulses, with the driver on a full step.
+ *
+ * @param[in] axis  Index of the axis
+ * @param[in] shift Microsteps per pulse as a power of two, 0 for the finest mode
+ */
+static inline void setMicrostepShift(uint8_t axis, uint8_t shift)
+{
+    if(axis == 0)
+        PanModePins::set(MICROSTEP_MODE_BITS(PAN_MICROSTEP_LOG2 - shift));
+    else
+        TiltModePins::set(MICROSTEP_MODE_BITS(TILT_MICROSTEP_LOG2 - shift));
+}
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+StepEngine* StepEngine::instance;
+
+StepEngine* StepEngine::getInstance()
+{
+    if(instance == NULL){
+        instance = new StepEngine();
+    }
+    return instance;
+}
+
+StepEngine::StepEngine(void)
+{
+    _motors = NULL;
+    _busy = 0;
+    _eventsLeft = 0;
+    _rate = 0;
+    _phase = 0;
+    _homing = 0;
+    _homeCount = 0;
+    _endstops = 0;
+    _dirMask = 0;
+    _edgeDown = 0;
+    _arc = ARC_NONE;
+
+    // The motors' init leaves the drivers in the finest mode, on index 0 after power up
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        _homingAxes[i].state = HOMING_IDLE;
+        _position[i] = 0;
+        _microIndex[i] = 0;
+        _shift[i] = 0;
+        _bounce[i] = 0;
+        _edgeCandidate[i] = 0;
+        _enterAt[i] = 0;
+        _leaveAt[i] = 0;
+        _edgeCount[i] = 0;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Attaches the motors that the step interrupt will drive. The interrupt writes their pins directly,
+ *         so they have to be initialized first.
+ *
+ *  @param[in] motors Array of STEP_ENGINE_AXES motors, indexed the same way as StepBlock::steps
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::attach(StepperMotor* motors)
+{
+    _motors = motors;
+}
+
+//=========================================//
+//               MAIN LOOP SIDE            //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts the step interrupt if it's idle and there are blocks queued. Call it after queuing blocks,
+ *         it returns right away. Poll busy() to know when every block is done.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::wake(void)
+{
+    if(_busy || (_motors == NULL))
+        return;
+
+    // The interrupt leaves the engine alone until it's busy, so no need to guard the load
+    if(load()){
+        _busy = 1;
+        startTimer();
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if blocks are being executed
+ *
+ *  @return 1 if moving,
+ *          0 if idle
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::busy(void)
+{
+    return _busy;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts the timer, unless the trigger is already keeping it running. Restarting it would stretch the tick
+ *         it's in. The interrupt stops it once neither the engine nor the trigger is busy.
+ *         The sensors weren't sampled while it was stopped, so their state is read afresh first.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::startTimer(void)
+{
+    if(Trigger::getInstance()->busy())
+        return;
+
+    _endstops = motorGroup.endstops() ^ endstopsFlip;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _bounce[i] = 0;
+
+    halTimerStart();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the live position of an axis, counting every pulse emitted so far
+ *
+ *  @param[in] axis Index of the axis
+ *
+ *  @return Position [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long StepEngine::getPosition(uint8_t axis)
+{
+    // Multi byte, so it has to be read with the interrupt held off
+    halNoInterrupts();
+    long position = _position[axis];
+    halInterrupts();
+
+    return position;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves the origin of every axis, e.g. when the position gets set. Adding the same shift to the end of the
+ *         queued moves keeps both consistent while moving.
+ *
+ *  @param[in] shift Array of STEP_ENGINE_AXES amounts added to the positions [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::shiftPosition(const long shift[])
+{
+    halNoInterrupts();
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _position[i] += shift[i];
+    halInterrupts();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts homing every axis at once and returns right away. Each axis seeks its magnet fast, backs out of it,
+ *         comes back slowly to measure it and stops on its center. Blocks queued in the meantime run once every
+ *         axis is home, or are dropped if one failed. Only starts while idle.
+ *
+ *  @param[in] config Array of STEP_ENGINE_AXES homing configs, indexed the same way as StepBlock::steps
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::home(const HomingConfig config[])
+{
+    if(_busy || (_motors == NULL))
+        return;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        HomingAxis* axis = &_homingAxes[i];
+
+        // Homing steps one microstep at a time, so it measures the magnet as finely as it can
+        if(_shift[i] != 0){
+            _shift[i] = 0;
+            setMicrostepShift(i, 0);
+        }
+
+        _homingConfig[i] = config[i];
+        axis->state = HOMING_SEEK;
+        axis->dir = config[i].seekDir;
+        axis->stopping = 0;
+        axis->seen = 0;
+        axis->rate = 0;
+        axis->targetRate = config[i].seekRate;
+        axis->phase = 0;
+        axis->count = 0;
+        axis->width = 0;
+    }
+    setDirs(homingDirs());
+
+    // The interrupt leaves the engine alone until it's busy, so no need to guard
+    _homeCount++;
+    _homing = 1;
+    _busy = 1;
+    startTimer();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets how far homing got
+ *
+ *  @return HOMING_FAILED if an axis failed, else the state of the axis furthest from done.
+ *          HOMING_IDLE if homing was never started.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+HomingState StepEngine::homingState(void)
+{
+    uint8_t state = HOMING_DONE;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        uint8_t axisState = _homingAxes[i].state;
+        if(axisState == HOMING_FAILED)
+            return HOMING_FAILED;
+        if(axisState < state)
+            state = axisState;
+    }
+    return (HomingState)state;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the microstep index of an axis' driver, the microsteps it took since power up wrapped to 8 bits.
+ *         It's on a full step when it's a multiple of the axis' microsteps. Only settled while the engine is idle.
+ *
+ *  @param[in] axis Index of the axis
+ *
+ *  @return [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::microIndex(uint8_t axis)
+{
+    return _microIndex[axis];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Puts the drivers back on given microstep indexes, e.g. the ones they were left on before a power cycle, which
+ *         starts them over on index 0. Pulses each one forward the least it takes, in the finest mode, without counting
+ *         the position. Only while idle and with the drivers off, whose translators still take steps, so the motors
+ *         don't move. Once on, each rotor is pulled back in phase with its driver instead of onto index 0.
+ *
+ *  @param[in] index Array of STEP_ENGINE_AXES microstep indexes, as microIndex() gave them
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::setMicroIndex(const uint8_t index[])
+{
+    // The phases repeat every four full steps
+    static const uint16_t cycle[STEP_ENGINE_AXES] = {4 * PAN_MICROSTEPS, 4 * TILT_MICROSTEPS};
+    uint8_t pulses[STEP_ENGINE_AXES];
+    uint8_t dirMask = 0;
+    uint8_t left = 0;
+
+    if(_busy)
+        return;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(_shift[i] != 0){
+            _shift[i] = 0;
+            setMicrostepShift(i, 0);
+        }
+
+        pulses[i] = (uint8_t)(index[i] - _microIndex[i]) % cycle[i];
+        left |= pulses[i];
+        if(forwardDirs[i])
+            dirMask |= (1 << i);
+    }
+    setDirs(dirMask);
+
+    while(left){
+        uint8_t axisMask = 0;
+        left = 0;
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+            if(pulses[i] == 0)
+                continue;
+            pulses[i]--;
+            axisMask |= (1 << i);
+            left |= pulses[i];
+        }
+
+        halDelayMicroseconds(STEP_PULSE_US);
+        motorGroup.step(axisMask);
+    }
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _microIndex[i] = index[i];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets how many times homing was started, wrapping around. Homing moves the drivers by an amount no one
+ *         planned, so a change tells the planner its microstep index went stale.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::homeCount(void)
+{
+    return _homeCount;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the state of the Hall sensors. Debounced while the engine is busy, read straight from the pins otherwise.
+ *
+ *  @return Bit i is set if axis i's magnet is detected
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::endstops(void)
+{
+    if(_busy)
+        return _endstops;
+    return motorGroup.endstops() ^ endstopsFlip;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the position of the last edge of a magnet the interrupt saw, at the first tick that read the new level
+ *
+ *  @param[in] axis    Index of the axis
+ *  @param[in] entered 1 for where the magnet was last detected coming from clear, 0 for where it was last cleared
+ *
+ *  @return Position [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long StepEngine::getEdge(uint8_t axis, uint8_t entered)
+{
+    halNoInterrupts();
+    long position = entered ? _enterAt[axis] : _leaveAt[axis];
+    halInterrupts();
+
+    return position;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the last edge of a magnet the interrupt saw on an axis
+ *
+ *  @param[in]  axis Index of the axis
+ *  @param[out] edge Where to copy it
+ *
+ *  @return Number of edges seen on the axis so far, wrapping around, so a caller can tell a new one
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::lastEdge(uint8_t axis, EndstopEdge* edge)
+{
+    // The state the last edge went to is the current one
+    halNoInterrupts();
+    edge->entered = (_endstops >> axis) & 0x01;
+    edge->down = (_edgeDown >> axis) & 0x01;
+    edge->position = edge->entered ? _enterAt[axis] : _leaveAt[axis];
+    uint8_t count = _edgeCount[axis];
+    halInterrupts();
+
+    return count;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Converts a step rate to the phase increment the interrupt adds every tick
+ *
+ *  @param[in] stepsPerSec Step rate of the leading axis [steps/s]
+ *
+ *  @return Step events per tick [Q0.32], saturated at one step event per tick
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint32_t StepEngine::rateFromStepsPerSec(double stepsPerSec)
+{
+    double rate = stepsPerSec * (4294967296.0 / STEP_TICK_HZ);
+
+    if(rate >= 4294967295.0)
+        return 0xFFFFFFFF;
+    if(rate < 1.0)
+        return 1;
+    return (uint32_t)rate;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Converts an acceleration to the rate change the interrupt applies every tick
+ *
+ *  @param[in] stepsPerSec2 Acceleration of the leading axis [steps/s^2]
+ *
+ *  @return Rate change per tick [Q0.40], saturated
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint32_t StepEngine::accelFromStepsPerSec2(double stepsPerSec2)
+{
+    double accel = stepsPerSec2 * (1099511627776.0 / ((double)STEP_TICK_HZ * STEP_TICK_HZ));
+
+    if(accel >= 4294967295.0)
+        return 0xFFFFFFFF;
+    if(accel < 256.0)
+        return 256;                 // Smallest value that still moves the rate once shifted down
+    return (uint32_t)accel;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Converts a jerk to the acceleration change the interrupt applies every tick
+ *
+ *  @param[in] stepsPerSec3 Jerk of the leading axis [steps/s^3]
+ *
+ *  @return Acceleration change per tick [Q0.40], saturated. Never 0, since 0 selects a trapezoid.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint32_t StepEngine::jerkFromStepsPerSec3(double stepsPerSec3)
+{
+    double jerk = stepsPerSec3 * (1099511627776.0 / ((double)STEP_TICK_HZ * STEP_TICK_HZ * STEP_TICK_HZ));
+
+    if(jerk >= 4294967295.0)
+        return 0xFFFFFFFF;
+    if(jerk < 1.0)
+        return 1;
+    return (uint32_t)jerk;
+}
+
+//=========================================//
+//              INTERRUPT SIDE             //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the live position of an axis without holding the interrupt off, only from the interrupt itself
+ *
+ *  @param[in] axis Index of the axis
+ *
+ *  @return Position [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long StepEngine::isrPosition(uint8_t axis)
+{
+    return _position[axis];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes, from the interrupt, if the motors are at rest or going at a constant rate
+ *
+ *  @return 1 if idle, cruising or holding the exit rate,
+ *          0 if accelerating, decelerating or homing
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::isrSteady(void)
+{
+    if(!_busy)
+        return 1;
+    return !_homing && ((_ramp == RAMP_CRUISE) || (_ramp == RAMP_HOLD));
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Samples the Hall sensors into the debounced state. A sensor that reads another level than its state for
+ *         ENDSTOP_DEBOUNCE_TICKS in a row takes it, with the edge at the position of the first of those readings.
+ *         The readings are of the position the last step event left the axis on.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::sampleEndstops(void)
+{
+    uint8_t changed = (motorGroup.endstops() ^ endstopsFlip) ^ _endstops;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(!(changed & (1 << i))){
+            _bounce[i] = 0;
+            continue;
+        }
+
+        if(_bounce[i] == 0)
+            _edgeCandidate[i] = _position[i];
+        if(++_bounce[i] < ENDSTOP_DEBOUNCE_TICKS)
+            continue;
+
+        _bounce[i] = 0;
+        _endstops ^= (1 << i);
+        if(_endstops & (1 << i))
+            _enterAt[i] = _edgeCandidate[i];
+        else
+            _leaveAt[i] = _edgeCandidate[i];
+
+        if(((_dirMask >> i) & 0x01) == forwardDirs[i])
+            _edgeDown &= ~(1 << i);
+        else
+            _edgeDown |= (1 << i);
+        _edgeCount[i]++;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sets the direction pins, keeping what they were set to
+ *
+ *  @param[in] dirMask Direction pin value of axis i in bit i
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::setDirs(uint8_t dirMask)
+{
+    _dirMask = dirMask;
+    motorGroup.setDirs(dirMask);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Loads the block at the head of the MotionQueue into the interrupt's registers and sets the direction pins.
+ *         Only called from the interrupt, or from wake() while the interrupt is stopped.
+ *
+ *  @return 0 if there is no block to load,
+ *          1 if a block was loaded
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::load(void)
+{
+    MotionBlock* block = MotionQueue::getInstance()->headBlock();
+    if(block == NULL)
+        return 0;
+
+    // From here on the planner leaves the block alone
+    block->flags |= BLOCK_BUSY;
+
+    // Start every error accumulator half way so the slower axes step in the middle of their runs.
+    // The planner only changes the mode of an axis where its driver is on a full step.
+    uint8_t dirMask = 0;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        uint8_t shift = block->step.shift[i];
+        if(shift != _shift[i]){
+            _shift[i] = shift;
+            setMicrostepShift(i, shift);
+        }
+
+        if(block->dir[i])
+            dirMask |= (1 << i);
+        _stepSign[i] = (block->step.negMask & (1 << i)) ? -(1 << shift) : (1 << shift);
+        _steps[i] = block->step.steps[i];
+        _error[i] = block->step.events >> 1;
+    }
+    setDirs(dirMask);
+    _events = block->step.events;
+    _eventsLeft = block->step.events;
+    _rate = block->step.entryRate;
+
+    _accelMax = block->step.accel;
+    _accelMin = block->step.accelMin;
+    _jerk = block->step.jerk;
+    _cruiseRate = block->step.cruiseRate;
+    _exitRate = block->step.exitRate;
+    _accelEaseRate = block->step.accelEaseRate;
+    _decelEaseRate = block->step.decelEaseRate;
+    _decelEvents = block->step.decelEvents;
+    STEP_TIMING_COMMANDED(_cruiseRate);
+
+    // An arc counts the steps left to its end on each axis, the last step event lands on them
+    _arc = block->step.arc;
+    if(_arc != ARC_NONE){
+        _arcShift = block->step.arcShift;
+        _arcX = block->step.arcX;
+        _arcY = block->step.arcY;
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+            _arcLow[i] = block->step.arcLow[i];
+            _arcLeft[i] = (block->step.negMask & (1 << i)) ? -(long)_steps[i] : (long)_steps[i];
+        }
+    }
+
+    // A trapezoid takes the full acceleration right away, an S-curve builds it up
+    _accel = (_jerk != 0) ? _accelMin : _accelMax;
+    if(_eventsLeft <= _decelEvents)
+        _ramp = RAMP_DECEL;
+    else if(_rate >= _cruiseRate)
+        _ramp = RAMP_CRUISE;
+    else
+        _ramp = RAMP_ACCEL;
+
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Does one tick of the step generator. Called from the timer interrupt every STEP_TICK_US.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::tick(void)
+{
+    sampleEndstops();
+
+    if(!_busy)
+        return;
+
+    if(_homing){
+        homingTick();
+        return;
+    }
+
+    // Ramp the rate. The jerk, when there is one, first builds the acceleration up then eases it
+    // back down once past the ease rate so the profile rounds off into the next part.
+    uint32_t change;
+    switch(_ramp){
+        case RAMP_ACCEL:
+            if(_jerk != 0){
+                if(_rate < _accelEaseRate)
+                    _accel = (_accelMax - _accel > _jerk) ? _accel + _jerk : _accelMax;
+                else
+                    _accel = (_accel - _accelMin > _jerk) ? _accel - _jerk : _accelMin;
+            }
+            change = _accel >> 8;
+            if(_cruiseRate - _rate <= change){
+                _rate = _cruiseRate;
+                _ramp = RAMP_CRUISE;
+            }
+            else{
+                _rate += change;
+            }
+            break;
+
+        case RAMP_DECEL:
+            if(_jerk != 0){
+                if(_rate > _decelEaseRate)
+                    _accel = (_accelMax - _accel > _jerk) ? _accel + _jerk : _accelMax;
+                else
+                    _accel = (_accel - _accelMin > _jerk) ? _accel - _jerk : _accelMin;
+            }
+            change = _accel >> 8;
+            if(_rate - _exitRate <= change){
+                _rate = _exitRate;
+                _ramp = RAMP_HOLD;
+            }
+            else{
+                _rate -= change;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    // Advance the phase, a step event happens only when it wraps around
+    uint32_t lastPhase = _phase;
+    _phase += _rate;
+    if(_phase >= lastPhase)
+        return;
+
+    // Bresenham, the leading axis always steps since its step count equals the number of events.
+    // Every axis stepping on this event is pulsed at once. An arc steps its own way.
+    uint8_t axisMask = 0;
+    if(_arc != ARC_NONE){
+        axisMask = arcEvent();
+    }
+    else{
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+            _error[i] += _steps[i];
+            if(_error[i] >= _events){
+                _error[i] -= _events;
+                _position[i] += _stepSign[i];
+                _microIndex[i] += _stepSign[i];
+                axisMask |= (1 << i);
+            }
+        }
+        motorGroup.step(axisMask);
+    }
+    STEP_TIMING_STEPPED(axisMask);
+    Telemetry::getInstance()->stepped(axisMask);
+
+    if(--_eventsLeft == 0){
+        // Block done, go straight into the next one or stop if there's none
+        MotionQueue::getInstance()->popBlock();
+        if(!load())
+            _busy = 0;
+    }
+    else if((_ramp < RAMP_DECEL) && (_eventsLeft <= _decelEvents)){
+        _ramp = RAMP_DECEL;
+        _accel = (_jerk != 0) ? _accelMin : _accelMax;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Does one step event of an arc. The vector from the center is turned by about 2^-arcShift radians the way
+ *         Minsky's circle does it, each coordinate updated from the other's new value with a shift and an add. That
+ *         keeps it on a closed curve within 2^-arcShift/4 of the radius, however many turns it makes, without a
+ *         multiply. The planner picks the shift so neither coordinate moves by more than a step per event.
+ *
+ *         An axis steps once its coordinate leaves the span of the step it's on, turning its direction pin around
+ *         first if it has to. The last event steps each axis towards the end of the arc instead, and is repeated
+ *         until both are on it. The turns can't land on the exact angle, so that's usually a step, rarely two.
+ *
+ *  @return Axis i stepped if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::arcEvent(void)
+{
+    static const long span[STEP_ENGINE_AXES] = {ARC_PAN_STEP, ARC_TILT_STEP};
+
+    // Rounded shifts, so the turns don't drift one way over many events
+    long half = 1L << (_arcShift - 1);
+    if(_arc == ARC_CCW){
+        _arcX -= (_arcY + half) >> _arcShift;
+        _arcY += (_arcX + half) >> _arcShift;
+    }
+    else{
+        _arcX += (_arcY + half) >> _arcShift;
+        _arcY -= (_arcX + half) >> _arcShift;
+    }
+
+    long coord[STEP_ENGINE_AXES] = {_arcX, _arcY};
+    uint8_t axisMask = 0;
+    uint8_t dirMask = _dirMask;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        int8_t sign = 0;
+        if(coord[i] >= _arcLow[i] + span[i]){
+            _arcLow[i] += span[i];
+            sign = 1;
+        }
+        else if(coord[i] < _arcLow[i]){
+            _arcLow[i] -= span[i];
+            sign = -1;
+        }
+        if(_eventsLeft == 1)
+            sign = (_arcLeft[i] > 0) ? 1 : (_arcLeft[i] < 0) ? -1 : 0;
+        if(sign == 0)
+            continue;
+
+        _arcLeft[i] -= sign;
+        _position[i] += sign;
+        _microIndex[i] += sign;
+        axisMask |= (1 << i);
+        if((sign > 0) == (forwardDirs[i] != 0))
+            dirMask |= (1 << i);
+        else
+            dirMask &= ~(1 << i);
+    }
+
+    if(dirMask != _dirMask){
+        _dirMask = dirMask;
+        motorGroup.step(axisMask, dirMask);
+    }
+    else{
+        motorGroup.step(axisMask);
+    }
+
+    // Still short of the end, the arc gets another last event
+    if((_eventsLeft == 1) && (_arcLeft[0] || _arcLeft[1]))
+        _eventsLeft++;
+    return axisMask;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Does one tick of homing. Every axis runs on its own phase accumulator and checks its debounced sensor on each
+ *         of its step events, before stepping. The magnet is measured between the edges latched on the way across it.
+ *         Once every axis is done the blocks queued in the meantime are picked up.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::homingTick(void)
+{
+    uint8_t axisMask = 0;
+    uint8_t active = 0;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        HomingAxis* axis = &_homingAxes[i];
+        const HomingConfig* config = &_homingConfig[i];
+
+        if(axis->state >= HOMING_DONE)
+            continue;
+        active = 1;
+
+        // Ramp up to the target rate, or down to rest before going on to the next part
+        uint32_t change = config->accel >> 8;
+        if(axis->stopping){
+            if(axis->rate <= change){
+                homingNext(i);
+                continue;
+            }
+            axis->rate -= change;
+        }
+        else if(axis->rate < axis->targetRate){
+            axis->rate = (axis->targetRate - axis->rate > change) ? axis->rate + change : axis->targetRate;
+        }
+
+        uint32_t lastPhase = axis->phase;
+        axis->phase += axis->rate;
+        if(axis->phase >= lastPhase)
+            continue;
+
+        // Step event, the sensor tells about the position the axis is about to leave
+        uint8_t detected = (_endstops >> i) & 0x01;
+        int8_t sign = (axis->dir == forwardDirs[i]) ? 1 : -1;
+        if(++axis->count > config->maxSteps){
+            axis->state = HOMING_FAILED;
+            continue;
+        }
+
+        switch(axis->state){
+            case HOMING_SEEK:
+                if(detected)
+                    axis->stopping = 1;
+                break;
+
+            case HOMING_BACKOFF:
+                // Count the steps from the last one in the magnet, whichever side of it the seek stopped on
+                if(detected){
+                    axis->seen = 1;
+                    axis->count = 0;
+                }
+                else if(axis->seen && (axis->count >= config->backoffSteps)){
+                    axis->stopping = 1;
+                }
+                break;
+
+            case HOMING_APPROACH:
+                if(!detected)
+                    break;
+                axis->state = HOMING_MEASURE;
+                axis->count = 0;
+                // fall through
+
+            case HOMING_MEASURE:
+                if(detected)
+                    break;
+
+                // Past the far edge. The magnet covers the positions from the near edge up to before the far one,
+                // the middle one is width/2 + 1 back from the far edge. Turn around without stepping so the direction
+                // settles first.
+                axis->width = labs(_leaveAt[i] - _enterAt[i]);
+                axis->target = _leaveAt[i] - sign * (long)((axis->width / 2) + 1);
+                axis->state = HOMING_CENTER;
+                axis->dir ^= 1;
+                axis->count = 0;
+                axis->phase = 0;
+                setDirs(homingDirs());
+                continue;
+
+            case HOMING_CENTER:
+                if(_position[i] + sign == axis->target){
+                    axis->state = HOMING_DONE;
+                    axis->rate = 0;
+                }
+                break;
+        }
+
+        _position[i] += sign;
+        _microIndex[i] += sign;
+        axisMask |= (1 << i);
+    }
+
+    motorGroup.step(axisMask);
+    STEP_TIMING_STEPPED(axisMask);
+    Telemetry::getInstance()->stepped(axisMask);
+
+    if(active)
+        return;
+
+    // Every axis is done, there's no telling where the blocks queued on a failed homing would go
+    _homing = 0;
+    if(homingState() == HOMING_FAILED){
+        MotionQueue::getInstance()->clear();
+    }
+    else{
+        // The edges it measured move along, they're where the magnets are from now on
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+            long shift = _homingConfig[i].homePosition - _position[i];
+            _position[i] += shift;
+            _enterAt[i] += shift;
+            _leaveAt[i] += shift;
+        }
+    }
+
+    if(!load())
+        _busy = 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves an axis that came to rest on to the next part of homing
+ *
+ *  @param[in] axis Index of the axis
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepEngine::homingNext(uint8_t axis)
+{
+    HomingAxis* homing = &_homingAxes[axis];
+    const HomingConfig* config = &_homingConfig[axis];
+
+    if(homing->state == HOMING_SEEK){
+        homing->state = HOMING_BACKOFF;
+        homing->targetRate = config->seekRate >> 2;        // Slower so stopping doesn't take it much further than backoffSteps
+        homing->rate = 0;
+        homing->seen = 0;
+    }
+    else{
+        homing->state = HOMING_APPROACH;
+        homing->targetRate = config->slowRate;
+        homing->rate = config->slowRate;
+    }
+
+    homing->dir ^= 1;
+    homing->stopping = 0;
+    homing->count = 0;
+    homing->phase = 0;
+    setDirs(homingDirs());
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gathers the homing directions of every axis
+ *
+ *  @return Direction pin value of axis i in bit i
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t StepEngine::homingDirs(void)
+{
+    uint8_t dirMask = 0;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(_homingAxes[i].dir)
+            dirMask |= (1 << i);
+    }
+    return dirMask;
+}
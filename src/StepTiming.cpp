@@ -0,0 +1,175 @@
+#include "../inc/StepTiming.hpp"
+#include <stdio.h>
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+StepTiming* StepTiming::instance;
+
+StepTiming* StepTiming::getInstance()
+{
+    if(instance == NULL){
+        instance = new StepTiming();
+    }
+    return instance;
+}
+
+StepTiming::StepTiming(void)
+{
+    reset();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Clears everything recorded so far
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepTiming::reset(void)
+{
+    halNoInterrupts();
+    _isrCount = 0;
+    _isrMaxUs = 0;
+    _isrTotalUs = 0;
+    _commandedRate = 0;
+    memset(_axes, 0, sizeof(_axes));
+    halInterrupts();
+}
+
+//=========================================//
+//              INTERRUPT SIDE             //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Marks the start of the step interrupt
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepTiming::isrEnter(void)
+{
+    _isrStart = halMicros();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Marks the end of the step interrupt
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepTiming::isrExit(void)
+{
+    unsigned long duration = halMicros() - _isrStart;
+
+    _isrCount++;
+    _isrTotalUs += duration;
+    if(duration > _isrMaxUs)
+        _isrMaxUs = duration;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Records the axes that just stepped
+ *
+ *  @param[in] axisMask Axis i stepped if bit i is set
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepTiming::stepped(uint8_t axisMask)
+{
+    unsigned long now = halMicros();
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        if(!(axisMask & (1 << i)))
+            continue;
+
+        StepTimingAxis* axis = &_axes[i];
+        if(axis->steps++ == 0){
+            axis->firstUs = now;
+            axis->lastUs = now;
+            axis->minInterval = 0xFFFFFFFF;
+            continue;
+        }
+
+        unsigned long interval = now - axis->lastUs;
+        axis->lastUs = now;
+        if(interval < axis->minInterval)
+            axis->minInterval = interval;
+        if(interval > axis->maxInterval)
+            axis->maxInterval = interval;
+
+        uint8_t bucket = 0;
+        while((interval >>= 1) && (bucket < STEP_TIMING_BUCKETS - 1))
+            bucket++;
+        axis->histogram[bucket]++;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Records the cruise rate of a block being loaded
+ *
+ *  @param[in] rate Step events per tick [Q0.32]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepTiming::commanded(uint32_t rate)
+{
+    if(rate > _commandedRate)
+        _commandedRate = rate;
+}
+
+//=========================================//
+//                 REPORT                  //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Writes what was recorded as one line of JSON, e.g.
+ *         {"isr":{"count":..,"max_us":..,"avg_us":..},"commanded_hz":..,"axes":[{"steps":..,"achieved_hz":..,
+ *         "min_us":..,"max_us":..,"hist":[..]},..]}
+ *         The achieved rate is the average over every step the axis took.
+ *
+ *  @param[out] buffer Where the line is written, always NULL terminated
+ *  @param[in]  size   Size of the buffer
+ *
+ *  @return Length of the line, it was cut short if it's size or more
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned int StepTiming::report(char* buffer, unsigned int size)
+{
+    StepTimingAxis axes[STEP_ENGINE_AXES];
+    unsigned long isrCount, isrMaxUs, isrTotalUs;
+    uint32_t commandedRate;
+    unsigned int length = 0;
+
+    // Take a consistent copy, the interrupt keeps recording
+    halNoInterrupts();
+    memcpy(axes, _axes, sizeof(axes));
+    isrCount = _isrCount;
+    isrMaxUs = _isrMaxUs;
+    isrTotalUs = _isrTotalUs;
+    commandedRate = _commandedRate;
+    halInterrupts();
+
+    // Every write is bounded by the room left, length keeps counting past the end like snprintf
+    #define REPORT(...) length += snprintf(buffer + ((length < size) ? length : size), (length < size) ? (size - length) : 0, __VA_ARGS__)
+
+    REPORT("{\"isr\":{\"count\":%lu,\"max_us\":%lu,\"avg_us\":%lu},", isrCount, isrMaxUs, isrCount ? (isrTotalUs / isrCount) : 0UL);
+    REPORT("\"commanded_hz\":%lu,\"axes\":[", (unsigned long)(((uint64_t)commandedRate * STEP_TICK_HZ) >> 32));
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        StepTimingAxis* axis = &axes[i];
+        unsigned long span = axis->lastUs - axis->firstUs;
+        unsigned long achieved = (span != 0) ? (unsigned long)(((uint64_t)(axis->steps - 1) * 1000000UL) / span) : 0UL;
+
+        REPORT("%s{\"steps\":%lu,\"achieved_hz\":%lu,\"min_us\":%lu,\"max_us\":%lu,\"hist\":[", i ? "," : "",
+               axis->steps, achieved, (axis->steps > 1) ? axis->minInterval : 0UL, axis->maxInterval);
+        for(uint8_t b = 0; b < STEP_TIMING_BUCKETS; b++)
+            REPORT("%s%lu", b ? "," : "", axis->histogram[b]);
+        REPORT("]}");
+    }
+    REPORT("]}");
+
+    #undef REPORT
+
+    if((size != 0) && (length >= size))
+        buffer[size - 1] = '\0';
+    return length;
+}
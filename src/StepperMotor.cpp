@@ -1,4 +1,5 @@
 #include "../inc/StepperMotor.hpp"
+#include "../inc/Hal.hpp"
 
 /**
  * ----------------------------------------------------------------------------------------------------------------------------------
@@ -14,26 +15,26 @@ StepperMotor::StepperMotor(){
  *  @brief Creates a stepper motor class
  * ----------------------------------------------------------------------------------------------------------------------------------
 */
-StepperMotor::StepperMotor(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, uint8_t en_value, uint8_t endstop_pin, pinSetup_t endstop_pin_setup = NONE)
+StepperMotor::StepperMotor(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, uint8_t en_value, uint8_t endstop_pin, pinSetup_t endstop_pin_setup)
 {
     _dir_pin = dir_pin;
     _step_pin = step_pin;
     _en_pin = en_pin;
     _endstop_pin = endstop_pin;
 
-    pinMode(_dir_pin, OUTPUT);
-    pinMode(_step_pin, OUTPUT);
-    pinMode(_en_pin, OUTPUT);
+    halPinMode(_dir_pin, OUTPUT);
+    halPinMode(_step_pin, OUTPUT);
+    halPinMode(_en_pin, OUTPUT);
     
-    if((en_value!=0) || (en_value!=1))
+    if((en_value!=0) && (en_value!=1))
         en_value = 0;
 
-    digitalWrite(_en_pin, en_value);
+    halDigitalWrite(_en_pin, en_value);
 
     if (endstop_pin_setup == NONE)
-        pinMode(_endstop_pin, INPUT);
+        halPinMode(_endstop_pin, INPUT);
     else if (endstop_pin_setup == PULLUP_ENDSTOP)
-        pinMode(_endstop_pin, INPUT_PULLUP);
+        halPinMode(_endstop_pin, INPUT_PULLUP);
 }
 
 /**
@@ -41,26 +42,61 @@ StepperMotor::StepperMotor(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, ui
  *  @brief Initializes stepper motor class
  * ----------------------------------------------------------------------------------------------------------------------------------
 */
-void StepperMotor::init(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, uint8_t en_value, uint8_t endstop_pin, pinSetup_t endstop_pin_setup = NONE)
+void StepperMotor::init(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, uint8_t en_value, uint8_t endstop_pin, pinSetup_t endstop_pin_setup)
 {
     _dir_pin = dir_pin;
     _step_pin = step_pin;
     _en_pin = en_pin;
     _endstop_pin = endstop_pin;
 
-    pinMode(_dir_pin, OUTPUT);
-    pinMode(_step_pin, OUTPUT);
-    pinMode(_en_pin, OUTPUT);
+    halPinMode(_dir_pin, OUTPUT);
+    halPinMode(_step_pin, OUTPUT);
+    halPinMode(_en_pin, OUTPUT);
     
-    if((en_value!=0) || (en_value!=1))
+    if((en_value!=0) && (en_value!=1))
         en_value = 0;
 
-    digitalWrite(_en_pin, en_value);
+    halDigitalWrite(_en_pin, en_value);
         
     if (endstop_pin_setup == NONE)
-        pinMode(_endstop_pin, INPUT);
+        halPinMode(_endstop_pin, INPUT);
     else if (endstop_pin_setup == PULLUP_ENDSTOP)
-        pinMode(_endstop_pin, INPUT_PULLUP);
+        halPinMode(_endstop_pin, INPUT_PULLUP);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Initializes the mode select pins of the driver and sets its microstep resolution
+ *
+ *  @param[in] ms1_pin   MS1 pin of the driver
+ *  @param[in] ms2_pin   MS2 pin of the driver
+ *  @param[in] ms3_pin   MS3 pin of the driver
+ *  @param[in] mode_bits Level of MS1 in bit 0, MS2 in bit 1 and MS3 in bit 2
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepperMotor::initMicrostep(uint8_t ms1_pin, uint8_t ms2_pin, uint8_t ms3_pin, uint8_t mode_bits)
+{
+    _ms_pins[0] = ms1_pin;
+    _ms_pins[1] = ms2_pin;
+    _ms_pins[2] = ms3_pin;
+
+    for(uint8_t i = 0; i < 3; i++)
+        halPinMode(_ms_pins[i], OUTPUT);
+
+    setMicrostep(mode_bits);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Sets the microstep resolution of the driver. Only switch on a full step, or the driver's position shifts.
+ *
+ *  @param[in] mode_bits Level of MS1 in bit 0, MS2 in bit 1 and MS3 in bit 2
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void StepperMotor::setMicrostep(uint8_t mode_bits)
+{
+    for(uint8_t i = 0; i < 3; i++)
+        halDigitalWrite(_ms_pins[i], (mode_bits >> i) & 0x01);
 }
 
 /**
@@ -70,7 +106,7 @@ void StepperMotor::init(uint8_t dir_pin, uint8_t step_pin, uint8_t en_pin, uint8
 */
 void StepperMotor::enable(void)
 {
-    digitalWrite(_en_pin, EN_MOTOR_ON);
+    halDigitalWrite(_en_pin, EN_MOTOR_ON);
 }
 
 /**
@@ -80,7 +116,7 @@ void StepperMotor::enable(void)
 */
 void StepperMotor::disable(void)
 {
-    digitalWrite(_en_pin, EN_MOTOR_OFF);
+    halDigitalWrite(_en_pin, EN_MOTOR_OFF);
 }
 
 /**
@@ -91,7 +127,7 @@ void StepperMotor::disable(void)
  * ----------------------------------------------------------------------------------------------------------------------------------
  */
 void StepperMotor::setDir(uint8_t pinVal){
-    digitalWrite(_dir_pin, pinVal);
+    halDigitalWrite(_dir_pin, pinVal);
 }
 
 /**
@@ -139,8 +175,8 @@ uint8_t StepperMotor::step(uint8_t dir)
  * ----------------------------------------------------------------------------------------------------------------------------------
 */
 void StepperMotor::hardStep(void){
-    digitalWrite(_step_pin, HIGH);
-    digitalWrite(_step_pin, LOW);
+    halDigitalWrite(_step_pin, HIGH);
+    halDigitalWrite(_step_pin, LOW);
 }
 
 /**
@@ -152,10 +188,10 @@ void StepperMotor::hardStep(void){
 */
 void StepperMotor::hardStep(uint8_t dir)
 {
-    digitalWrite(_dir_pin, dir);
+    halDigitalWrite(_dir_pin, dir);
 
-    digitalWrite(_step_pin, HIGH);
-    digitalWrite(_step_pin, LOW);
+    halDigitalWrite(_step_pin, HIGH);
+    halDigitalWrite(_step_pin, LOW);
 }
 
 /**
@@ -168,10 +204,5 @@ void StepperMotor::hardStep(uint8_t dir)
 */
 uint8_t StepperMotor::endstop(void)
 {
-#ifdef DEBUG
-    Serial.print("Endstop: ");
-    Serial.println(!digitalRead(_end_pin));
-#endif
-
-    return !digitalRead(_endstop_pin); // Inverted because 0 is active since endstops are setup as input pullup
+    return !halDigitalRead(_endstop_pin); // Inverted because 0 is active since endstops are setup as input pullup
 }
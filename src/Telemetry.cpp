@@ -0,0 +1,161 @@
+#include "../inc/Telemetry.hpp"
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+Telemetry* Telemetry::instance;
+
+Telemetry* Telemetry::getInstance()
+{
+    if(instance == NULL){
+        instance = new Telemetry();
+    }
+    return instance;
+}
+
+Telemetry::Telemetry(void)
+{
+    _ticks = 0;
+    _isrCounts = 0;
+    _isrMax = 0;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _steps[i] = 0;
+
+    memset(&_current, 0, sizeof(_current));
+    memset(_records, 0, sizeof(_records));
+    _periodStart = halMicros();
+    _count = 0;
+    _dumpNext = 0;
+    _dumpEnd = 0;
+}
+
+//=========================================//
+//                COUNTERS                 //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Notes how many blocks the MotionQueue holds, right after one was pushed
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Telemetry::queued(uint8_t blocks)
+{
+    if(blocks > _current.blocksHigh)
+        _current.blocksHigh = blocks;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Notes how many commands the CommandQueue holds, right after receiving
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Telemetry::commands(uint8_t count)
+{
+    if(count > _current.commandsHigh)
+        _current.commandsHigh = count;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Notes a text command parsed
+ *
+ *  @param[in] us Time its bytes took to parse all together [us]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Telemetry::parsed(unsigned long us)
+{
+    _current.parseUs += us;
+    if(us > _current.parseMax)
+        _current.parseMax = (us > 0xFFFF) ? 0xFFFF : us;
+    _current.parseCount++;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Closes the current record into the ring once its period is up. Call it regularly from the main loop.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Telemetry::service(void)
+{
+    unsigned long now = halMicros();
+    if(now - _periodStart < TELEMETRY_PERIOD_MS * 1000UL)
+        return;
+
+    TelemetryRecord* record = &_records[_count & (TELEMETRY_RECORDS - 1)];
+    *record = _current;
+    record->sequence = _count;
+    unsigned long periodMs = (now - _periodStart) / 1000UL;
+    record->periodMs = (periodMs > 0xFFFF) ? 0xFFFF : periodMs;
+
+    // Take the interrupt's counters and start them over in one go, so no tick falls between two records
+    halNoInterrupts();
+    record->ticks = _ticks;
+    record->isrCounts = _isrCounts;
+    record->isrMax = _isrMax;
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++){
+        record->steps[i] = _steps[i];
+        _steps[i] = 0;
+    }
+    _ticks = 0;
+    _isrCounts = 0;
+    _isrMax = 0;
+    halInterrupts();
+
+    memset(&_current, 0, sizeof(_current));
+    _periodStart = now;
+    _count++;
+}
+
+//=========================================//
+//                  DUMP                   //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts sending every record in the ring, oldest first. Returns right away, in place of any dump under way.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Telemetry::dump(void)
+{
+    _dumpEnd = _count;
+    _dumpNext = (_count > TELEMETRY_RECORDS) ? (uint16_t)(_count - TELEMETRY_RECORDS) : 0;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets how many records are left to send
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Telemetry::dumping(void)
+{
+    // The ones overwritten since the dump started are gone
+    if((uint16_t)(_count - _dumpNext) > TELEMETRY_RECORDS)
+        _dumpNext = _count - TELEMETRY_RECORDS;
+
+    uint16_t left = _dumpEnd - _dumpNext;
+    return (left > TELEMETRY_RECORDS) ? 0 : left;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Gets the next record to send
+ *
+ *  @param[out] record Where to copy it
+ *
+ *  @return 0 if there's none left,
+ *          1 if the record was copied,
+ *          2 if the passed pointer is a NULL pointer
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Telemetry::next(TelemetryRecord* record)
+{
+    if(record == NULL)
+        return 2;
+    if(dumping() == 0)
+        return 0;
+
+    *record = _records[_dumpNext & (TELEMETRY_RECORDS - 1)];
+    _dumpNext++;
+    return 1;
+}
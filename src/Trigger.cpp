@@ -0,0 +1,326 @@
+#include "../inc/Trigger.hpp"
+#include "../inc/FastStepperMotor.hpp"
+
+typedef FastPin<TRIGGER_SHUTTER_PIN> ShutterPin;
+typedef FastPin<TRIGGER_FOCUS_PIN> FocusPin;
+
+//=========================================//
+//               INITIALIZERS              //
+//=========================================//
+
+Trigger* Trigger::instance;
+
+Trigger* Trigger::getInstance()
+{
+    if(instance == NULL){
+        instance = new Trigger();
+    }
+    return instance;
+}
+
+Trigger::Trigger(void)
+{
+    halPinMode(TRIGGER_SHUTTER_PIN, OUTPUT);
+    halPinMode(TRIGGER_FOCUS_PIN, OUTPUT);
+    ShutterPin::low();
+    FocusPin::low();
+
+    _mode = TRIGGER_NONE;
+    _focusHold = 0;
+    _pulseLeft = 0;
+    _pulseOn = 0;
+    _fired = 0;
+    _blocked = 0;
+    setPulse(TRIGGER_DEFAULT_PULSE_US);
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _shotPosition[i] = 0;
+}
+
+//=========================================//
+//               MAIN LOOP SIDE            //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Schedules shots on the step counts of an axis: at first, first + spacing and so on. Each fires in the tick
+ *         the axis steps onto or over its count, whichever way it's going. Replaces whatever was scheduled.
+ *
+ *  @param[in] axis    Index of the axis
+ *  @param[in] first   Position of the first shot [Steps]
+ *  @param[in] spacing Steps between shots, its sign is the way the axis goes
+ *  @param[in] count   Number of shots
+ *
+ *  @return 0 if there's nothing to schedule,
+ *          1 if the shots were scheduled
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Trigger::atSteps(uint8_t axis, long first, long spacing, unsigned long count)
+{
+    if((axis >= STEP_ENGINE_AXES) || (count == 0) || ((spacing == 0) && (count > 1)))
+        return 0;
+
+    halNoInterrupts();
+    uint8_t running = StepEngine::getInstance()->busy() || busy();
+    _axis = axis;
+    _last = StepEngine::getInstance()->isrPosition(axis);
+    _next = first;
+    _spacing = spacing;
+    _remaining = count;
+    _mode = TRIGGER_STEPS;
+    schedule(running);
+    halInterrupts();
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Schedules shots on a fixed interval, the first one an interval from now. Replaces whatever was scheduled.
+ *
+ *  @param[in] intervalUs Time between shots, rounded to the tick [us]
+ *  @param[in] count      Number of shots
+ *
+ *  @return 0 if there's nothing to schedule,
+ *          1 if the shots were scheduled
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Trigger::every(unsigned long intervalUs, unsigned long count)
+{
+    unsigned long ticks = (intervalUs + STEP_TICK_US / 2) / STEP_TICK_US;
+
+    if((ticks == 0) || (count == 0))
+        return 0;
+
+    halNoInterrupts();
+    uint8_t running = StepEngine::getInstance()->busy() || busy();
+    _interval = ticks;
+    _countdown = ticks;
+    _remaining = count;
+    _mode = TRIGGER_INTERVAL;
+    schedule(running);
+    halInterrupts();
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Schedules a single shot on the next tick. Replaces whatever was scheduled.
+ *
+ *  @return 1, the shot was scheduled
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Trigger::shoot(void)
+{
+    halNoInterrupts();
+    uint8_t running = StepEngine::getInstance()->busy() || busy();
+    _interval = 1;
+    _countdown = 1;
+    _remaining = 1;
+    _mode = TRIGGER_INTERVAL;
+    schedule(running);
+    halInterrupts();
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Drops the shots scheduled. A pulse already on still ends on time.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Trigger::cancel(void)
+{
+    halNoInterrupts();
+    _mode = TRIGGER_NONE;
+    if(!_pulseOn)
+        FocusPin::low();
+    halInterrupts();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Raises the focus line if it's held and makes sure the timer runs. Called with the interrupt held off.
+ *
+ *  @param[in] running Set if the step engine or the trigger already kept the timer running, starting it again
+ *                     would restart the tick it's in
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Trigger::schedule(uint8_t running)
+{
+    if(_focusHold)
+        FocusPin::high();
+
+    if(!running)
+        halTimerStart();
+}
+
+//=========================================//
+//              INTERRUPT SIDE             //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Does one tick of the trigger, right after the step engine's so the positions are the ones just stepped to.
+ *         Called from the timer interrupt every STEP_TICK_US.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Trigger::tick(void)
+{
+    if((_pulseLeft != 0) && (--_pulseLeft == 0)){
+        _pulseOn = 0;
+        ShutterPin::low();
+        if(!_focusHold || (_mode == TRIGGER_NONE))
+            FocusPin::low();
+    }
+
+    StepEngine* engine;
+    long position, last;
+    switch(_mode){
+        case TRIGGER_STEPS:
+            // A pulse in a coarse microstep mode moves several steps, so stepping over the count fires too
+            engine = StepEngine::getInstance();
+            position = engine->isrPosition(_axis);
+            last = _last;
+            _last = position;
+            if(!((position == _next) || ((last < _next) && (position > _next)) || ((last > _next) && (position < _next))))
+                return;
+            _next += _spacing;
+            break;
+
+        case TRIGGER_INTERVAL:
+            if(--_countdown != 0)
+                return;
+            _countdown = _interval;
+            engine = StepEngine::getInstance();
+            break;
+
+        default:
+            return;
+    }
+
+    // A shot is due
+    if(engine->isrSteady() && (_pulseLeft == 0))
+        fire(engine);
+    else
+        _blocked++;
+
+    if(--_remaining == 0){
+        _mode = TRIGGER_NONE;
+        if(_pulseLeft == 0)
+            FocusPin::low();
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Starts the pulse of a shot and latches where every axis is
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Trigger::fire(StepEngine* engine)
+{
+    FocusPin::high();
+    ShutterPin::high();
+    _pulseLeft = _pulse;
+    _pulseOn = 1;
+    _fired++;
+
+    for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+        _shotPosition[i] = engine->isrPosition(i);
+}
+
+//=========================================//
+//           SETTERS AND GETTERS           //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set how long the shutter line is held up on a shot, rounded up to the tick
+ *
+ *  @param[in] pulseUs [us]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Trigger::setPulse(unsigned long pulseUs)
+{
+    unsigned long ticks = (pulseUs + STEP_TICK_US - 1) / STEP_TICK_US;
+
+    halNoInterrupts();
+    _pulse = (ticks == 0) ? 1 : ticks;
+    halInterrupts();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Set if the focus line is held up while shots are scheduled, keeping the camera awake
+ *
+ *  @param[in] hold 1 to hold it, 0 to only raise it with the shutter
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+void Trigger::setFocusHold(uint8_t hold)
+{
+    halNoInterrupts();
+    _focusHold = hold;
+    if(hold && (_mode != TRIGGER_NONE))
+        FocusPin::high();
+    else if(!hold && !_pulseOn)
+        FocusPin::low();
+    halInterrupts();
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Probes if shots are scheduled or a pulse is on, the timer has to keep running until neither is
+ *
+ *  @return 1 if busy,
+ *          0 if idle
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+uint8_t Trigger::busy(void)
+{
+    // The pulse is read through its flag, the interrupt could change a multi-byte count in the middle of reading it
+    return (_mode != TRIGGER_NONE) || _pulseOn;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get how many shots were fired
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long Trigger::getFired(void)
+{
+    halNoInterrupts();
+    unsigned long fired = _fired;
+    halInterrupts();
+
+    return fired;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get how many shots were dropped because the motors were ramping or the last pulse wasn't over
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+unsigned long Trigger::getBlocked(void)
+{
+    halNoInterrupts();
+    unsigned long blocked = _blocked;
+    halInterrupts();
+
+    return blocked;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Get where an axis was on the last shot
+ *
+ *  @param[in] axis Index of the axis
+ *
+ *  @return Position [Steps]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+long Trigger::getShotPosition(uint8_t axis)
+{
+    halNoInterrupts();
+    long position = _shotPosition[axis];
+    halInterrupts();
+
+    return position;
+}
@@ -1,10 +1,115 @@
+#include "../inc/MotionProcessor.hpp"
+#include "../inc/CommandQueue.hpp"
+#include "../inc/CommandParser.hpp"
+#include "../inc/CommandExecutor.hpp"
+#include "../inc/FrameLink.hpp"
+#include "../inc/MotorPower.hpp"
+#include "../inc/Panorama.hpp"
+#include "../inc/Sequencer.hpp"
+#include "../inc/Snapshot.hpp"
+#include "../inc/StallMonitor.hpp"
+#include "../inc/Telemetry.hpp"
+#include "../inc/Trigger.hpp"
 
+#define SERIAL_BAUD     115200
 
+/**
+ * @brief Writes a reply frame of the binary protocol out
+ */
+void sendFrame(const uint8_t* data, uint8_t length)
+{
+    Serial.write(data, length);
+}
+
+/**
+ * @brief Gets the bytes the serial transmit buffer takes without waiting
+ */
+uint8_t sendRoom(void)
+{
+    return Serial.availableForWrite();
+}
+
+CommandQueue commands;
+CommandParser parser(&commands);
+FrameLink link(&commands, sendFrame, sendRoom);
+CommandExecutor* executor;
+Sequencer* sequencer;
+Panorama* panorama;
+unsigned long parseUs;      // Time the bytes of the text command under way took to parse so far [us]
+
+/**
+ * @brief Parses the bytes received so far into the command queue, as text commands or binary frames.
+ * A frame starts with FRAME_SYNC, which no text command has, and its bytes go to the FrameLink until it ends.
+ * A text line cut short by a frame is dropped, so the frame doesn't take the queue slot the line was written into.
+ * Bytes are left in the serial buffer while the queue is full, and a binary host is told when room frees up.
+ * Also registered with the MotionProcessor, so it keeps running while a command waits for room,
+ * and so does the telemetry.
+ */
+void serviceSerial(void)
+{
+    Telemetry* telemetry = Telemetry::getInstance();
+
+    while(Serial.available() && !commands.isFull()){
+        uint8_t c = Serial.read();
+        if(link.receiving() || (c == FRAME_SYNC)){
+            if(!link.receiving()){
+                parser.reset();
+                parseUs = 0;
+            }
+            link.receive(c);
+            continue;
+        }
+
+        unsigned long start = halMicros();
+        uint8_t result = parser.parse(c);
+        parseUs += halMicros() - start;
+        if(result != PARSE_NONE){
+            telemetry->parsed(parseUs);
+            parseUs = 0;
+        }
+    }
+
+    telemetry->commands(commands.numCommands());
+    telemetry->service();
+    link.service();
+}
+
+/**
+ * @brief Takes the shots of a shoot-move-shoot sequence
+ */
+void shootFrame(unsigned long shot)
+{
+    (void)shot;
+    Trigger::getInstance()->shoot();
+}
 
 void setup()
 {
+    Serial.begin(SERIAL_BAUD);
+
+    MotionProcessor* motion = MotionProcessor::getInstance();
+    motion->registerTryAndExecCallback(serviceSerial);
+    sequencer = new Sequencer(motion);
+    sequencer->registerShotCallback(shootFrame);
+    panorama = new Panorama(motion);
+    executor = new CommandExecutor(motion, sequencer, panorama);
+
+    // After a power cycle at rest the position is taken back, G28 then only checks it
+    motion->restore();
 }
 
 void loop()
 {
-}
\ No newline at end of file
+    serviceSerial();
+    MotorPower::getInstance()->service();
+    sequencer->service();
+    panorama->service();
+    Snapshot::getInstance()->service();
+    StallMonitor::getInstance()->service();
+
+    const Command* cmd = commands.borrowCommand();
+    if(cmd != NULL){
+        executor->execute(cmd);
+        commands.releaseCommand();
+    }
+}
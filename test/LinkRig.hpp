@@ -0,0 +1,223 @@
+#ifndef LINKRIG_HPP
+#define LINKRIG_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../inc/Hal.hpp"
+#include "../inc/CommandParser.hpp"
+#include "../inc/FrameLink.hpp"
+#include "../host/FrameHost.hpp"
+
+/**
+ * Serial line between a host and the board, on the simulator's virtual clock. Each way moves
+ * one byte every LINK_BYTE_US, 8N1 at LINK_BAUD. The board has the Uno's 64 byte receive and
+ * transmit buffers, a byte arriving at a full receive buffer is lost, like on the board. The
+ * host's buffers are as large as a computer's. Bytes can be corrupted on the wire, one in a
+ * given number each way, picked by a fixed random sequence.
+ */
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define LINK_BAUD           115200UL
+#define LINK_BITS_PER_BYTE  10              // 8N1, with start and stop bits
+#define LINK_BOARD_BUFFER   64              // The Uno's serial buffers [Bytes]
+#define LINK_HOST_BUFFER    4096            // [Bytes]
+
+typedef struct {
+    uint8_t data[LINK_HOST_BUFFER];
+    unsigned int size;                      // [Bytes]
+    unsigned int head;
+    unsigned int count;
+    unsigned int peak;                      // Most bytes it held at once
+    unsigned long lost;                     // Bytes that arrived when it was full
+} LinkBuffer;
+
+typedef struct {
+    LinkBuffer hostTx;
+    LinkBuffer boardRx;
+    LinkBuffer boardTx;
+    LinkBuffer hostRx;
+    unsigned long start;                    // When the line came up [us]
+    unsigned long moved;                    // Byte times gone by since, each way carries a byte in each
+    unsigned long corruptEvery;             // One byte in this many gets a bit flipped, 0 for none
+    unsigned long corrupted;
+    unsigned long bytes[2];                 // Bytes sent to the board and back to the host
+    uint32_t seed;
+} Link;
+
+static Link simLink;
+
+//=========================================//
+//                 BUFFERS                 //
+//=========================================//
+
+static inline void linkPut(LinkBuffer* buffer, uint8_t c)
+{
+    if(buffer->count == buffer->size){
+        buffer->lost++;
+        return;
+    }
+    buffer->data[(buffer->head + buffer->count++) % buffer->size] = c;
+    if(buffer->count > buffer->peak)
+        buffer->peak = buffer->count;
+}
+
+static inline int linkGet(LinkBuffer* buffer)
+{
+    if(buffer->count == 0)
+        return -1;
+    uint8_t c = buffer->data[buffer->head];
+    buffer->head = (buffer->head + 1) % buffer->size;
+    buffer->count--;
+    return c;
+}
+
+//=========================================//
+//                  LINE                   //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Brings the line up, empty, from now on the simulator's clock
+ *
+ *  @param[in] corruptEvery One byte in this many gets a bit flipped on the wire, 0 for a clean line
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline void linkReset(unsigned long corruptEvery)
+{
+    memset(&simLink, 0, sizeof(simLink));
+    simLink.hostTx.size = LINK_HOST_BUFFER;
+    simLink.boardRx.size = LINK_BOARD_BUFFER;
+    simLink.boardTx.size = LINK_BOARD_BUFFER;
+    simLink.hostRx.size = LINK_HOST_BUFFER;
+    simLink.start = halSimTime();
+    simLink.corruptEvery = corruptEvery;
+    simLink.seed = 12345;
+}
+
+static inline uint8_t linkWire(uint8_t c)
+{
+    if(simLink.corruptEvery == 0)
+        return c;
+
+    simLink.seed = simLink.seed * 1664525UL + 1013904223UL;
+    if((simLink.seed >> 8) % simLink.corruptEvery != 0)
+        return c;
+    simLink.corrupted++;
+    return c ^ (1 << ((simLink.seed >> 28) & 0x07));
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves the bytes the line carried up to now on the simulator's clock, each way
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline void linkRun(void)
+{
+    unsigned long due = (unsigned long)((unsigned long long)(halSimTime() - simLink.start) * LINK_BAUD / (LINK_BITS_PER_BYTE * 1000000ULL));
+
+    for(; simLink.moved < due; simLink.moved++){
+        int c = linkGet(&simLink.hostTx);
+        if(c >= 0){
+            linkPut(&simLink.boardRx, linkWire((uint8_t)c));
+            simLink.bytes[0]++;
+        }
+        c = linkGet(&simLink.boardTx);
+        if(c >= 0){
+            linkPut(&simLink.hostRx, linkWire((uint8_t)c));
+            simLink.bytes[1]++;
+        }
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves bytes each way at once, as many as the other end has room for, like an in-process pipe. No clock, no loss.
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline void linkPipe(void)
+{
+    while((simLink.hostTx.count > 0) && (simLink.boardRx.count < simLink.boardRx.size)){
+        linkPut(&simLink.boardRx, (uint8_t)linkGet(&simLink.hostTx));
+        simLink.bytes[0]++;
+    }
+    while((simLink.boardTx.count > 0) && (simLink.hostRx.count < simLink.hostRx.size)){
+        linkPut(&simLink.hostRx, (uint8_t)linkGet(&simLink.boardTx));
+        simLink.bytes[1]++;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Time since the line came up [us]
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline unsigned long linkTime(void)
+{
+    return halSimTime() - simLink.start;
+}
+
+//=========================================//
+//                  ENDS                   //
+//=========================================//
+
+static inline void linkHostSend(const uint8_t* data, uint8_t length)
+{
+    for(uint8_t i = 0; i < length; i++)
+        linkPut(&simLink.hostTx, data[i]);
+}
+
+static inline void linkBoardSend(const uint8_t* data, uint8_t length)
+{
+    for(uint8_t i = 0; i < length; i++)
+        linkPut(&simLink.boardTx, data[i]);
+}
+
+static inline uint8_t linkBoardRoom(void)
+{
+    return LINK_BOARD_BUFFER - simLink.boardTx.count;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Hands the host the bytes it received
+ *
+ *  @param[in] host Host side of the binary protocol
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline void linkHostRead(FrameHost* host)
+{
+    int c;
+    while((c = linkGet(&simLink.hostRx)) >= 0)
+        host->receive((uint8_t)c, linkTime() / 1000);
+    host->poll(linkTime() / 1000);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Reads the board's receive buffer like serviceSerial() in main.ino, frames to the FrameLink and text to the
+ *         parser, leaving bytes in the buffer while the queue is full. A frame drops the text line it cuts short.
+ *
+ *  @param[in] queue  Command queue of the board
+ *  @param[in] parser Text parser of the board
+ *  @param[in] link   Board side of the binary protocol
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline void linkBoardRead(CommandQueue* queue, CommandParser* parser, FrameLink* link)
+{
+    while((simLink.boardRx.count > 0) && !queue->isFull()){
+        uint8_t c = (uint8_t)linkGet(&simLink.boardRx);
+        if(link->receiving() || (c == FRAME_SYNC)){
+            if(!link->receiving())
+                parser->reset();
+            link->receive(c);
+        }
+        else
+            parser->parse((char)c);
+    }
+    link->service();
+}
+
+#endif
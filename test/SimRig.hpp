@@ -0,0 +1,113 @@
+#ifndef SIMRIG_HPP
+#define SIMRIG_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../inc/Hal.hpp"
+#include "../inc/PinDef.h"
+#include "../inc/MotionProcessor.hpp"
+#include "../inc/StepEngine.hpp"
+
+/**
+ * Shared rig of the host tests. The firmware is made of singletons that keep their state,
+ * so each test is its own program and sets the rig up once, before anything else.
+ */
+
+//=========================================//
+//               DEFINITIONS               //
+//=========================================//
+
+#define SIM_DRIVER_WAKE_US  2000            // Time the simulated drivers take to get their current up [us]
+#define SIM_PAN_MAGNET      123.4           // Where the pan magnet is, from where the simulation starts [Degrees]
+#define SIM_TILT_MAGNET     47.0            // Where the tilt magnet is [Degrees]
+#define SIM_MAGNET_WIDTH    4.0             // Angle over which a sensor sees its magnet [Degrees]
+
+static unsigned long simFailures;
+
+#define SIM_CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        simFailures++; \
+    } \
+}while(0)
+
+//=========================================//
+//                   RIG                   //
+//=========================================//
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Moves virtual time on while a command waits, so blocking calls get to finish
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline void simIdle(void)
+{
+    halSimRun(STEP_TICK_US);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Wires both axes to the simulator, with their mode select pins and drivers, then brings the motion processor up.
+ *         Call it once, first thing.
+ *
+ *  @param[in] magnets 1 to put the Hall magnets in, 0 to leave the sensors dark
+ *
+ *  @return The motion processor, at the origin in absolute mode
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline MotionProcessor* simRig(uint8_t magnets)
+{
+    halSimReset();
+    halSimAxis(0, PAN_STEP_PIN, PAN_DIR_PIN, PAN_HALL_PIN, PAN_DIR_CCW, 1 / PAN_STEPRATE);
+    halSimAxis(1, TILT_STEP_PIN, TILT_DIR_PIN, TILT_HALL_PIN, TILT_DIR_CCW, 1 / TILT_STEPRATE);
+    halSimMicrostep(0, PAN_MS1_PIN, PAN_MS2_PIN, PAN_MS3_PIN, PAN_MICROSTEPS);
+    halSimMicrostep(1, TILT_MS1_PIN, TILT_MS2_PIN, TILT_MS3_PIN, TILT_MICROSTEPS);
+    halSimDriver(0, PAN_EN_PIN, EN_MOTOR_ON, SIM_DRIVER_WAKE_US);
+    halSimDriver(1, TILT_EN_PIN, EN_MOTOR_ON, SIM_DRIVER_WAKE_US);
+    if(magnets){
+        halSimMagnet(0, SIM_PAN_MAGNET, SIM_MAGNET_WIDTH, !HALL_MAG_DETECTED);
+        halSimMagnet(1, SIM_TILT_MAGNET, SIM_MAGNET_WIDTH, !HALL_MAG_DETECTED);
+    }
+
+    MotionProcessor* motion = MotionProcessor::getInstance();
+    motion->registerTryAndExecCallback(simIdle);
+    motion->setMode(ABS);
+    return motion;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Runs virtual time until every queued move is done
+ *
+ *  @param[in] limitUs Gives up after this long [us]
+ *
+ *  @return 1 if the moves are done, 0 if it gave up
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline uint8_t simWaitReady(unsigned long limitUs)
+{
+    MotionProcessor* motion = MotionProcessor::getInstance();
+    unsigned long start = halSimTime();
+
+    while(!motion->ready()){
+        if(halSimTime() - start > limitUs)
+            return 0;
+        halSimRun(STEP_TICK_US);
+    }
+    return 1;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Prints how the test went
+ *
+ *  @return Exit code of the test
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static inline int simDone(const char* name)
+{
+    printf("%s: %s, %lu failed checks\n", name, simFailures ? "FAILED" : "passed", simFailures);
+    return simFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
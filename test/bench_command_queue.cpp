@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../inc/CommandParser.hpp"
+
+/**
+ * Compares the copy-based command buffer the firmware started with against the CommandQueue
+ * written in place, on the same stream of text commands.
+ *
+ * - Copy-based, as the old CommandBuffer: the line is gathered in a buffer, copied into the
+ *   ring by putCommand(), copied out by getCommand(), then tokenized from the copy.
+ * - In place: every byte goes straight to the parser, which tokenizes into a reserved slot,
+ *   and the command is executed from the slot it was written in.
+ *
+ * Reports the host time per command, the bytes copied per command and the RAM each takes:
+ * the copy-based one counts its ring, line and text buffers and the command it tokenizes
+ * into. Checks both give the same commands.
+ */
+
+#define BENCH_COMMANDS      2000000UL
+
+static unsigned long failures;
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+}while(0)
+
+/**
+ * @brief The put and get of the old CommandBuffer, the text copied in and out of a ring
+ */
+class CopyBuffer
+{
+public:
+    CopyBuffer(void) : _head(0), _tail(0), _full(0), copied(0) {}
+
+    uint8_t putCommand(const char* command)
+    {
+        if(_full)
+            return 0;
+
+        uint8_t i = 0;
+        while((command[i] != '\0') && (i < (COMMAND_TEXT_LENGTH - 1))){
+            _buffer[_tail][i] = command[i];
+            i++;
+        }
+        _buffer[_tail][i] = '\0';
+        copied += i + 1;
+
+        _tail = (_tail + 1) % COMMAND_QUEUE_SIZE;
+        if(_tail == _head)
+            _full = 1;
+        return 1;
+    }
+
+    uint8_t getCommand(char* command)
+    {
+        if(!_full && (_head == _tail))
+            return 0;
+
+        uint8_t i = 0;
+        while((_buffer[_head][i] != '\0') && (i < (COMMAND_TEXT_LENGTH - 1))){
+            command[i] = _buffer[_head][i];
+            i++;
+        }
+        command[i] = '\0';
+        copied += i + 1;
+
+        _full = 0;
+        _head = (_head + 1) % COMMAND_QUEUE_SIZE;
+        return 1;
+    }
+
+private:
+    char _buffer[COMMAND_QUEUE_SIZE][COMMAND_TEXT_LENGTH];
+    uint8_t _head;
+    uint8_t _tail;
+    uint8_t _full;
+
+public:
+    unsigned long copied;                   // Bytes copied in and out
+};
+
+static const char* const stream[] = {
+    "G1 P12.345 T-6.789",
+    "G91",
+    "M203 P30 T20",
+    "G3 P10 T0 I5 J0",
+    "G1 P-0.5",
+    "M240",
+};
+#define STREAM_LINES    (sizeof(stream) / sizeof(stream[0]))
+
+// Stands in for executing a command, so the compiler keeps the work
+static long executed;
+static void execute(const Command* cmd)
+{
+    executed += cmd->op + cmd->argMask;
+    if(cmd->argMask & (1 << ARG_P))
+        executed += cmd->args[ARG_P];
+}
+
+static double copyBased(unsigned long commands, unsigned long* copied)
+{
+    CopyBuffer buffer;
+    char line[COMMAND_TEXT_LENGTH];
+    char text[COMMAND_TEXT_LENGTH];
+    Command cmd;
+
+    clock_t start = clock();
+    for(unsigned long n = 0; n < commands; n++){
+        // Bytes gathered into a line as they arrive, until its end
+        const char* c = stream[n % STREAM_LINES];
+        uint8_t length = 0;
+        while((*c != '\0') && (length < COMMAND_TEXT_LENGTH - 1))
+            line[length++] = *c++;
+        line[length] = '\0';
+        buffer.copied += length;
+
+        buffer.putCommand(line);
+        buffer.getCommand(text);
+        if(tokenizeCommand(text, &cmd) == 1)
+            execute(&cmd);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    *copied = buffer.copied;
+    return seconds;
+}
+
+static double inPlace(unsigned long commands)
+{
+    CommandQueue queue;
+    CommandParser parser(&queue);
+
+    clock_t start = clock();
+    for(unsigned long n = 0; n < commands; n++){
+        for(const char* c = stream[n % STREAM_LINES]; *c != '\0'; c++)
+            parser.parse(*c);
+        parser.parse('\n');
+
+        const Command* cmd = queue.borrowCommand();
+        if(cmd != NULL){
+            execute(cmd);
+            queue.releaseCommand();
+        }
+    }
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long commands = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_COMMANDS;
+    unsigned long copied;
+
+    executed = 0;
+    double copySeconds = copyBased(commands, &copied);
+    long copyExecuted = executed;
+
+    executed = 0;
+    double placeSeconds = inPlace(commands);
+    long placeExecuted = executed;
+
+    printf("copy-based: %6.1f ns/command, %5.1f bytes copied/command, %4u bytes of RAM\n",
+           copySeconds * 1e9 / commands, (double)copied / commands,
+           (unsigned)(sizeof(CopyBuffer) + 2 * COMMAND_TEXT_LENGTH + sizeof(Command)));
+    printf("in place:   %6.1f ns/command, %5.1f bytes copied/command, %4u bytes of RAM, parser %u bytes\n",
+           placeSeconds * 1e9 / commands, 0.0, (unsigned)sizeof(CommandQueue), (unsigned)sizeof(CommandParser));
+
+    CHECK(copyExecuted == placeExecuted);
+    printf("command_queue: %s, %lu failed checks\n", failures ? "FAILED" : "passed", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+#include <time.h>
+#include "SimRig.hpp"
+#include "LinkRig.hpp"
+
+/**
+ * Loopback benchmark of the binary protocol, FrameHost on one end and the board's FrameLink on
+ * the other, with the commands taken off the board's queue as fast as they come.
+ *
+ * - Pipe: the two ends joined by an in-process pipe, so the line isn't what limits it. The
+ *   commands/s are what both ends together get through on the host.
+ * - Binary at 115200 baud: the sustained commands/s the line carries, with the Uno's 64 byte
+ *   serial buffers, and how many bytes each command takes on it.
+ * - Text at 115200 baud: the same commands as G1 lines through the text parser, to compare.
+ * - Binary on a noisy line: one byte in LINK_NOISE_EVERY corrupted each way, frames are sent
+ *   again and still every command comes out once.
+ *
+ * Checks that every command comes out once, in order, as it went in, that no byte is lost to
+ * a full receive buffer with the credits, and that the binary protocol carries at least
+ * LINK_MIN_GAIN times as many commands as text. Pass a number of commands to send.
+ */
+
+#define LINK_DEFAULT_COMMANDS   20000UL
+#define LINK_NOISE_EVERY        2000UL      // One byte in this many is corrupted on the noisy line
+#define LINK_MIN_GAIN           1.5         // Least binary over text commands/s on the line
+#define LINK_LIMIT_US           600000000UL // Gives up on a run after this long [us]
+
+static unsigned long received;
+static unsigned long wrong;
+
+/**
+ * @brief Command number seq of the stream, a move to some angle worked out from seq
+ */
+static void makeCommand(unsigned long seq, Command* cmd)
+{
+    cmd->op = CMD_MOVE;
+    cmd->argMask = ARG_P_BIT | ARG_T_BIT;
+    cmd->args[ARG_P] = (int32_t)((seq * 2654435761UL) % 360001UL) - 180000;
+    cmd->args[ARG_T] = (int32_t)((seq * 40503UL) % 180001UL) - 90000;
+}
+
+static void formatCommand(unsigned long seq, char* text, size_t length)
+{
+    Command cmd;
+    makeCommand(seq, &cmd);
+    long p = cmd.args[ARG_P], t = cmd.args[ARG_T];
+    snprintf(text, length, "G1 P%s%ld.%03ld T%s%ld.%03ld\n", (p < 0) ? "-" : "", labs(p) / FIXED_SCALE, labs(p) % FIXED_SCALE,
+             (t < 0) ? "-" : "", labs(t) / FIXED_SCALE, labs(t) % FIXED_SCALE);
+}
+
+/**
+ * @brief Takes every command off the board's queue, checking it's the one expected next
+ */
+static void drain(CommandQueue* queue)
+{
+    const Command* cmd;
+    while((cmd = queue->borrowCommand()) != NULL){
+        Command expected;
+        makeCommand(received, &expected);
+        if((cmd->op != expected.op) || (cmd->argMask != expected.argMask) ||
+           (cmd->args[ARG_P] != expected.args[ARG_P]) || (cmd->args[ARG_T] != expected.args[ARG_T])){
+            if(wrong++ < 10)
+                printf("command %lu came out wrong: op %u P %ld T %ld\n", received, cmd->op, (long)cmd->args[ARG_P], (long)cmd->args[ARG_T]);
+        }
+        received++;
+        queue->releaseCommand();
+    }
+}
+
+/**
+ * @brief Streams count commands through FrameHost to the board, on the pipe or the serial line
+ *
+ * @return Commands/s, on the host's clock for the pipe, on the line's for the serial line
+ */
+static double streamBinary(unsigned long count, uint8_t pipe, unsigned long corruptEvery, unsigned long* resent)
+{
+    CommandQueue queue;
+    CommandParser parser(&queue);
+    FrameLink link(&queue, linkBoardSend, linkBoardRoom);
+    FrameHost host(linkHostSend);
+    unsigned long sent = 0;
+
+    received = 0;
+    wrong = 0;
+    linkReset(corruptEvery);
+    host.start(0);
+    clock_t c = clock();
+
+    while((received < count) && (linkTime() < LINK_LIMIT_US)){
+        Command cmd;
+        while(sent < count){
+            makeCommand(sent, &cmd);
+            if(!host.add(&cmd, linkTime() / 1000))
+                break;
+            sent++;
+        }
+        if(sent == count)
+            host.flush(linkTime() / 1000);
+
+        if(pipe){
+            linkPipe();
+        }
+        else{
+            halSimRun(STEP_TICK_US);
+            linkRun();
+        }
+        linkBoardRead(&queue, &parser, &link);
+        drain(&queue);
+        if(pipe)
+            linkPipe();
+        linkHostRead(&host);
+    }
+
+    double cpu = (double)(clock() - c) / CLOCKS_PER_SEC;
+    *resent = host.getResent();
+    SIM_CHECK(received == count);
+    SIM_CHECK(wrong == 0);
+    SIM_CHECK(host.getRejected() == 0);
+    return count / (pipe ? cpu : linkTime() / 1e6);
+}
+
+/**
+ * @brief Streams count commands as G1 lines to the board's text parser on the serial line,
+ * keeping the host's transmit buffer topped up as there's no flow control
+ *
+ * @return Commands/s on the line's clock
+ */
+static double streamText(unsigned long count, unsigned long* bytes)
+{
+    CommandQueue queue;
+    CommandParser parser(&queue);
+    FrameLink link(&queue, linkBoardSend, linkBoardRoom);
+    unsigned long sent = 0;
+
+    received = 0;
+    wrong = 0;
+    *bytes = 0;
+    linkReset(0);
+
+    while((received < count) && (linkTime() < LINK_LIMIT_US)){
+        while((sent < count) && (simLink.hostTx.count < LINK_BOARD_BUFFER)){
+            char text[COMMAND_TEXT_LENGTH];
+            formatCommand(sent++, text, sizeof(text));
+            linkHostSend((const uint8_t*)text, (uint8_t)strlen(text));
+            *bytes += strlen(text);
+        }
+
+        halSimRun(STEP_TICK_US);
+        linkRun();
+        linkBoardRead(&queue, &parser, &link);
+        drain(&queue);
+    }
+
+    SIM_CHECK(received == count);
+    SIM_CHECK(wrong == 0);
+    return count / (linkTime() / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 10) : LINK_DEFAULT_COMMANDS;
+    unsigned long resent, bytes;
+
+    halSimReset();
+
+    double rate = streamBinary(count, 1, 0, &resent);
+    printf("pipe: %lu commands, %.0f commands/s through both ends on the host, %.1f bytes/command\n",
+           count, rate, (double)simLink.bytes[0] / count);
+
+    double binary = streamBinary(count, 0, 0, &resent);
+    double line = LINK_BAUD / LINK_BITS_PER_BYTE;
+    printf("binary at %lu baud: %.0f commands/s, %.1f bytes/command, %.0f%% of the line, %lu bytes lost, %lu frames sent again\n",
+           LINK_BAUD, binary, (double)simLink.bytes[0] / count, 100.0 * simLink.bytes[0] / (linkTime() / 1e6) / line,
+           simLink.boardRx.lost, resent);
+    SIM_CHECK(simLink.boardRx.lost == 0);
+    SIM_CHECK(resent == 0);
+
+    double text = streamText(count, &bytes);
+    printf("text at %lu baud: %.0f commands/s, %.1f bytes/command, %lu bytes lost\n",
+           LINK_BAUD, text, (double)bytes / count, simLink.boardRx.lost);
+    SIM_CHECK(simLink.boardRx.lost == 0);
+
+    printf("binary carries %.2f times the commands of text\n", binary / text);
+    SIM_CHECK(binary >= LINK_MIN_GAIN * text);
+
+    double noisy = streamBinary(count, 0, LINK_NOISE_EVERY, &resent);
+    printf("binary, 1 byte in %lu corrupted: %.0f commands/s, %lu bytes corrupted, %lu frames sent again\n",
+           LINK_NOISE_EVERY, noisy, simLink.corrupted, resent);
+    SIM_CHECK(simLink.corrupted > 0);
+    SIM_CHECK(resent > 0);
+
+    return simDone("bench_frame_link");
+}
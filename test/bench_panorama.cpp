@@ -0,0 +1,125 @@
+#include <math.h>
+#include <time.h>
+#include "SimRig.hpp"
+#include "../inc/Panorama.hpp"
+#include "../inc/MotorPower.hpp"
+#include "../inc/Trigger.hpp"
+
+/**
+ * Shoots a large panorama grid in each order, the main loop calling service() every millisecond,
+ * and reports how long the head spends moving and how many steps each axis takes.
+ *
+ * - The rows order stands for a host sending an absolute move per frame, row after row. The
+ *   serpentine and the minimum travel orders take less time moving and fewer steps.
+ * - Minimum travel takes no more time moving than serpentine.
+ * - Every frame is shot, none blocked. service() never blocks, and the RAM it takes doesn't
+ *   depend on the size of the grid.
+ *
+ * Pass a field of view in degrees to shoot another grid, more frames with a narrower one.
+ */
+
+#define BENCH_FOV           3.0         // Field of view of a frame, a 400 mm lens on a crop body [Degrees]
+#define BENCH_OVERLAP       300         // [1/1000]
+#define BENCH_PAN_EXTENT    120000L     // [Millidegrees]
+#define BENCH_TILT_EXTENT   45000L      // [Millidegrees]
+#define BENCH_SPEED         20.0        // Set speed of both axes [Degrees/Sec]
+#define BENCH_SETTLE_MS     100UL
+#define BENCH_PULSE_US      20000UL     // Shutter pulse, also the exposure [us]
+#define BENCH_LOOP_US       1000UL      // Period of the main loop [us]
+
+typedef struct {
+    double seconds;                     // From start to the last shot
+    double moving;                      // Time the step engine was running [Sec]
+    unsigned long pulses[NUM_OF_MOTORS];
+    unsigned long frames;
+    uint8_t byColumns;
+} BenchResult;
+
+static const char* const orderNames[NUM_OF_PANO_ORDERS] = {"serpentine", "min travel", "rows"};
+
+/**
+ * @brief Shoots a whole panorama from where the head is, then goes back there
+ */
+static void shoot(Panorama* panorama, MotionProcessor* motion, uint8_t order, double fov, BenchResult* result)
+{
+    MotorPower* power = MotorPower::getInstance();
+    Trigger* trigger = Trigger::getInstance();
+    long fovs[NUM_OF_MOTORS] = {lround(fov * 1000), lround(fov * 1000 * 2 / 3)};
+    long extent[NUM_OF_MOTORS] = {BENCH_PAN_EXTENT, BENCH_TILT_EXTENT};
+    LongVector origin = motion->getTargetMdeg();
+
+    SIM_CHECK(panorama->setFrame(fovs, BENCH_OVERLAP, order) == 1);
+    SIM_CHECK(panorama->start(extent, BENCH_SETTLE_MS, 0) == 1);
+
+    unsigned long pulses[NUM_OF_MOTORS] = {halSimPulses(0), halSimPulses(1)};
+    unsigned long fired = trigger->getFired(), blocked = trigger->getBlocked();
+    unsigned long moving = 0, stalled = 0;
+    unsigned long start = halSimTime();
+    PanoramaState state;
+
+    do{
+        power->service();
+        unsigned long before = halSimTime();
+        state = panorama->service();
+        if(halSimTime() != before)
+            stalled++;
+
+        halSimRun(BENCH_LOOP_US);
+        if(!motion->ready())
+            moving += BENCH_LOOP_US;
+    }while(state != PANO_DONE);
+
+    result->seconds = (halSimTime() - start) / 1e6;
+    result->moving = moving / 1e6;
+    result->pulses[0] = halSimPulses(0) - pulses[0];
+    result->pulses[1] = halSimPulses(1) - pulses[1];
+    result->frames = panorama->numFrames();
+    result->byColumns = panorama->byColumns();
+
+    SIM_CHECK(stalled == 0);
+    SIM_CHECK(trigger->getFired() - fired == panorama->numFrames());
+    SIM_CHECK(trigger->getBlocked() == blocked);
+
+    motion->line(origin);
+    SIM_CHECK(simWaitReady(60000000UL));
+}
+
+int main(int argc, char** argv)
+{
+    double fov = BENCH_FOV;
+    if(argc > 1)
+        fov = strtod(argv[1], NULL);
+
+    MotionProcessor* motion = simRig(0);
+    motion->setPanSpeed(BENCH_SPEED);
+    motion->setTiltSpeed(BENCH_SPEED);
+    Trigger::getInstance()->setPulse(BENCH_PULSE_US);
+
+    Panorama panorama(motion);
+    BenchResult results[NUM_OF_PANO_ORDERS];
+    for(uint8_t order = 0; order < NUM_OF_PANO_ORDERS; order++){
+        clock_t c = clock();
+        shoot(&panorama, motion, order, fov, &results[order]);
+        double cpu = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+        const BenchResult* r = &results[order];
+        printf("%-10s %lu frames in %lu columns by %lu rows%s: %.1f s, %.1f s moving, %lu pan + %lu tilt steps (%.1f s on the host)\n",
+               orderNames[order], r->frames, panorama.getColumns(), panorama.getRows(), r->byColumns ? " by columns" : "",
+               r->seconds, r->moving, r->pulses[0], r->pulses[1], cpu);
+    }
+
+    const BenchResult* rows = &results[PANO_ROWS];
+    for(uint8_t order = PANO_SERPENTINE; order < PANO_ROWS; order++){
+        const BenchResult* r = &results[order];
+        printf("%-10s against rows: %.2fx the time moving, %.2fx the steps\n", orderNames[order],
+               r->moving / rows->moving, (double)(r->pulses[0] + r->pulses[1]) / (rows->pulses[0] + rows->pulses[1]));
+        SIM_CHECK(r->moving < rows->moving);
+        SIM_CHECK(r->pulses[0] + r->pulses[1] < rows->pulses[0] + rows->pulses[1]);
+    }
+    SIM_CHECK(results[PANO_MIN_TRAVEL].moving <= results[PANO_SERPENTINE].moving);
+    printf("sizeof(Panorama) %u bytes\n", (unsigned)sizeof(Panorama));
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("bench_panorama");
+}
@@ -0,0 +1,169 @@
+#include <math.h>
+#include <time.h>
+#include "SimRig.hpp"
+#include "../inc/MotionPlanner.hpp"
+#include "../inc/MotorPower.hpp"
+
+/**
+ * Reports what the motion planner gets out of the axes and what it costs the main loop.
+ *
+ * - Top speed: pan moves asked for ever higher feedrates, straight through the planner so the
+ *   processor's PAN_MAX_SPEED doesn't cap them. The speed they cruise at, from the simulated
+ *   rotor, tells how fast the step interrupt can go, coarse microstepping included.
+ * - Profiles: moves of a few lengths at PAN_MAX_SPEED with the default acceleration, how fast
+ *   they get and how long they take, with trapezoid and S-curve ramps.
+ * - Planning time: host time of append() on random moves that keep the queue full, so every
+ *   call replans the whole look-ahead.
+ *
+ * Checks that no step is missed or taken off the full steps, that no move goes faster than
+ * asked, and that S-curves take longer than trapezoids. Pass a number of moves to plan.
+ */
+
+#define BENCH_PLAN_MOVES    2000UL
+#define BENCH_SWEEP_ACCEL   20000.0     // Acceleration of the top speed sweep, so the moves get to cruise [Degrees/Sec^2]
+#define BENCH_SWEEP_TURNS   8.0         // Length of the sweep's moves [Turns]
+#define BENCH_WINDOW_US     10000UL     // Speeds are measured over this long [us]
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom(void)
+{
+    seed = seed * 1664525UL + 1013904223UL;
+    return seed >> 8;
+}
+
+static void queueMove(long pan, long tilt, double panFeedrate, double tiltFeedrate)
+{
+    long delta[2] = {pan, tilt};
+    uint8_t dir[2] = {(uint8_t)((pan < 0) ? PAN_DIR_CW : PAN_DIR_CCW), (uint8_t)((tilt < 0) ? TILT_DIR_CW : TILT_DIR_CCW)};
+
+    while(MotionPlanner::getInstance()->append(delta, dir, panFeedrate, tiltFeedrate) == 0)
+        halSimRun(STEP_TICK_US);
+    StepEngine::getInstance()->wake();
+}
+
+/**
+ * @brief Runs the queue empty, sampling how far pan went every window
+ *
+ * @return Fastest pan speed over a window [Degrees/Sec]
+ */
+static double runPeak(unsigned long* us)
+{
+    unsigned long start = halSimTime();
+    double peak = 0;
+    long last = halSimSteps(0);
+
+    while(StepEngine::getInstance()->busy()){
+        halSimRun(BENCH_WINDOW_US);
+        long steps = halSimSteps(0);
+        double speed = labs(steps - last) * PAN_STEPRATE * 1e6 / BENCH_WINDOW_US;
+        if(speed > peak)
+            peak = speed;
+        last = steps;
+    }
+    *us = halSimTime() - start;
+    return peak;
+}
+
+static void sweepTopSpeed(void)
+{
+    static const double speeds[] = {90, 250, 500, 1000, 1500, 2000, 2500, 3000, 4000};
+    MotionPlanner* planner = MotionPlanner::getInstance();
+    double top = 0;
+
+    planner->setProfileMode(TRAPEZOID);
+    planner->setPanAccel(BENCH_SWEEP_ACCEL);
+    for(unsigned i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++){
+        unsigned long us;
+        unsigned long misaligned = halSimMisaligned(0);
+        queueMove(lround(360.0 * BENCH_SWEEP_TURNS / PAN_STEPRATE), 0, speeds[i] / PAN_STEPRATE, 1);
+        double peak = runPeak(&us);
+        uint8_t clean = (halSimMissed(0) == 0) && (halSimMisaligned(0) == misaligned);
+
+        printf("asked %6.0f deg/s: cruised at %7.1f deg/s%s\n", speeds[i], peak, clean ? "" : ", steps lost");
+        SIM_CHECK(clean);
+        SIM_CHECK(peak <= speeds[i] * 1.01 + PAN_STEPRATE * 1e6 / BENCH_WINDOW_US);
+        if(peak > top)
+            top = peak;
+    }
+
+    double ceiling = STEP_TICK_HZ * (1 << PAN_COARSE_SHIFT) * PAN_STEPRATE;
+    printf("top pan speed %.1f deg/s, the step interrupt's ceiling is %.1f deg/s\n", top, ceiling);
+    SIM_CHECK(top <= ceiling * 1.01);
+    planner->setPanAccel(PAN_DEFAULT_ACCEL);
+}
+
+static void compareProfiles(void)
+{
+    static const double lengths[] = {5, 30, 90, 360};
+    MotionPlanner* planner = MotionPlanner::getInstance();
+
+    for(unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++){
+        unsigned long us[2];
+        double peak[2];
+
+        for(int mode = TRAPEZOID; mode <= SCURVE; mode++){
+            planner->setProfileMode((ProfileMode)mode);
+            queueMove(lround(lengths[i] / PAN_STEPRATE), 0, PAN_MAX_SPEED / PAN_STEPRATE, 1);
+            peak[mode] = runPeak(&us[mode]);
+        }
+        printf("%5.0f deg move: trapezoid %5.1f deg/s in %6.3f s, s-curve %5.1f deg/s in %6.3f s\n",
+               lengths[i], peak[TRAPEZOID], us[TRAPEZOID] / 1e6, peak[SCURVE], us[SCURVE] / 1e6);
+        SIM_CHECK(us[SCURVE] >= us[TRAPEZOID]);
+        SIM_CHECK(peak[TRAPEZOID] <= PAN_MAX_SPEED * 1.01 + PAN_STEPRATE * 1e6 / BENCH_WINDOW_US);
+    }
+    planner->setProfileMode(TRAPEZOID);
+}
+
+static void timePlanning(unsigned long moves)
+{
+    MotionPlanner* planner = MotionPlanner::getInstance();
+
+    for(int mode = TRAPEZOID; mode <= SCURVE; mode++){
+        planner->setProfileMode((ProfileMode)mode);
+        double total = 0, worst = 0;
+
+        for(unsigned long n = 0; n < moves; n++){
+            long delta[2] = {(long)(nextRandom() % 401) - 200, (long)(nextRandom() % 401) - 200};
+            uint8_t dir[2] = {(uint8_t)((delta[0] < 0) ? PAN_DIR_CW : PAN_DIR_CCW), (uint8_t)((delta[1] < 0) ? TILT_DIR_CW : TILT_DIR_CCW)};
+            double panFeedrate = (30 + nextRandom() % 60) / PAN_STEPRATE;
+            double tiltFeedrate = (20 + nextRandom() % 40) / TILT_STEPRATE;
+
+            while(!planner->hasRoom()){
+                StepEngine::getInstance()->wake();
+                halSimRun(STEP_TICK_US);
+            }
+
+            clock_t c = clock();
+            planner->append(delta, dir, panFeedrate, tiltFeedrate);
+            double spent = (double)(clock() - c) / CLOCKS_PER_SEC;
+            total += spent;
+            if(spent > worst)
+                worst = spent;
+        }
+        StepEngine::getInstance()->wake();
+        SIM_CHECK(simWaitReady(600000000UL));
+        printf("%s planning: %lu moves, %.2f us avg, %.2f us worst on the host\n",
+               (mode == TRAPEZOID) ? "trapezoid" : "s-curve  ", moves, total * 1e6 / moves, worst * 1e6);
+    }
+    planner->setProfileMode(TRAPEZOID);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long moves = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_PLAN_MOVES;
+
+    simRig(0);
+    MotorPower::getInstance()->wake(0x03);
+    halSimRun(SIM_DRIVER_WAKE_US * 2);
+
+    sweepTopSpeed();
+    compareProfiles();
+    timePlanning(moves);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    SIM_CHECK(halSimMisaligned(0) == 0);
+    SIM_CHECK(halSimMisaligned(1) == 0);
+    return simDone("bench_planner");
+}
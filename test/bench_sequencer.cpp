@@ -0,0 +1,99 @@
+#include <math.h>
+#include <time.h>
+#include "SimRig.hpp"
+#include "../inc/Sequencer.hpp"
+#include "../inc/MotorPower.hpp"
+#include "../inc/MotionQueue.hpp"
+
+/**
+ * Runs a 10,000 keyframe path through the sequencer, the main loop calling service() every
+ * millisecond, and reports what a loop pass costs.
+ *
+ * - service() never blocks: virtual time doesn't move while it runs, though the drivers go
+ *   idle between the path's still stretches and the motion queue fills up.
+ * - The step engine never starves while the path moves.
+ * - The head ends on the last keyframe, the RAM used doesn't depend on the path's length.
+ *
+ * Pass a number of keyframes to run another length.
+ */
+
+#define BENCH_KEYS          10000UL
+#define BENCH_KEY_MS        300UL       // Time between keyframes [ms]
+#define BENCH_LOOP_US       1000UL      // Period of the main loop [us]
+
+static unsigned long numKeys = BENCH_KEYS;
+
+// A Lissajous figure, holding still for a few seconds every minute so the drivers go idle
+static uint8_t keyframeAt(unsigned long index, Keyframe* key)
+{
+    if(index >= numKeys)
+        return 0;
+
+    unsigned long time = index * BENCH_KEY_MS;
+    unsigned long still = time % 60000UL;
+    double t = (double)(time - ((still > 50000UL) ? still - 50000UL : 0)) / 1000.0;
+
+    key->time = time;
+    key->p = lround(30000.0 * sin(t * 2.0 * PI / 20.0));
+    key->t = lround(15000.0 * sin(t * 2.0 * PI / 13.0));
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 1)
+        numKeys = strtoul(argv[1], NULL, 10);
+
+    MotionProcessor* motion = simRig(0);
+    MotorPower* power = MotorPower::getInstance();
+    power->setIdleTimeout(0, 1000);
+    power->setIdleTimeout(1, 1000);
+
+    Sequencer sequencer(motion);
+    SequenceConfig config = {0, 0, 0};
+    SIM_CHECK(sequencer.start(keyframeAt, &config) == 1);
+
+    unsigned long calls = 0, blocked = 0, starved = 0;
+    double cpu = 0, cpuMax = 0;
+    unsigned long start = halSimTime();
+    SequenceState state;
+
+    do{
+        power->service();
+
+        unsigned long before = halSimTime();
+        clock_t c = clock();
+        state = sequencer.service();
+        double spent = (double)(clock() - c) / CLOCKS_PER_SEC;
+        if(halSimTime() != before)
+            blocked++;
+
+        calls++;
+        cpu += spent;
+        if(spent > cpuMax)
+            cpuMax = spent;
+
+        // Past the first keyframe the queue only runs dry where the path holds still
+        if((state == SEQ_MOVE) && !StepEngine::getInstance()->busy() && (MotionQueue::getInstance()->numBlocks() > 0))
+            starved++;
+
+        halSimRun(BENCH_LOOP_US);
+    }while((state != SEQ_DONE) && (state != SEQ_IDLE));
+    SIM_CHECK(simWaitReady(60000000UL));
+
+    Keyframe last = {0, 0, 0};
+    keyframeAt(numKeys - 1, &last);
+    double seconds = (halSimTime() - start) / 1e6;
+    printf("%lu keyframes, %.1f s of path in %.1f s, %lu service() calls, %.2f us avg %.2f us max on the host\n",
+           numKeys, (numKeys - 1) * BENCH_KEY_MS / 1000.0, seconds, calls, cpu * 1e6 / calls, cpuMax * 1e6);
+    printf("blocked calls %lu, starved ticks %lu, sizeof(Sequencer) %u bytes\n", blocked, starved, (unsigned)sizeof(Sequencer));
+
+    SIM_CHECK(state == SEQ_DONE);
+    SIM_CHECK(blocked == 0);
+    SIM_CHECK(starved == 0);
+    SIM_CHECK(fabs(halSimAngle(0) - last.p / 1000.0) <= PAN_STEPRATE);
+    SIM_CHECK(fabs(halSimAngle(1) - last.t / 1000.0) <= TILT_STEPRATE);
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("bench_sequencer");
+}
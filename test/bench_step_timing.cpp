@@ -0,0 +1,148 @@
+#include "SimRig.hpp"
+#include "../inc/StepTiming.hpp"
+
+/**
+ * Step timing suite. Runs move profiles through the motion processor on the simulated clock,
+ * with the firmware built with STEP_TIMING, and prints one line of JSON per profile for CI to
+ * keep and compare:
+ *
+ *   {"profile":"<name>","timing":<StepTiming::report()>,"host_isr":{"calls":..,"avg_ns":..,"worst_ns":..}}
+ *
+ * The timing is what the step interrupt recorded on the virtual clock: commanded and achieved
+ * step frequency, interval histograms and the interrupt's duration, which there only counts
+ * its pulses. host_isr is the interrupt's time on the host.
+ *
+ * - single_axis: a long pan move, achieved frequency close to the commanded one.
+ * - diagonal: both axes, the slower one stepped by the Bresenham accumulators.
+ * - ramps: short moves that never get to cruise, back and forth.
+ * - homing: the seek, backoff and slow passes over the magnets.
+ *
+ * Checks that every profile reports, that no axis steps faster than commanded, that the
+ * interrupt fits within its tick, and that no step is missed. Homing steps on its own
+ * rates, not on planned blocks, so it has no commanded frequency. Pass a file name to also
+ * write the lines there.
+ */
+
+#define TIMING_REPORT_SIZE  1024
+
+static FILE* out;
+
+static void begin(void)
+{
+    StepTiming::getInstance()->reset();
+    halSimClearIsrTime();
+}
+
+/**
+ * @brief Prints the profile's line and checks what it recorded
+ *
+ * @param[in] name      Name of the profile
+ * @param[in] planned   1 if it ran planned blocks, which have a commanded frequency
+ * @param[in] minRatio  Least achieved over commanded frequency of the fastest axis
+ */
+static void end(const char* name, uint8_t planned, double minRatio)
+{
+    static char timing[TIMING_REPORT_SIZE];
+    StepTiming* stepTiming = StepTiming::getInstance();
+    HalSimIsrTime isr;
+
+    unsigned int length = stepTiming->report(timing, sizeof(timing));
+    halSimIsrTime(&isr);
+    SIM_CHECK(length < sizeof(timing));
+
+    char line[TIMING_REPORT_SIZE + 128];
+    snprintf(line, sizeof(line), "{\"profile\":\"%s\",\"timing\":%s,\"host_isr\":{\"calls\":%lu,\"avg_ns\":%lu,\"worst_ns\":%lu}}",
+             name, timing, isr.calls, isr.calls ? (unsigned long)(isr.totalNs / isr.calls) : 0UL, isr.worstNs);
+    printf("%s\n", line);
+    if(out != NULL)
+        fprintf(out, "%s\n", line);
+
+    // Read back what the line says
+    unsigned long count, maxUs, commanded, achieved[2] = {0, 0};
+    SIM_CHECK(sscanf(timing, "{\"isr\":{\"count\":%lu,\"max_us\":%lu,\"avg_us\":%*[0-9]},\"commanded_hz\":%lu", &count, &maxUs, &commanded) == 3);
+    const char* axis = timing;
+    for(int i = 0; i < 2; i++){
+        axis = strstr(axis, "\"achieved_hz\":");
+        SIM_CHECK(axis != NULL);
+        if(axis == NULL)
+            return;
+        axis += strlen("\"achieved_hz\":");
+        achieved[i] = strtoul(axis, NULL, 10);
+    }
+
+    unsigned long fastest = (achieved[0] > achieved[1]) ? achieved[0] : achieved[1];
+    SIM_CHECK(count > 0);
+    SIM_CHECK(maxUs < STEP_TICK_US);
+    if(planned){
+        SIM_CHECK(fastest <= commanded + commanded / 100 + 1);
+        SIM_CHECK(fastest >= minRatio * commanded);
+    }
+}
+
+static void singleAxis(MotionProcessor* motion)
+{
+    DoubleVector target = {90.0, 0};
+    motion->setPanSpeed(20.0);
+
+    begin();
+    motion->line(target);
+    SIM_CHECK(simWaitReady(60000000UL));
+    end("single_axis", 1, 0.9);
+}
+
+static void diagonal(MotionProcessor* motion)
+{
+    DoubleVector target = {-40.0, -25.0};
+    motion->setPanSpeed(20.0);
+    motion->setTiltSpeed(20.0);
+
+    begin();
+    motion->line(target);
+    SIM_CHECK(simWaitReady(60000000UL));
+    end("diagonal", 1, 0.9);
+}
+
+static void ramps(MotionProcessor* motion)
+{
+    motion->setPanSpeed(PAN_MAX_SPEED);
+    motion->setTiltSpeed(TILT_MAX_SPEED);
+
+    begin();
+    for(int i = 0; i < 20; i++){
+        DoubleVector target = {(i & 0x01) ? 0.0 : 2.0, (i & 0x01) ? 0.0 : -1.0};
+        motion->line(target);
+        SIM_CHECK(simWaitReady(60000000UL));
+    }
+    end("ramps", 1, 0.0);
+}
+
+static void homing(MotionProcessor* motion)
+{
+    begin();
+    motion->home();
+    while(StepEngine::getInstance()->homingState() < HOMING_DONE)
+        halSimRun(STEP_TICK_US);
+    SIM_CHECK(StepEngine::getInstance()->homingState() == HOMING_DONE);
+    SIM_CHECK(simWaitReady(60000000UL));
+    end("homing", 0, 0.0);
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 1){
+        out = fopen(argv[1], "w");
+        SIM_CHECK(out != NULL);
+    }
+
+    MotionProcessor* motion = simRig(1);
+    singleAxis(motion);
+    diagonal(motion);
+    ramps(motion);
+    homing(motion);
+
+    if(out != NULL)
+        fclose(out);
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("bench_step_timing");
+}
@@ -0,0 +1,227 @@
+#include <math.h>
+#include "SimRig.hpp"
+#include "../inc/CommandExecutor.hpp"
+#include "../inc/CommandParser.hpp"
+#include "../inc/Kinematics.hpp"
+#include "../inc/MotionPlanner.hpp"
+
+/**
+ * Checks the arcs the step interrupt traces, tick by tick on the simulated motors.
+ *
+ * - Arcs of every size and both ways, a full circle among them: every position the motors go
+ *   through is within ARC_MAX_DEVIATION of the true circle, they end on the exact step of the
+ *   end point, and, away from the ramps, the speed along the path stays within ARC_MAX_SPEED_SPREAD
+ *   of its mean.
+ * - An end point off the circle is still reached exactly, straight on from where the arc ends.
+ * - G2 and G3 go through the parser and the executor, the center relative to the start.
+ * - What a tick of the step interrupt costs on the host while tracing an arc, against the same
+ *   while stepping a line for as long. It must stay under ARC_MAX_COST times as much.
+ */
+
+#define ARC_SPEED               20.0        // Set speed of both axes [Degrees/Sec]
+// Half a step off on both axes, plus a quarter of the larger step the traced curve may wander [Degrees]
+#define ARC_MAX_DEVIATION       (sqrt(PAN_STEPRATE * PAN_STEPRATE + TILT_STEPRATE * TILT_STEPRATE) / 2 + \
+                                 ((PAN_STEPRATE > TILT_STEPRATE) ? PAN_STEPRATE : TILT_STEPRATE) / 4)
+#define ARC_SPEED_WINDOW_US     200000UL    // Time the speed is averaged over [us]
+#define ARC_MAX_SPEED_SPREAD    0.03        // Most a window's speed is off the mean
+#define ARC_MAX_COST            2.0
+#define ARC_LIMIT_US            60000000UL  // Longest an arc may take [us]
+
+typedef struct {
+    double radius;                          // [Degrees]
+    double startAngle;                      // Angle of the start around the center [Degrees]
+    double sweep;                           // Angle to go around it, counterclockwise if positive [Degrees]
+} ArcCase;
+
+static const ArcCase arcCases[] = {
+    {30.0,   180.0,   90.0},
+    {10.0,    45.0, -270.0},
+    {45.0,   270.0,  360.0},                // All the way around, ends where it started
+    {0.5,      0.0,  180.0},
+    {60.0,    90.0,  -60.0},
+    {2.0,    300.0,  120.0},
+    {170.0,  200.0,  -45.0},
+};
+
+typedef struct {
+    double deviation;                       // Furthest off the circle [Degrees]
+    double spread;                          // Most a window's speed is off the mean
+    double speed;                           // Mean speed away from the ramps [Degrees/Sec]
+    unsigned long ticks;
+} ArcTrace;
+
+static double wrapAngle(double a)
+{
+    while(a > PI)
+        a -= 2.0 * PI;
+    while(a <= -PI)
+        a += 2.0 * PI;
+    return a;
+}
+
+/**
+ * @brief Runs the queued arc until it's done, measuring how far the motors are off the circle every tick and how
+ *        far they went around it every ARC_SPEED_WINDOW_US
+ */
+static void trace(double cp, double ct, double radius, ArcTrace* result)
+{
+    static double windowSpeed[ARC_LIMIT_US / ARC_SPEED_WINDOW_US];
+    unsigned long windows = 0;
+    double last = atan2(halSimAngle(1) - ct, halSimAngle(0) - cp);
+    double swept = 0, windowStart = 0;
+    unsigned long start = halSimTime(), windowTime = start;
+
+    result->deviation = 0;
+    result->ticks = 0;
+    while(!MotionProcessor::getInstance()->ready() && (halSimTime() - start < ARC_LIMIT_US)){
+        halSimRun(STEP_TICK_US);
+        result->ticks++;
+
+        double p = halSimAngle(0) - cp, t = halSimAngle(1) - ct;
+        double off = fabs(sqrt(p * p + t * t) - radius);
+        if(off > result->deviation)
+            result->deviation = off;
+
+        double angle = atan2(t, p);
+        swept += wrapAngle(angle - last);
+        last = angle;
+        if(halSimTime() - windowTime >= ARC_SPEED_WINDOW_US){
+            windowSpeed[windows++] = fabs(swept - windowStart) * radius * 1e6 / (halSimTime() - windowTime);
+            windowStart = swept;
+            windowTime = halSimTime();
+        }
+    }
+
+    // The middle third of the windows, clear of the ramps at both ends
+    unsigned long first = windows / 3, end = 2 * windows / 3;
+    result->speed = 0;
+    result->spread = 0;
+    if(end <= first)
+        return;
+    for(unsigned long i = first; i < end; i++)
+        result->speed += windowSpeed[i] / (end - first);
+    for(unsigned long i = first; i < end; i++){
+        double spread = fabs(windowSpeed[i] - result->speed) / result->speed;
+        if(spread > result->spread)
+            result->spread = spread;
+    }
+}
+
+/**
+ * @brief Queues an arc from where the motors are and checks how it's traced
+ */
+static void checkArc(MotionProcessor* motion, const ArcCase* arc)
+{
+    LongVector at = motion->getTargetMdeg();
+    double from[2] = {degreesFromMdeg(at.p), degreesFromMdeg(at.t)};
+    double a = arc->startAngle * PI / 180.0;
+    double cp = from[0] - arc->radius * cos(a);
+    double ct = from[1] - arc->radius * sin(a);
+    double e = a + arc->sweep * PI / 180.0;
+    DoubleVector end = {cp + arc->radius * cos(e), ct + arc->radius * sin(e)};
+    DoubleVector center = {cp - from[0], ct - from[1]};
+
+    motion->arc(end, center, (arc->sweep > 0) ? ARC_CCW : ARC_CW);
+    ArcTrace result;
+    trace(cp, ct, arc->radius, &result);
+
+    printf("radius %5.1f, %6.1f deg around: off the circle by %.4f deg at most, %.2f deg/s along it, %.1f%% spread\n",
+           arc->radius, arc->sweep, result.deviation, result.speed, 100.0 * result.spread);
+    SIM_CHECK(motion->ready());
+    SIM_CHECK(result.deviation <= ARC_MAX_DEVIATION);
+    SIM_CHECK(halSimSteps(0) == panStepsFromMdeg(mdegFromDegrees(end.p)));
+    SIM_CHECK(halSimSteps(1) == tiltStepsFromMdeg(mdegFromDegrees(end.t)));
+    SIM_CHECK(motion->getPositionSteps().p == halSimSteps(0));
+    SIM_CHECK(motion->getPositionSteps().t == halSimSteps(1));
+    if(result.speed > 0)
+        SIM_CHECK(result.spread <= ARC_MAX_SPEED_SPREAD);
+}
+
+/**
+ * @brief An end point off the circle, the arc ends on the way to it and a line takes the rest
+ */
+static void checkOffCircle(MotionProcessor* motion)
+{
+    LongVector from = motion->getTargetMdeg();
+    LongVector center = {-20000, 0};
+    LongVector end = {from.p - 20000, from.t + 21000};
+
+    motion->arc(end, center, ARC_CCW);
+    SIM_CHECK(simWaitReady(ARC_LIMIT_US));
+    SIM_CHECK(halSimSteps(0) == panStepsFromMdeg(end.p));
+    SIM_CHECK(halSimSteps(1) == tiltStepsFromMdeg(end.t));
+    SIM_CHECK(motion->getTargetMdeg().p == end.p);
+    SIM_CHECK(motion->getTargetMdeg().t == end.t);
+}
+
+/**
+ * @brief G2 and G3 through the parser and the executor, relative moves coming back to where they started
+ */
+static void checkCommands(MotionProcessor* motion)
+{
+    CommandExecutor executor(motion, NULL);
+    LongVector from = motion->getTargetMdeg();
+    const char* lines[] = {"G91", "G3 P10 T10 I10", "G2 P-10 T-10 I-10", "G90"};
+    Command cmd;
+
+    for(uint8_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++){
+        SIM_CHECK(tokenizeCommand(lines[i], &cmd) == 1);
+        SIM_CHECK(executor.execute(&cmd) == 1);
+    }
+    SIM_CHECK(simWaitReady(ARC_LIMIT_US));
+    SIM_CHECK(halSimSteps(0) == panStepsFromMdeg(from.p));
+    SIM_CHECK(halSimSteps(1) == tiltStepsFromMdeg(from.t));
+    SIM_CHECK(motion->getTargetMdeg().p == from.p);
+    SIM_CHECK(motion->getTargetMdeg().t == from.t);
+}
+
+/**
+ * @brief Host time of a tick of the step interrupt while moving [ns]
+ */
+static double tickCost(unsigned long* ticks)
+{
+    HalSimIsrTime isr;
+    SIM_CHECK(simWaitReady(ARC_LIMIT_US));
+    halSimIsrTime(&isr);
+    *ticks = isr.calls;
+    return isr.totalNs / isr.calls;
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(0);
+    motion->setPanSpeed(ARC_SPEED);
+    motion->setTiltSpeed(ARC_SPEED);
+
+    for(uint8_t i = 0; i < sizeof(arcCases) / sizeof(arcCases[0]); i++)
+        checkArc(motion, &arcCases[i]);
+    checkOffCircle(motion);
+    checkCommands(motion);
+
+    // Same time on a line and around a circle, best of a few runs
+    double lineNs = 1e9, arcNs = 1e9;
+    for(uint8_t run = 0; run < 5; run++){
+        unsigned long lineTicks, arcTicks;
+        LongVector from = motion->getTargetMdeg();
+        LongVector to = {from.p + 94248, from.t};
+        LongVector center = {0, 15000};
+
+        halSimClearIsrTime();
+        motion->line(to);
+        double ns = tickCost(&lineTicks);
+        if(ns < lineNs)
+            lineNs = ns;
+
+        halSimClearIsrTime();
+        motion->arc(motion->getTargetMdeg(), center, ARC_CCW);
+        ns = tickCost(&arcTicks);
+        if(ns < arcNs)
+            arcNs = ns;
+    }
+    printf("step interrupt on the host: %.1f ns a tick on a line, %.1f ns around a circle, %.2fx\n", lineNs, arcNs, arcNs / lineNs);
+    SIM_CHECK(arcNs < ARC_MAX_COST * lineNs);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("arc");
+}
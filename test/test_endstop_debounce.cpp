@@ -0,0 +1,95 @@
+#include "SimRig.hpp"
+
+/**
+ * Glitches the pan Hall sensor while the axis moves clear of its magnet, and checks how the step
+ * interrupt's debounce takes them.
+ *
+ * - A glitch read by fewer than ENDSTOP_DEBOUNCE_TICKS ticks is rejected: no edge, no change of
+ *   the debounced state.
+ * - One read by ENDSTOP_DEBOUNCE_TICKS ticks is taken, both ways.
+ * - getEdge() gives the positions at the first tick that read each new level, for a level held
+ *   over several steps too.
+ */
+
+#define DEBOUNCE_LIMIT_US   60000000UL
+#define DEBOUNCE_MOVE       30.0            // Far from the magnet, so only the glitches are seen [Degrees]
+#define DEBOUNCE_CRUISE_US  500000UL        // Into the move, past the wake up and the ramp [us]
+#define DEBOUNCE_TICKS_US   ((unsigned long)ENDSTOP_DEBOUNCE_TICKS * STEP_TICK_US)
+#define DEBOUNCE_HELD_US    20000UL         // A few steps at the default speed [us]
+
+/**
+ * @brief Runs up to halfway between two ticks, so a glitch starting now is read by a tick for every STEP_TICK_US it lasts
+ */
+static void midTick(void)
+{
+    HalSimIsrTime time;
+    halSimIsrTime(&time);
+    unsigned long calls = time.calls;
+
+    do{
+        halSimRun(1);
+        halSimIsrTime(&time);
+    }while(time.calls == calls);
+    halSimRun(STEP_TICK_US / 2);
+}
+
+/**
+ * @brief Glitches pan for a while from halfway between two ticks, and checks the two edges it makes
+ *
+ * @return How far the axis went between the edges [Steps]
+ */
+static long glitchEdges(unsigned long us)
+{
+    StepEngine* engine = StepEngine::getInstance();
+    EndstopEdge edge;
+    uint8_t count = engine->lastEdge(0, &edge);
+
+    midTick();
+    long enterAt = engine->getPosition(0);
+    halSimGlitch(0, us);
+    halSimRun(us);
+    SIM_CHECK(engine->endstops() & 0x01);
+    SIM_CHECK((uint8_t)(engine->lastEdge(0, &edge) - count) == 1);
+    SIM_CHECK(edge.entered && (edge.position == enterAt));
+
+    long leaveAt = engine->getPosition(0);
+    halSimRun(4 * DEBOUNCE_TICKS_US);
+    SIM_CHECK(!(engine->endstops() & 0x01));
+    SIM_CHECK((uint8_t)(engine->lastEdge(0, &edge) - count) == 2);
+    SIM_CHECK(!edge.entered && (edge.position == leaveAt));
+    SIM_CHECK(engine->getEdge(0, 1) == enterAt);
+    SIM_CHECK(engine->getEdge(0, 0) == leaveAt);
+    return labs(leaveAt - enterAt);
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(1);
+    StepEngine* engine = StepEngine::getInstance();
+    EndstopEdge edge;
+
+    DoubleVector target = {DEBOUNCE_MOVE, 0};
+    motion->line(target);
+    halSimRun(DEBOUNCE_CRUISE_US);
+    SIM_CHECK(engine->busy());
+    SIM_CHECK(!(engine->endstops() & 0x01));
+    uint8_t count = engine->lastEdge(0, &edge);
+
+    // One tick short of the debounce
+    midTick();
+    halSimGlitch(0, DEBOUNCE_TICKS_US - STEP_TICK_US);
+    halSimRun(DEBOUNCE_TICKS_US);
+    SIM_CHECK(!(engine->endstops() & 0x01));
+    halSimRun(4 * DEBOUNCE_TICKS_US);
+    SIM_CHECK(engine->lastEdge(0, &edge) == count);
+
+    // Read by just as many ticks as the debounce, then held over a few steps
+    glitchEdges(DEBOUNCE_TICKS_US);
+    long held = glitchEdges(DEBOUNCE_HELD_US);
+    printf("level held %lu us: edges %ld steps apart\n", DEBOUNCE_HELD_US, held);
+    SIM_CHECK(held > 0);
+
+    SIM_CHECK(simWaitReady(DEBOUNCE_LIMIT_US));
+    SIM_CHECK(halSimMissed(0) == 0);
+    return simDone("endstop_debounce");
+}
@@ -0,0 +1,94 @@
+#include "SimRig.hpp"
+#include "LinkRig.hpp"
+
+/**
+ * A binary frame arriving in the middle of a text line, read the way serviceSerial() in main.ino
+ * reads the serial buffer.
+ *
+ * - The frame's command is queued as sent, the text line it cut short is dropped, and so is the
+ *   rest of that line once the frame is over.
+ * - The text lines after it and a frame between two lines are queued as usual.
+ */
+
+static CommandQueue commands;
+static CommandParser parser(&commands);
+static FrameLink frameLink(&commands, linkBoardSend, linkBoardRoom);
+
+/**
+ * @brief Sends text as it is, a byte at a time on the line
+ */
+static void sendText(const char* text)
+{
+    linkHostSend((const uint8_t*)text, strlen(text));
+}
+
+/**
+ * @brief Sends a frame holding a move of both axes
+ */
+static void sendMove(uint8_t sequence, int32_t pan, int32_t tilt)
+{
+    Command cmd;
+    cmd.op = CMD_MOVE;
+    cmd.argMask = ARG_P_BIT | ARG_T_BIT;
+    cmd.args[ARG_P] = pan;
+    cmd.args[ARG_T] = tilt;
+
+    uint8_t record[FRAME_RECORD_MAX];
+    uint8_t frame[FRAME_MAX_LENGTH];
+    uint8_t n = encodeCommand(&cmd, record);
+    linkHostSend(frame, writeFrame(sequence, record, n, frame));
+}
+
+/**
+ * @brief Takes the next command off the queue, checking it's a move to the given millidegrees
+ */
+static void checkMove(int32_t pan, int32_t tilt)
+{
+    const Command* cmd = commands.borrowCommand();
+    SIM_CHECK(cmd != NULL);
+    if(cmd == NULL)
+        return;
+    SIM_CHECK(cmd->op == CMD_MOVE);
+    SIM_CHECK(cmd->argMask == (ARG_P_BIT | ARG_T_BIT));
+    SIM_CHECK((cmd->args[ARG_P] == pan) && (cmd->args[ARG_T] == tilt));
+    commands.releaseCommand();
+}
+
+int main(void)
+{
+    simRig(0);
+    linkReset(0);
+
+    // The frame lands in the middle of the number of a word, the line would have been "G1 P10 T3"
+    sendText("G1 P1");
+    sendMove(0, 5000, -2000);
+    sendText("0 T3\n");
+    linkPipe();
+    linkBoardRead(&commands, &parser, &frameLink);
+    SIM_CHECK(commands.numCommands() == 1);
+    checkMove(5000, -2000);
+
+    // Cut short after a word, the rest of the line starting with a letter is no command either
+    sendText("G1 P7 ");
+    sendMove(1, -1500, 250);
+    sendText("T3\nG1 P7 T-1.5\n");
+    linkPipe();
+    linkBoardRead(&commands, &parser, &frameLink);
+    SIM_CHECK(commands.numCommands() == 2);
+    checkMove(-1500, 250);
+    checkMove(7000, -1500);
+
+    // A frame between two lines leaves both of them as they are
+    sendText("G1 P1 T2\n");
+    sendMove(2, 3000, 4000);
+    sendText("G1 P5 T6\n");
+    linkPipe();
+    linkBoardRead(&commands, &parser, &frameLink);
+    SIM_CHECK(commands.numCommands() == 3);
+    checkMove(1000, 2000);
+    checkMove(3000, 4000);
+    checkMove(5000, 6000);
+    SIM_CHECK(commands.isEmpty());
+
+    return simDone("frame_midline");
+}
@@ -0,0 +1,90 @@
+#include <math.h>
+#include "SimRig.hpp"
+
+/**
+ * Homes the head against magnets placed all around the turn, of a few widths, and checks
+ * how precisely homing finds their centers.
+ *
+ * - Both axes end within a step of the center of their magnet, whichever side of the
+ *   magnet they start from and however far it is.
+ * - The position homing gives to the center is the home offset, to the step.
+ * - A move to the origin afterwards lands the offset away from the center.
+ */
+
+#define HOMING_LIMIT_US     60000000UL
+
+struct MagnetCase
+{
+    double pan;                             // Center of the pan magnet [Degrees]
+    double tilt;                            // Center of the tilt magnet [Degrees]
+    double width;                           // Width of both magnets [Degrees]
+    LongVector offset;                      // Home offset [Millidegrees]
+};
+
+static const MagnetCase cases[] = {
+    {SIM_PAN_MAGNET, SIM_TILT_MAGNET, SIM_MAGNET_WIDTH, {0, 0}},
+    {-5.0, 3.0, 2.0, {0, 0}},
+    {359.0, -170.0, 6.5, {0, 0}},
+    {10.011, 0.37, 0.3, {0, 0}},
+    {200.0, 90.0, 4.0, {12500, -3000}},
+};
+#define NUM_OF_CASES    (sizeof(cases) / sizeof(cases[0]))
+
+// Distance from an angle to the center of a magnet, wrapped to [-180, 180) [Degrees]
+static double fromCenter(double angle, double center)
+{
+    double d = fmod(angle - center + 180.0, 360.0);
+    if(d < 0)
+        d += 360.0;
+    return d - 180.0;
+}
+
+static uint8_t waitHomed(void)
+{
+    unsigned long start = halSimTime();
+
+    while(StepEngine::getInstance()->homingState() < HOMING_DONE){
+        if(halSimTime() - start > HOMING_LIMIT_US)
+            return 0;
+        halSimRun(STEP_TICK_US);
+    }
+    return simWaitReady(HOMING_LIMIT_US);
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(1);
+    StepEngine* engine = StepEngine::getInstance();
+
+    for(unsigned i = 0; i < NUM_OF_CASES; i++){
+        const MagnetCase* c = &cases[i];
+        halSimMagnet(0, c->pan, c->width, !HALL_MAG_DETECTED);
+        halSimMagnet(1, c->tilt, c->width, !HALL_MAG_DETECTED);
+        motion->setHomeOffset(c->offset);
+
+        motion->home();
+        SIM_CHECK(waitHomed());
+        SIM_CHECK(engine->homingState() == HOMING_DONE);
+
+        double pan = fromCenter(halSimAngle(0), c->pan);
+        double tilt = fromCenter(halSimAngle(1), c->tilt);
+        printf("magnets %8.3f %8.3f, %.1f wide: off center by %+.4f %+.4f degrees\n", c->pan, c->tilt, c->width, pan, tilt);
+        SIM_CHECK(fabs(pan) <= PAN_STEPRATE);
+        SIM_CHECK(fabs(tilt) <= TILT_STEPRATE);
+
+        LongVector steps = motion->getPositionSteps();
+        SIM_CHECK(steps.p == lround(c->offset.p / 1000.0 / PAN_STEPRATE));
+        SIM_CHECK(steps.t == lround(c->offset.t / 1000.0 / TILT_STEPRATE));
+
+        // The origin is the offset away from the centers
+        DoubleVector origin = {0, 0};
+        motion->line(origin);
+        SIM_CHECK(simWaitReady(HOMING_LIMIT_US));
+        SIM_CHECK(fabs(fromCenter(halSimAngle(0), c->pan) + c->offset.p / 1000.0) <= 2 * PAN_STEPRATE);
+        SIM_CHECK(fabs(fromCenter(halSimAngle(1), c->tilt) + c->offset.t / 1000.0) <= 2 * TILT_STEPRATE);
+    }
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("homing");
+}
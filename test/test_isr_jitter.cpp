@@ -0,0 +1,104 @@
+#include <math.h>
+#include "SimRig.hpp"
+
+/**
+ * Measures the step interrupt on the simulated timer: how evenly it spaces the steps and how
+ * long a call takes on the host.
+ *
+ * - While a move cruises, the steps of the axis going furthest are never more than a tick
+ *   off where a constant rate would put them, and the other axis never more than one of
+ *   those steps plus a tick, as the Bresenham error accumulators step it.
+ * - The STEP pulses are all as wide.
+ * - The worst and average time of a call on the host, a bound on the fixed cost per tick.
+ */
+
+#define JITTER_PAN          90.0        // Move measured [Degrees]
+#define JITTER_TILT         37.5
+#define JITTER_SPEED        20.0        // Below the coarse speeds, so every pulse is a microstep [Degrees/Sec]
+
+typedef struct {
+    unsigned long steps;
+    double period;                      // Mean time between steps [us]
+    double worst;                       // Furthest a step is from the constant rate [us]
+    unsigned long minWidth;             // Narrowest and widest STEP pulse [us]
+    unsigned long maxWidth;
+} Jitter;
+
+/**
+ * @brief Fits the rising edges of a STEP pin in the middle third of the log, the cruise of a long move,
+ *        to a constant rate and gets how far off it they are
+ */
+static void measure(uint8_t pin, Jitter* jitter)
+{
+    static unsigned long rise[HAL_SIM_EDGES];
+    unsigned long n = 0, high = 0;
+
+    jitter->minWidth = ~0UL;
+    jitter->maxWidth = 0;
+    for(unsigned long i = 0; i < halSimNumEdges(); i++){
+        const HalSimEdge* edge = halSimEdge(i);
+        if(edge->pin != pin)
+            continue;
+        if(edge->value){
+            rise[n++] = edge->time;
+            high = edge->time;
+        }
+        else if(n > 0){
+            unsigned long width = edge->time - high;
+            if(width < jitter->minWidth)
+                jitter->minWidth = width;
+            if(width > jitter->maxWidth)
+                jitter->maxWidth = width;
+        }
+    }
+
+    unsigned long first = n / 3, last = 2 * n / 3;
+    jitter->steps = n;
+    jitter->period = (double)(rise[last] - rise[first]) / (last - first);
+    jitter->worst = 0;
+    for(unsigned long i = first; i <= last; i++){
+        double off = fabs((double)(rise[i] - rise[first]) - (i - first) * jitter->period);
+        if(off > jitter->worst)
+            jitter->worst = off;
+    }
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(0);
+    motion->setPanSpeed(JITTER_SPEED);
+    motion->setTiltSpeed(JITTER_SPEED);
+
+    halSimClearEdges();
+    halSimClearIsrTime();
+    DoubleVector target = {JITTER_PAN, JITTER_TILT};
+    motion->line(target);
+    SIM_CHECK(simWaitReady(60000000UL));
+    SIM_CHECK(halSimNumEdges() < HAL_SIM_EDGES);
+
+    Jitter pan, tilt;
+    measure(PAN_STEP_PIN, &pan);
+    measure(TILT_STEP_PIN, &tilt);
+    printf("pan:  %lu steps, period %.1f us, worst %.1f us off the rate, pulses %lu to %lu us wide\n",
+           pan.steps, pan.period, pan.worst, pan.minWidth, pan.maxWidth);
+    printf("tilt: %lu steps, period %.1f us, worst %.1f us off the rate, pulses %lu to %lu us wide\n",
+           tilt.steps, tilt.period, tilt.worst, tilt.minWidth, tilt.maxWidth);
+
+    SIM_CHECK(pan.steps == lround(JITTER_PAN / PAN_STEPRATE));
+    SIM_CHECK(tilt.steps == lround(JITTER_TILT / TILT_STEPRATE));
+    SIM_CHECK(fabs(pan.period - PAN_STEPRATE / JITTER_SPEED * 1e6) <= 1.0);
+    SIM_CHECK(pan.worst <= STEP_TICK_US);
+    SIM_CHECK(tilt.worst <= pan.period + STEP_TICK_US);
+    SIM_CHECK(pan.minWidth == pan.maxWidth);
+    SIM_CHECK(tilt.minWidth == tilt.maxWidth);
+
+    HalSimIsrTime isr;
+    halSimIsrTime(&isr);
+    printf("step interrupt on the host: %lu calls, %.1f ns avg, %lu ns worst\n",
+           isr.calls, isr.totalNs / isr.calls, isr.worstNs);
+    SIM_CHECK(isr.calls > 0);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("isr_jitter");
+}
@@ -0,0 +1,27 @@
+#include <math.h>
+#include "SimRig.hpp"
+
+/**
+ * Smoke test of the host build: a move queued through the motion processor ends with the
+ * simulated motors where it was asked to, with no step lost to a driver still waking up.
+ */
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(0);
+
+    DoubleVector target = {30.0, -10.0};
+    motion->line(target);
+    SIM_CHECK(simWaitReady(10000000UL));
+
+    SIM_CHECK(fabs(halSimAngle(0) - target.p) <= PAN_STEPRATE);
+    SIM_CHECK(fabs(halSimAngle(1) - target.t) <= TILT_STEPRATE);
+
+    LongVector steps = motion->getPositionSteps();
+    SIM_CHECK(steps.p == halSimSteps(0));
+    SIM_CHECK(steps.t == halSimSteps(1));
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+
+    return simDone("motion");
+}
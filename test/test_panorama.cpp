@@ -0,0 +1,172 @@
+#include <math.h>
+#include "SimRig.hpp"
+#include "../inc/CommandExecutor.hpp"
+#include "../inc/CommandParser.hpp"
+#include "../inc/Frame.hpp"
+#include "../inc/Kinematics.hpp"
+#include "../inc/MotorPower.hpp"
+#include "../inc/Trigger.hpp"
+
+/**
+ * M422 and M423 shoot a panorama from the main loop, the way main.ino wires it.
+ *
+ * - Every frame is shot once, where the grid puts it, at rest and after the settle time, and the
+ *   next move waits for the exposure.
+ * - Neighbouring frames overlap at least as set, the outer frames are centered on the corners.
+ * - Serpentine and minimum travel orders only ever move to a neighbour, the minimum travel order
+ *   goes by columns when the tilt moves are the quicker ones.
+ * - The ops past the first record byte's bits go through the binary protocol.
+ */
+
+#define PANO_LIMIT_US       120000000UL     // Longest a panorama may take [us]
+#define PANO_LOOP_US        1000UL          // Period of the main loop [us]
+
+static Panorama* panorama;
+static CommandExecutor* executor;
+
+static void send(const char* text)
+{
+    Command cmd;
+    SIM_CHECK(tokenizeCommand(text, &cmd) == 1);
+    SIM_CHECK(executor->execute(&cmd) == 1);
+}
+
+/**
+ * @brief Runs the main loop until the panorama is done, checking every shot against the grid
+ *
+ * @return Frames that weren't where the grid puts them, or shot before the settle time
+ */
+static unsigned long runPanorama(unsigned long settleMs)
+{
+    Trigger* trigger = Trigger::getInstance();
+    unsigned long fired = trigger->getFired();
+    unsigned long wrong = 0, lastMove = halSimTime();
+    unsigned long start = halSimTime();
+
+    while((panorama->getState() != PANO_DONE) && (halSimTime() - start < PANO_LIMIT_US)){
+        MotorPower::getInstance()->service();
+        panorama->service();
+        halSimRun(PANO_LOOP_US);
+
+        if(!MotionProcessor::getInstance()->ready())
+            lastMove = halSimTime();
+        if(trigger->getFired() == fired)
+            continue;
+
+        LongVector pos;
+        fired = trigger->getFired();
+        SIM_CHECK(panorama->frameAt(panorama->getShot(), &pos));
+        if((trigger->getShotPosition(0) != panStepsFromMdeg(pos.p)) || (trigger->getShotPosition(1) != tiltStepsFromMdeg(pos.t)))
+            wrong++;
+        if(halSimTime() - lastMove < settleMs * 1000UL)
+            wrong++;
+    }
+    return wrong;
+}
+
+/**
+ * @brief Checks every move of the last panorama, started with these extents, is to a neighbour in the grid
+ */
+static void checkNeighbours(long panExtent, long tiltExtent)
+{
+    long pitch[2] = {0, 0};
+    LongVector prev, pos;
+
+    if(panorama->getColumns() > 1)
+        pitch[0] = labs(panExtent) / (long)(panorama->getColumns() - 1);
+    if(panorama->getRows() > 1)
+        pitch[1] = labs(tiltExtent) / (long)(panorama->getRows() - 1);
+
+    SIM_CHECK(panorama->frameAt(0, &prev));
+    unsigned long jumps = 0;
+    for(unsigned long i = 1; panorama->frameAt(i, &pos); i++){
+        long dp = labs(pos.p - prev.p), dt = labs(pos.t - prev.t);
+        if(!(((dp <= pitch[0] + 1) && (dt == 0)) || ((dp == 0) && (dt <= pitch[1] + 1))))
+            jumps++;
+        prev = pos;
+    }
+    SIM_CHECK(jumps == 0);
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(0);
+    panorama = new Panorama(motion);
+    executor = new CommandExecutor(motion, NULL, panorama);
+    Trigger::getInstance()->setPulse(20000);
+
+    // 12x8 deg frames overlapping by a quarter, 40x20 deg from here, a tenth of a second to settle and 50 ms exposures
+    LongVector from = motion->getTargetMdeg();
+    send("M422 P12 T8 I0.25 J0");
+    send("M423 P40 T-20 I0.1 J0.05");
+    SIM_CHECK(panorama->getColumns() == 6);
+    SIM_CHECK(panorama->getRows() == 5);
+    SIM_CHECK(40.0 / (panorama->getColumns() - 1) <= 12.0 * 0.75);
+    SIM_CHECK(20.0 / (panorama->getRows() - 1) <= 8.0 * 0.75);
+
+    unsigned long fired = Trigger::getInstance()->getFired();
+    SIM_CHECK(runPanorama(100) == 0);
+    SIM_CHECK(panorama->getState() == PANO_DONE);
+    SIM_CHECK(Trigger::getInstance()->getFired() - fired == 30);
+    SIM_CHECK(Trigger::getInstance()->getBlocked() == 0);
+    checkNeighbours(40000, -20000);
+
+    LongVector pos;
+    SIM_CHECK(panorama->frameAt(0, &pos));
+    SIM_CHECK((pos.p == from.p) && (pos.t == from.t));
+    SIM_CHECK(panorama->frameAt(29, &pos));
+    SIM_CHECK((pos.p == from.p + 40000) && (pos.t == from.t - 20000));     // 5 rows, the last one left to right
+    SIM_CHECK(!panorama->frameAt(30, &pos));
+
+    // Tilt slower than pan, the minimum travel order goes row by row
+    motion->setPanSpeed(30);
+    motion->setTiltSpeed(5);
+    send("M422 P5 T5 I0.2 J1");
+    send("M423 P20 T20");
+    SIM_CHECK(!panorama->byColumns());
+    panorama->stop();
+
+    // Tilt quicker, column by column, 6 of them so the head ends on the far column's first row
+    motion->setPanSpeed(5);
+    motion->setTiltSpeed(30);
+    from = motion->getTargetMdeg();
+    send("M423 P20 T20");
+    SIM_CHECK(panorama->byColumns());
+    SIM_CHECK(panorama->getColumns() == 6);
+    checkNeighbours(20000, 20000);
+    SIM_CHECK(runPanorama(0) == 0);
+    SIM_CHECK(simWaitReady(PANO_LIMIT_US));
+    SIM_CHECK(halSimSteps(0) == panStepsFromMdeg(from.p + 20000));
+    SIM_CHECK(halSimSteps(1) == tiltStepsFromMdeg(from.t));
+
+    // The rows order goes back to the start of every row
+    send("M422 J2");
+    send("M423 P10 T10");
+    SIM_CHECK(panorama->frameAt(panorama->getColumns(), &pos));
+    SIM_CHECK(pos.p == motion->getTargetMdeg().p);
+
+    // Stopped without arguments, a frame that can't be is left out
+    send("M423");
+    SIM_CHECK(panorama->getState() == PANO_IDLE);
+    send("M422 P0");
+    SIM_CHECK(panorama->getFov(0) == 5000);
+    send("M422 P10 I0.95");
+    SIM_CHECK(panorama->getOverlap() == 200);
+
+    // Ops past FRAME_OP_MASK take a byte of their own in a frame
+    Command cmd, decoded;
+    uint8_t record[FRAME_RECORD_MAX];
+    SIM_CHECK(tokenizeCommand("M423 P-40.5 T20 I0.1 J0.05", &cmd) == 1);
+    SIM_CHECK(cmd.op > FRAME_OP_MASK);
+    uint8_t n = encodeCommand(&cmd, record);
+    SIM_CHECK(n == FRAME_RECORD_MAX);
+    SIM_CHECK(decodeCommand(record, n, &decoded) == n);
+    SIM_CHECK((decoded.op == cmd.op) && (decoded.argMask == cmd.argMask) && (decoded.args[ARG_P] == -40500));
+    SIM_CHECK(decodeCommand(record, 1, &decoded) == 0);
+    SIM_CHECK(tokenizeCommand("G1 P10", &cmd) == 1);
+    SIM_CHECK(encodeCommand(&cmd, record) == 5);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("panorama");
+}
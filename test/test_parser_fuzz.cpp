@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../inc/CommandParser.hpp"
+
+/**
+ * Fuzzes the command parser and measures how fast it goes. Built with the undefined
+ * behavior sanitizer, so an overflow in the number accumulation fails the test.
+ *
+ * - Numbers at the edge of the 32 bit fixed-point range are taken or rejected, never wrapped.
+ * - A line of more than 255 words keeps its command code.
+ * - Well formed moves with random numbers of any length match a reference parse.
+ * - Random bytes never finish a command with an unknown op or argument.
+ *
+ * Pass a number of lines to run more than the default.
+ */
+
+#define FUZZ_DEFAULT_LINES  200000UL
+#define BENCH_BYTES         (8UL * 1024 * 1024)
+
+static unsigned long failures;
+static uint32_t seed = 12345;
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+}while(0)
+
+static uint32_t nextRandom(void)
+{
+    seed = seed * 1664525UL + 1013904223UL;
+    return seed >> 8;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------------------------------------
+ *  @brief Parses an argument the slow way, from the whole text
+ *
+ *  @param[in]  text  Number, with an optional sign and decimal point
+ *  @param[out] value [1/FIXED_SCALE]
+ *
+ *  @return 0 if it doesn't fit an argument, 1 otherwise
+ * ----------------------------------------------------------------------------------------------------------------------------------
+*/
+static uint8_t referenceNumber(const char* text, long long* value)
+{
+    long long whole = 0, fraction = 0;
+    int decimals = 0, negative = 0, dot = 0;
+
+    if((*text == '-') || (*text == '+'))
+        negative = (*text++ == '-');
+    for(; *text != '\0'; text++){
+        if(*text == '.'){
+            dot = 1;
+            continue;
+        }
+        if(!dot){
+            if(whole < 100000000000LL)
+                whole = whole * 10 + (*text - '0');
+        }
+        else if(decimals < 3){
+            fraction = fraction * 10 + (*text - '0');
+            decimals++;
+        }
+    }
+    while(decimals++ < 3)
+        fraction *= 10;
+
+    long long v = whole * FIXED_SCALE + fraction;
+    if(whole * FIXED_SCALE + (FIXED_SCALE - 1) > 2147483647LL)
+        return 0;
+    *value = negative ? -v : v;
+    return 1;
+}
+
+static void randomNumber(char* out)
+{
+    int n = 0;
+    uint32_t r = nextRandom();
+
+    if(r & 0x01)
+        out[n++] = '-';
+    int whole = 1 + nextRandom() % 14;
+    for(int i = 0; i < whole; i++)
+        out[n++] = '0' + nextRandom() % 10;
+    if(r & 0x02){
+        out[n++] = '.';
+        int decimals = nextRandom() % 6;
+        for(int i = 0; i < decimals; i++)
+            out[n++] = '0' + nextRandom() % 10;
+    }
+    out[n] = '\0';
+}
+
+static void testEdges(void)
+{
+    Command cmd;
+
+    CHECK(tokenizeCommand("G1 P2147482.999 T-2147482.999", &cmd) == 1);
+    CHECK(cmd.args[ARG_P] == 2147482999L);
+    CHECK(cmd.args[ARG_T] == -2147482999L);
+    CHECK(tokenizeCommand("G1 P2147483", &cmd) == 0);
+    CHECK(tokenizeCommand("G1 P-2147483", &cmd) == 0);
+    CHECK(tokenizeCommand("G1 P99999999999999999999999999", &cmd) == 0);
+    CHECK(tokenizeCommand("M99999999999999999999999999", &cmd) == 0);
+    CHECK(tokenizeCommand("G1 P0000000000000000000000000012.5", &cmd) == 1);
+    CHECK(cmd.args[ARG_P] == 12500);
+}
+
+static void testManyWords(void)
+{
+    static char line[2048];
+    Command cmd;
+    int n = sprintf(line, "M17");
+
+    for(int i = 0; i < 300; i++)
+        n += sprintf(line + n, " P%d", i);
+    CHECK(tokenizeCommand(line, &cmd) == 1);
+    CHECK(cmd.op == CMD_ENABLE);
+    CHECK(cmd.args[ARG_P] == 299L * FIXED_SCALE);
+}
+
+static void testReference(unsigned long lines)
+{
+    char p[32], t[32], line[80];
+    Command cmd;
+
+    for(unsigned long i = 0; i < lines; i++){
+        randomNumber(p);
+        randomNumber(t);
+        sprintf(line, "G1 P%s T%s", p, t);
+
+        long long vp = 0, vt = 0;
+        uint8_t fits = referenceNumber(p, &vp) && referenceNumber(t, &vt);
+        uint8_t result = tokenizeCommand(line, &cmd);
+        CHECK(result == fits);
+        if(result && fits){
+            CHECK(cmd.args[ARG_P] == vp);
+            CHECK(cmd.args[ARG_T] == vt);
+        }
+        if(failures > 10)
+            return;
+    }
+}
+
+static void testRandomBytes(unsigned long lines)
+{
+    static const char alphabet[] = "GMPTIJgmptXZ0123456789.-+ \t;(";
+    static const char* const codes[] = {"G1 ", "G2", "G28", "G91", "M18", "M84 ", "M203", "M431 "};
+    CommandQueue queue;
+    CommandParser parser(&queue);
+    unsigned long done = 0;
+
+    for(unsigned long i = 0; i < lines; i++){
+        // Half the lines start with a valid code, so the random bytes get to its arguments
+        const char* code = (nextRandom() & 0x01) ? codes[nextRandom() % (sizeof(codes) / sizeof(codes[0]))] : "";
+        for(; *code != '\0'; code++)
+            parser.parse(*code);
+
+        int length = nextRandom() % 48;
+        for(int j = 0; j <= length; j++){
+            char c = (j == length) ? '\n' : alphabet[nextRandom() % (sizeof(alphabet) - 1)];
+            if(parser.parse(c) != PARSE_DONE)
+                continue;
+
+            const Command* cmd = queue.borrowCommand();
+            CHECK(cmd != NULL);
+            if(cmd != NULL){
+                CHECK((cmd->op > CMD_NONE) && (cmd->op < NUM_OF_OPS));
+                CHECK(cmd->argMask < (1 << NUM_OF_ARGS));
+                queue.releaseCommand();
+            }
+            done++;
+        }
+        if(failures > 10)
+            return;
+    }
+    CHECK(queue.isEmpty());
+    printf("random bytes: %lu lines, %lu commands finished\n", lines, done);
+}
+
+static void benchThroughput(void)
+{
+    static const char stream[] = "G1 P12.345 T-6.789\nG91\nM203 P30 T20\nG1 P10 T0\n";
+    CommandQueue queue;
+    CommandParser parser(&queue);
+    unsigned long bytes = 0, commands = 0;
+
+    clock_t start = clock();
+    while(bytes < BENCH_BYTES){
+        for(const char* c = stream; *c != '\0'; c++){
+            if(parser.parse(*c) == PARSE_DONE){
+                queue.borrowCommand();
+                queue.releaseCommand();
+                commands++;
+            }
+        }
+        bytes += sizeof(stream) - 1;
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if(seconds <= 0)
+        seconds = 1e-9;
+    printf("throughput: %lu bytes, %lu commands in %.3f s, %.1f ns/byte, %.2f Mcommands/s\n",
+           bytes, commands, seconds, seconds * 1e9 / bytes, commands / seconds / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long lines = (argc > 1) ? strtoul(argv[1], NULL, 10) : FUZZ_DEFAULT_LINES;
+
+    testEdges();
+    testManyWords();
+    testReference(lines);
+    testRandomBytes(lines);
+    benchThroughput();
+
+    printf("parser_fuzz: %s, %lu failed checks\n", failures ? "FAILED" : "passed", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#include <math.h>
+#include "SimRig.hpp"
+#include "../inc/CommandExecutor.hpp"
+#include "../inc/CommandParser.hpp"
+
+/**
+ * M18, and M84 without arguments, sent while a move runs leave its drivers on until it's done,
+ * then turn them off. A move sent after them turns the drivers back on.
+ */
+
+static CommandExecutor* executor;
+
+static void send(const char* text)
+{
+    Command cmd;
+    SIM_CHECK(tokenizeCommand(text, &cmd) == 1);
+    SIM_CHECK(executor->execute(&cmd) == 1);
+}
+
+// Runs the main loop's power servicing until the moves are done, counting the ticks a moving axis was off
+static unsigned long runMoves(void)
+{
+    MotionProcessor* motion = MotionProcessor::getInstance();
+    MotorPower* power = MotorPower::getInstance();
+    unsigned long offWhileMoving = 0;
+    unsigned long start = halSimTime();
+
+    while(!motion->ready() && (halSimTime() - start < 60000000UL)){
+        power->service();
+        halSimRun(STEP_TICK_US);
+        if(StepEngine::getInstance()->busy() && !(power->enabled() & 0x01))
+            offWhileMoving++;
+    }
+    power->service();
+    return offWhileMoving;
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(0);
+    MotorPower* power = MotorPower::getInstance();
+    executor = new CommandExecutor(motion);
+
+    // The tilt has nothing queued, so only it is turned off right away
+    send("G1 P30");
+    send("M18");
+    SIM_CHECK(power->enabled() == 0x01);
+    SIM_CHECK(runMoves() == 0);
+    SIM_CHECK(power->enabled() == 0);
+    SIM_CHECK(fabs(halSimAngle(0) - 30.0) <= PAN_STEPRATE);
+
+    // A move queued after it wakes the drivers up again and keeps them
+    send("G1 P0 T5");
+    send("M84");
+    send("G1 P10 T0");
+    SIM_CHECK(runMoves() == 0);
+    SIM_CHECK(power->enabled() == 0x03);
+    SIM_CHECK(fabs(halSimAngle(0) - 10.0) <= PAN_STEPRATE);
+    SIM_CHECK(fabs(halSimAngle(1)) <= TILT_STEPRATE);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("power_defer");
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include "../inc/CommandQueue.hpp"
+#include "../inc/MotionQueue.hpp"
+
+/**
+ * Pushes millions of entries through the command queue and the motion queue, the producer
+ * and the consumer each on their own thread, as the serial interrupt, the main loop and the
+ * step interrupt would. Built with the thread sanitizer, so a race on a slot or an index
+ * fails the test.
+ *
+ * - Every entry comes out once, in the order it went in, with the content it was written with.
+ * - Commands go in both tokenized and as text, tokenized on commit.
+ * - Neither side ever takes a lock or turns interrupts off, they spin on full and empty.
+ *
+ * Pass a number of entries to push through each queue.
+ */
+
+#define STRESS_DEFAULT_COUNT    2000000UL
+#define STRESS_TEXT_EVERY       16      // One command in this many goes in as text
+
+static unsigned long failures;
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+}while(0)
+
+static void produceCommands(CommandQueue* queue, unsigned long count, unsigned long* full)
+{
+    for(unsigned long seq = 0; seq < count; seq++){
+        CommandSlot* slot;
+        while((slot = queue->reserveCommand()) == NULL){
+            (*full)++;
+            std::this_thread::yield();
+        }
+
+        if(seq % STRESS_TEXT_EVERY == 0){
+            snprintf(slot->text, COMMAND_TEXT_LENGTH, "G1 P%lu T-1", seq % 1000000UL);
+        }
+        else{
+            slot->state = SLOT_TOKEN;
+            slot->cmd.op = CMD_MOVE;
+            slot->cmd.argMask = ARG_P_BIT | ARG_T_BIT;
+            slot->cmd.args[ARG_P] = (int32_t)seq;
+            slot->cmd.args[ARG_T] = ~(int32_t)seq;
+        }
+        queue->commitCommand();
+    }
+}
+
+static unsigned long consumeCommands(CommandQueue* queue, unsigned long count)
+{
+    unsigned long bad = 0;
+
+    for(unsigned long seq = 0; seq < count; seq++){
+        const Command* cmd;
+        while((cmd = queue->borrowCommand()) == NULL)
+            std::this_thread::yield();
+
+        uint8_t ok = (cmd->op == CMD_MOVE) && (cmd->argMask == (ARG_P_BIT | ARG_T_BIT));
+        if(seq % STRESS_TEXT_EVERY == 0)
+            ok = ok && (cmd->args[ARG_P] == (int32_t)(seq % 1000000UL) * FIXED_SCALE) && (cmd->args[ARG_T] == -FIXED_SCALE);
+        else
+            ok = ok && (cmd->args[ARG_P] == (int32_t)seq) && (cmd->args[ARG_T] == ~(int32_t)seq);
+        if(!ok && (bad++ < 10))
+            printf("command %lu came out wrong: op %u P %ld T %ld\n", seq, cmd->op, (long)cmd->args[ARG_P], (long)cmd->args[ARG_T]);
+
+        queue->releaseCommand();
+    }
+    return bad;
+}
+
+static void produceBlocks(MotionQueue* queue, unsigned long count, unsigned long* full)
+{
+    for(unsigned long seq = 0; seq < count; seq++){
+        MotionBlock* block;
+        while((block = queue->tailBlock()) == NULL){
+            (*full)++;
+            std::this_thread::yield();
+        }
+
+        block->step.events = seq;
+        block->dir[0] = (uint8_t)seq;
+        block->dir[1] = (uint8_t)~seq;
+        block->length = (double)seq;
+        queue->pushBlock();
+    }
+}
+
+static unsigned long consumeBlocks(MotionQueue* queue, unsigned long count)
+{
+    unsigned long bad = 0;
+
+    for(unsigned long seq = 0; seq < count; seq++){
+        MotionBlock* block;
+        while((block = queue->headBlock()) == NULL)
+            std::this_thread::yield();
+
+        // The step interrupt marks the block it loaded, the producer clears the mark on push
+        uint8_t ok = (block->flags == 0) && (block->step.events == seq) && (block->dir[0] == (uint8_t)seq) &&
+                     (block->dir[1] == (uint8_t)~seq) && (block->length == (double)seq);
+        if(!ok && (bad++ < 10))
+            printf("block %lu came out wrong: events %lu length %.0f\n", seq, (unsigned long)block->step.events, block->length);
+
+        block->flags |= BLOCK_BUSY;
+        queue->popBlock();
+    }
+    return bad;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 10) : STRESS_DEFAULT_COUNT;
+    unsigned long full = 0, bad = 0;
+
+    CommandQueue commands;
+    std::thread commandProducer(produceCommands, &commands, count, &full);
+    bad = consumeCommands(&commands, count);
+    commandProducer.join();
+    printf("command queue: %lu commands, %lu wrong, producer found it full %lu times\n", count, bad, full);
+    CHECK(bad == 0);
+    CHECK(commands.isEmpty());
+
+    MotionQueue* blocks = MotionQueue::getInstance();
+    full = 0;
+    std::thread blockProducer(produceBlocks, blocks, count, &full);
+    bad = consumeBlocks(blocks, count);
+    blockProducer.join();
+    printf("motion queue: %lu blocks, %lu wrong, producer found it full %lu times\n", count, bad, full);
+    CHECK(bad == 0);
+    CHECK(blocks->isEmpty());
+
+    printf("queue_stress: %s, %lu failed checks\n", failures ? "FAILED" : "passed", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
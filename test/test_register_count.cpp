@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * Counts the register and flash accesses of a step, of setting the direction and of reading
+ * the endstop, through StepperMotor and its digitalWrite()/digitalRead() against the
+ * FastStepperMotor the step interrupt uses.
+ *
+ * The ports of the ATmega328P are mocked with registers that count how they're accessed:
+ * single bit set/clear and in/out on a fixed address are what the compiler makes of FastPin
+ * and FastMotorGroup, loads and stores through a pointer what the Arduino core does after
+ * looking the pin up in its flash tables. The hal is implemented here the way the core
+ * implements digitalWrite() and digitalRead(), PWM check and interrupt guard included.
+ * Cycles are a lower bound from the AVR instruction timings, arithmetic and branches aren't
+ * counted.
+ *
+ * Compares each StepperMotor call, and both axes stepped through FastMotorGroup as the step
+ * interrupt does it against two StepperMotor::hardStep(dir). Checks that both drive the pins
+ * the same way, and that the fast path is a single instruction per pin access with no table
+ * lookup.
+ */
+
+//=========================================//
+//             MOCK REGISTERS              //
+//=========================================//
+
+typedef enum {
+    OP_IN,                              // in, read of an I/O register
+    OP_OUT,                             // out, write of an I/O register
+    OP_BIT,                             // sbi/cbi, set or clear a bit of a fixed I/O register
+    OP_LD,                              // ld/lds, load of a register through a pointer or from data space
+    OP_ST,                              // st/sts, store of a register through a pointer or to data space
+    OP_LPM,                             // lpm, byte read from a flash table
+    OP_CLI,                             // cli
+    OP_CALL,                            // call and ret of a function
+    NUM_OF_OPS_COUNTED
+} RegisterOp;
+
+static const unsigned opCycles[NUM_OF_OPS_COUNTED] = {1, 1, 2, 2, 2, 3, 1, 8};
+static const char* const opNames[NUM_OF_OPS_COUNTED] = {"in", "out", "sbi/cbi", "ld", "st", "lpm", "cli", "call"};
+static unsigned long ops[NUM_OF_OPS_COUNTED];
+
+/**
+ * @brief An 8 bit register that counts how it's accessed and the rising edges of each of its bits
+ */
+class MockRegister
+{
+public:
+    MockRegister(void) : _value(0) {}
+
+    // Fixed address: a single bit is set or cleared in place, more take an in and an out
+    void operator|=(uint8_t mask)       { modify(mask); set(_value | mask); }
+    void operator&=(int mask)           { modify((uint8_t)~mask); set(_value & mask); }
+    uint8_t operator&(int mask)         { ops[OP_IN]++; return _value & mask; }
+    void operator=(uint8_t value)       { ops[OP_OUT]++; set(value); }
+
+    // Arduino core, through the pointer it looked up
+    uint8_t load(void)                  { ops[OP_LD]++; return _value; }
+    void store(uint8_t value)           { ops[OP_ST]++; set(value); }
+
+    // Test only, not counted
+    uint8_t peek(void)                  { return _value; }
+    void poke(uint8_t value)            { _value = value; }
+    unsigned long rises(uint8_t bit)    { return _rises[bit]; }
+
+private:
+    static void modify(uint8_t bits)
+    {
+        if((bits & (bits - 1)) == 0){
+            ops[OP_BIT]++;
+        }
+        else{
+            ops[OP_IN]++;
+            ops[OP_OUT]++;
+        }
+    }
+
+    void set(uint8_t value)
+    {
+        for(uint8_t i = 0; i < 8; i++){
+            if((value & ~_value) & (1 << i))
+                _rises[i]++;
+        }
+        _value = value;
+    }
+
+    uint8_t _value;
+    unsigned long _rises[8] = {0};
+};
+
+static MockRegister mockPort[3], mockPin[3], mockTimerControl[3];
+
+#define FAST_PIN_DIRECT
+#define F_CPU                               16000000UL
+#define __builtin_avr_delay_cycles(cycles)  ((void)(cycles))
+#define PORTD                               mockPort[FAST_PORT_D]
+#define PORTB                               mockPort[FAST_PORT_B]
+#define PORTC                               mockPort[FAST_PORT_C]
+#define PIND                                mockPin[FAST_PORT_D]
+#define PINB                                mockPin[FAST_PORT_B]
+#define PINC                                mockPin[FAST_PORT_C]
+
+#include "../inc/FastStepperMotor.hpp"
+#include "../inc/PinDef.h"
+
+//=========================================//
+//            MOCK ARDUINO CORE            //
+//=========================================//
+
+#define NOT_ON_TIMER    0
+
+// pins_arduino.h of the Uno: port, bit and PWM timer of each pin
+static const uint8_t pinPort[20] = {
+    FAST_PORT_D, FAST_PORT_D, FAST_PORT_D, FAST_PORT_D, FAST_PORT_D, FAST_PORT_D, FAST_PORT_D, FAST_PORT_D,
+    FAST_PORT_B, FAST_PORT_B, FAST_PORT_B, FAST_PORT_B, FAST_PORT_B, FAST_PORT_B,
+    FAST_PORT_C, FAST_PORT_C, FAST_PORT_C, FAST_PORT_C, FAST_PORT_C, FAST_PORT_C
+};
+static const uint8_t pinMask[20] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20
+};
+static const uint8_t pinTimer[20] = {
+    0, 0, 0, 3, 0, 1, 1, 0,             // 3: timer 2 B, 5: timer 0 B, 6: timer 0 A
+    0, 2, 2, 3, 0, 0,                   // 9: timer 1 A, 10: timer 1 B, 11: timer 2 A
+    0, 0, 0, 0, 0, 0
+};
+
+static uint8_t lpm(const uint8_t* table, uint8_t pin)
+{
+    ops[OP_LPM]++;
+    return table[pin];
+}
+
+// portOutputRegister() and portInputRegister() read a word from flash
+static MockRegister* lpmRegister(MockRegister* registers, uint8_t port)
+{
+    ops[OP_LPM] += 2;
+    return &registers[port];
+}
+
+// turnOffPWM() clears the compare output mode bit of the timer, which sits in data space
+static void turnOffPWM(uint8_t timer)
+{
+    ops[OP_CALL]++;
+    MockRegister* control = &mockTimerControl[timer - 1];
+    control->store(control->load() & 0x0F);
+}
+
+void halPinMode(uint8_t, uint8_t) {}
+void halDelayMicroseconds(unsigned int) {}
+
+void halDigitalWrite(uint8_t pin, uint8_t value)
+{
+    ops[OP_CALL]++;
+    uint8_t timer = lpm(pinTimer, pin);
+    uint8_t bit = lpm(pinMask, pin);
+    uint8_t port = lpm(pinPort, pin);
+
+    if(timer != NOT_ON_TIMER)
+        turnOffPWM(timer);
+
+    MockRegister* out = lpmRegister(mockPort, port);
+    ops[OP_IN]++;                       // oldSREG = SREG
+    ops[OP_CLI]++;
+    uint8_t level = out->load();
+    out->store(value ? (level | bit) : (level & ~bit));
+    ops[OP_OUT]++;                      // SREG = oldSREG
+}
+
+uint8_t halDigitalRead(uint8_t pin)
+{
+    ops[OP_CALL]++;
+    uint8_t timer = lpm(pinTimer, pin);
+    uint8_t bit = lpm(pinMask, pin);
+    uint8_t port = lpm(pinPort, pin);
+
+    if(timer != NOT_ON_TIMER)
+        turnOffPWM(timer);
+
+    return (lpmRegister(mockPin, port)->load() & bit) ? HIGH : LOW;
+}
+
+//=========================================//
+//               COMPARISON                //
+//=========================================//
+
+static unsigned long failures;
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+}while(0)
+
+typedef struct {
+    unsigned long registers;            // Register accesses
+    unsigned long lookups;              // Flash table reads
+    unsigned long calls;
+    unsigned long cycles;               // Lower bound
+} Cost;
+
+static void clearCost(void)
+{
+    for(int i = 0; i < NUM_OF_OPS_COUNTED; i++)
+        ops[i] = 0;
+}
+
+static Cost takeCost(void)
+{
+    Cost cost = {0, 0, 0, 0};
+
+    for(int i = 0; i < NUM_OF_OPS_COUNTED; i++)
+        cost.cycles += ops[i] * opCycles[i];
+    cost.registers = ops[OP_IN] + ops[OP_OUT] + ops[OP_BIT] + ops[OP_LD] + ops[OP_ST];
+    cost.lookups = ops[OP_LPM];
+    cost.calls = ops[OP_CALL];
+    return cost;
+}
+
+static void report(const char* what, Cost slow, Cost fast)
+{
+    printf("%-16s digitalWrite: %2lu registers %2lu lpm %lu calls %3lu cycles | FastPin: %lu registers %lu lpm %lu calls %2lu cycles\n",
+           what, slow.registers, slow.lookups, slow.calls, slow.cycles, fast.registers, fast.lookups, fast.calls, fast.cycles);
+}
+
+/**
+ * @brief Runs the same pin accesses on both motors of an axis and compares what they cost and what they do
+ */
+template<uint8_t DIR, uint8_t STEP, uint8_t EN, uint8_t ENDSTOP>
+static void compare(const char* axis)
+{
+    StepperMotor slow(DIR, STEP, EN, EN_MOTOR_ON, ENDSTOP);
+    FastStepperMotor<DIR, STEP, EN, ENDSTOP> fast;
+    typedef FastPin<STEP> StepPin;
+    typedef FastPin<DIR> DirPin;
+    Cost slowCost, fastCost;
+
+    // The endstop's pullup keeps it released
+    mockPin[FastPin<ENDSTOP>::PORT].poke(mockPin[FastPin<ENDSTOP>::PORT].peek() | FastPin<ENDSTOP>::MASK);
+    MockRegister* stepPort = &mockPort[StepPin::PORT];
+    uint8_t stepBit = __builtin_ctz(StepPin::MASK);
+    printf("%s, STEP on pin %u, DIR on pin %u, endstop on pin %u\n", axis, STEP, DIR, ENDSTOP);
+
+    unsigned long rises = stepPort->rises(stepBit);
+    clearCost(); slow.hardStep();   slowCost = takeCost();
+    clearCost(); fast.hardStep();   fastCost = takeCost();
+    report("hardStep()", slowCost, fastCost);
+    CHECK(stepPort->rises(stepBit) == rises + 2);
+    CHECK(!(stepPort->peek() & StepPin::MASK));
+    CHECK((fastCost.registers == 2) && (fastCost.lookups == 0) && (fastCost.calls == 0));
+    CHECK(fastCost.cycles * 10 < slowCost.cycles);
+
+    clearCost(); slow.hardStep(HIGH);   slowCost = takeCost();
+    CHECK(mockPort[DirPin::PORT].peek() & DirPin::MASK);
+    clearCost(); fast.hardStep(LOW);    fastCost = takeCost();
+    CHECK(!(mockPort[DirPin::PORT].peek() & DirPin::MASK));
+    report("hardStep(dir)", slowCost, fastCost);
+    CHECK(stepPort->rises(stepBit) == rises + 4);
+    CHECK((fastCost.registers == 3) && (fastCost.lookups == 0));
+
+    clearCost(); uint8_t slowTaken = slow.step();   slowCost = takeCost();
+    clearCost(); uint8_t fastTaken = fast.step();   fastCost = takeCost();
+    report("step()", slowCost, fastCost);
+    CHECK((slowTaken == 1) && (fastTaken == 1));
+    CHECK(stepPort->rises(stepBit) == rises + 6);
+    CHECK((fastCost.registers == 3) && (fastCost.lookups == 0));
+
+    clearCost(); uint8_t slowEnd = slow.endstop();  slowCost = takeCost();
+    clearCost(); uint8_t fastEnd = fast.endstop();  fastCost = takeCost();
+    report("endstop()", slowCost, fastCost);
+    CHECK((slowEnd == 0) && (fastEnd == 0));
+    CHECK((fastCost.registers == 1) && (fastCost.lookups == 0));
+
+    // A pressed endstop stops both from stepping
+    mockPin[FastPin<ENDSTOP>::PORT].poke(mockPin[FastPin<ENDSTOP>::PORT].peek() & ~FastPin<ENDSTOP>::MASK);
+    CHECK((slow.step() == 0) && (fast.step() == 0));
+    CHECK((slow.endstop() == 1) && (fast.endstop() == 1));
+    CHECK(stepPort->rises(stepBit) == rises + 6);
+}
+
+/**
+ * @brief Steps both axes the way the step interrupt does, against doing it through StepperMotor
+ */
+static void compareGroup(void)
+{
+    StepperMotor pan(PAN_DIR_PIN, PAN_STEP_PIN, PAN_EN_PIN, EN_MOTOR_ON, PAN_HALL_PIN);
+    StepperMotor tilt(TILT_DIR_PIN, TILT_STEP_PIN, TILT_EN_PIN, EN_MOTOR_ON, TILT_HALL_PIN);
+    typedef FastStepperMotor<PAN_DIR_PIN, PAN_STEP_PIN, PAN_EN_PIN, PAN_HALL_PIN> PanMotor;
+    typedef FastStepperMotor<TILT_DIR_PIN, TILT_STEP_PIN, TILT_EN_PIN, TILT_HALL_PIN> TiltMotor;
+    FastMotorGroup<PanMotor, TiltMotor> group;
+    MockRegister* panPort = &mockPort[PanMotor::StepPin::PORT];
+    MockRegister* tiltPort = &mockPort[TiltMotor::StepPin::PORT];
+    uint8_t panBit = __builtin_ctz(PanMotor::StepPin::MASK);
+    uint8_t tiltBit = __builtin_ctz(TiltMotor::StepPin::MASK);
+    Cost slowCost, fastCost;
+
+    unsigned long panRises = panPort->rises(panBit), tiltRises = tiltPort->rises(tiltBit);
+    clearCost(); pan.hardStep(HIGH); tilt.hardStep(LOW);    slowCost = takeCost();
+    uint8_t slowDirs = mockPort[PanMotor::DirPin::PORT].peek() & (PanMotor::DirPin::MASK | TiltMotor::DirPin::MASK);
+    mockPort[PanMotor::DirPin::PORT].poke(0);
+    clearCost(); group.step(0x03, 0x01);                    fastCost = takeCost();
+    uint8_t fastDirs = mockPort[PanMotor::DirPin::PORT].peek() & (PanMotor::DirPin::MASK | TiltMotor::DirPin::MASK);
+    report("both axes", slowCost, fastCost);
+
+    CHECK(slowDirs == fastDirs);
+    CHECK(panPort->rises(panBit) == panRises + 2);
+    CHECK(tiltPort->rises(tiltBit) == tiltRises + 2);
+    CHECK(!(panPort->peek() & PanMotor::StepPin::MASK) && !(tiltPort->peek() & TiltMotor::StepPin::MASK));
+    CHECK(fastCost.lookups == 0);
+    CHECK(fastCost.cycles * 10 < slowCost.cycles);
+}
+
+int main(void)
+{
+    compare<PAN_DIR_PIN, PAN_STEP_PIN, PAN_EN_PIN, PAN_HALL_PIN>("pan");
+    compare<TILT_DIR_PIN, TILT_STEP_PIN, TILT_EN_PIN, TILT_HALL_PIN>("tilt");
+    compareGroup();
+
+    printf("cycles per op:");
+    for(int i = 0; i < NUM_OF_OPS_COUNTED; i++)
+        printf(" %s %u", opNames[i], opCycles[i]);
+    printf("\nregister_count: %s, %lu failed checks\n", failures ? "FAILED" : "passed", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
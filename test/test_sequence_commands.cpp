@@ -0,0 +1,51 @@
+#include <math.h>
+#include "SimRig.hpp"
+#include "../inc/CommandExecutor.hpp"
+#include "../inc/CommandParser.hpp"
+#include "../inc/MotorPower.hpp"
+
+/**
+ * M420 and M421 run a sequence from the main loop, the way main.ino wires the sequencer.
+ */
+
+static Sequencer* sequencer;
+static CommandExecutor* executor;
+
+static void send(const char* text)
+{
+    Command cmd;
+    SIM_CHECK(tokenizeCommand(text, &cmd) == 1);
+    SIM_CHECK(executor->execute(&cmd) == 1);
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(0);
+    sequencer = new Sequencer(motion);
+    executor = new CommandExecutor(motion, sequencer);
+
+    send("M420 P0 T0 I0");
+    send("M420 P10 T5 I2");
+    send("M420 P20 T0 I4");
+    SIM_CHECK(sequencer->numKeyframes() == 3);
+    send("M421 I0");
+
+    unsigned long start = halSimTime();
+    while((sequencer->getState() != SEQ_DONE) && (halSimTime() - start < 20000000UL)){
+        MotorPower::getInstance()->service();
+        sequencer->service();
+        halSimRun(1000);
+    }
+    SIM_CHECK(sequencer->getState() == SEQ_DONE);
+    SIM_CHECK(simWaitReady(10000000UL));
+    SIM_CHECK(fabs(halSimAngle(0) - 20.0) <= PAN_STEPRATE);
+    SIM_CHECK(fabs(halSimAngle(1)) <= TILT_STEPRATE);
+
+    // Clearing the table stops a sequence running through it
+    send("M421 I0");
+    send("M420");
+    SIM_CHECK(sequencer->numKeyframes() == 0);
+    SIM_CHECK(sequencer->getState() == SEQ_IDLE);
+
+    return simDone("sequence_commands");
+}
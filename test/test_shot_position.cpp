@@ -0,0 +1,72 @@
+#include <math.h>
+#include "SimRig.hpp"
+#include "../inc/CommandExecutor.hpp"
+#include "../inc/CommandParser.hpp"
+#include "../inc/Trigger.hpp"
+
+/**
+ * M240 sent right after moves fires the shutter where they end. The angle of the simulated
+ * motors is read on every rising edge of the shutter line and compared to the position
+ * commanded before the shot.
+ */
+
+#define SHOTS   4
+
+static CommandExecutor* executor;
+static double shotAngle[SHOTS][NUM_OF_MOTORS];
+static unsigned long shots;
+
+// Runs a tick, then looks for the shutter going up in it
+static void tickAndWatch(void)
+{
+    halSimRun(STEP_TICK_US);
+    for(unsigned long i = 0; i < halSimNumEdges(); i++){
+        const HalSimEdge* edge = halSimEdge(i);
+        if((edge->pin != TRIGGER_SHUTTER_PIN) || !edge->value)
+            continue;
+        if(shots < SHOTS){
+            shotAngle[shots][0] = halSimAngle(0);
+            shotAngle[shots][1] = halSimAngle(1);
+        }
+        shots++;
+    }
+    halSimClearEdges();
+}
+
+static void send(const char* text)
+{
+    Command cmd;
+    SIM_CHECK(tokenizeCommand(text, &cmd) == 1);
+    SIM_CHECK(executor->execute(&cmd) == 1);
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(0);
+    motion->registerTryAndExecCallback(tickAndWatch);
+    executor = new CommandExecutor(motion);
+    const double commanded[SHOTS][NUM_OF_MOTORS] = {{10, 0}, {20, 5}, {-5, 5}, {-5, -12.5}};
+
+    send("M203 P40 T30");
+    send("G1 P10");
+    send("M240");
+    send("G1 P20 T5");
+    send("M240");
+    send("G1 P-5");
+    send("M240");
+    send("G1 T-12.5");
+    send("M240");
+    for(unsigned long i = 0; (i < 100000UL) && !(motion->ready() && !Trigger::getInstance()->busy()); i++)
+        tickAndWatch();
+
+    SIM_CHECK(shots == SHOTS);
+    SIM_CHECK(Trigger::getInstance()->getBlocked() == 0);
+    for(unsigned long i = 0; (i < shots) && (i < SHOTS); i++){
+        double error[NUM_OF_MOTORS] = {shotAngle[i][0] - commanded[i][0], shotAngle[i][1] - commanded[i][1]};
+        printf("shot %lu at %8.4f %8.4f, error %7.4f %7.4f degrees\n", i, shotAngle[i][0], shotAngle[i][1], error[0], error[1]);
+        SIM_CHECK(fabs(error[0]) <= PAN_STEPRATE);
+        SIM_CHECK(fabs(error[1]) <= TILT_STEPRATE);
+    }
+
+    return simDone("shot_position");
+}
@@ -0,0 +1,321 @@
+#include <unistd.h>
+#include <sys/wait.h>
+#include "SimRig.hpp"
+#include "../inc/Snapshot.hpp"
+#include "../inc/MotorPower.hpp"
+
+/**
+ * Cuts the power while the snapshot of a new rest position is being written to the EEPROM, at
+ * every point of the write, and boots again from what's left in it.
+ *
+ * The firmware's singletons keep their state, so each boot is its own process, forked from
+ * one that never ran the firmware, like the board coming back up. What outlives the power goes
+ * from one boot to the next: the bytes of the EEPROM, a byte cut mid-write left with a mix of
+ * its old and new bits, and where the rotors are, each driver pulling its rotor in phase with
+ * its translator as it powers up. The second boot puts the magnets where they are from there.
+ *
+ * The first boot homes, rests at A until its snapshot is written, moves to B and cuts the
+ * power some time after getting there. The second boot loads the snapshot and restores, then
+ * homes, which only checks the magnets when the position was restored. Whatever the cut:
+ *
+ * - A valid record is always found, and it's A's or B's, never anything in between.
+ * - The position is only taken back from B once its record was written whole, and always
+ *   once the write was done before the cut.
+ * - Taken back, it's the exact step the rotors are on. Homed again, it's within one.
+ * - The home offset and speeds come back either way.
+ *
+ * Then the wear: moving between rest positions many times, the records go round the slots,
+ * and no byte is written more than a few times per round.
+ */
+
+#define POWER_CUT_STEP_US       2100UL      // Cuts are this far apart, so they fall on every part of a byte's write [us]
+#define POWER_CUT_FROM_US       (SNAPSHOT_SETTLE_MS * 1000UL - 10 * POWER_CUT_STEP_US)  // Cuts before this wouldn't find a write under way [us]
+#define POWER_CUT_LIMIT_US      1000000UL   // Every cut is within this long of coming to rest at B [us]
+#define POWER_WEAR_MOVES        (3 * SNAPSHOT_SLOTS)
+#define POWER_SERVICE_US        100UL       // How often the main loop services the snapshots [us]
+#define POWER_MAGNET_WIDTH      1.5         // Narrow, so homing doesn't take long [Degrees]
+
+static const LongVector restA = {3000, -1000};
+static const LongVector restB = {-4250, 1725};
+static const LongVector homeOffset = {1500, -700};
+static const double magnet[NUM_OF_MOTORS] = {-3.0, -2.0};   // Close, on the side homing seeks, so it doesn't take long [Degrees]
+
+/**
+ * @brief What goes from one boot to the next through the pipe, and what the boots found
+ */
+typedef struct {
+    uint8_t eeprom[HAL_EEPROM_SIZE];
+    long rotor[NUM_OF_MOTORS];              // Where the rotors are after the power cycle, from where the first boot started [Steps]
+    long offset[NUM_OF_MOTORS];             // Rotor less the processor's position, after the first boot homed [Steps]
+    SnapshotRecord a;                       // Records of the first boot, at A and at B
+    SnapshotRecord b;
+    unsigned long cutUs;                    // When the power was cut, from coming to rest at B [us]
+    uint8_t written;                        // B's record was written whole before the cut
+    uint8_t restored;                       // The second boot took the position back
+    uint8_t fromB;                          // The second boot found B's record
+    unsigned long maxWrites;                // Most writes a byte of the EEPROM took
+    unsigned long failures;
+} World;
+
+//=========================================//
+//                  BOOTS                  //
+//=========================================//
+
+/**
+ * @brief Runs a boot in its own process, handing it the world and taking it back
+ *
+ * @return 1 if the boot ran to its end
+ */
+static uint8_t boot(void (*run)(World*), World* world)
+{
+    int fds[2];
+    if(pipe(fds) != 0)
+        return 0;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0){
+        close(fds[0]);
+        simFailures = 0;
+        run(world);
+        world->failures = simFailures;
+        fflush(stdout);
+
+        const uint8_t* bytes = (const uint8_t*)world;
+        for(size_t done = 0; done < sizeof(*world);){
+            ssize_t n = write(fds[1], bytes + done, sizeof(*world) - done);
+            if(n <= 0)
+                _exit(EXIT_FAILURE);
+            done += n;
+        }
+        _exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+
+    size_t done = 0;
+    while((pid > 0) && (done < sizeof(*world))){
+        ssize_t n = read(fds[0], (uint8_t*)world + done, sizeof(*world) - done);
+        if(n <= 0)
+            break;
+        done += n;
+    }
+    close(fds[0]);
+
+    int status = 0;
+    if(pid > 0)
+        waitpid(pid, &status, 0);
+    if((pid <= 0) || (done < sizeof(*world)) || !WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS))
+        return 0;
+
+    simFailures += world->failures;
+    return 1;
+}
+
+/**
+ * @brief Runs the main loop's services for a while
+ */
+static void service(unsigned long us)
+{
+    for(unsigned long t = 0; t < us; t += POWER_SERVICE_US){
+        halSimRun(POWER_SERVICE_US);
+        MotorPower::getInstance()->service();
+        Snapshot::getInstance()->service();
+    }
+}
+
+/**
+ * @brief Homes, or only checks the magnets if the position was restored
+ *
+ * @return 1 if it homed
+ */
+static uint8_t homeAndWait(MotionProcessor* motion)
+{
+    motion->home();
+    SIM_CHECK(simWaitReady(60000000UL));
+    return StepEngine::getInstance()->homingState() == HOMING_DONE;
+}
+
+/**
+ * @brief Rotor less the processor's position, from where the first boot started [Steps]
+ */
+static long rotorOffset(uint8_t axis, const World* world)
+{
+    LongVector position = MotionProcessor::getInstance()->getPositionSteps();
+    return halSimSteps(axis) + world->rotor[axis] - ((axis == 0) ? position.p : position.t);
+}
+
+/**
+ * @brief Moves to a rest position and waits until its snapshot is written
+ *
+ * @return 1 if the latest record is of there, with the position
+ */
+static uint8_t restAt(MotionProcessor* motion, LongVector rest, SnapshotRecord* record)
+{
+    motion->line(rest);
+    SIM_CHECK(simWaitReady(60000000UL));
+
+    for(unsigned long t = 0; t < POWER_CUT_LIMIT_US; t += 10000UL){
+        service(10000UL);
+        if(Snapshot::getInstance()->writing())
+            continue;
+        if((Snapshot::getInstance()->load(record) == 1) && (record->flags & SNAPSHOT_POSITION) &&
+           (record->targetMdeg[0] == rest.p) && (record->targetMdeg[1] == rest.t))
+            return 1;
+    }
+    return 0;
+}
+
+static uint8_t sameState(const SnapshotRecord* x, const SnapshotRecord* y)
+{
+    return (x->targetMdeg[0] == y->targetMdeg[0]) && (x->targetMdeg[1] == y->targetMdeg[1]) &&
+           (x->position[0] == y->position[0]) && (x->position[1] == y->position[1]) &&
+           (x->homeOffset[0] == y->homeOffset[0]) && (x->homeOffset[1] == y->homeOffset[1]) &&
+           (x->speed[0] == y->speed[0]) && (x->speed[1] == y->speed[1]);
+}
+
+/**
+ * @brief First boot: homes, rests at A, moves to B and cuts the power cutUs after getting there
+ */
+static void firstBoot(World* world)
+{
+    halSimEepromErase();
+    MotionProcessor* motion = simRig(0);
+    halSimMagnet(0, magnet[0], POWER_MAGNET_WIDTH, !HALL_MAG_DETECTED);
+    halSimMagnet(1, magnet[1], POWER_MAGNET_WIDTH, !HALL_MAG_DETECTED);
+    motion->setHomeOffset(homeOffset);
+    SIM_CHECK(homeAndWait(motion));
+    motion->setPanSpeed(30);
+    motion->setTiltSpeed(20);
+
+    world->offset[0] = rotorOffset(0, world);
+    world->offset[1] = rotorOffset(1, world);
+    SIM_CHECK(restAt(motion, restA, &world->a));
+
+    motion->line(restB);
+    SIM_CHECK(simWaitReady(60000000UL));
+    service(world->cutUs);
+
+    SnapshotRecord record;
+    world->written = !Snapshot::getInstance()->writing() && halEepromReady() && (Snapshot::getInstance()->load(&record) == 1) &&
+                     (record.flags & SNAPSHOT_POSITION) && (record.targetMdeg[0] == restB.p) && (record.targetMdeg[1] == restB.t);
+    if(world->written)
+        world->b = record;
+
+    halSimPowerCycle();
+    for(uint16_t i = 0; i < HAL_EEPROM_SIZE; i++)
+        world->eeprom[i] = halEepromRead(i);
+    world->rotor[0] = halSimSteps(0);
+    world->rotor[1] = halSimSteps(1);
+}
+
+/**
+ * @brief Second boot: the rotors where the first left them, restores from the EEPROM it left, then homes
+ */
+static void secondBoot(World* world)
+{
+    MotionProcessor* motion = simRig(0);
+    halSimMagnet(0, magnet[0] - world->rotor[0] * PAN_STEPRATE, POWER_MAGNET_WIDTH, !HALL_MAG_DETECTED);
+    halSimMagnet(1, magnet[1] - world->rotor[1] * TILT_STEPRATE, POWER_MAGNET_WIDTH, !HALL_MAG_DETECTED);
+
+    // Starts erased, so only the rest needs writing
+    for(uint16_t i = 0; i < HAL_EEPROM_SIZE; i++){
+        if(world->eeprom[i] != 0xFF)
+            halEepromWrite(i, world->eeprom[i]);
+    }
+
+    SnapshotRecord record;
+    SIM_CHECK(Snapshot::getInstance()->load(&record) == 1);
+    world->fromB = (record.targetMdeg[0] == restB.p) && (record.targetMdeg[1] == restB.t);
+    SIM_CHECK(sameState(&record, &world->a) || world->fromB);
+
+    world->restored = motion->restore();
+    SIM_CHECK(motion->getHomeOffset().p == homeOffset.p);
+    SIM_CHECK(motion->getHomeOffset().t == homeOffset.t);
+    SIM_CHECK(motion->getPanSpeed() == 30);
+    SIM_CHECK(motion->getTiltSpeed() == 20);
+    SIM_CHECK(!world->restored || world->fromB);
+
+    // The drivers pull the rotors back in phase as they come on. Homed again, the magnets may
+    // be found a turn away from where the first boot found them.
+    uint8_t homed = homeAndWait(motion);
+    SIM_CHECK(homed == !world->restored);
+    static const long turn[NUM_OF_MOTORS] = {lround(360.0 / PAN_STEPRATE), lround(360.0 / TILT_STEPRATE)};
+    for(uint8_t i = 0; i < NUM_OF_MOTORS; i++){
+        long off = (((rotorOffset(i, world) - world->offset[i]) % turn[i]) + turn[i] + turn[i] / 2) % turn[i] - turn[i] / 2;
+        if(world->restored)
+            SIM_CHECK(rotorOffset(i, world) == world->offset[i]);
+        else
+            SIM_CHECK(labs(off) <= 1);
+    }
+}
+
+/**
+ * @brief Moves between rest positions, each written to a record, and finds the byte written most
+ */
+static void wearBoot(World* world)
+{
+    halSimEepromErase();
+    MotionProcessor* motion = simRig(1);
+    SIM_CHECK(homeAndWait(motion));
+
+    for(unsigned long n = 0; n < POWER_WEAR_MOVES; n++){
+        LongVector rest = {(long)(n % 7) * 1000 - 3000, (long)(n % 5) * 1000 - 2000};
+        SnapshotRecord record;
+        SIM_CHECK(restAt(motion, rest, &record));
+    }
+
+    world->maxWrites = 0;
+    for(uint16_t i = SNAPSHOT_EEPROM_START; i < SNAPSHOT_EEPROM_START + SNAPSHOT_SLOTS * SNAPSHOT_SLOT_SIZE; i++){
+        if(halSimEepromWrites(i) > world->maxWrites)
+            world->maxWrites = halSimEepromWrites(i);
+    }
+}
+
+//=========================================//
+//                  TEST                   //
+//=========================================//
+
+int main(void)
+{
+    static World world;
+    unsigned long cuts = 0, restored = 0, fromB = 0, lastUnwritten = 0;
+    uint8_t wasRestored = 0, done = 0;
+
+    for(unsigned long cutUs = POWER_CUT_FROM_US; !done && (cutUs < POWER_CUT_LIMIT_US); cutUs += POWER_CUT_STEP_US){
+        memset(&world, 0, sizeof(world));
+        world.cutUs = cutUs;
+        SIM_CHECK(boot(firstBoot, &world));
+        SIM_CHECK(boot(secondBoot, &world));
+
+        cuts++;
+        restored += world.restored;
+        fromB += world.fromB;
+        if(!world.written)
+            lastUnwritten = cutUs;
+
+        // Once taken back it's always taken back, and always once the write was done
+        SIM_CHECK(!wasRestored || world.restored);
+        SIM_CHECK(!world.written || world.restored);
+        wasRestored = world.restored;
+
+        // A few cuts past the end of the write, to be sure nothing comes after it
+        if(world.written && (cutUs > lastUnwritten + 10 * POWER_CUT_STEP_US))
+            done = 1;
+    }
+    printf("power cut at %lu points of writing B's snapshot: B's record found after %lu, position taken back after %lu\n",
+           cuts, fromB, restored);
+    printf("  its write was done by %.1f ms after coming to rest\n", (lastUnwritten + POWER_CUT_STEP_US) / 1000.0);
+    SIM_CHECK(done);
+    SIM_CHECK(restored > 0);
+    SIM_CHECK(restored < cuts);
+
+    memset(&world, 0, sizeof(world));
+    SIM_CHECK(boot(wearBoot, &world));
+    unsigned long rounds = (POWER_WEAR_MOVES + SNAPSHOT_SLOTS - 1) / SNAPSHOT_SLOTS;
+    printf("wear: %d snapshots over %d slots, the most written byte took %lu writes\n",
+           (int)POWER_WEAR_MOVES, (int)SNAPSHOT_SLOTS, world.maxWrites);
+    SIM_CHECK(world.maxWrites > 0);
+    SIM_CHECK(world.maxWrites <= 3 * (rounds + 1));
+
+    return simDone("snapshot_power");
+}
@@ -0,0 +1,92 @@
+#include <math.h>
+#include "SimRig.hpp"
+#include "../inc/MotionQueue.hpp"
+#include "../inc/StallMonitor.hpp"
+
+/**
+ * Slips the pan rotor behind the step engine's back and checks the StallMonitor catches it the
+ * next time the axis crosses the edges of its magnet.
+ *
+ * - A slip of one electrical cycle is taken out of the position, counted as a resync, and the
+ *   move it happened on still ends where it was sent.
+ * - A slip past STALL_TOLERANCE is flagged as a stall, and the position stops being known.
+ */
+
+#define STALL_LIMIT_US      30000000UL
+#define STALL_LOOP_US       1000UL          // Period of the main loop [us]
+#define STALL_SWING         10.0            // How far either side of the magnet the moves go [Degrees]
+
+// Distance from an angle to the pan magnet's center, wrapped to [-180, 180) [Degrees]
+static double fromMagnet(double angle)
+{
+    double d = fmod(angle - SIM_PAN_MAGNET + 180.0, 360.0);
+    if(d < 0)
+        d += 360.0;
+    return d - 180.0;
+}
+
+/**
+ * @brief Moves pan to an angle from home, the main loop servicing the monitor until the head is at rest
+ */
+static uint8_t movePan(MotionProcessor* motion, double pan)
+{
+    StallMonitor* monitor = StallMonitor::getInstance();
+    DoubleVector target = {pan, 0};
+    unsigned long start = halSimTime();
+
+    motion->line(target);
+    do{
+        if(halSimTime() - start > STALL_LIMIT_US)
+            return 0;
+        monitor->service();
+        halSimRun(STALL_LOOP_US);
+    }while(!motion->ready() || !MotionQueue::getInstance()->isEmpty());
+
+    // Once more at rest, so a move making up for a slip gets queued and run
+    monitor->service();
+    return simWaitReady(STALL_LIMIT_US);
+}
+
+int main(void)
+{
+    MotionProcessor* motion = simRig(1);
+    StallMonitor* monitor = StallMonitor::getInstance();
+    long cycle = 4L * PAN_MICROSTEPS;
+
+    motion->home();
+    SIM_CHECK(simWaitReady(STALL_LIMIT_US));
+    SIM_CHECK(StepEngine::getInstance()->homingState() == HOMING_DONE);
+    monitor->service();
+    SIM_CHECK(motion->positionKnown());
+
+    // Both ways across the magnet, so every checkpoint is learned
+    SIM_CHECK(movePan(motion, -STALL_SWING));
+    SIM_CHECK(movePan(motion, STALL_SWING));
+    SIM_CHECK(movePan(motion, -STALL_SWING));
+    SIM_CHECK(monitor->getResyncs(0) == 0);
+    SIM_CHECK(!monitor->stalled());
+
+    // One electrical cycle lost, found crossing the magnet and made up for by the end of the move
+    halSimSlip(0, cycle);
+    SIM_CHECK(movePan(motion, STALL_SWING));
+    printf("slip of %ld steps: %u resyncs, move ended %+.4f deg off\n", cycle, monitor->getResyncs(0), fromMagnet(halSimAngle(0)) - STALL_SWING);
+    SIM_CHECK(monitor->getResyncs(0) == 1);
+    SIM_CHECK(!monitor->stalled());
+    SIM_CHECK(motion->positionKnown());
+    SIM_CHECK(fabs(fromMagnet(halSimAngle(0)) - STALL_SWING) <= PAN_STEPRATE);
+    SIM_CHECK(movePan(motion, 0));
+    SIM_CHECK(fabs(fromMagnet(halSimAngle(0))) <= PAN_STEPRATE);
+
+    // Further off than a slip can put it, a stall
+    long stall = lround(2.0 * STALL_TOLERANCE / PAN_STEPRATE);
+    halSimSlip(0, stall);
+    SIM_CHECK(movePan(motion, -STALL_SWING));
+    printf("slip of %ld steps: error %ld steps at the checkpoint, stalled %u\n", stall, monitor->getError(0), monitor->stalled());
+    SIM_CHECK(monitor->stalled() & 0x01);
+    SIM_CHECK(motion->positionKnown() == 0);
+    SIM_CHECK(monitor->getResyncs(0) == 1);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("stall");
+}
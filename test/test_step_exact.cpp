@@ -0,0 +1,179 @@
+#include <math.h>
+#include <time.h>
+#include "SimRig.hpp"
+#include "../inc/Kinematics.hpp"
+#include "../inc/MotionPlanner.hpp"
+
+/**
+ * Proves the fixed-point kinematics give bit-exact step counts.
+ *
+ * - Every angle within KIN_EXACT_MDEG of home, each of them, converts to the exact nearest
+ *   step of both axes, worked out with integers from the gear ratios and microsteps.
+ * - Random relative moves through the motion processor: the target is always the sum of the
+ *   moves, and every EXACT_CHECK_EVERY moves, once they're done, the processor and the
+ *   simulated motors are on its exact step. A double per-move conversion, as the motion path
+ *   used to do, is run alongside to show the drift it builds up.
+ * - How long line() takes to set a move up, with room for it in the queue. It's timed on the
+ *   host clock, so it's host time, not AVR cycles, only good to compare builds on one machine.
+ *
+ * Pass a number of moves to run more than the default, ctest runs it with two million under
+ * the "long" label.
+ */
+
+#define EXACT_DEFAULT_MOVES     5000UL
+#define EXACT_MOVE_MDEG         2000L       // Largest relative move, either way [Millidegrees]
+#define EXACT_ACCEL             20000.0     // Fast ramps so the moves don't take long [Degrees/Sec^2]
+#define EXACT_CHECK_EVERY       250         // Moves between two checks of the steps, once they're done
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom(void)
+{
+    seed = seed * 1664525UL + 1013904223UL;
+    return seed >> 8;
+}
+
+/**
+ * @brief Steps per millidegree of an axis as an exact fraction, from how it's geared
+ */
+typedef struct {
+    int64_t num;
+    int64_t den;
+} StepRatio;
+
+static StepRatio ratio(unsigned long microsteps, double gearRatio)
+{
+    StepRatio r = {(int64_t)microsteps * llround(gearRatio * 1000), llround(MOTOR_STEP_ANGLE * 1000) * FIXED_SCALE};
+    return r;
+}
+
+// Nearest step to an angle, halves rounded up, like stepsFromMdeg()
+static long exactSteps(long mdeg, StepRatio r)
+{
+    int64_t x = 2 * (int64_t)mdeg * r.num + r.den;
+    int64_t d = 2 * r.den;
+    int64_t q = x / d;
+    if((x % d != 0) && (x < 0))
+        q--;
+    return (long)q;
+}
+
+/**
+ * @brief Checks every angle from 0 to limit, one way, walking the exact step alongside
+ *
+ * @return Number of angles that convert to another step
+ */
+static unsigned long sweep(long (*convert)(long), StepRatio r, long direction)
+{
+    int64_t d = 2 * r.den;
+    int64_t x = r.den;                      // 2 * mdeg * num + den at mdeg = 0
+    int64_t q = 0;
+    unsigned long wrong = 0;
+
+    for(long mdeg = 0; labs(mdeg) <= KIN_EXACT_MDEG; mdeg += direction){
+        // Floor of x / d, kept up as x moves by 2 * num
+        while(x >= (q + 1) * d)
+            q++;
+        while(x < q * d)
+            q--;
+        if(convert(mdeg) != q)
+            wrong++;
+        x += direction * 2 * r.num;
+    }
+    return wrong;
+}
+
+static void checkConversions(void)
+{
+    StepRatio pan = ratio(PAN_MICROSTEPS, PAN_GEAR_RATIO);
+    StepRatio tilt = ratio(TILT_MICROSTEPS, TILT_GEAR_RATIO);
+
+    // The fractions are the axes' step angles
+    SIM_CHECK(fabs((double)pan.den / pan.num / FIXED_SCALE - PAN_STEPRATE) < 1e-12);
+    SIM_CHECK(fabs((double)tilt.den / tilt.num / FIXED_SCALE - TILT_STEPRATE) < 1e-12);
+    SIM_CHECK(panStepsFromMdeg(-12345678) == exactSteps(-12345678, pan));
+
+    unsigned long wrong[2];
+    wrong[0] = sweep(panStepsFromMdeg, pan, 1) + sweep(panStepsFromMdeg, pan, -1);
+    wrong[1] = sweep(tiltStepsFromMdeg, tilt, 1) + sweep(tiltStepsFromMdeg, tilt, -1);
+    printf("conversions: %lu angles per axis, %lu pan and %lu tilt off the exact step\n", 2 * KIN_EXACT_MDEG + 1, wrong[0], wrong[1]);
+    SIM_CHECK(wrong[0] == 0);
+    SIM_CHECK(wrong[1] == 0);
+}
+
+static void checkMoves(unsigned long moves)
+{
+    MotionProcessor* motion = MotionProcessor::getInstance();
+    StepRatio pan = ratio(PAN_MICROSTEPS, PAN_GEAR_RATIO);
+    StepRatio tilt = ratio(TILT_MICROSTEPS, TILT_GEAR_RATIO);
+
+    MotionPlanner::getInstance()->setPanAccel(EXACT_ACCEL);
+    MotionPlanner::getInstance()->setTiltAccel(EXACT_ACCEL);
+    motion->setPanSpeed(PAN_MAX_SPEED);
+    motion->setTiltSpeed(TILT_MAX_SPEED);
+    motion->setMode(REL);
+
+    LongVector sum = {0, 0};
+    double naive[2] = {0, 0};               // Steps of each move rounded on their own, in double
+    unsigned long wrong = 0;
+    double cpu = 0, cpuMax = 0;
+
+    for(unsigned long n = 0; n < moves; n++){
+        LongVector move = {(long)(nextRandom() % (2 * EXACT_MOVE_MDEG + 1)) - EXACT_MOVE_MDEG,
+                           (long)(nextRandom() % (2 * EXACT_MOVE_MDEG + 1)) - EXACT_MOVE_MDEG};
+        sum.p += move.p;
+        sum.t += move.t;
+        naive[0] += lround(move.p / 1000.0 / PAN_STEPRATE);
+        naive[1] += lround(move.t / 1000.0 / TILT_STEPRATE);
+
+        while(!MotionPlanner::getInstance()->hasRoom())
+            halSimRun(STEP_TICK_US);
+
+        clock_t c = clock();
+        motion->line(move);
+        double spent = (double)(clock() - c) / CLOCKS_PER_SEC;
+        cpu += spent;
+        if(spent > cpuMax)
+            cpuMax = spent;
+
+        LongVector target = motion->getTargetMdeg();
+        if((target.p != sum.p) || (target.t != sum.t))
+            wrong++;
+
+        if((n + 1) % EXACT_CHECK_EVERY == 0){
+            SIM_CHECK(simWaitReady(600000000UL));
+            LongVector steps = motion->getPositionSteps();
+            long p = exactSteps(sum.p, pan), t = exactSteps(sum.t, tilt);
+            if((steps.p != p) || (steps.t != t) || (halSimSteps(0) != p) || (halSimSteps(1) != t))
+                wrong++;
+        }
+    }
+    SIM_CHECK(simWaitReady(600000000UL));
+
+    long exact[2] = {exactSteps(sum.p, pan), exactSteps(sum.t, tilt)};
+    printf("moves: %lu random relative moves, ending %ld/%ld mdeg from the start\n", moves, sum.p, sum.t);
+    printf("  exact steps %ld/%ld, processor %ld/%ld, motors %ld/%ld, %lu checks off the exact step\n", exact[0], exact[1],
+           motion->getPositionSteps().p, motion->getPositionSteps().t, halSimSteps(0), halSimSteps(1), wrong);
+    printf("  a double per-move conversion would be at %.0f/%.0f steps, off by %.0f/%.0f\n",
+           naive[0], naive[1], naive[0] - exact[0], naive[1] - exact[1]);
+    printf("line() setup: %.2f us avg, %.2f us worst, host time, not AVR cycles\n", cpu * 1e6 / moves, cpuMax * 1e6);
+
+    SIM_CHECK(wrong == 0);
+    SIM_CHECK(motion->getPositionSteps().p == exact[0]);
+    SIM_CHECK(motion->getPositionSteps().t == exact[1]);
+    SIM_CHECK(halSimSteps(0) == exact[0]);
+    SIM_CHECK(halSimSteps(1) == exact[1]);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long moves = (argc > 1) ? strtoul(argv[1], NULL, 10) : EXACT_DEFAULT_MOVES;
+
+    simRig(0);
+    checkConversions();
+    checkMoves(moves);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("step_exact");
+}
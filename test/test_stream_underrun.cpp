@@ -0,0 +1,212 @@
+#include <math.h>
+#include "SimRig.hpp"
+#include "LinkRig.hpp"
+#include "../inc/CommandExecutor.hpp"
+#include "../inc/MotionPlanner.hpp"
+#include "../inc/MotorPower.hpp"
+
+/**
+ * A host streams a dense path of short moves to the whole board over the simulated 115200 baud
+ * line, as fast as the credits let it: FrameHost on one end, main.ino's loop on the other with
+ * the FrameLink, the executor and the motion processor. The host never polls, it only goes by
+ * the credits of the replies and the status frames the board sends on its own.
+ *
+ * The path is run at a few move rates, from moves far longer than a command takes on the line
+ * to moves as short as the line can feed. Once the first move starts, an underrun is the step
+ * engine running dry before the last move was queued, and a drop is a command lost on the way:
+ * a byte lost to a full receive buffer, a frame turned away, or a point of the path the head
+ * doesn't go through. The ramps are steep, so the head keeps to the path's timing and the
+ * stream, not the acceleration, is what limits it.
+ *
+ * Checks that up to STREAM_MAX_RATE moves/s there's no underrun and no drop, and that above
+ * what the line carries the engine does run dry, so the check would see it. Pass a length of
+ * the runs to stream for longer.
+ */
+
+#define STREAM_DEFAULT_MS       2000UL      // How long each rate streams for [ms]
+#define STREAM_PAN_SPEED        80.0        // [Degrees/Sec]
+#define STREAM_TILT_SPEED       50.0        // [Degrees/Sec]
+#define STREAM_TILT_AMPLITUDE   5000L       // Tilt goes up and down this far along the path [Millidegrees]
+#define STREAM_ACCEL            20000.0     // Fast ramps, so the head keeps to the path's timing [Degrees/Sec^2]
+#define STREAM_MAX_RATE         800         // Fastest rate that must stream without underrun [Moves/Sec]
+#define STREAM_OVER_RATE        2000        // A rate the line can't carry [Moves/Sec]
+
+static CommandQueue commands;
+static CommandParser parser(&commands);
+static FrameLink frameLink(&commands, linkBoardSend, linkBoardRoom);
+static FrameHost* host;
+static MotionProcessor* motion;
+
+static unsigned long rate;                  // Moves per second of the path being streamed
+static unsigned long total;                 // Moves of the path
+static unsigned long sent;                  // Moves the host added so far
+static unsigned long startUs;               // When the first move started, 0 until then [us]
+static unsigned long endUs;                 // When the last move was queued, 0 until then [us]
+static unsigned long dryUs;                 // Time the engine ran dry in between [us]
+static unsigned long underruns;             // Times it ran dry
+static uint8_t wasBusy;
+static uint8_t primed;                      // A status reported moves queued
+static unsigned long leastQueued;           // Least time of queued moves a status reported since [ms]
+
+/**
+ * @brief Point n of the path, pan sweeps on at its speed and tilt goes up and down
+ */
+static LongVector pathPoint(unsigned long n)
+{
+    double t = (double)(n + 1) / rate;
+    LongVector p = {lround(t * STREAM_PAN_SPEED * 1000), lround(STREAM_TILT_AMPLITUDE * sin(2 * M_PI * t))};
+    return p;
+}
+
+/**
+ * @brief Adds the next moves while the credits let it, and reads the board's replies
+ */
+static void hostStream(void)
+{
+    unsigned long nowMs = linkTime() / 1000;
+
+    while(sent < total){
+        LongVector p = pathPoint(sent);
+        Command cmd;
+        cmd.op = CMD_MOVE;
+        cmd.argMask = ARG_P_BIT | ARG_T_BIT;
+        cmd.args[ARG_P] = p.p;
+        cmd.args[ARG_T] = p.t;
+        if(!host->add(&cmd, nowMs))
+            break;
+        sent++;
+    }
+    if(sent == total)
+        host->flush(nowMs);
+    linkHostRead(host);
+}
+
+/**
+ * @brief Notes whether the engine ran dry, from the first move until the last one is queued
+ */
+static void watch(void)
+{
+    uint8_t busy = StepEngine::getInstance()->busy();
+    LongVector target = motion->getTargetMdeg();
+    LongVector last = pathPoint(total - 1);
+
+    if(!startUs && busy)
+        startUs = halSimTime();
+    if(startUs && !endUs && (target.p == last.p) && (target.t == last.t))
+        endUs = halSimTime();
+
+    if(startUs && !endUs){
+        if(!busy){
+            dryUs += STEP_TICK_US;
+            if(wasBusy)
+                underruns++;
+        }
+        if(host->queuedTime() > 0)
+            primed = 1;
+        if(primed && (host->queuedTime() < leastQueued))
+            leastQueued = host->queuedTime();
+    }
+    wasBusy = busy;
+}
+
+/**
+ * @brief One tick of everything but the board's main loop: the clock, the line and the host
+ */
+static void tick(void)
+{
+    halSimRun(STEP_TICK_US);
+    linkRun();
+    if(host != NULL){
+        hostStream();
+        watch();
+    }
+}
+
+/**
+ * @brief serviceSerial() of main.ino, registered with the motion processor so it also runs while a move waits for room
+ */
+static void serviceSerial(void)
+{
+    tick();
+    linkBoardRead(&commands, &parser, &frameLink);
+}
+
+static void stream(CommandExecutor* executor, unsigned long movesPerSec, unsigned long ms, uint8_t mustKeepUp)
+{
+    FrameHost frameHost(linkHostSend);
+    LongVector origin = {0, 0};
+
+    // Every path starts from the origin
+    motion->setMode(ABS);
+    motion->line(origin);
+    SIM_CHECK(simWaitReady(60000000UL));
+
+    host = &frameHost;
+    rate = movesPerSec;
+    total = movesPerSec * ms / 1000;
+    sent = 0;
+    startUs = 0;
+    endUs = 0;
+    dryUs = 0;
+    underruns = 0;
+    wasBusy = 0;
+    primed = 0;
+    leastQueued = (unsigned long)-1;
+
+    linkReset(0);
+    frameHost.start(0);
+    unsigned long limit = halSimTime() + 60000000UL;
+
+    // main.ino's loop, until the head is at the end of the path
+    while(!endUs && (halSimTime() < limit)){
+        serviceSerial();
+        MotorPower::getInstance()->service();
+
+        const Command* cmd = commands.borrowCommand();
+        if(cmd != NULL){
+            executor->execute(cmd);
+            commands.releaseCommand();
+        }
+    }
+    unsigned long streamUs = endUs - startUs;
+    SIM_CHECK(simWaitReady(60000000UL));
+
+    LongVector last = pathPoint(total - 1);
+    LongVector target = motion->getTargetMdeg();
+    uint8_t dropped = (simLink.boardRx.lost > 0) || (frameHost.getRejected() > 0) || (frameHost.getResent() > 0) ||
+                      (target.p != last.p) || (target.t != last.t);
+
+    printf("%5lu moves/s asked: %5lu moves at %6.1f moves/s, %3lu underruns, %6.1f ms dry, least queued %4lu ms, %s\n",
+           movesPerSec, total, total * 1e6 / streamUs, underruns, dryUs / 1000.0,
+           (leastQueued == (unsigned long)-1) ? 0 : leastQueued, dropped ? "commands dropped" : "nothing dropped");
+
+    SIM_CHECK(endUs != 0);
+    SIM_CHECK(!dropped);
+    if(mustKeepUp)
+        SIM_CHECK(underruns == 0);
+    else
+        SIM_CHECK(underruns > 0);
+    host = NULL;
+}
+
+int main(int argc, char** argv)
+{
+    static const unsigned long rates[] = {50, 100, 200, 400, STREAM_MAX_RATE};
+    unsigned long ms = (argc > 1) ? strtoul(argv[1], NULL, 10) : STREAM_DEFAULT_MS;
+
+    motion = simRig(0);
+    motion->registerTryAndExecCallback(serviceSerial);
+    motion->setPanSpeed(STREAM_PAN_SPEED);
+    motion->setTiltSpeed(STREAM_TILT_SPEED);
+    MotionPlanner::getInstance()->setPanAccel(STREAM_ACCEL);
+    MotionPlanner::getInstance()->setTiltAccel(STREAM_ACCEL);
+    CommandExecutor executor(motion);
+
+    for(unsigned i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+        stream(&executor, rates[i], ms, 1);
+    stream(&executor, STREAM_OVER_RATE, ms, 0);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("stream_underrun");
+}
@@ -0,0 +1,138 @@
+#include <math.h>
+#include <time.h>
+#include "SimRig.hpp"
+#include "../inc/Telemetry.hpp"
+
+/**
+ * Measures what the always on Telemetry adds to the step interrupt, and checks what it counts.
+ *
+ * - A diagonal move with the main loop closing a record every TELEMETRY_PERIOD_MS: the records
+ *   together hold every tick the simulator fired and every pulse each motor took, and no tick
+ *   is timed longer than the tick itself.
+ * - The interrupt's hooks on their own, isrEnter(), stepped() of both axes and isrExit(), timed
+ *   over many calls on the host, against the average time of a whole tick of that move. That
+ *   share is what the instrumentation adds to the interrupt, and must stay under
+ *   TELEMETRY_MAX_SHARE. On the board the records' isrCounts time the interrupt in cycles.
+ *
+ * Pass a number of hook calls to time more than the default.
+ */
+
+#define TELEMETRY_DEFAULT_CALLS 10000000UL
+#define TELEMETRY_PAN           60.0        // Move measured [Degrees]
+#define TELEMETRY_TILT          -35.0
+#define TELEMETRY_SPEED         20.0        // [Degrees/Sec]
+#define TELEMETRY_MAX_SHARE     0.25        // Most the hooks may take of a tick's time on the host
+
+/**
+ * @brief Runs the main loop's side for a while, closing the records as their periods are up
+ */
+static void serviceFor(unsigned long us)
+{
+    Telemetry* telemetry = Telemetry::getInstance();
+    unsigned long end = halSimTime() + us;
+
+    while(halSimTime() < end){
+        halSimRun(STEP_TICK_US);
+        telemetry->service();
+    }
+}
+
+/**
+ * @brief Adds up the records in the ring
+ *
+ * @return Number of records
+ */
+static unsigned long sumRecords(TelemetryRecord* sum)
+{
+    Telemetry* telemetry = Telemetry::getInstance();
+    TelemetryRecord record;
+    unsigned long count = 0;
+
+    memset(sum, 0, sizeof(*sum));
+    telemetry->dump();
+    while(telemetry->next(&record) == 1){
+        sum->ticks += record.ticks;
+        sum->isrCounts += record.isrCounts;
+        if(record.isrMax > sum->isrMax)
+            sum->isrMax = record.isrMax;
+        for(uint8_t i = 0; i < STEP_ENGINE_AXES; i++)
+            sum->steps[i] += record.steps[i];
+        count++;
+    }
+    return count;
+}
+
+static void checkCounts(MotionProcessor* motion, HalSimIsrTime* isr)
+{
+    // Fill the ring with idle records first, so only the move shows up in it
+    serviceFor(TELEMETRY_RECORDS * TELEMETRY_PERIOD_MS * 1000UL);
+    unsigned long pulses[2] = {halSimPulses(0), halSimPulses(1)};
+    halSimClearIsrTime();
+
+    DoubleVector target = {TELEMETRY_PAN, TELEMETRY_TILT};
+    motion->line(target);
+    while(!motion->ready())
+        serviceFor(STEP_TICK_US);
+    serviceFor(TELEMETRY_PERIOD_MS * 1000UL);
+    halSimIsrTime(isr);
+
+    TelemetryRecord sum;
+    unsigned long records = sumRecords(&sum);
+    pulses[0] = halSimPulses(0) - pulses[0];
+    pulses[1] = halSimPulses(1) - pulses[1];
+    printf("records: %lu, %lu ticks, %lu/%lu steps, longest tick %.2f us of the simulated pulses, simulator fired %lu ticks, %lu/%lu pulses\n",
+           records, (unsigned long)sum.ticks, (unsigned long)sum.steps[0], (unsigned long)sum.steps[1],
+           (double)sum.isrMax / HAL_TIMER_COUNTS_PER_US, isr->calls, pulses[0], pulses[1]);
+
+    SIM_CHECK(records == TELEMETRY_RECORDS);
+    SIM_CHECK(isr->calls > 0);
+    SIM_CHECK(sum.ticks == isr->calls);
+    SIM_CHECK(sum.steps[0] == pulses[0]);
+    SIM_CHECK(sum.steps[1] == pulses[1]);
+    SIM_CHECK(pulses[0] == (unsigned long)lround(TELEMETRY_PAN / PAN_STEPRATE));
+    SIM_CHECK(sum.isrMax < STEP_TICK_US * HAL_TIMER_COUNTS_PER_US);
+    SIM_CHECK(sum.isrCounts <= sum.ticks * (uint32_t)sum.isrMax);
+}
+
+/**
+ * @brief Times the hooks a tick runs, with both axes stepping
+ *
+ * @return Host time of one tick's hooks [ns]
+ */
+static double timeHooks(unsigned long calls)
+{
+    Telemetry* telemetry = Telemetry::getInstance();
+    volatile uint8_t axisMask = 0x03;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(unsigned long i = 0; i < calls; i++){
+        telemetry->isrEnter();
+        telemetry->stepped(axisMask);
+        telemetry->isrExit();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    return ns / calls;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long calls = (argc > 1) ? strtoul(argv[1], NULL, 10) : TELEMETRY_DEFAULT_CALLS;
+    HalSimIsrTime isr;
+
+    MotionProcessor* motion = simRig(0);
+    motion->setPanSpeed(TELEMETRY_SPEED);
+    motion->setTiltSpeed(TELEMETRY_SPEED);
+    checkCounts(motion, &isr);
+
+    double hooks = timeHooks(calls);
+    double tick = isr.totalNs / isr.calls;
+    printf("step interrupt on the host: %.1f ns avg a tick, telemetry hooks %.2f ns of it, %.1f%%\n", tick, hooks, 100.0 * hooks / tick);
+    SIM_CHECK(hooks < TELEMETRY_MAX_SHARE * tick);
+
+    SIM_CHECK(halSimMissed(0) == 0);
+    SIM_CHECK(halSimMissed(1) == 0);
+    return simDone("telemetry_isr");
+}